@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2015 Andrew Kelley
+ *
+ * This file is part of zig, which is MIT licensed.
+ * See http://opensource.org/licenses/MIT
+ */
+
+// Measures how resolving top level declarations scales. A file of N
+// generated declarations, each of which depends on another, is analyzed for
+// N = count / 4, count / 2 and count, and the time of the resolve decls phase
+// is reported per declaration, which should stay about the same. Usage:
+//
+//     decl_bench [--decls count] [--runs N]
+
+#include "codegen.hpp"
+#include "os.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static int usage(const char *arg0) {
+    fprintf(stderr, "Usage: %s [--decls count] [--runs N]\n", arg0);
+    return 1;
+}
+
+// Every declaration but the last waits on the last one, so each of them is
+// still unresolved when its turn comes. Every tenth is a function and every
+// tenth a struct, so that all kinds of declaration are in the mix.
+static void gen_decls(Buf *out, int decl_count) {
+    buf_resize(out, 0);
+    for (int i = 0; i < decl_count - 1; i += 1) {
+        if (i % 10 == 1) {
+            buf_appendf(out, "fn f%d(a: T) -> T { a }\n", i);
+        } else if (i % 10 == 2) {
+            buf_appendf(out, "struct S%d { a: T, }\n", i);
+        } else {
+            buf_appendf(out, "const c%d: T = %d;\n", i, i);
+        }
+    }
+    buf_append_str(out, "const T = i32;\n");
+}
+
+static double resolve_seconds(Buf *dir, Buf *source) {
+    Buf *basename = buf_create_from_str("decls.zig");
+    Buf path = BUF_INIT;
+    os_path_join(buf_view(dir), buf_view(basename), &path);
+    os_write_file(&path, source);
+
+    CodeGen *g = codegen_create(dir);
+    codegen_set_out_type(g, OutTypeObj);
+    codegen_set_out_name(g, buf_create_from_str("decls"));
+    codegen_set_thread_count(g, 1);
+    codegen_set_time_report(g, true);
+    codegen_analyze_root_code(g, dir, basename, source);
+    unlink(buf_ptr(&path));
+
+    if (g->errors.length != 0) {
+        print_err_msg(g->errors.at(0), ErrColorAuto);
+        exit(1);
+    }
+    for (int i = 0; i < g->time_phases.length; i += 1) {
+        TimePhase *phase = &g->time_phases.at(i);
+        if (strcmp(phase->name, "resolve decls") == 0)
+            return phase->wall_seconds;
+    }
+    zig_unreachable();
+}
+
+int main(int argc, char **argv) {
+    int decl_count = 100000;
+    int runs = 3;
+
+    for (int i = 1; i < argc; i += 1) {
+        char *arg = argv[i];
+        if (i + 1 >= argc)
+            return usage(argv[0]);
+        if (strcmp(arg, "--decls") == 0) {
+            decl_count = atoi(argv[++i]);
+        } else if (strcmp(arg, "--runs") == 0) {
+            runs = atoi(argv[++i]);
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    if (decl_count < 4 || runs <= 0)
+        return usage(argv[0]);
+
+    char tmp_template[] = "/tmp/zig-decl-bench-XXXXXX";
+    if (!mkdtemp(tmp_template))
+        zig_panic("unable to create a temporary directory");
+    Buf *dir = buf_create_from_str(tmp_template);
+
+    Buf source = BUF_INIT;
+    for (int divisor = 4; divisor >= 1; divisor /= 2) {
+        int count = decl_count / divisor;
+        gen_decls(&source, count);
+        double best = 0.0;
+        for (int run = 0; run < runs; run += 1) {
+            double seconds = resolve_seconds(dir, &source);
+            if (run == 0 || seconds < best)
+                best = seconds;
+        }
+        printf("%7d decls: %8.3f ms, %.3f us/decl\n", count, best * 1000.0, best * 1000000.0 / count);
+    }
+
+    rmdir(tmp_template);
+    return 0;
+}
@@ -0,0 +1,328 @@
+/*
+ * Copyright (c) 2015 Andrew Kelley
+ *
+ * This file is part of zig, which is MIT licensed.
+ * See http://opensource.org/licenses/MIT
+ */
+
+// Measures tokenizer and parser throughput, in process. Without input files a
+// synthetic corpus is generated from a seed: many functions, deeply nested
+// blocks, large array literal tables, long operator chains, and many structs
+// and enums. The corpus is tokenized and parsed as one file several times and
+// the fastest run of each phase is reported, along with the allocations made
+// by one run. Usage:
+//
+//     frontend_bench [--size MiB] [--runs N] [--seed N] [--write-corpus path] [file...]
+
+#include "buffer.hpp"
+#include "os.hpp"
+#include "tokenizer.hpp"
+#include "parser.hpp"
+#include "error.hpp"
+
+#include <stdio.h>
+
+static int usage(const char *arg0) {
+    fprintf(stderr, "Usage: %s [--size MiB] [--runs N] [--seed N] [--write-corpus path] [file...]\n",
+            arg0);
+    return 1;
+}
+
+struct CorpusGen {
+    Buf *out;
+    uint64_t rand_state;
+    int name_index;
+};
+
+// xorshift64, so that a seed gives the same corpus everywhere
+static uint32_t gen_rand(CorpusGen *gen, uint32_t bound) {
+    uint64_t x = gen->rand_state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    gen->rand_state = x;
+    return (uint32_t)(x % bound);
+}
+
+static void gen_indent(CorpusGen *gen, int indent) {
+    for (int i = 0; i < indent; i += 1) {
+        buf_append_str(gen->out, "    ");
+    }
+}
+
+static const char *binary_ops[] = {"+", "-", "*", "/", "%", "&", "|", "^", "<<", ">>"};
+static const char *compare_ops[] = {"<", ">", "<=", ">=", "==", "!="};
+
+static void gen_operand(CorpusGen *gen) {
+    switch (gen_rand(gen, 4)) {
+        case 0:
+            buf_appendf(gen->out, "%u", gen_rand(gen, 100000));
+            break;
+        case 1:
+            buf_append_str(gen->out, gen_rand(gen, 2) ? "a" : "b");
+            break;
+        case 2:
+            buf_appendf(gen->out, "table_%d[%u]", gen_rand(gen, gen->name_index + 1), gen_rand(gen, 64));
+            break;
+        default:
+            buf_append_str(gen->out, "(a ");
+            buf_append_str(gen->out, binary_ops[gen_rand(gen, array_length(binary_ops))]);
+            buf_appendf(gen->out, " %u)", gen_rand(gen, 1000));
+            break;
+    }
+}
+
+static void gen_expr_chain(CorpusGen *gen, int length) {
+    gen_operand(gen);
+    for (int i = 1; i < length; i += 1) {
+        buf_append_char(gen->out, ' ');
+        buf_append_str(gen->out, binary_ops[gen_rand(gen, array_length(binary_ops))]);
+        buf_append_char(gen->out, ' ');
+        gen_operand(gen);
+    }
+}
+
+static void gen_block(CorpusGen *gen, int indent, int depth) {
+    int statement_count = 1 + gen_rand(gen, 4);
+    for (int i = 0; i < statement_count; i += 1) {
+        gen_indent(gen, indent);
+        uint32_t kind = depth > 0 ? gen_rand(gen, 4) : 0;
+        if (kind == 0) {
+            buf_append_str(gen->out, "x += ");
+            gen_expr_chain(gen, 2 + gen_rand(gen, 6));
+            buf_append_str(gen->out, ";\n");
+        } else if (kind == 1) {
+            buf_append_str(gen->out, "if (x ");
+            buf_append_str(gen->out, compare_ops[gen_rand(gen, array_length(compare_ops))]);
+            buf_append_char(gen->out, ' ');
+            gen_operand(gen);
+            buf_append_str(gen->out, ") {\n");
+            gen_block(gen, indent + 1, depth - 1);
+            gen_indent(gen, indent);
+            buf_append_str(gen->out, "} else {\n");
+            gen_block(gen, indent + 1, depth - 1);
+            gen_indent(gen, indent);
+            buf_append_str(gen->out, "}\n");
+        } else if (kind == 2) {
+            buf_append_str(gen->out, "while (x < b) {\n");
+            gen_block(gen, indent + 1, depth - 1);
+            gen_indent(gen, indent);
+            buf_append_str(gen->out, "}\n");
+        } else {
+            buf_append_str(gen->out, "{\n");
+            gen_block(gen, indent + 1, depth - 1);
+            gen_indent(gen, indent);
+            buf_append_str(gen->out, "}\n");
+        }
+    }
+}
+
+static void gen_struct(CorpusGen *gen, int index) {
+    buf_appendf(gen->out, "struct Struct_%d {\n", index);
+    int field_count = 1 + gen_rand(gen, 8);
+    for (int i = 0; i < field_count; i += 1) {
+        buf_appendf(gen->out, "    field_%d: %s,\n", i, gen_rand(gen, 2) ? "u64" : "i32");
+    }
+    buf_appendf(gen->out, "    pub fn get(self: &Struct_%d) -> u64 {\n", index);
+    buf_append_str(gen->out, "        self.field_0\n");
+    buf_append_str(gen->out, "    }\n");
+    buf_append_str(gen->out, "}\n\n");
+}
+
+static void gen_enum(CorpusGen *gen, int index) {
+    buf_appendf(gen->out, "enum Enum_%d {\n", index);
+    int member_count = 2 + gen_rand(gen, 12);
+    for (int i = 0; i < member_count; i += 1) {
+        if (gen_rand(gen, 3) == 0) {
+            buf_appendf(gen->out, "    Member_%d: Struct_%d,\n", i, index);
+        } else {
+            buf_appendf(gen->out, "    Member_%d,\n", i);
+        }
+    }
+    buf_append_str(gen->out, "}\n\n");
+}
+
+static void gen_table(CorpusGen *gen, int index) {
+    buf_appendf(gen->out, "const table_%d = []u32 {", index);
+    int entry_count = 64 + gen_rand(gen, 192);
+    for (int i = 0; i < entry_count; i += 1) {
+        buf_append_str(gen->out, (i % 12 == 0) ? "\n    " : " ");
+        buf_appendf(gen->out, "%u,", gen_rand(gen, 1000000));
+    }
+    buf_append_str(gen->out, "\n};\n\n");
+}
+
+static void gen_fn(CorpusGen *gen, int index) {
+    buf_appendf(gen->out, "fn function_%d(a: u32, b: u32) -> u32 {\n", index);
+    buf_append_str(gen->out, "    var x: u32 = a;\n");
+    gen_block(gen, 1, 1 + gen_rand(gen, 6));
+    buf_append_str(gen->out, "    return x ^ ");
+    gen_expr_chain(gen, 16 + gen_rand(gen, 48));
+    buf_append_str(gen->out, ";\n}\n\n");
+}
+
+static void gen_corpus(Buf *out, size_t size, uint64_t seed) {
+    CorpusGen gen = {0};
+    gen.out = out;
+    gen.rand_state = seed * 2654435761u + 1;
+    while ((size_t)buf_len(out) < size) {
+        int index = gen.name_index;
+        gen_struct(&gen, index);
+        gen_enum(&gen, index);
+        gen_table(&gen, index);
+        int fn_count = 4 + gen_rand(&gen, 8);
+        for (int i = 0; i < fn_count; i += 1) {
+            gen_fn(&gen, index * 16 + i);
+        }
+        gen.name_index += 1;
+    }
+}
+
+static uint64_t alloc_count_total(void) {
+    uint64_t count = 0;
+    for (int i = 0; i < AllocCategoryCount; i += 1) {
+        count += alloc_stats[i].count;
+    }
+    return count;
+}
+
+static uint64_t alloc_bytes_total(void) {
+    uint64_t bytes = 0;
+    for (int i = 0; i < AllocCategoryCount; i += 1) {
+        bytes += alloc_stats[i].bytes;
+    }
+    return bytes;
+}
+
+int main(int argc, char **argv) {
+    int size_mib = 16;
+    int runs = 5;
+    uint64_t seed = 1;
+    const char *corpus_path = nullptr;
+    Buf files = BUF_INIT;
+    buf_resize(&files, 0);
+    stats_enabled = true;
+
+    for (int i = 1; i < argc; i += 1) {
+        char *arg = argv[i];
+        if (arg[0] == '-') {
+            if (i + 1 >= argc)
+                return usage(argv[0]);
+            if (strcmp(arg, "--size") == 0) {
+                size_mib = atoi(argv[++i]);
+            } else if (strcmp(arg, "--runs") == 0) {
+                runs = atoi(argv[++i]);
+            } else if (strcmp(arg, "--seed") == 0) {
+                seed = strtoull(argv[++i], nullptr, 10);
+            } else if (strcmp(arg, "--write-corpus") == 0) {
+                corpus_path = argv[++i];
+            } else {
+                return usage(argv[0]);
+            }
+        } else {
+            Buf *path = buf_create_from_str(arg);
+            Buf *contents = buf_alloc();
+            int err;
+            if ((err = os_fetch_file_path(path, contents))) {
+                fprintf(stderr, "unable to open '%s': %s\n", arg, err_str(err));
+                return 1;
+            }
+            buf_append_buf(&files, contents);
+            // keep the last token of one file from running into the next
+            buf_append_char(&files, '\n');
+        }
+    }
+    if (size_mib <= 0 || runs <= 0)
+        return usage(argv[0]);
+
+    size_t size = (size_t)size_mib * 1024 * 1024;
+    Buf source = BUF_INIT;
+    buf_resize(&source, 0);
+    if (buf_len(&files) == 0) {
+        gen_corpus(&source, size, seed);
+    } else {
+        while ((size_t)buf_len(&source) < size) {
+            buf_append_buf(&source, &files);
+        }
+    }
+
+    if (corpus_path) {
+        os_write_file(buf_create_from_str(corpus_path), &source);
+    }
+
+    Buf *path = buf_create_from_str(corpus_path ? corpus_path : "corpus.zig");
+    double best_tokenize = 0.0;
+    double best_parse = 0.0;
+    int token_count = 0;
+    uint32_t node_count = 0;
+    uint64_t tokenize_allocs = 0;
+    uint64_t tokenize_alloc_bytes = 0;
+    uint64_t parse_allocs = 0;
+    uint64_t parse_alloc_bytes = 0;
+    size_t arena_bytes = 0;
+    for (int run = 0; run < runs; run += 1) {
+        uint64_t allocs_start = alloc_count_total();
+        uint64_t bytes_start = alloc_bytes_total();
+        double start = os_get_time();
+        Tokenization tokenization = {0};
+        tokenize(&source, &tokenization);
+        double tokenize_elapsed = os_get_time() - start;
+
+        if (tokenization.err) {
+            fprintf(stderr, "line %d: %s\n", tokenization.err_line + 1, buf_ptr(tokenization.err));
+            return 1;
+        }
+        uint64_t allocs_mid = alloc_count_total();
+        uint64_t bytes_mid = alloc_bytes_total();
+
+        ImportTableEntry *import_entry = allocate<ImportTableEntry>(1);
+        import_entry->ast_arena.category = AllocCategoryAst;
+        import_entry->source_code = &source;
+        import_entry->path = path;
+        import_entry->line_offsets = tokenization.line_offsets;
+
+        uint32_t next_node_index = 0;
+        ErrorMsg *parse_err = nullptr;
+        start = os_get_time();
+        AstNode *root = ast_try_parse(&source, &tokenization, import_entry, &next_node_index, &parse_err);
+        double parse_elapsed = os_get_time() - start;
+
+        if (!root) {
+            print_err_msg(parse_err, ErrColorAuto);
+            return 1;
+        }
+
+        token_count = tokenization.tokens->length;
+        node_count = next_node_index;
+        tokenize_allocs = allocs_mid - allocs_start;
+        tokenize_alloc_bytes = bytes_mid - bytes_start;
+        parse_allocs = alloc_count_total() - allocs_mid;
+        parse_alloc_bytes = alloc_bytes_total() - bytes_mid;
+        arena_bytes = import_entry->ast_arena.bytes_used;
+        if (run == 0 || tokenize_elapsed < best_tokenize)
+            best_tokenize = tokenize_elapsed;
+        if (run == 0 || parse_elapsed < best_parse)
+            best_parse = parse_elapsed;
+
+        arena_deinit(&import_entry->ast_arena);
+        free(import_entry);
+        tokenization.tokens->deinit();
+        tokenization.line_offsets->deinit();
+        tokenization.number_literals->deinit();
+        free(tokenization.tokens);
+        free(tokenization.line_offsets);
+        free(tokenization.number_literals);
+    }
+
+    double mib = buf_len(&source) / (1024.0 * 1024.0);
+    printf("%.1f MiB, %d tokens, %" PRIu32 " nodes, best of %d runs\n", mib, token_count, node_count, runs);
+    printf("tokenize: %.3f s, %.1f MiB/s, %.2f M tokens/s, %" PRIu64 " allocations (%.1f MiB)\n",
+            best_tokenize, mib / best_tokenize, token_count / best_tokenize / 1000000.0,
+            tokenize_allocs, tokenize_alloc_bytes / (1024.0 * 1024.0));
+    printf("parse:    %.3f s, %.1f MiB/s, %.2f M nodes/s, %" PRIu64 " allocations (%.1f MiB)\n",
+            best_parse, mib / best_parse, node_count / best_parse / 1000000.0,
+            parse_allocs, parse_alloc_bytes / (1024.0 * 1024.0));
+    printf("ast arena: %.1f MiB used, %.1f bytes/node\n",
+            arena_bytes / (1024.0 * 1024.0), node_count ? (double)arena_bytes / node_count : 0.0);
+    return 0;
+}
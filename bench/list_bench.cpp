@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2015 Andrew Kelley
+ *
+ * This file is part of zig, which is MIT licensed.
+ * See http://opensource.org/licenses/MIT
+ */
+
+// Counts heap allocations made while tokenizing and parsing a set of source
+// files, then compares ZigList against SmallList on the list lengths which
+// are typical for the AST. Usage:
+//
+//     list_bench std/*.zig
+
+#include "list.hpp"
+#include "buffer.hpp"
+#include "os.hpp"
+#include "tokenizer.hpp"
+#include "parser.hpp"
+#include "error.hpp"
+
+#include <stdio.h>
+#include <time.h>
+
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+
+static size_t alloc_count;
+
+extern "C" void *malloc(size_t size) {
+    alloc_count += 1;
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size) {
+    alloc_count += 1;
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size) {
+    alloc_count += 1;
+    return __libc_realloc(ptr, size);
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static void bench_parse(int file_count, char **file_names) {
+    size_t total_allocs = 0;
+    uint32_t total_nodes = 0;
+    uint32_t next_node_index = 0;
+    for (int i = 0; i < file_count; i += 1) {
+        Buf *path = buf_create_from_str(file_names[i]);
+        Buf *source = buf_alloc();
+        int err;
+        if ((err = os_fetch_file_path(path, source))) {
+            fprintf(stderr, "unable to open '%s': %s\n", file_names[i], err_str(err));
+            exit(1);
+        }
+
+        size_t allocs_before = alloc_count;
+        uint32_t nodes_before = next_node_index;
+
+        Tokenization tokenization = {0};
+        tokenize(source, &tokenization);
+        if (tokenization.err) {
+            fprintf(stderr, "%s: %s\n", file_names[i], buf_ptr(tokenization.err));
+            exit(1);
+        }
+        ImportTableEntry *import = allocate<ImportTableEntry>(1);
+        import->source_code = source;
+        import->line_offsets = tokenization.line_offsets;
+        import->path = path;
+        ast_parse(source, &tokenization, import, ErrColorOff, &next_node_index);
+
+        size_t allocs = alloc_count - allocs_before;
+        uint32_t nodes = next_node_index - nodes_before;
+        printf("%-40s %8u nodes %8zu allocations\n", file_names[i], nodes, allocs);
+        total_allocs += allocs;
+        total_nodes += nodes;
+    }
+    printf("%-40s %8u nodes %8zu allocations\n\n", "total", total_nodes, total_allocs);
+}
+
+template<typename List>
+static void bench_list(const char *name, int iterations) {
+    // argument and prong lists in the compiler's own sources are mostly
+    // 0 to 3 items long
+    static const int lengths[] = {0, 1, 1, 2, 2, 2, 3, 3, 5, 9};
+    size_t allocs_before = alloc_count;
+    double start = now_seconds();
+    for (int i = 0; i < iterations; i += 1) {
+        List list = {};
+        int length = lengths[i % array_length(lengths)];
+        for (int j = 0; j < length; j += 1) {
+            list.append(reinterpret_cast<void *>(j));
+        }
+        list.deinit();
+    }
+    double elapsed = now_seconds() - start;
+    printf("%-24s %10zu allocations %8.2f ns/list\n", name,
+            alloc_count - allocs_before, elapsed * 1000000000.0 / iterations);
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        bench_parse(argc - 1, argv + 1);
+    }
+
+    int iterations = 10000000;
+    bench_list<ZigList<void *>>("ZigList", iterations);
+    bench_list<SmallList<void *, 2>>("SmallList<N=2>", iterations);
+    bench_list<SmallList<void *, 4>>("SmallList<N=4>", iterations);
+    return 0;
+}
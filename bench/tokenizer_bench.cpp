@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2015 Andrew Kelley
+ *
+ * This file is part of zig, which is MIT licensed.
+ * See http://opensource.org/licenses/MIT
+ */
+
+// Measures tokenizer throughput. The given source files are concatenated and
+// repeated until the input reaches the requested size, which is then
+// tokenized several times; the fastest run is reported. Usage:
+//
+//     tokenizer_bench [--size MiB] [--runs N] [--threads N] std/*.zig
+
+#include "buffer.hpp"
+#include "os.hpp"
+#include "tokenizer.hpp"
+#include "error.hpp"
+
+#include <stdio.h>
+
+static int usage(const char *arg0) {
+    fprintf(stderr, "Usage: %s [--size MiB] [--runs N] [--threads N] file...\n", arg0);
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    int size_mib = 64;
+    int runs = 5;
+    int thread_count = 1;
+    Buf files = BUF_INIT;
+    buf_resize(&files, 0);
+
+    for (int i = 1; i < argc; i += 1) {
+        char *arg = argv[i];
+        if (arg[0] == '-') {
+            if (i + 1 >= argc)
+                return usage(argv[0]);
+            if (strcmp(arg, "--size") == 0) {
+                size_mib = atoi(argv[++i]);
+            } else if (strcmp(arg, "--runs") == 0) {
+                runs = atoi(argv[++i]);
+            } else if (strcmp(arg, "--threads") == 0) {
+                thread_count = atoi(argv[++i]);
+            } else {
+                return usage(argv[0]);
+            }
+        } else {
+            Buf *path = buf_create_from_str(arg);
+            Buf *contents = buf_alloc();
+            int err;
+            if ((err = os_fetch_file_path(path, contents))) {
+                fprintf(stderr, "unable to open '%s': %s\n", arg, err_str(err));
+                return 1;
+            }
+            buf_append_buf(&files, contents);
+            // keep the last token of one file from running into the next
+            buf_append_char(&files, '\n');
+        }
+    }
+    if (buf_len(&files) == 0 || size_mib <= 0 || runs <= 0 || thread_count <= 0)
+        return usage(argv[0]);
+
+    Buf source = BUF_INIT;
+    buf_resize(&source, 0);
+    while (buf_len(&source) < size_mib * 1024 * 1024) {
+        buf_append_buf(&source, &files);
+    }
+
+    double best = 0.0;
+    int token_count = 0;
+    for (int run = 0; run < runs; run += 1) {
+        double start = os_get_time();
+        Tokenization tokenization = {0};
+        tokenize_parallel(&source, &tokenization, thread_count);
+        double elapsed = os_get_time() - start;
+
+        if (tokenization.err) {
+            fprintf(stderr, "line %d: %s\n", tokenization.err_line + 1, buf_ptr(tokenization.err));
+            return 1;
+        }
+        token_count = tokenization.tokens->length;
+        if (run == 0 || elapsed < best)
+            best = elapsed;
+
+        tokenization.tokens->deinit();
+        tokenization.line_offsets->deinit();
+        tokenization.number_literals->deinit();
+        free(tokenization.tokens);
+        free(tokenization.line_offsets);
+        free(tokenization.number_literals);
+    }
+
+    double mib = buf_len(&source) / (1024.0 * 1024.0);
+    printf("%.1f MiB, %d tokens, best of %d runs: %.3f s\n", mib, token_count, runs, best);
+    printf("%.1f MiB/s, %.2f M tokens/s\n", mib / best, token_count / best / 1000000.0);
+    return 0;
+}
@@ -10,10 +10,16 @@
 
 #include "list.hpp"
 #include "buffer.hpp"
+#include "intern.hpp"
+#include "scope_table.hpp"
 #include "zig_llvm.hpp"
 #include "hash_map.hpp"
 #include "errmsg.hpp"
 #include "bignum.hpp"
+#include "arena.hpp"
+#include "side_table.hpp"
+
+#include <stdio.h>
 
 struct AstNode;
 struct ImportTableEntry;
@@ -100,7 +106,7 @@ struct StructValExprCodeGen {
 
 struct TopLevelDecl {
     // reminder: hash tables must be initialized before use
-    HashMap<Buf *, AstNode *, buf_hash, buf_eql_buf> deps;
+    HashMap<Buf *, AstNode *, intern_hash, intern_eql> deps;
     Buf *name;
     ImportTableEntry *import;
     // set this flag temporarily to detect infinite loops
@@ -174,8 +180,8 @@ enum VisibMod {
 struct AstNodeFnProto {
     ZigList<AstNode *> *directives;
     VisibMod visib_mod;
-    Buf name;
-    ZigList<AstNode *> params;
+    Buf *name;
+    SmallList<AstNode *, 3> params;
     AstNode *return_type;
     bool is_var_args;
     bool is_extern;
@@ -188,7 +194,6 @@ struct AstNodeFnProto {
     AstNode *fn_def_node;
     FnTableEntry *fn_table_entry;
     bool skip;
-    TopLevelDecl top_level_decl;
 };
 
 struct AstNodeFnDef {
@@ -205,7 +210,7 @@ struct AstNodeFnDecl {
 };
 
 struct AstNodeParamDecl {
-    Buf name;
+    Buf *name;
     AstNode *type;
     bool is_noalias;
 
@@ -221,7 +226,6 @@ struct AstNodeBlock {
 
     // populated by semantic analyzer
     BlockContext *block_context;
-    Expr resolved_expr;
 };
 
 enum ReturnKind {
@@ -234,13 +238,10 @@ struct AstNodeReturnExpr {
     ReturnKind kind;
     // might be null in case of return void;
     AstNode *expr;
-
-    // populated by semantic analyzer:
-    Expr resolved_expr;
 };
 
 struct AstNodeVariableDeclaration {
-    Buf symbol;
+    Buf *symbol;
     bool is_const;
     bool is_extern;
     VisibMod visib_mod;
@@ -250,18 +251,13 @@ struct AstNodeVariableDeclaration {
     ZigList<AstNode *> *directives;
 
     // populated by semantic analyzer
-    TopLevelDecl top_level_decl;
-    Expr resolved_expr;
     VariableTableEntry *variable;
 };
 
 struct AstNodeErrorValueDecl {
-    Buf name;
+    Buf *name;
     VisibMod visib_mod;
     ZigList<AstNode *> *directives;
-
-    // populated by semantic analyzer
-    TopLevelDecl top_level_decl;
 };
 
 enum BinOpType {
@@ -309,7 +305,6 @@ struct AstNodeBinOpExpr {
     // populated by semantic analyzer:
     // for when op is BinOpTypeAssign
     VariableTableEntry *var_entry;
-    Expr resolved_expr;
 };
 
 struct AstNodeUnwrapErrorExpr {
@@ -318,7 +313,6 @@ struct AstNodeUnwrapErrorExpr {
     AstNode *op2;
 
     // populated by semantic analyzer:
-    Expr resolved_expr;
     VariableTableEntry *var;
 };
 
@@ -338,12 +332,11 @@ enum CastOp {
 
 struct AstNodeFnCallExpr {
     AstNode *fn_ref_expr;
-    ZigList<AstNode *> params;
+    SmallList<AstNode *, 4> params;
     bool is_builtin;
 
     // populated by semantic analyzer:
     BuiltinFnEntry *builtin_fn;
-    Expr resolved_expr;
     FnTableEntry *fn_entry;
     CastOp cast_op;
     // if cast_op is CastOpArrayToString, this will be a pointer to
@@ -354,9 +347,6 @@ struct AstNodeFnCallExpr {
 struct AstNodeArrayAccessExpr {
     AstNode *array_ref_expr;
     AstNode *subscript;
-
-    // populated by semantic analyzer:
-    Expr resolved_expr;
 };
 
 struct AstNodeSliceExpr {
@@ -364,30 +354,24 @@ struct AstNodeSliceExpr {
     AstNode *start;
     AstNode *end;
     bool is_const;
-
-    // populated by semantic analyzer:
-    Expr resolved_expr;
-    StructValExprCodeGen resolved_struct_val_expr;
 };
 
 struct AstNodeFieldAccessExpr {
     AstNode *struct_expr;
-    Buf field_name;
+    Buf *field_name;
 
     // populated by semantic analyzer
     TypeStructField *type_struct_field;
     TypeEnumField *type_enum_field;
-    Expr resolved_expr;
-    StructValExprCodeGen resolved_struct_val_expr; // for enum values
 };
 
 struct AstNodeDirective {
-    Buf name;
+    Buf *name;
     Buf param;
 };
 
 struct AstNodeRootExportDecl {
-    Buf type;
+    Buf *type;
     Buf name;
     ZigList<AstNode *> *directives;
 };
@@ -408,9 +392,6 @@ enum PrefixOp {
 struct AstNodePrefixOpExpr {
     PrefixOp prefix_op;
     AstNode *primary_expr;
-
-    // populated by semantic analyzer
-    Expr resolved_expr;
 };
 
 struct AstNodeImport {
@@ -426,18 +407,12 @@ struct AstNodeCImport {
     ZigList<AstNode *> *directives;
     VisibMod visib_mod;
     AstNode *block;
-
-    // populated by semantic analyzer
-    TopLevelDecl top_level_decl;
 };
 
 struct AstNodeIfBoolExpr {
     AstNode *condition;
     AstNode *then_block;
     AstNode *else_node; // null, block node, or other if expr node
-
-    // populated by semantic analyzer
-    Expr resolved_expr;
 };
 
 struct AstNodeIfVarExpr {
@@ -447,7 +422,6 @@ struct AstNodeIfVarExpr {
 
     // populated by semantic analyzer
     TypeTableEntry *type;
-    Expr resolved_expr;
 };
 
 struct AstNodeWhileExpr {
@@ -457,7 +431,6 @@ struct AstNodeWhileExpr {
     // populated by semantic analyzer
     bool condition_always_true;
     bool contains_break;
-    Expr resolved_expr;
     BlockContext *block_context;
 };
 
@@ -469,7 +442,6 @@ struct AstNodeForExpr {
 
     // populated by semantic analyzer
     bool contains_break;
-    Expr resolved_expr;
     VariableTableEntry *elem_var;
     VariableTableEntry *index_var;
 };
@@ -477,13 +449,10 @@ struct AstNodeForExpr {
 struct AstNodeSwitchExpr {
     AstNode *expr;
     ZigList<AstNode *> prongs;
-
-    // populated by semantic analyzer
-    Expr resolved_expr;
 };
 
 struct AstNodeSwitchProng {
-    ZigList<AstNode *> items;
+    SmallList<AstNode *, 2> items;
     AstNode *var_symbol;
     AstNode *expr;
 
@@ -498,30 +467,31 @@ struct AstNodeSwitchRange {
 };
 
 struct AstNodeLabel {
-    Buf name;
+    Buf *name;
 
     // populated by semantic analyzer
     LabelTableEntry *label_entry;
-    Expr resolved_expr;
 };
 
 struct AstNodeGoto {
-    Buf name;
+    Buf *name;
 
     // populated by semantic analyzer
     LabelTableEntry *label_entry;
-    Expr resolved_expr;
 };
 
 struct AsmOutput {
-    Buf asm_symbolic_name;
+    Buf *asm_symbolic_name;
     Buf constraint;
-    Buf variable_name;
+    Buf *variable_name;
     AstNode *return_type; // null unless "=r" and return
+
+    // populated by semantic analyzer
+    VariableTableEntry *variable;
 };
 
 struct AsmInput {
-    Buf asm_symbolic_name;
+    Buf *asm_symbolic_name;
     Buf constraint;
     AstNode *expr;
 };
@@ -542,7 +512,6 @@ struct AstNodeAsmExpr {
 
     // populated by semantic analyzer
     int return_count;
-    Expr resolved_expr;
 };
 
 enum ContainerKind {
@@ -551,7 +520,7 @@ enum ContainerKind {
 };
 
 struct AstNodeStructDecl {
-    Buf name;
+    Buf *name;
     ContainerKind kind;
     ZigList<AstNode *> fields;
     ZigList<AstNode *> fns;
@@ -560,11 +529,10 @@ struct AstNodeStructDecl {
 
     // populated by semantic analyzer
     TypeTableEntry *type_entry;
-    TopLevelDecl top_level_decl;
 };
 
 struct AstNodeStructField {
-    Buf name;
+    Buf *name;
     AstNode *type;
     ZigList<AstNode *> *directives;
     VisibMod visib_mod;
@@ -573,16 +541,10 @@ struct AstNodeStructField {
 struct AstNodeStringLiteral {
     Buf buf;
     bool c;
-
-    // populated by semantic analyzer:
-    Expr resolved_expr;
 };
 
 struct AstNodeCharLiteral {
     uint8_t value;
-
-    // populated by semantic analyzer:
-    Expr resolved_expr;
 };
 
 enum NumLit {
@@ -601,13 +563,10 @@ struct AstNodeNumberLiteral {
         uint64_t x_uint;
         double x_float;
     } data;
-
-    // populated by semantic analyzer
-    Expr resolved_expr;
 };
 
 struct AstNodeStructValueField {
-    Buf name;
+    Buf *name;
     AstNode *expr;
 
     // populated by semantic analyzer
@@ -621,31 +580,20 @@ enum ContainerInitKind {
 
 struct AstNodeContainerInitExpr {
     AstNode *type;
-    ZigList<AstNode *> entries;
+    SmallList<AstNode *, 4> entries;
     ContainerInitKind kind;
-
-    // populated by semantic analyzer
-    StructValExprCodeGen resolved_struct_val_expr;
-    Expr resolved_expr;
 };
 
 struct AstNodeNullLiteral {
-    // populated by semantic analyzer
-    StructValExprCodeGen resolved_struct_val_expr;
-    Expr resolved_expr;
 };
 
 struct AstNodeUndefinedLiteral {
-    // populated by semantic analyzer
-    StructValExprCodeGen resolved_struct_val_expr;
-    Expr resolved_expr;
 };
 
 struct AstNodeSymbolExpr {
-    Buf symbol;
+    Buf *symbol;
 
     // populated by semantic analyzer
-    Expr resolved_expr;
     VariableTableEntry *variable;
     FnTableEntry *fn_entry;
     // set this to instead of analyzing the node, pretend it's a type entry and it's this one.
@@ -654,33 +602,21 @@ struct AstNodeSymbolExpr {
 
 struct AstNodeBoolLiteral {
     bool value;
-
-    // populated by semantic analyzer
-    Expr resolved_expr;
 };
 
 struct AstNodeBreakExpr {
-    // populated by semantic analyzer
-    Expr resolved_expr;
 };
 
 struct AstNodeContinueExpr {
-    // populated by semantic analyzer
-    Expr resolved_expr;
 };
 
 struct AstNodeArrayType {
     AstNode *size;
     AstNode *child_type;
     bool is_const;
-
-    // populated by semantic analyzer
-    Expr resolved_expr;
 };
 
 struct AstNodeErrorType {
-    // populated by semantic analyzer
-    Expr resolved_expr;
 };
 
 struct AstNode {
@@ -784,7 +720,7 @@ struct TypeTableEntryStruct {
     bool is_invalid; // true if any fields are invalid
     bool is_unknown_size_array;
     // reminder: hash tables must be initialized before use
-    HashMap<Buf *, FnTableEntry *, buf_hash, buf_eql_buf> fn_table;
+    HashMap<Buf *, FnTableEntry *, intern_hash, intern_eql> fn_table;
 
     // set this flag temporarily to detect infinite loops
     bool embedded_in_current;
@@ -810,7 +746,7 @@ struct TypeTableEntryEnum {
     TypeTableEntry *tag_type;
 
     // reminder: hash tables must be initialized before use
-    HashMap<Buf *, FnTableEntry *, buf_hash, buf_eql_buf> fn_table;
+    HashMap<Buf *, FnTableEntry *, intern_hash, intern_eql> fn_table;
 
     // set this flag temporarily to detect infinite loops
     bool embedded_in_current;
@@ -829,6 +765,7 @@ struct TypeTableEntryFn {
     int gen_param_count;
     LLVMCallConv calling_convention;
     bool is_naked;
+    bool is_inline;
 };
 
 enum TypeTableEntryId {
@@ -862,6 +799,14 @@ struct TypeTableEntry {
 
     Buf name;
 
+    // Types derived from this one, published with a release store. They are
+    // also in CodeGen::derived_type_table, and are only kept here so that
+    // the common lookups do not take the type lock.
+    TypeTableEntry *pointer_parent[2];
+    TypeTableEntry *unknown_size_array_parent[2];
+    TypeTableEntry *maybe_parent;
+    TypeTableEntry *error_parent;
+
     union {
         TypeTableEntryPointer pointer;
         TypeTableEntryInt integral;
@@ -872,15 +817,28 @@ struct TypeTableEntry {
         TypeTableEntryEnum enumeration;
         TypeTableEntryFn fn;
     } data;
+};
 
-    // use these fields to make sure we don't duplicate type table entries for the same type
-    TypeTableEntry *pointer_parent[2];
-    TypeTableEntry *unknown_size_array_parent[2];
-    HashMap<uint64_t, TypeTableEntry *, uint64_hash, uint64_eq> arrays_by_size;
-    TypeTableEntry *maybe_parent;
-    TypeTableEntry *error_parent;
+// What a derived type is made of, which identifies it in
+// CodeGen::derived_type_table. child is the pointed to, element, payload or
+// return type, and a slice has the id TypeTableEntryIdStruct. Fields which do
+// not apply to the id are zero.
+struct DerivedTypeKey {
+    TypeTableEntryId id;
+    TypeTableEntry *child;
+    uint64_t array_len;
+    bool is_const;
+    TypeTableEntry **param_types;
+    int param_count;
+    bool is_var_args;
+    bool is_naked;
+    bool is_inline;
+    LLVMCallConv calling_convention;
 };
 
+uint32_t derived_type_key_hash(DerivedTypeKey key);
+bool derived_type_key_eql(DerivedTypeKey a, DerivedTypeKey b);
+
 struct ImporterInfo {
     ImportTableEntry *import;
     AstNode *source_node;
@@ -890,15 +848,19 @@ struct ImportTableEntry {
     AstNode *root;
     Buf *path; // relative to root_source_dir
     LLVMZigDIFile *di_file;
+    // read only. usually a mapping of the file, which error messages point
+    // into, so it is never unmapped.
     Buf *source_code;
     ZigList<int> *line_offsets;
     BlockContext *block_context;
     ZigList<ImporterInfo> importers;
     AstNode *c_import_node;
 
+    // backing memory for the AST nodes of this import
+    Arena ast_arena;
+
     // reminder: hash tables must be initialized before use
-    HashMap<Buf *, FnTableEntry *, buf_hash, buf_eql_buf> fn_table;
-    HashMap<Buf *, TypeTableEntry *, buf_hash, buf_eql_buf> fn_type_table;
+    HashMap<Buf *, FnTableEntry *, intern_hash, intern_eql> fn_table;
 };
 
 struct LabelTableEntry {
@@ -908,6 +870,26 @@ struct LabelTableEntry {
     bool entered_from_fallthrough;
 };
 
+// a local variable while it is in scope
+struct LocalBinding {
+    Buf *name;
+    VariableTableEntry *var;
+    // of the block context which declares it
+    int depth;
+    // the binding of the same name which this one hides, or -1
+    int shadowed;
+};
+
+// The local variables in scope at the point a function body is being
+// analyzed, so that looking one up takes a single hash lookup however deeply
+// the scopes are nested. names maps each name to its innermost binding.
+// bindings is in declaration order and also serves as the undo log: when a
+// scope ends, its bindings are popped and the ones they hid are put back.
+struct LocalScopes {
+    HashMap<Buf *, int, intern_hash, intern_eql> names;
+    ZigList<LocalBinding> bindings;
+};
+
 struct FnTableEntry {
     LLVMValueRef fn_value;
     AstNode *proto_node;
@@ -921,9 +903,11 @@ struct FnTableEntry {
     bool is_inline;
     bool internal_linkage;
     bool is_extern;
+    // only set while the body is analyzed
+    LocalScopes *local_scopes;
 
     // reminder: hash tables must be initialized before use
-    HashMap<Buf *, LabelTableEntry *, buf_hash, buf_eql_buf> label_table;
+    HashMap<Buf *, LabelTableEntry *, intern_hash, intern_eql> label_table;
 };
 
 enum BuiltinFnId {
@@ -945,13 +929,30 @@ enum BuiltinFnId {
 
 struct BuiltinFnEntry {
     BuiltinFnId id;
-    Buf name;
+    Buf *name;
     int param_count;
     TypeTableEntry *return_type;
     TypeTableEntry **param_types;
     LLVMValueRef fn_val;
 };
 
+// one measured stage of the compilation, for --time-report
+struct TimePhase {
+    const char *name;
+    // such as the path of the import being parsed, or nullptr
+    Buf *detail;
+    int depth;
+    double wall_start;
+    double cpu_start;
+    double wall_seconds;
+    double cpu_seconds;
+};
+
+enum StatsFormat {
+    StatsFormatText,
+    StatsFormatJson,
+};
+
 struct CodeGen {
     LLVMModuleRef module;
     ZigList<ErrorMsg*> errors;
@@ -964,9 +965,15 @@ struct CodeGen {
     // reminder: hash tables must be initialized before use
     HashMap<Buf *, bool, buf_hash, buf_eql_buf> link_table;
     HashMap<Buf *, ImportTableEntry *, buf_hash, buf_eql_buf> import_table;
-    HashMap<Buf *, BuiltinFnEntry *, buf_hash, buf_eql_buf> builtin_fn_table;
-    HashMap<Buf *, TypeTableEntry *, buf_hash, buf_eql_buf> primitive_type_table;
-    HashMap<Buf *, AstNode *, buf_hash, buf_eql_buf> unresolved_top_level_decls;
+    HashMap<Buf *, BuiltinFnEntry *, intern_hash, intern_eql> builtin_fn_table;
+    HashMap<Buf *, TypeTableEntry *, intern_hash, intern_eql> primitive_type_table;
+    // pointer, array, slice, maybe, error union and fn types, so that each
+    // is only created once. guarded by the type lock in analyze.cpp.
+    HashMap<DerivedTypeKey, TypeTableEntry *, derived_type_key_hash, derived_type_key_eql> derived_type_table;
+    HashMap<Buf *, AstNode *, intern_hash, intern_eql> unresolved_top_level_decls;
+    // the nodes of unresolved_top_level_decls as a min-heap on create_index.
+    // nodes which have been resolved since are skipped when they come up.
+    ZigList<AstNode *> unresolved_decl_queue;
 
     uint32_t next_unresolved_index;
 
@@ -1039,6 +1046,43 @@ struct CodeGen {
     bool error_during_imports;
     uint32_t next_node_index;
     uint32_t next_error_index;
+
+    // semantic analysis results, indexed by AstNode::create_index
+    SideTable<Expr> resolved_exprs;
+    SideTable<StructValExprCodeGen *> resolved_struct_val_exprs;
+    SideTable<TopLevelDecl *> resolved_top_level_decls;
+
+    uint32_t block_context_count;
+    uint32_t promoted_scope_table_count;
+    uint32_t type_entry_count;
+
+    // for loading imports, tokenizing large files and analyzing fn bodies
+    int thread_count;
+
+    // where parsed files are cached; nullptr when caching is off
+    Buf *ast_cache_dir;
+    // cached files are only used by the compiler which wrote them
+    uint64_t compiler_id;
+    uint64_t ast_cache_hits;
+    uint64_t ast_cache_misses;
+    // entries written by another compiler version, or damaged
+    uint64_t ast_cache_stale;
+    uint64_t ast_cache_stores;
+    double ast_cache_load_seconds;
+
+    // --stats; also printed when the compile fails
+    bool print_stats;
+    StatsFormat stats_format;
+
+    bool time_report;
+    ZigList<TimePhase> time_phases;
+    int time_phase_depth;
+
+    // --trace-out; nullptr when not tracing
+    FILE *trace_file;
+    double trace_start;
+    bool trace_need_comma;
+
     uint32_t error_value_count;
     TypeTableEntry *err_tag_type;
     LLVMValueRef int_overflow_fns[2][3][4]; // [0-signed,1-unsigned][0-add,1-sub,2-mul][0-8,1-16,2-32,3-64]
@@ -1048,7 +1092,7 @@ struct CodeGen {
 };
 
 struct VariableTableEntry {
-    Buf name;
+    Buf *name;
     TypeTableEntry *type;
     LLVMValueRef value_ref;
     bool is_const;
@@ -1060,7 +1104,7 @@ struct VariableTableEntry {
 };
 
 struct ErrorTableEntry {
-    Buf name;
+    Buf *name;
     uint32_t value;
     AstNode *decl_node;
 };
@@ -1069,9 +1113,14 @@ struct BlockContext {
     AstNode *node; // either NodeTypeFnDef or NodeTypeBlock or NodeTypeRoot
     FnTableEntry *fn_entry; // null at the module scope
     BlockContext *parent; // null when this is the root
-    HashMap<Buf *, VariableTableEntry *, buf_hash, buf_eql_buf> variable_table;
-    HashMap<Buf *, TypeTableEntry *, buf_hash, buf_eql_buf> type_table;
-    HashMap<Buf *, ErrorTableEntry *, buf_hash, buf_eql_buf> error_table;
+    int depth; // 0 at the root
+    // the variables of a scope inside a function are in
+    // fn_entry->local_scopes instead
+    ScopeTable<VariableTableEntry *> variable_table;
+    // types and errors are only declared at the module scope, so these are
+    // null until the first one is added
+    ScopeTable<TypeTableEntry *> *type_table;
+    ScopeTable<ErrorTableEntry *> *error_table;
     ZigList<AstNode *> cast_alloca_list;
     ZigList<StructValExprCodeGen *> struct_val_expr_alloca_list;
     ZigList<VariableTableEntry *> variable_list;
@@ -1080,6 +1129,22 @@ struct BlockContext {
     Buf *c_import_buf;
 };
 
+ZIG_ALLOC_CATEGORY(AstNode, AllocCategoryAst);
+ZIG_ALLOC_CATEGORY(AsmInput, AllocCategoryAst);
+ZIG_ALLOC_CATEGORY(AsmOutput, AllocCategoryAst);
+ZIG_ALLOC_CATEGORY(TypeTableEntry, AllocCategoryTypes);
+ZIG_ALLOC_CATEGORY(TypeTableEntry *, AllocCategoryTypes);
+ZIG_ALLOC_CATEGORY(TypeStructField, AllocCategoryTypes);
+ZIG_ALLOC_CATEGORY(TypeEnumField, AllocCategoryTypes);
+ZIG_ALLOC_CATEGORY(BlockContext, AllocCategoryScopes);
+ZIG_ALLOC_CATEGORY(VariableTableEntry, AllocCategoryScopes);
+ZIG_ALLOC_CATEGORY(LabelTableEntry, AllocCategoryScopes);
+ZIG_ALLOC_CATEGORY(LLVMValueRef, AllocCategoryLlvm);
+ZIG_ALLOC_CATEGORY(LLVMTypeRef, AllocCategoryLlvm);
+ZIG_ALLOC_CATEGORY(LLVMBasicBlockRef, AllocCategoryLlvm);
+ZIG_ALLOC_CATEGORY(LLVMZigDIType *, AllocCategoryLlvm);
+ZIG_ALLOC_CATEGORY(LLVMZigDIEnumerator *, AllocCategoryLlvm);
+
 struct ParseH {
     ZigList<ErrorMsg*> errors;
     ZigList<AstNode *> fn_list;
@@ -13,13 +13,16 @@
 #include "parseh.hpp"
 #include "config.h"
 #include "ast_render.hpp"
+#include "timing.hpp"
+
+#include <pthread.h>
 
 static TypeTableEntry * analyze_expression(CodeGen *g, ImportTableEntry *import, BlockContext *context,
         TypeTableEntry *expected_type, AstNode *node);
 static VariableTableEntry *analyze_variable_declaration(CodeGen *g, ImportTableEntry *import,
         BlockContext *context, TypeTableEntry *expected_type, AstNode *node);
 static void resolve_struct_type(CodeGen *g, ImportTableEntry *import, TypeTableEntry *struct_type);
-static TypeTableEntry *unwrapped_node_type(AstNode *node);
+static TypeTableEntry *unwrapped_node_type(CodeGen *g, AstNode *node);
 static TypeTableEntry *analyze_cast_expr(CodeGen *g, ImportTableEntry *import, BlockContext *context,
         AstNode *node);
 static TypeTableEntry *analyze_error_literal_expr(CodeGen *g, ImportTableEntry *import,
@@ -29,6 +32,34 @@ static TypeTableEntry *analyze_block_expr(CodeGen *g, ImportTableEntry *import,
 static TypeTableEntry *resolve_expr_const_val_as_void(CodeGen *g, AstNode *node);
 static void detect_top_level_decl_deps(CodeGen *g, ImportTableEntry *import, AstNode *node);
 
+// A function body to analyze once the top level declarations are resolved.
+// When bodies are analyzed on several threads, the errors and global
+// constants of each are kept here and added to the CodeGen in source order
+// afterwards, so that the result does not depend on the thread count.
+struct FnBodyJob {
+    ImportTableEntry *import;
+    AstNode *fn_def_node;
+    ZigList<ErrorMsg *> errors;
+    ZigList<Expr *> global_consts;
+    int thread_id;
+    double wall_start;
+    double wall_seconds;
+    int scope_count;
+};
+
+// the job this thread is running; null unless bodies are analyzed in parallel
+static __thread FnBodyJob *current_fn_body_job;
+
+// Derived types are created on demand while function bodies are analyzed,
+// possibly on several threads. This lock guards derived_type_table, and the
+// thread holding it may take it again. A type which is already cached in a
+// parent slot of its child type is found without it.
+static pthread_mutex_t type_mutex = PTHREAD_MUTEX_INITIALIZER;
+static __thread int type_mutex_depth;
+
+// guards the import arenas and the node counter used by create_ast_node
+static pthread_mutex_t node_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 static AstNode *first_executing_node(AstNode *node) {
     switch (node->type) {
         case NodeTypeFnCallExpr:
@@ -94,14 +125,18 @@ ErrorMsg *add_node_error(CodeGen *g, AstNode *node, Buf *msg) {
     ErrorMsg *err = err_msg_create_with_line(node->owner->path, node->line, node->column,
             node->owner->source_code, node->owner->line_offsets, msg);
 
-    g->errors.append(err);
+    if (current_fn_body_job) {
+        current_fn_body_job->errors.append(err);
+    } else {
+        g->errors.append(err);
+    }
     return err;
 }
 
-TypeTableEntry *new_type_table_entry(TypeTableEntryId id) {
+TypeTableEntry *new_type_table_entry(CodeGen *g, TypeTableEntryId id) {
     TypeTableEntry *entry = allocate<TypeTableEntry>(1);
-    entry->arrays_by_size.init(2);
     entry->id = id;
+    __atomic_fetch_add(&g->type_entry_count, 1, __ATOMIC_RELAXED);
 
     switch (id) {
         case TypeTableEntryIdInvalid:
@@ -150,13 +185,112 @@ static TypeTableEntry *get_smallest_unsigned_int_type(CodeGen *g, uint64_t x) {
     return get_int_type(g, false, bits_needed_for_unsigned(x));
 }
 
+static void lock_types(void) {
+    if (type_mutex_depth == 0)
+        pthread_mutex_lock(&type_mutex);
+    type_mutex_depth += 1;
+}
+
+static void unlock_types(void) {
+    type_mutex_depth -= 1;
+    if (type_mutex_depth == 0)
+        pthread_mutex_unlock(&type_mutex);
+}
+
+uint32_t derived_type_key_hash(DerivedTypeKey key) {
+    uint64_t h = 14695981039346656037ULL;
+    uint64_t words[] = {
+        (uint64_t)key.id,
+        (uint64_t)(uintptr_t)key.child,
+        key.array_len,
+        (uint64_t)key.is_const | ((uint64_t)key.is_var_args << 1) | ((uint64_t)key.is_naked << 2) |
+            ((uint64_t)key.is_inline << 3) | ((uint64_t)key.calling_convention << 4),
+    };
+    for (int i = 0; i < array_length(words); i += 1) {
+        h = (h ^ words[i]) * 1099511628211ULL;
+    }
+    for (int i = 0; i < key.param_count; i += 1) {
+        h = (h ^ (uint64_t)(uintptr_t)key.param_types[i]) * 1099511628211ULL;
+    }
+    return (uint32_t)(h ^ (h >> 32));
+}
+
+bool derived_type_key_eql(DerivedTypeKey a, DerivedTypeKey b) {
+    if (a.id != b.id || a.child != b.child || a.array_len != b.array_len || a.is_const != b.is_const ||
+        a.param_count != b.param_count || a.is_var_args != b.is_var_args || a.is_naked != b.is_naked ||
+        a.is_inline != b.is_inline || a.calling_convention != b.calling_convention)
+    {
+        return false;
+    }
+    for (int i = 0; i < a.param_count; i += 1) {
+        if (a.param_types[i] != b.param_types[i])
+            return false;
+    }
+    return true;
+}
+
+static DerivedTypeKey derived_type_key(TypeTableEntryId id, TypeTableEntry *child) {
+    DerivedTypeKey key;
+    memset(&key, 0, sizeof(DerivedTypeKey));
+    key.id = id;
+    key.child = child;
+    return key;
+}
+
+static DerivedTypeKey fn_type_key(TypeTableEntry *fn_type) {
+    TypeTableEntryFn *fn = &fn_type->data.fn;
+    DerivedTypeKey key = derived_type_key(TypeTableEntryIdFn, fn->src_return_type);
+    key.param_types = fn->param_types;
+    key.param_count = fn->src_param_count;
+    key.is_var_args = fn->is_var_args;
+    key.is_naked = fn->is_naked;
+    key.is_inline = fn->is_inline;
+    key.calling_convention = fn->calling_convention;
+    return key;
+}
+
+// Returns the derived type with this key. If there is none, returns null with
+// the type lock held, and the caller creates the type and calls publish_type.
+// slot is the parent slot of the child type which caches this kind of type,
+// or null for the kinds which are only in the table.
+static TypeTableEntry *find_or_lock_type(CodeGen *g, TypeTableEntry **slot, DerivedTypeKey key) {
+    if (slot) {
+        TypeTableEntry *type_entry = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+        if (type_entry)
+            return type_entry;
+    }
+    lock_types();
+    auto entry = g->derived_type_table.maybe_get(key);
+    if (entry) {
+        TypeTableEntry *type_entry = entry->value;
+        unlock_types();
+        return type_entry;
+    }
+    return nullptr;
+}
+
+static TypeTableEntry *publish_type(CodeGen *g, TypeTableEntry **slot, DerivedTypeKey key,
+        TypeTableEntry *entry)
+{
+    g->derived_type_table.put(key, entry);
+    if (slot)
+        __atomic_store_n(slot, entry, __ATOMIC_RELEASE);
+    unlock_types();
+    return entry;
+}
+
 TypeTableEntry *get_pointer_to_type(CodeGen *g, TypeTableEntry *child_type, bool is_const) {
     assert(child_type->id != TypeTableEntryIdInvalid);
-    TypeTableEntry **parent_pointer = &child_type->pointer_parent[(is_const ? 1 : 0)];
-    if (*parent_pointer) {
-        return *parent_pointer;
+    DerivedTypeKey key = derived_type_key(TypeTableEntryIdPointer, child_type);
+    key.is_const = is_const;
+    TypeTableEntry **slot = &child_type->pointer_parent[is_const ? 1 : 0];
+    TypeTableEntry *existing_entry = find_or_lock_type(g, slot, key);
+    if (existing_entry) {
+        return existing_entry;
     } else {
-        TypeTableEntry *entry = new_type_table_entry(TypeTableEntryIdPointer);
+        TypeTableEntry *entry = new_type_table_entry(g, TypeTableEntryIdPointer);
+        entry->data.pointer.child_type = child_type;
+        entry->data.pointer.is_const = is_const;
 
         const char *const_str = is_const ? "const " : "";
         buf_resize(&entry->name, 0);
@@ -185,20 +319,21 @@ TypeTableEntry *get_pointer_to_type(CodeGen *g, TypeTableEntry *child_type, bool
                     entry->size_in_bits, entry->align_in_bits, buf_ptr(&entry->name));
         }
 
-        entry->data.pointer.child_type = child_type;
-        entry->data.pointer.is_const = is_const;
-
-        *parent_pointer = entry;
-        return entry;
+        return publish_type(g, slot, key, entry);
     }
 }
 
 static TypeTableEntry *get_maybe_type(CodeGen *g, TypeTableEntry *child_type) {
-    if (child_type->maybe_parent) {
-        TypeTableEntry *entry = child_type->maybe_parent;
-        return entry;
+    DerivedTypeKey key = derived_type_key(TypeTableEntryIdMaybe, child_type);
+    TypeTableEntry **slot = &child_type->maybe_parent;
+    TypeTableEntry *existing_entry = find_or_lock_type(g, slot, key);
+    if (existing_entry) {
+        return existing_entry;
     } else {
-        TypeTableEntry *entry = new_type_table_entry(TypeTableEntryIdMaybe);
+        TypeTableEntry *entry = new_type_table_entry(g, TypeTableEntryIdMaybe);
+        entry->data.maybe.child_type = child_type;
+        buf_resize(&entry->name, 0);
+        buf_appendf(&entry->name, "?%s", buf_ptr(&child_type->name));
         // create a struct with a boolean whether this is the null value
         assert(child_type->type_ref);
         LLVMTypeRef elem_types[] = {
@@ -206,8 +341,6 @@ static TypeTableEntry *get_maybe_type(CodeGen *g, TypeTableEntry *child_type) {
             LLVMInt1Type(),
         };
         entry->type_ref = LLVMStructType(elem_types, 2, false);
-        buf_resize(&entry->name, 0);
-        buf_appendf(&entry->name, "?%s", buf_ptr(&child_type->name));
         entry->size_in_bits = child_type->size_in_bits + 8;
         entry->align_in_bits = child_type->align_in_bits;
         assert(child_type->di_type);
@@ -237,26 +370,26 @@ static TypeTableEntry *get_maybe_type(CodeGen *g, TypeTableEntry *child_type) {
         LLVMZigReplaceTemporary(g->dbuilder, entry->di_type, replacement_di_type);
         entry->di_type = replacement_di_type;
 
-        entry->data.maybe.child_type = child_type;
-
-        child_type->maybe_parent = entry;
-        return entry;
+        return publish_type(g, slot, key, entry);
     }
 }
 
 static TypeTableEntry *get_error_type(CodeGen *g, TypeTableEntry *child_type) {
-    if (child_type->error_parent) {
-        return child_type->error_parent;
+    DerivedTypeKey key = derived_type_key(TypeTableEntryIdErrorUnion, child_type);
+    TypeTableEntry **slot = &child_type->error_parent;
+    TypeTableEntry *existing_entry = find_or_lock_type(g, slot, key);
+    if (existing_entry) {
+        return existing_entry;
     } else {
-        TypeTableEntry *entry = new_type_table_entry(TypeTableEntryIdErrorUnion);
+        TypeTableEntry *entry = new_type_table_entry(g, TypeTableEntryIdErrorUnion);
         assert(child_type->type_ref);
         assert(child_type->di_type);
 
+        entry->data.error.child_type = child_type;
+
         buf_resize(&entry->name, 0);
         buf_appendf(&entry->name, "%%%s", buf_ptr(&child_type->name));
 
-        entry->data.error.child_type = child_type;
-
         if (child_type->size_in_bits == 0) {
             entry->type_ref = g->err_tag_type->type_ref;
             entry->size_in_bits = g->err_tag_type->size_in_bits;
@@ -298,20 +431,21 @@ static TypeTableEntry *get_error_type(CodeGen *g, TypeTableEntry *child_type) {
             entry->di_type = replacement_di_type;
         }
 
-        child_type->error_parent = entry;
-        return entry;
+        return publish_type(g, slot, key, entry);
     }
 }
 
 static TypeTableEntry *get_array_type(CodeGen *g, TypeTableEntry *child_type, uint64_t array_size)
 {
-    auto existing_entry = child_type->arrays_by_size.maybe_get(array_size);
+    DerivedTypeKey key = derived_type_key(TypeTableEntryIdArray, child_type);
+    key.array_len = array_size;
+    TypeTableEntry *existing_entry = find_or_lock_type(g, nullptr, key);
     if (existing_entry) {
-        TypeTableEntry *entry = existing_entry->value;
-        return entry;
+        return existing_entry;
     } else {
-        TypeTableEntry *entry = new_type_table_entry(TypeTableEntryIdArray);
+        TypeTableEntry *entry = new_type_table_entry(g, TypeTableEntryIdArray);
         entry->type_ref = LLVMArrayType(child_type->type_ref, array_size);
+
         buf_resize(&entry->name, 0);
         buf_appendf(&entry->name, "[%" PRIu64 "]%s", array_size, buf_ptr(&child_type->name));
 
@@ -323,8 +457,7 @@ static TypeTableEntry *get_array_type(CodeGen *g, TypeTableEntry *child_type, ui
         entry->data.array.child_type = child_type;
         entry->data.array.len = array_size;
 
-        child_type->arrays_by_size.put(array_size, entry);
-        return entry;
+        return publish_type(g, nullptr, key, entry);
     }
 }
 
@@ -341,11 +474,11 @@ static void unknown_size_array_type_common_init(CodeGen *g, TypeTableEntry *chil
     entry->data.structure.src_field_count = element_count;
     entry->data.structure.gen_field_count = element_count;
     entry->data.structure.fields = allocate<TypeStructField>(element_count);
-    entry->data.structure.fields[0].name = buf_create_from_str("ptr");
+    entry->data.structure.fields[0].name = intern_str("ptr");
     entry->data.structure.fields[0].type_entry = pointer_type;
     entry->data.structure.fields[0].src_index = 0;
     entry->data.structure.fields[0].gen_index = 0;
-    entry->data.structure.fields[1].name = buf_create_from_str("len");
+    entry->data.structure.fields[1].name = intern_str("len");
     entry->data.structure.fields[1].type_entry = g->builtin_types.entry_isize;
     entry->data.structure.fields[1].src_index = 1;
     entry->data.structure.fields[1].gen_index = 1;
@@ -353,13 +486,16 @@ static void unknown_size_array_type_common_init(CodeGen *g, TypeTableEntry *chil
 
 static TypeTableEntry *get_unknown_size_array_type(CodeGen *g, TypeTableEntry *child_type, bool is_const) {
     assert(child_type->id != TypeTableEntryIdInvalid);
-    TypeTableEntry **parent_pointer = &child_type->unknown_size_array_parent[(is_const ? 1 : 0)];
+    DerivedTypeKey key = derived_type_key(TypeTableEntryIdStruct, child_type);
+    key.is_const = is_const;
 
-    if (*parent_pointer) {
-        return *parent_pointer;
+    TypeTableEntry **slot = &child_type->unknown_size_array_parent[is_const ? 1 : 0];
+    TypeTableEntry *existing_entry = find_or_lock_type(g, slot, key);
+    if (existing_entry) {
+        return existing_entry;
     } else if (is_const) {
         TypeTableEntry *var_peer = get_unknown_size_array_type(g, child_type, false);
-        TypeTableEntry *entry = new_type_table_entry(TypeTableEntryIdStruct);
+        TypeTableEntry *entry = new_type_table_entry(g, TypeTableEntryIdStruct);
 
         buf_resize(&entry->name, 0);
         buf_appendf(&entry->name, "[]const %s", buf_ptr(&child_type->name));
@@ -369,16 +505,17 @@ static TypeTableEntry *get_unknown_size_array_type(CodeGen *g, TypeTableEntry *c
         entry->type_ref = var_peer->type_ref;
         entry->di_type = var_peer->di_type;
 
-        *parent_pointer = entry;
-        return entry;
+        return publish_type(g, slot, key, entry);
     } else {
-        TypeTableEntry *entry = new_type_table_entry(TypeTableEntryIdStruct);
+        TypeTableEntry *entry = new_type_table_entry(g, TypeTableEntryIdStruct);
 
         buf_resize(&entry->name, 0);
         buf_appendf(&entry->name, "[]%s", buf_ptr(&child_type->name));
+
+        unknown_size_array_type_common_init(g, child_type, is_const, entry);
         entry->type_ref = LLVMStructCreateNamed(LLVMGetGlobalContext(), buf_ptr(&entry->name));
 
-        TypeTableEntry *pointer_type = get_pointer_to_type(g, child_type, is_const);
+        TypeTableEntry *pointer_type = entry->data.structure.fields[0].type_entry;
 
         unsigned element_count = 2;
         LLVMTypeRef element_types[] = {
@@ -387,8 +524,6 @@ static TypeTableEntry *get_unknown_size_array_type(CodeGen *g, TypeTableEntry *c
         };
         LLVMStructSetBody(entry->type_ref, element_types, element_count, false);
 
-        unknown_size_array_type_common_init(g, child_type, is_const, entry);
-
         LLVMZigDIType *di_element_types[] = {
             pointer_type->di_type,
             g->builtin_types.entry_isize->di_type,
@@ -398,8 +533,7 @@ static TypeTableEntry *get_unknown_size_array_type(CodeGen *g, TypeTableEntry *c
                 buf_ptr(&entry->name), g->dummy_di_file, 0, entry->size_in_bits, entry->align_in_bits, 0,
                 nullptr, di_element_types, element_count, 0, nullptr, "");
 
-        *parent_pointer = entry;
-        return entry;
+        return publish_type(g, slot, key, entry);
     }
 }
 
@@ -410,7 +544,7 @@ static TypeTableEntry *resolve_type(CodeGen *g, AstNode *node) {
     if (node->type == NodeTypeSymbol && node->data.symbol_expr.override_type_entry) {
         return node->data.symbol_expr.override_type_entry;
     }
-    Expr *expr = get_resolved_expr(node);
+    Expr *expr = get_resolved_expr(g, node);
     assert(expr->type_entry);
     if (expr->type_entry->id == TypeTableEntryIdInvalid) {
         return g->builtin_types.entry_invalid;
@@ -445,13 +579,13 @@ static void resolve_function_proto(CodeGen *g, AstNode *node, FnTableEntry *fn_t
     assert(node->type == NodeTypeFnProto);
     AstNodeFnProto *fn_proto = &node->data.fn_proto;
 
-    TypeTableEntry *fn_type = new_type_table_entry(TypeTableEntryIdFn);
+    TypeTableEntry *fn_type = new_type_table_entry(g, TypeTableEntryIdFn);
     fn_table_entry->type_entry = fn_type;
     fn_type->data.fn.calling_convention = fn_table_entry->internal_linkage ? LLVMFastCallConv : LLVMCCallConv;
 
     for (int i = 0; i < fn_proto->directives->length; i += 1) {
         AstNode *directive_node = fn_proto->directives->at(i);
-        Buf *name = &directive_node->data.directive.name;
+        Buf *name = directive_node->data.directive.name;
 
         if (buf_eql_str(name, "attribute")) {
             Buf *attr_name = &directive_node->data.directive.param;
@@ -460,6 +594,7 @@ static void resolve_function_proto(CodeGen *g, AstNode *node, FnTableEntry *fn_t
                     fn_type->data.fn.is_naked = true;
                 } else if (buf_eql_str(attr_name, "inline")) {
                     fn_table_entry->is_inline = true;
+                    fn_type->data.fn.is_inline = true;
                 } else {
                     add_node_error(g, directive_node,
                             buf_sprintf("invalid function attribute: '%s'", buf_ptr(name)));
@@ -482,20 +617,12 @@ static void resolve_function_proto(CodeGen *g, AstNode *node, FnTableEntry *fn_t
 
     // first, analyze the parameters and return type in order they appear in
     // source code in order for error messages to be in the best order.
-    buf_resize(&fn_type->name, 0);
-    const char *export_str = fn_table_entry->internal_linkage ? "" : "export ";
-    const char *inline_str = fn_table_entry->is_inline ? "inline " : "";
-    const char *naked_str = fn_type->data.fn.is_naked ? "naked " : "";
-    buf_appendf(&fn_type->name, "%s%s%sfn(", export_str, inline_str, naked_str);
     for (int i = 0; i < src_param_count; i += 1) {
         AstNode *child = node->data.fn_proto.params.at(i);
         assert(child->type == NodeTypeParamDecl);
         TypeTableEntry *type_entry = analyze_type_expr(g, import, import->block_context,
                 child->data.param_decl.type);
         fn_type->data.fn.param_types[i] = type_entry;
-
-        const char *comma = (i == 0) ? "" : ", ";
-        buf_appendf(&fn_type->name, "%s%s", comma, buf_ptr(&type_entry->name));
     }
 
     TypeTableEntry *return_type = analyze_type_expr(g, import, import->block_context,
@@ -505,17 +632,25 @@ static void resolve_function_proto(CodeGen *g, AstNode *node, FnTableEntry *fn_t
         fn_proto->skip = true;
     }
     fn_type->data.fn.is_var_args = fn_proto->is_var_args;
+
+    buf_resize(&fn_type->name, 0);
+    const char *export_str = fn_table_entry->internal_linkage ? "" : "export ";
+    const char *inline_str = fn_table_entry->is_inline ? "inline " : "";
+    const char *naked_str = fn_type->data.fn.is_naked ? "naked " : "";
+    buf_appendf(&fn_type->name, "%s%s%sfn(", export_str, inline_str, naked_str);
+    for (int i = 0; i < src_param_count; i += 1) {
+        const char *comma = (i == 0) ? "" : ", ";
+        buf_appendf(&fn_type->name, "%s%s", comma, buf_ptr(&fn_type->data.fn.param_types[i]->name));
+    }
     if (fn_proto->is_var_args) {
         const char *comma = (src_param_count == 0) ? "" : ", ";
         buf_appendf(&fn_type->name, "%s...", comma);
     }
-
     buf_appendf(&fn_type->name, ")");
     if (return_type->id != TypeTableEntryIdVoid) {
         buf_appendf(&fn_type->name, " %s", buf_ptr(&return_type->name));
     }
 
-
     // next, loop over the parameters again and compute debug information
     // and codegen information
     bool first_arg_return = !fn_proto->skip && handle_is_ptr(return_type);
@@ -580,9 +715,10 @@ static void resolve_function_proto(CodeGen *g, AstNode *node, FnTableEntry *fn_t
         return;
     }
 
-    auto table_entry = import->fn_type_table.maybe_get(&fn_type->name);
-    if (table_entry) {
-        fn_type = table_entry->value;
+    DerivedTypeKey key = fn_type_key(fn_type);
+    TypeTableEntry *existing_fn_type = find_or_lock_type(g, nullptr, key);
+    if (existing_fn_type) {
+        fn_type = existing_fn_type;
         fn_table_entry->type_entry = fn_type;
     } else {
         fn_type->data.fn.raw_type_ref = LLVMFunctionType(gen_return_type->type_ref,
@@ -591,7 +727,7 @@ static void resolve_function_proto(CodeGen *g, AstNode *node, FnTableEntry *fn_t
         fn_type->di_type = LLVMZigCreateSubroutineType(g->dbuilder, import->di_file,
                 param_di_types, gen_param_index + 1, 0);
 
-        import->fn_type_table.put(&fn_type->name, fn_type);
+        publish_type(g, nullptr, key, fn_type);
     }
 
 
@@ -628,7 +764,7 @@ static void resolve_function_proto(CodeGen *g, AstNode *node, FnTableEntry *fn_t
         fn_type->di_type, fn_table_entry->internal_linkage,
         is_definition, scope_line, flags, is_optimized, fn_table_entry->fn_value);
     if (fn_table_entry->fn_def_node) {
-        BlockContext *context = new_block_context(fn_table_entry->fn_def_node, import->block_context);
+        BlockContext *context = new_block_context(g, fn_table_entry->fn_def_node, import->block_context);
         fn_table_entry->fn_def_node->data.fn_def.block_context = context;
         context->di_scope = LLVMZigSubprogramToScope(subprogram);
     }
@@ -644,7 +780,7 @@ static void preview_function_labels(CodeGen *g, AstNode *node, FnTableEntry *fn_
 
         LabelTableEntry *label_entry = allocate<LabelTableEntry>(1);
         label_entry->label_node = label_node;
-        Buf *name = &label_node->data.label.name;
+        Buf *name = label_node->data.label.name;
         fn_table_entry->label_table.put(name, label_entry);
 
         label_node->data.label.label_entry = label_entry;
@@ -692,7 +828,7 @@ static void resolve_enum_type(CodeGen *g, ImportTableEntry *import, TypeTableEnt
     for (uint32_t i = 0; i < field_count; i += 1) {
         AstNode *field_node = decl_node->data.struct_decl.fields.at(i);
         TypeEnumField *type_enum_field = &enum_type->data.enumeration.fields[i];
-        type_enum_field->name = &field_node->data.struct_field.name;
+        type_enum_field->name = field_node->data.struct_field.name;
         type_enum_field->type_entry = analyze_type_expr(g, import, import->block_context,
                 field_node->data.struct_field.type);
         type_enum_field->value = i;
@@ -788,7 +924,7 @@ static void resolve_enum_type(CodeGen *g, ImportTableEntry *import, TypeTableEnt
 
             LLVMZigDIType *replacement_di_type = LLVMZigCreateDebugStructType(g->dbuilder,
                     LLVMZigFileToScope(import->di_file),
-                    buf_ptr(&decl_node->data.struct_decl.name),
+                    buf_ptr(decl_node->data.struct_decl.name),
                     import->di_file, decl_node->line + 1, enum_type->size_in_bits, enum_type->align_in_bits, 0,
                     nullptr, di_root_members, 2, 0, nullptr, "");
 
@@ -800,7 +936,7 @@ static void resolve_enum_type(CodeGen *g, ImportTableEntry *import, TypeTableEnt
 
             // create debug type for tag
             LLVMZigDIType *tag_di_type = LLVMZigCreateDebugEnumerationType(g->dbuilder,
-                    LLVMZigFileToScope(import->di_file), buf_ptr(&decl_node->data.struct_decl.name),
+                    LLVMZigFileToScope(import->di_file), buf_ptr(decl_node->data.struct_decl.name),
                     import->di_file, decl_node->line + 1,
                     tag_type_entry->size_in_bits, tag_type_entry->align_in_bits, di_enumerators, field_count,
                     tag_type_entry->di_type, "");
@@ -856,7 +992,7 @@ static void resolve_struct_type(CodeGen *g, ImportTableEntry *import, TypeTableE
     for (int i = 0; i < field_count; i += 1) {
         AstNode *field_node = decl_node->data.struct_decl.fields.at(i);
         TypeStructField *type_struct_field = &struct_type->data.structure.fields[i];
-        type_struct_field->name = &field_node->data.struct_field.name;
+        type_struct_field->name = field_node->data.struct_field.name;
         type_struct_field->type_entry = analyze_type_expr(g, import, import->block_context,
                 field_node->data.struct_field.type);
         type_struct_field->src_index = i;
@@ -908,7 +1044,7 @@ static void resolve_struct_type(CodeGen *g, ImportTableEntry *import, TypeTableE
 
         LLVMZigDIType *replacement_di_type = LLVMZigCreateDebugStructType(g->dbuilder,
                 LLVMZigFileToScope(import->di_file),
-                buf_ptr(&decl_node->data.struct_decl.name),
+                buf_ptr(decl_node->data.struct_decl.name),
                 import->di_file, decl_node->line + 1, struct_type->size_in_bits, struct_type->align_in_bits, 0,
                 nullptr, di_element_types, gen_field_index, 0, nullptr, "");
 
@@ -931,7 +1067,7 @@ static void preview_fn_proto(CodeGen *g, ImportTableEntry *import,
         struct_type = nullptr;
     }
 
-    Buf *proto_name = &proto_node->data.fn_proto.name;
+    Buf *proto_name = proto_node->data.fn_proto.name;
 
     auto fn_table = struct_type ? &struct_type->data.structure.fn_table : &import->fn_table;
 
@@ -1009,6 +1145,44 @@ static void preview_fn_proto(CodeGen *g, ImportTableEntry *import,
     }
 }
 
+static TypeTableEntry *scope_get_type(BlockContext *context, Buf *name) {
+    if (!context->type_table)
+        return nullptr;
+    TypeTableEntry **entry = context->type_table->maybe_get(name);
+    return entry ? *entry : nullptr;
+}
+
+static ErrorTableEntry *scope_get_error(BlockContext *context, Buf *name) {
+    if (!context->error_table)
+        return nullptr;
+    ErrorTableEntry **entry = context->error_table->maybe_get(name);
+    return entry ? *entry : nullptr;
+}
+
+static void scope_put_variable(CodeGen *g, BlockContext *context, Buf *name, VariableTableEntry *var) {
+    if (context->variable_table.put(name, var)) {
+        __atomic_fetch_add(&g->promoted_scope_table_count, 1, __ATOMIC_RELAXED);
+    }
+}
+
+static void scope_put_type(CodeGen *g, BlockContext *context, Buf *name, TypeTableEntry *type_entry) {
+    if (!context->type_table) {
+        context->type_table = allocate<ScopeTable<TypeTableEntry *>>(1);
+    }
+    if (context->type_table->put(name, type_entry)) {
+        __atomic_fetch_add(&g->promoted_scope_table_count, 1, __ATOMIC_RELAXED);
+    }
+}
+
+static void scope_put_error(CodeGen *g, BlockContext *context, Buf *name, ErrorTableEntry *err) {
+    if (!context->error_table) {
+        context->error_table = allocate<ScopeTable<ErrorTableEntry *>>(1);
+    }
+    if (context->error_table->put(name, err)) {
+        __atomic_fetch_add(&g->promoted_scope_table_count, 1, __ATOMIC_RELAXED);
+    }
+}
+
 static void resolve_error_value_decl(CodeGen *g, ImportTableEntry *import, AstNode *node) {
     assert(node->type == NodeTypeErrorValueDecl);
 
@@ -1018,26 +1192,26 @@ static void resolve_error_value_decl(CodeGen *g, ImportTableEntry *import, AstNo
     g->next_error_index += 1;
 
     err->decl_node = node;
-    buf_init_from_buf(&err->name, &node->data.error_value_decl.name);
+    err->name = node->data.error_value_decl.name;
 
-    auto existing_entry = import->block_context->error_table.maybe_get(&err->name);
-    if (existing_entry) {
-        add_node_error(g, node, buf_sprintf("redefinition of error '%s'", buf_ptr(&err->name)));
+    ErrorTableEntry *existing_err = scope_get_error(import->block_context, err->name);
+    if (existing_err) {
+        add_node_error(g, node, buf_sprintf("redefinition of error '%s'", buf_ptr(err->name)));
     } else {
-        import->block_context->error_table.put(&err->name, err);
+        scope_put_error(g, import->block_context, err->name, err);
     }
 
     bool is_pub = (node->data.error_value_decl.visib_mod != VisibModPrivate);
     if (is_pub) {
         for (int i = 0; i < import->importers.length; i += 1) {
             ImporterInfo importer = import->importers.at(i);
-            auto table_entry = importer.import->block_context->error_table.maybe_get(&err->name);
-            if (table_entry) {
+            ErrorTableEntry *existing_err = scope_get_error(importer.import->block_context, err->name);
+            if (existing_err) {
                 add_node_error(g, importer.source_node,
                     buf_sprintf("import of error '%s' overrides existing definition",
-                        buf_ptr(&err->name)));
+                        buf_ptr(err->name)));
             } else {
-                importer.import->block_context->error_table.put(&err->name, err);
+                scope_put_error(g, importer.import->block_context, err->name, err);
             }
         }
     }
@@ -1048,7 +1222,7 @@ static void resolve_c_import_decl(CodeGen *g, ImportTableEntry *parent_import, A
 
     AstNode *block_node = node->data.c_import.block;
 
-    BlockContext *child_context = new_block_context(node, parent_import->block_context);
+    BlockContext *child_context = new_block_context(g, node, parent_import->block_context);
     child_context->c_import_buf = buf_alloc();
 
     TypeTableEntry *resolved_type = analyze_block_expr(g, parent_import, child_context,
@@ -1061,15 +1235,15 @@ static void resolve_c_import_decl(CodeGen *g, ImportTableEntry *parent_import, A
     find_libc_path(g);
 
     ImportTableEntry *child_import = allocate<ImportTableEntry>(1);
+    child_import->ast_arena.category = AllocCategoryAst;
     child_import->fn_table.init(32);
-    child_import->fn_type_table.init(32);
     child_import->c_import_node = node;
 
     ZigList<ErrorMsg *> errors = {0};
 
     int err;
     if ((err = parse_h_buf(child_import, &errors, child_context->c_import_buf, g->clang_argv, g->clang_argv_len,
-                    buf_ptr(g->libc_include_path), false)))
+                    buf_ptr(g->libc_include_path), false, &g->next_node_index)))
     {
         zig_panic("unable to parse h file: %s\n", err_str(err));
     }
@@ -1090,20 +1264,60 @@ static void resolve_c_import_decl(CodeGen *g, ImportTableEntry *parent_import, A
     }
 
     child_import->di_file = parent_import->di_file;
-    child_import->block_context = new_block_context(child_import->root, nullptr);
+    child_import->block_context = new_block_context(g, child_import->root, nullptr);
     child_import->importers.append({parent_import, node});
 
     detect_top_level_decl_deps(g, child_import, child_import->root);
 }
 
+static void add_unresolved_decl(CodeGen *g, Buf *name, AstNode *node) {
+    g->unresolved_top_level_decls.put(name, node);
+
+    ZigList<AstNode *> *queue = &g->unresolved_decl_queue;
+    queue->append(node);
+    int i = queue->length - 1;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (queue->at(parent)->create_index <= node->create_index)
+            break;
+        queue->at(i) = queue->at(parent);
+        i = parent;
+    }
+    queue->at(i) = node;
+}
+
+static AstNode *pop_unresolved_decl(CodeGen *g) {
+    ZigList<AstNode *> *queue = &g->unresolved_decl_queue;
+    AstNode *result = queue->at(0);
+    AstNode *last = queue->pop();
+    int length = queue->length;
+    if (length == 0)
+        return result;
+
+    int i = 0;
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= length)
+            break;
+        if (child + 1 < length && queue->at(child + 1)->create_index < queue->at(child)->create_index)
+            child += 1;
+        if (last->create_index <= queue->at(child)->create_index)
+            break;
+        queue->at(i) = queue->at(child);
+        i = child;
+    }
+    queue->at(i) = last;
+    return result;
+}
+
 static void satisfy_dep(CodeGen *g, AstNode *node) {
-    Buf *name = get_resolved_top_level_decl(node)->name;
+    Buf *name = get_resolved_top_level_decl(g, node)->name;
     if (name) {
         g->unresolved_top_level_decls.maybe_remove(name);
     }
 }
 
-static void resolve_top_level_decl(CodeGen *g, ImportTableEntry *import, AstNode *node) {
+static void resolve_top_level_decl_raw(CodeGen *g, ImportTableEntry *import, AstNode *node) {
     switch (node->type) {
         case NodeTypeFnProto:
             preview_fn_proto(g, import, node);
@@ -1189,13 +1403,22 @@ static void resolve_top_level_decl(CodeGen *g, ImportTableEntry *import, AstNode
     satisfy_dep(g, node);
 }
 
+static void resolve_top_level_decl(CodeGen *g, ImportTableEntry *import, AstNode *node) {
+    // c imports create their AST while being resolved
+    const char *event_name = (node->type == NodeTypeCImport) ? "resolve c_import" : "resolve";
+    uint32_t first_node_index = g->next_node_index;
+    trace_begin(g, event_name, get_resolved_top_level_decl(g, node)->name);
+    resolve_top_level_decl_raw(g, import, node);
+    trace_end(g, "nodes", g->next_node_index - first_node_index);
+}
+
 static FnTableEntry *get_context_fn_entry(BlockContext *context) {
     assert(context->fn_entry);
     return context->fn_entry;
 }
 
-static TypeTableEntry *unwrapped_node_type(AstNode *node) {
-    Expr *expr = get_resolved_expr(node);
+static TypeTableEntry *unwrapped_node_type(CodeGen *g, AstNode *node) {
+    Expr *expr = get_resolved_expr(g, node);
     if (expr->type_entry->id == TypeTableEntryIdInvalid) {
         return expr->type_entry;
     }
@@ -1205,12 +1428,12 @@ static TypeTableEntry *unwrapped_node_type(AstNode *node) {
     return const_val->data.x_type;
 }
 
-static TypeTableEntry *get_return_type(BlockContext *context) {
+static TypeTableEntry *get_return_type(CodeGen *g, BlockContext *context) {
     FnTableEntry *fn_entry = get_context_fn_entry(context);
     AstNode *fn_proto_node = fn_entry->proto_node;
     assert(fn_proto_node->type == NodeTypeFnProto);
     AstNode *return_type_node = fn_proto_node->data.fn_proto.return_type;
-    return unwrapped_node_type(return_type_node);
+    return unwrapped_node_type(g, return_type_node);
 }
 
 static bool type_has_codegen_value(TypeTableEntryId id) {
@@ -1246,7 +1469,11 @@ static void add_global_const_expr(CodeGen *g, Expr *expr) {
         !expr->has_global_const &&
         expr->type_entry->size_in_bits > 0)
     {
-        g->global_const_list.append(expr);
+        if (current_fn_body_job) {
+            current_fn_body_job->global_consts.append(expr);
+        } else {
+            g->global_const_list.append(expr);
+        }
         expr->has_global_const = true;
     }
 }
@@ -1255,7 +1482,7 @@ static bool num_lit_fits_in_other_type(CodeGen *g, AstNode *literal_node, TypeTa
     if (other_type->id == TypeTableEntryIdInvalid) {
         return false;
     }
-    Expr *expr = get_resolved_expr(literal_node);
+    Expr *expr = get_resolved_expr(g, literal_node);
     ConstExprValue *const_val = &expr->const_val;
     assert(const_val->ok);
     if (other_type->id == TypeTableEntryIdFloat) {
@@ -1485,11 +1712,13 @@ static bool types_match_with_implicit_cast(CodeGen *g, TypeTableEntry *expected_
 }
 
 static AstNode *create_ast_node(CodeGen *g, ImportTableEntry *import, NodeType kind) {
-    AstNode *node = allocate<AstNode>(1);
-    node->type = kind;
-    node->owner = import;
+    pthread_mutex_lock(&node_mutex);
+    AstNode *node = arena_allocate<AstNode>(&import->ast_arena, 1);
     node->create_index = g->next_node_index;
     g->next_node_index += 1;
+    pthread_mutex_unlock(&node_mutex);
+    node->type = kind;
+    node->owner = import;
     return node;
 }
 
@@ -1573,7 +1802,7 @@ static TypeTableEntry *resolve_peer_type_compatibility(CodeGen *g, ImportTableEn
         AstNode **child_node = child_nodes[i]->parent_field;
         TypeTableEntry *resolved_type = resolve_type_compatibility(g, import, block_context,
                 *child_node, expected_type, child_types[i]);
-        Expr *expr = get_resolved_expr(*child_node);
+        Expr *expr = get_resolved_expr(g, *child_node);
         expr->type_entry = resolved_type;
         add_global_const_expr(g, expr);
     }
@@ -1581,15 +1810,14 @@ static TypeTableEntry *resolve_peer_type_compatibility(CodeGen *g, ImportTableEn
     return expected_type;
 }
 
-BlockContext *new_block_context(AstNode *node, BlockContext *parent) {
+BlockContext *new_block_context(CodeGen *g, AstNode *node, BlockContext *parent) {
     BlockContext *context = allocate<BlockContext>(1);
     context->node = node;
     context->parent = parent;
-    context->variable_table.init(8);
-    context->type_table.init(8);
-    context->error_table.init(8);
+    __atomic_fetch_add(&g->block_context_count, 1, __ATOMIC_RELAXED);
 
     if (parent) {
+        context->depth = parent->depth + 1;
         context->parent_loop_node = parent->parent_loop_node;
         context->c_import_buf = parent->c_import_buf;
     }
@@ -1608,22 +1836,61 @@ BlockContext *new_block_context(AstNode *node, BlockContext *parent) {
     return context;
 }
 
-static VariableTableEntry *find_local_variable(BlockContext *context, Buf *name) {
-    while (context && context->fn_entry) {
-        auto entry = context->variable_table.maybe_get(name);
-        if (entry != nullptr)
-            return entry->value;
+static void scope_put_local(BlockContext *context, Buf *name, VariableTableEntry *var) {
+    LocalScopes *scopes = context->fn_entry->local_scopes;
+    assert(scopes);
+    LocalBinding binding;
+    binding.name = name;
+    binding.var = var;
+    binding.depth = context->depth;
+    auto entry = scopes->names.maybe_get(name);
+    binding.shadowed = entry ? entry->value : -1;
+    scopes->names.put(name, scopes->bindings.length);
+    scopes->bindings.append(binding);
+}
 
-        context = context->parent;
+// Ends the scope of the variables declared in context, which must be the
+// innermost scope of its function which has not ended yet.
+static void end_block_context(BlockContext *context) {
+    if (!context->fn_entry)
+        return;
+    LocalScopes *scopes = context->fn_entry->local_scopes;
+    assert(scopes);
+    while (scopes->bindings.length > 0 && scopes->bindings.last().depth >= context->depth) {
+        LocalBinding binding = scopes->bindings.pop();
+        if (binding.shadowed >= 0) {
+            scopes->names.put(binding.name, binding.shadowed);
+        } else {
+            scopes->names.remove(binding.name);
+        }
     }
-    return nullptr;
 }
 
-VariableTableEntry *find_variable(BlockContext *context, Buf *name) {
+// Only looks in the scopes of the function which context belongs to.
+static VariableTableEntry *find_local_variable(BlockContext *context, Buf *name) {
+    LocalScopes *scopes = context->fn_entry->local_scopes;
+    assert(scopes);
+    auto entry = scopes->names.maybe_get(name);
+    int index = entry ? entry->value : -1;
+    // context may enclose a scope which has not ended yet, whose variables
+    // it does not see
+    while (index >= 0 && scopes->bindings.at(index).depth > context->depth) {
+        index = scopes->bindings.at(index).shadowed;
+    }
+    return (index >= 0) ? scopes->bindings.at(index).var : nullptr;
+}
+
+static VariableTableEntry *find_variable(BlockContext *context, Buf *name) {
+    if (context->fn_entry) {
+        VariableTableEntry *var = find_local_variable(context, name);
+        if (var)
+            return var;
+        context = context->fn_entry->import_entry->block_context;
+    }
     while (context) {
-        auto entry = context->variable_table.maybe_get(name);
+        VariableTableEntry **entry = context->variable_table.maybe_get(name);
         if (entry != nullptr)
-            return entry->value;
+            return *entry;
 
         context = context->parent;
     }
@@ -1632,9 +1899,9 @@ VariableTableEntry *find_variable(BlockContext *context, Buf *name) {
 
 TypeTableEntry *find_container(BlockContext *context, Buf *name) {
     while (context) {
-        auto entry = context->type_table.maybe_get(name);
-        if (entry != nullptr)
-            return entry->value;
+        TypeTableEntry *type_entry = scope_get_type(context, name);
+        if (type_entry != nullptr)
+            return type_entry;
 
         context = context->parent;
     }
@@ -1644,7 +1911,7 @@ TypeTableEntry *find_container(BlockContext *context, Buf *name) {
 static TypeEnumField *get_enum_field(TypeTableEntry *enum_type, Buf *name) {
     for (uint32_t i = 0; i < enum_type->data.enumeration.field_count; i += 1) {
         TypeEnumField *type_enum_field = &enum_type->data.enumeration.fields[i];
-        if (buf_eql_buf(type_enum_field->name, name)) {
+        if (type_enum_field->name == name) {
             return type_enum_field;
         }
     }
@@ -1663,7 +1930,7 @@ static TypeTableEntry *analyze_enum_value_expr(CodeGen *g, ImportTableEntry *imp
         if (value_node) {
             analyze_expression(g, import, context, type_enum_field->type_entry, value_node);
 
-            StructValExprCodeGen *codegen = &field_access_node->data.field_access_expr.resolved_struct_val_expr;
+            StructValExprCodeGen *codegen = get_resolved_struct_val_expr(g, field_access_node);
             codegen->type_entry = enum_type;
             codegen->source_node = field_access_node;
             context->struct_val_expr_alloca_list.append(codegen);
@@ -1674,7 +1941,7 @@ static TypeTableEntry *analyze_enum_value_expr(CodeGen *g, ImportTableEntry *imp
                     buf_ptr(field_name),
                     buf_ptr(&type_enum_field->type_entry->name)));
         } else {
-            Expr *expr = get_resolved_expr(field_access_node);
+            Expr *expr = get_resolved_expr(g, field_access_node);
             expr->const_val.ok = true;
             expr->const_val.data.x_enum.tag = type_enum_field->value;
             expr->const_val.data.x_enum.payload = nullptr;
@@ -1691,7 +1958,7 @@ static TypeStructField *find_struct_type_field(TypeTableEntry *type_entry, Buf *
     assert(type_entry->id == TypeTableEntryIdStruct);
     for (uint32_t i = 0; i < type_entry->data.structure.src_field_count; i += 1) {
         TypeStructField *field = &type_entry->data.structure.fields[i];
-        if (buf_eql_buf(field->name, name)) {
+        if (field->name == name) {
             return field;
         }
     }
@@ -1725,7 +1992,7 @@ static TypeTableEntry *analyze_container_init_expr(CodeGen *g, ImportTableEntry
                !container_type->data.structure.is_unknown_size_array &&
                kind == ContainerInitKindStruct)
     {
-        StructValExprCodeGen *codegen = &container_init_expr->resolved_struct_val_expr;
+        StructValExprCodeGen *codegen = get_resolved_struct_val_expr(g, node);
         codegen->type_entry = container_type;
         codegen->source_node = node;
         context->struct_val_expr_alloca_list.append(codegen);
@@ -1735,7 +2002,7 @@ static TypeTableEntry *analyze_container_init_expr(CodeGen *g, ImportTableEntry
         int actual_field_count = container_type->data.structure.src_field_count;
 
         int *field_use_counts = allocate<int>(actual_field_count);
-        ConstExprValue *const_val = &get_resolved_expr(node)->const_val;
+        ConstExprValue *const_val = &get_resolved_expr(g, node)->const_val;
         const_val->ok = true;
         const_val->data.x_struct.fields = allocate<ConstExprValue*>(actual_field_count);
         for (int i = 0; i < expr_field_count; i += 1) {
@@ -1745,12 +2012,12 @@ static TypeTableEntry *analyze_container_init_expr(CodeGen *g, ImportTableEntry
             val_field_node->block_context = context;
 
             TypeStructField *type_field = find_struct_type_field(container_type,
-                    &val_field_node->data.struct_val_field.name);
+                    val_field_node->data.struct_val_field.name);
 
             if (!type_field) {
                 add_node_error(g, val_field_node,
                     buf_sprintf("no member named '%s' in '%s'",
-                        buf_ptr(&val_field_node->data.struct_val_field.name), buf_ptr(&container_type->name)));
+                        buf_ptr(val_field_node->data.struct_val_field.name), buf_ptr(&container_type->name)));
                 continue;
             }
 
@@ -1768,7 +2035,7 @@ static TypeTableEntry *analyze_container_init_expr(CodeGen *g, ImportTableEntry
 
             if (const_val->ok) {
                 ConstExprValue *field_val =
-                    &get_resolved_expr(val_field_node->data.struct_val_field.expr)->const_val;
+                    &get_resolved_expr(g, val_field_node->data.struct_val_field.expr)->const_val;
                 if (field_val->ok) {
                     const_val->data.x_struct.fields[field_index] = field_val;
                 } else {
@@ -1794,7 +2061,7 @@ static TypeTableEntry *analyze_container_init_expr(CodeGen *g, ImportTableEntry
         assert(pointer_type->id == TypeTableEntryIdPointer);
         TypeTableEntry *child_type = pointer_type->data.pointer.child_type;
 
-        ConstExprValue *const_val = &get_resolved_expr(node)->const_val;
+        ConstExprValue *const_val = &get_resolved_expr(g, node)->const_val;
         const_val->ok = true;
         const_val->data.x_array.fields = allocate<ConstExprValue*>(elem_count);
 
@@ -1803,7 +2070,7 @@ static TypeTableEntry *analyze_container_init_expr(CodeGen *g, ImportTableEntry
             analyze_expression(g, import, context, child_type, *elem_node);
 
             if (const_val->ok) {
-                ConstExprValue *elem_const_val = &get_resolved_expr(*elem_node)->const_val;
+                ConstExprValue *elem_const_val = &get_resolved_expr(g, *elem_node)->const_val;
                 if (elem_const_val->ok) {
                     const_val->data.x_array.fields[i] = elem_const_val;
                 } else {
@@ -1814,7 +2081,7 @@ static TypeTableEntry *analyze_container_init_expr(CodeGen *g, ImportTableEntry
 
         TypeTableEntry *fixed_size_array_type = get_array_type(g, child_type, elem_count);
 
-        StructValExprCodeGen *codegen = &container_init_expr->resolved_struct_val_expr;
+        StructValExprCodeGen *codegen = get_resolved_struct_val_expr(g, node);
         codegen->type_entry = fixed_size_array_type;
         codegen->source_node = node;
         context->struct_val_expr_alloca_list.append(codegen);
@@ -1855,7 +2122,7 @@ static TypeTableEntry *analyze_field_access_expr(CodeGen *g, ImportTableEntry *i
 
     AstNode *struct_expr_node = node->data.field_access_expr.struct_expr;
     TypeTableEntry *struct_type = analyze_expression(g, import, context, nullptr, struct_expr_node);
-    Buf *field_name = &node->data.field_access_expr.field_name;
+    Buf *field_name = node->data.field_access_expr.field_name;
 
     if (struct_type->id == TypeTableEntryIdStruct || (struct_type->id == TypeTableEntryIdPointer &&
          struct_type->data.pointer.child_type->id == TypeTableEntryIdStruct))
@@ -1937,9 +2204,10 @@ static TypeTableEntry *analyze_slice_expr(CodeGen *g, ImportTableEntry *import,
     }
 
     if (return_type->id != TypeTableEntryIdInvalid) {
-        node->data.slice_expr.resolved_struct_val_expr.type_entry = return_type;
-        node->data.slice_expr.resolved_struct_val_expr.source_node = node;
-        context->struct_val_expr_alloca_list.append(&node->data.slice_expr.resolved_struct_val_expr);
+        StructValExprCodeGen *codegen = get_resolved_struct_val_expr(g, node);
+        codegen->type_entry = return_type;
+        codegen->source_node = node;
+        context->struct_val_expr_alloca_list.append(codegen);
     }
 
     analyze_expression(g, import, context, g->builtin_types.entry_isize, node->data.slice_expr.start);
@@ -1981,55 +2249,55 @@ static TypeTableEntry *analyze_array_access_expr(CodeGen *g, ImportTableEntry *i
 }
 
 static TypeTableEntry *resolve_expr_const_val_as_void(CodeGen *g, AstNode *node) {
-    Expr *expr = get_resolved_expr(node);
+    Expr *expr = get_resolved_expr(g, node);
     expr->const_val.ok = true;
     return g->builtin_types.entry_void;
 }
 
 static TypeTableEntry *resolve_expr_const_val_as_type(CodeGen *g, AstNode *node, TypeTableEntry *type) {
-    Expr *expr = get_resolved_expr(node);
+    Expr *expr = get_resolved_expr(g, node);
     expr->const_val.ok = true;
     expr->const_val.data.x_type = type;
     return g->builtin_types.entry_type;
 }
 
 static TypeTableEntry *resolve_expr_const_val_as_other_expr(CodeGen *g, AstNode *node, AstNode *other) {
-    Expr *expr = get_resolved_expr(node);
-    Expr *other_expr = get_resolved_expr(other);
+    Expr *expr = get_resolved_expr(g, node);
+    Expr *other_expr = get_resolved_expr(g, other);
     expr->const_val = other_expr->const_val;
     return other_expr->type_entry;
 }
 
 static TypeTableEntry *resolve_expr_const_val_as_fn(CodeGen *g, AstNode *node, FnTableEntry *fn) {
-    Expr *expr = get_resolved_expr(node);
+    Expr *expr = get_resolved_expr(g, node);
     expr->const_val.ok = true;
     expr->const_val.data.x_fn = fn;
     return fn->type_entry;
 }
 
 static TypeTableEntry *resolve_expr_const_val_as_err(CodeGen *g, AstNode *node, ErrorTableEntry *err) {
-    Expr *expr = get_resolved_expr(node);
+    Expr *expr = get_resolved_expr(g, node);
     expr->const_val.ok = true;
     expr->const_val.data.x_err.err = err;
     return g->builtin_types.entry_pure_error;
 }
 
 static TypeTableEntry *resolve_expr_const_val_as_bool(CodeGen *g, AstNode *node, bool value) {
-    Expr *expr = get_resolved_expr(node);
+    Expr *expr = get_resolved_expr(g, node);
     expr->const_val.ok = true;
     expr->const_val.data.x_bool = value;
     return g->builtin_types.entry_bool;
 }
 
 static TypeTableEntry *resolve_expr_const_val_as_null(CodeGen *g, AstNode *node, TypeTableEntry *type) {
-    Expr *expr = get_resolved_expr(node);
+    Expr *expr = get_resolved_expr(g, node);
     expr->const_val.ok = true;
     expr->const_val.data.x_maybe = nullptr;
     return type;
 }
 
 static TypeTableEntry *resolve_expr_const_val_as_c_string_lit(CodeGen *g, AstNode *node, Buf *str) {
-    Expr *expr = get_resolved_expr(node);
+    Expr *expr = get_resolved_expr(g, node);
     expr->const_val.ok = true;
 
     int len_with_null = buf_len(str) + 1;
@@ -2053,7 +2321,7 @@ static TypeTableEntry *resolve_expr_const_val_as_c_string_lit(CodeGen *g, AstNod
 }
 
 static TypeTableEntry *resolve_expr_const_val_as_string_lit(CodeGen *g, AstNode *node, Buf *str) {
-    Expr *expr = get_resolved_expr(node);
+    Expr *expr = get_resolved_expr(g, node);
     expr->const_val.ok = true;
     expr->const_val.data.x_array.fields = allocate<ConstExprValue*>(buf_len(str));
 
@@ -2071,7 +2339,7 @@ static TypeTableEntry *resolve_expr_const_val_as_string_lit(CodeGen *g, AstNode
 static TypeTableEntry *resolve_expr_const_val_as_unsigned_num_lit(CodeGen *g, AstNode *node,
         TypeTableEntry *expected_type, uint64_t x)
 {
-    Expr *expr = get_resolved_expr(node);
+    Expr *expr = get_resolved_expr(g, node);
     expr->const_val.ok = true;
 
     bignum_init_unsigned(&expr->const_val.data.x_bignum, x);
@@ -2081,7 +2349,7 @@ static TypeTableEntry *resolve_expr_const_val_as_unsigned_num_lit(CodeGen *g, As
 static TypeTableEntry *resolve_expr_const_val_as_float_num_lit(CodeGen *g, AstNode *node,
         TypeTableEntry *expected_type, double x)
 {
-    Expr *expr = get_resolved_expr(node);
+    Expr *expr = get_resolved_expr(g, node);
     expr->const_val.ok = true;
 
     bignum_init_float(&expr->const_val.data.x_bignum, x);
@@ -2098,9 +2366,9 @@ static TypeTableEntry *resolve_expr_const_val_as_bignum_op(CodeGen *g, AstNode *
         bool (*bignum_fn)(BigNum *, BigNum *, BigNum *), AstNode *op1, AstNode *op2,
         TypeTableEntry *resolved_type)
 {
-    ConstExprValue *const_val = &get_resolved_expr(node)->const_val;
-    ConstExprValue *op1_val = &get_resolved_expr(op1)->const_val;
-    ConstExprValue *op2_val = &get_resolved_expr(op2)->const_val;
+    ConstExprValue *const_val = &get_resolved_expr(g, node)->const_val;
+    ConstExprValue *op1_val = &get_resolved_expr(g, op1)->const_val;
+    ConstExprValue *op2_val = &get_resolved_expr(g, op2)->const_val;
 
     const_val->ok = true;
 
@@ -2117,10 +2385,10 @@ static TypeTableEntry *resolve_expr_const_val_as_bignum_op(CodeGen *g, AstNode *
 static TypeTableEntry *analyze_error_literal_expr(CodeGen *g, ImportTableEntry *import,
         BlockContext *context, AstNode *node, Buf *err_name)
 {
-    auto err_table_entry = import->block_context->error_table.maybe_get(err_name);
+    ErrorTableEntry *err = scope_get_error(import->block_context, err_name);
 
-    if (err_table_entry) {
-        return resolve_expr_const_val_as_err(g, node, err_table_entry->value);
+    if (err) {
+        return resolve_expr_const_val_as_err(g, node, err);
     }
 
     add_node_error(g, node,
@@ -2137,7 +2405,7 @@ static TypeTableEntry *analyze_symbol_expr(CodeGen *g, ImportTableEntry *import,
         return resolve_expr_const_val_as_type(g, node, node->data.symbol_expr.override_type_entry);
     }
 
-    Buf *variable_name = &node->data.symbol_expr.symbol;
+    Buf *variable_name = node->data.symbol_expr.symbol;
 
     auto primitive_table_entry = g->primitive_type_table.maybe_get(variable_name);
     if (primitive_table_entry) {
@@ -2151,7 +2419,7 @@ static TypeTableEntry *analyze_symbol_expr(CodeGen *g, ImportTableEntry *import,
             AstNode *decl_node = var->decl_node;
             if (decl_node->type == NodeTypeVariableDeclaration) {
                 AstNode *expr_node = decl_node->data.variable_declaration.expr;
-                ConstExprValue *other_const_val = &get_resolved_expr(expr_node)->const_val;
+                ConstExprValue *other_const_val = &get_resolved_expr(g, expr_node)->const_val;
                 if (other_const_val->ok) {
                     return resolve_expr_const_val_as_other_expr(g, node, expr_node);
                 }
@@ -2175,17 +2443,15 @@ static TypeTableEntry *analyze_symbol_expr(CodeGen *g, ImportTableEntry *import,
     return g->builtin_types.entry_invalid;
 }
 
-static TypeTableEntry *analyze_variable_name(CodeGen *g, ImportTableEntry *import, BlockContext *context,
+static VariableTableEntry *analyze_variable_name(CodeGen *g, ImportTableEntry *import, BlockContext *context,
         AstNode *node, Buf *variable_name)
 {
     VariableTableEntry *var = find_variable(context, variable_name);
-    if (var) {
-        return var->type;
-    } else {
+    if (!var) {
         add_node_error(g, node,
                 buf_sprintf("use of undeclared identifier '%s'", buf_ptr(variable_name)));
-        return g->builtin_types.entry_invalid;
     }
+    return var;
 }
 
 static bool is_op_allowed(TypeTableEntry *type, BinOpType op) {
@@ -2248,11 +2514,12 @@ static TypeTableEntry *analyze_lvalue(CodeGen *g, ImportTableEntry *import, Bloc
     TypeTableEntry *expected_rhs_type = nullptr;
     lhs_node->block_context = block_context;
     if (lhs_node->type == NodeTypeSymbol) {
-        Buf *name = &lhs_node->data.symbol_expr.symbol;
+        Buf *name = lhs_node->data.symbol_expr.symbol;
         if (purpose == LValPurposeAddressOf) {
             expected_rhs_type = analyze_symbol_expr(g, import, block_context, nullptr, lhs_node);
         } else {
             VariableTableEntry *var = find_variable(block_context, name);
+            lhs_node->data.symbol_expr.variable = var;
             if (var) {
                 if (var->is_const) {
                     add_node_error(g, lhs_node, buf_sprintf("cannot assign to constant"));
@@ -2337,8 +2604,8 @@ static TypeTableEntry *analyze_bool_bin_op_expr(CodeGen *g, ImportTableEntry *im
         return g->builtin_types.entry_invalid;
     }
 
-    ConstExprValue *op1_val = &get_resolved_expr(op1)->const_val;
-    ConstExprValue *op2_val = &get_resolved_expr(op2)->const_val;
+    ConstExprValue *op1_val = &get_resolved_expr(g, op1)->const_val;
+    ConstExprValue *op2_val = &get_resolved_expr(g, op2)->const_val;
     if (!op1_val->ok || !op2_val->ok) {
         return g->builtin_types.entry_bool;
     }
@@ -2411,8 +2678,8 @@ static TypeTableEntry *analyze_logic_bin_op_expr(CodeGen *g, ImportTableEntry *i
         return g->builtin_types.entry_invalid;
     }
 
-    ConstExprValue *op1_val = &get_resolved_expr(op1)->const_val;
-    ConstExprValue *op2_val = &get_resolved_expr(op2)->const_val;
+    ConstExprValue *op1_val = &get_resolved_expr(g, op1)->const_val;
+    ConstExprValue *op2_val = &get_resolved_expr(g, op2)->const_val;
     if (!op1_val->ok || !op2_val->ok) {
         return g->builtin_types.entry_bool;
     }
@@ -2491,8 +2758,8 @@ static TypeTableEntry *analyze_bin_op_expr(CodeGen *g, ImportTableEntry *import,
                     return resolved_type;
                 }
 
-                ConstExprValue *op1_val = &get_resolved_expr(op1)->const_val;
-                ConstExprValue *op2_val = &get_resolved_expr(op2)->const_val;
+                ConstExprValue *op1_val = &get_resolved_expr(g, op1)->const_val;
+                ConstExprValue *op2_val = &get_resolved_expr(g, op2)->const_val;
                 if (!op1_val->ok || !op2_val->ok) {
                     return resolved_type;
                 }
@@ -2556,8 +2823,8 @@ static TypeTableEntry *analyze_bin_op_expr(CodeGen *g, ImportTableEntry *import,
                     return g->builtin_types.entry_invalid;
                 }
 
-                ConstExprValue *op1_val = &get_resolved_expr(*op1)->const_val;
-                ConstExprValue *op2_val = &get_resolved_expr(*op2)->const_val;
+                ConstExprValue *op1_val = &get_resolved_expr(g, *op1)->const_val;
+                ConstExprValue *op2_val = &get_resolved_expr(g, *op2)->const_val;
 
                 AstNode *bad_node;
                 if (!op1_val->ok) {
@@ -2571,7 +2838,7 @@ static TypeTableEntry *analyze_bin_op_expr(CodeGen *g, ImportTableEntry *import,
                     add_node_error(g, bad_node, buf_sprintf("string concatenation requires constant expression"));
                     return g->builtin_types.entry_invalid;
                 }
-                ConstExprValue *const_val = &get_resolved_expr(node)->const_val;
+                ConstExprValue *const_val = &get_resolved_expr(g, node)->const_val;
                 const_val->ok = true;
 
                 ConstExprValue *all_fields = allocate<ConstExprValue>(2);
@@ -2616,7 +2883,7 @@ static VariableTableEntry *add_local_var(CodeGen *g, AstNode *source_node, Block
     variable_entry->type = type_entry;
 
     if (name) {
-        buf_init_from_buf(&variable_entry->name, name);
+        variable_entry->name = name;
         VariableTableEntry *existing_var;
 
         if (context->fn_entry) {
@@ -2642,10 +2909,14 @@ static VariableTableEntry *add_local_var(CodeGen *g, AstNode *source_node, Block
             }
         }
 
-        context->variable_table.put(&variable_entry->name, variable_entry);
+        if (context->fn_entry) {
+            scope_put_local(context, variable_entry->name, variable_entry);
+        } else {
+            scope_put_variable(g, context, variable_entry->name, variable_entry);
+        }
         context->variable_list.append(variable_entry);
     } else {
-        buf_init_from_str(&variable_entry->name, "_anon");
+        variable_entry->name = intern_str("_anon");
         context->variable_list.append(variable_entry);
     }
 
@@ -2670,9 +2941,9 @@ static TypeTableEntry *analyze_unwrap_error_expr(CodeGen *g, ImportTableEntry *i
         TypeTableEntry *child_type = lhs_type->data.error.child_type;
         BlockContext *child_context;
         if (var_node) {
-            child_context = new_block_context(node, parent_context);
+            child_context = new_block_context(g, node, parent_context);
             var_node->block_context = child_context;
-            Buf *var_name = &var_node->data.symbol_expr.symbol;
+            Buf *var_name = var_node->data.symbol_expr.symbol;
             node->data.unwrap_err_expr.var = add_local_var(g, var_node, child_context, var_name,
                     g->builtin_types.entry_pure_error, true);
         } else {
@@ -2680,6 +2951,9 @@ static TypeTableEntry *analyze_unwrap_error_expr(CodeGen *g, ImportTableEntry *i
         }
 
         analyze_expression(g, import, child_context, child_type, op2);
+        if (var_node) {
+            end_block_context(child_context);
+        }
         return child_type;
     } else {
         add_node_error(g, op1,
@@ -2734,7 +3008,7 @@ static VariableTableEntry *analyze_variable_declaration_raw(CodeGen *g, ImportTa
             implicit_type = g->builtin_types.entry_invalid;
         }
         if (implicit_type->id != TypeTableEntryIdInvalid && !context->fn_entry) {
-            ConstExprValue *const_val = &get_resolved_expr(variable_declaration->expr)->const_val;
+            ConstExprValue *const_val = &get_resolved_expr(g, variable_declaration->expr)->const_val;
             if (!const_val->ok) {
                 add_node_error(g, first_executing_node(variable_declaration->expr),
                         buf_sprintf("global variable initializer requires constant expression"));
@@ -2749,7 +3023,7 @@ static VariableTableEntry *analyze_variable_declaration_raw(CodeGen *g, ImportTa
     assert(type != nullptr); // should have been caught by the parser
 
     VariableTableEntry *var = add_local_var(g, source_node, context,
-            &variable_declaration->symbol, type, is_const);
+            variable_declaration->symbol, type, is_const);
 
     variable_declaration->variable = var;
 
@@ -2758,13 +3032,13 @@ static VariableTableEntry *analyze_variable_declaration_raw(CodeGen *g, ImportTa
     if (is_pub) {
         for (int i = 0; i < import->importers.length; i += 1) {
             ImporterInfo importer = import->importers.at(i);
-            auto table_entry = importer.import->block_context->variable_table.maybe_get(&var->name);
-            if (table_entry) {
+            VariableTableEntry **existing_var = importer.import->block_context->variable_table.maybe_get(var->name);
+            if (existing_var) {
                 add_node_error(g, importer.source_node,
                     buf_sprintf("import of variable '%s' overrides existing definition",
-                        buf_ptr(&var->name)));
+                        buf_ptr(var->name)));
             } else {
-                importer.import->block_context->variable_table.put(&var->name, var);
+                scope_put_variable(g, importer.import->block_context, var->name, var);
             }
         }
     }
@@ -2792,9 +3066,10 @@ static TypeTableEntry *analyze_null_literal_expr(CodeGen *g, ImportTableEntry *i
 
     assert(expected_type->id == TypeTableEntryIdMaybe);
 
-    node->data.null_literal.resolved_struct_val_expr.type_entry = expected_type;
-    node->data.null_literal.resolved_struct_val_expr.source_node = node;
-    block_context->struct_val_expr_alloca_list.append(&node->data.null_literal.resolved_struct_val_expr);
+    StructValExprCodeGen *codegen = get_resolved_struct_val_expr(g, node);
+    codegen->type_entry = expected_type;
+    codegen->source_node = node;
+    block_context->struct_val_expr_alloca_list.append(codegen);
 
     return resolve_expr_const_val_as_null(g, node, expected_type);
 }
@@ -2802,7 +3077,7 @@ static TypeTableEntry *analyze_null_literal_expr(CodeGen *g, ImportTableEntry *i
 static TypeTableEntry *analyze_undefined_literal_expr(CodeGen *g, ImportTableEntry *import, BlockContext *context,
         TypeTableEntry *expected_type, AstNode *node)
 {
-    Expr *expr = get_resolved_expr(node);
+    Expr *expr = get_resolved_expr(g, node);
     ConstExprValue *const_val = &expr->const_val;
 
     const_val->ok = true;
@@ -2852,7 +3127,7 @@ static TypeTableEntry *analyze_array_type(CodeGen *g, ImportTableEntry *import,
             return g->builtin_types.entry_invalid;
         }
 
-        ConstExprValue *const_val = &get_resolved_expr(size_node)->const_val;
+        ConstExprValue *const_val = &get_resolved_expr(g, size_node)->const_val;
         if (const_val->ok) {
             if (const_val->data.x_bignum.is_negative) {
                 add_node_error(g, size_node,
@@ -2884,11 +3159,12 @@ static TypeTableEntry *analyze_while_expr(CodeGen *g, ImportTableEntry *import,
     TypeTableEntry *condition_type = analyze_expression(g, import, context,
             g->builtin_types.entry_bool, condition_node);
 
-    BlockContext *child_context = new_block_context(node, context);
+    BlockContext *child_context = new_block_context(g, node, context);
     child_context->parent_loop_node = node;
     node->data.while_expr.block_context = child_context;
 
     analyze_expression(g, import, child_context, g->builtin_types.entry_void, while_body_node);
+    end_block_context(child_context);
 
 
     TypeTableEntry *expr_return_type = g->builtin_types.entry_void;
@@ -2898,7 +3174,7 @@ static TypeTableEntry *analyze_while_expr(CodeGen *g, ImportTableEntry *import,
     } else {
         // if the condition is a simple constant expression and there are no break statements
         // then the return type is unreachable
-        ConstExprValue *const_val = &get_resolved_expr(condition_node)->const_val;
+        ConstExprValue *const_val = &get_resolved_expr(g, condition_node)->const_val;
         if (const_val->ok) {
             if (const_val->data.x_bool) {
                 node->data.while_expr.condition_always_true = true;
@@ -2936,16 +3212,16 @@ static TypeTableEntry *analyze_for_expr(CodeGen *g, ImportTableEntry *import, Bl
         child_type = g->builtin_types.entry_invalid;
     }
 
-    BlockContext *child_context = new_block_context(node, context);
+    BlockContext *child_context = new_block_context(g, node, context);
 
     AstNode *elem_var_node = node->data.for_expr.elem_node;
     elem_var_node->block_context = child_context;
-    Buf *elem_var_name = &elem_var_node->data.symbol_expr.symbol;
+    Buf *elem_var_name = elem_var_node->data.symbol_expr.symbol;
     node->data.for_expr.elem_var = add_local_var(g, elem_var_node, child_context, elem_var_name, child_type, true);
 
     AstNode *index_var_node = node->data.for_expr.index_node;
     if (index_var_node) {
-        Buf *index_var_name = &index_var_node->data.symbol_expr.symbol;
+        Buf *index_var_name = index_var_node->data.symbol_expr.symbol;
         index_var_node->block_context = child_context;
         node->data.for_expr.index_var = add_local_var(g, index_var_node, child_context, index_var_name,
                 g->builtin_types.entry_isize, true);
@@ -2956,6 +3232,7 @@ static TypeTableEntry *analyze_for_expr(CodeGen *g, ImportTableEntry *import, Bl
 
     AstNode *for_body_node = node->data.for_expr.body;
     analyze_expression(g, import, child_context, g->builtin_types.entry_void, for_body_node);
+    end_block_context(child_context);
 
 
     return g->builtin_types.entry_void;
@@ -3024,12 +3301,14 @@ static TypeTableEntry *analyze_if_var_expr(CodeGen *g, ImportTableEntry *import,
 {
     assert(node->type == NodeTypeIfVarExpr);
 
-    BlockContext *child_context = new_block_context(node, context);
+    BlockContext *child_context = new_block_context(g, node, context);
 
     analyze_variable_declaration_raw(g, import, child_context, node, &node->data.if_var_expr.var_decl, true);
 
-    return analyze_if_then_else(g, import, child_context, expected_type,
+    TypeTableEntry *result_type = analyze_if_then_else(g, import, child_context, expected_type,
             node->data.if_var_expr.then_block, node->data.if_var_expr.else_node, node);
+    end_block_context(child_context);
+    return result_type;
 }
 
 static TypeTableEntry *analyze_min_max_value(CodeGen *g, ImportTableEntry *import, BlockContext *context,
@@ -3043,7 +3322,7 @@ static TypeTableEntry *analyze_min_max_value(CodeGen *g, ImportTableEntry *impor
     if (type_entry->id == TypeTableEntryIdInvalid) {
         return g->builtin_types.entry_invalid;
     } else if (type_entry->id == TypeTableEntryIdInt) {
-        ConstExprValue *const_val = &get_resolved_expr(node)->const_val;
+        ConstExprValue *const_val = &get_resolved_expr(g, node)->const_val;
         const_val->ok = true;
         if (is_max) {
             if (type_entry->data.integral.is_signed) {
@@ -3109,8 +3388,8 @@ static TypeTableEntry *analyze_min_max_value(CodeGen *g, ImportTableEntry *impor
 
 static void eval_const_expr_implicit_cast(CodeGen *g, AstNode *node, AstNode *expr_node) {
     assert(node->type == NodeTypeFnCallExpr);
-    ConstExprValue *other_val = &get_resolved_expr(expr_node)->const_val;
-    ConstExprValue *const_val = &get_resolved_expr(node)->const_val;
+    ConstExprValue *other_val = &get_resolved_expr(g, expr_node)->const_val;
+    ConstExprValue *const_val = &get_resolved_expr(g, node)->const_val;
     if (!other_val->ok) {
         return;
     }
@@ -3129,7 +3408,7 @@ static void eval_const_expr_implicit_cast(CodeGen *g, AstNode *node, AstNode *ex
             break;
         case CastOpToUnknownSizeArray:
             {
-                TypeTableEntry *other_type = get_resolved_expr(expr_node)->type_entry;
+                TypeTableEntry *other_type = get_resolved_expr(g, expr_node)->type_entry;
                 assert(other_type->id == TypeTableEntryIdArray);
 
                 ConstExprValue *all_fields = allocate<ConstExprValue>(2);
@@ -3351,7 +3630,7 @@ static TypeTableEntry *analyze_builtin_fn_call_expr(CodeGen *g, ImportTableEntry
     assert(node->type == NodeTypeFnCallExpr);
 
     AstNode *fn_ref_expr = node->data.fn_call_expr.fn_ref_expr;
-    Buf *name = &fn_ref_expr->data.symbol_expr.symbol;
+    Buf *name = fn_ref_expr->data.symbol_expr.symbol;
 
     auto entry = g->builtin_fn_table.maybe_get(name);
 
@@ -3541,7 +3820,7 @@ static TypeTableEntry *analyze_builtin_fn_call_expr(CodeGen *g, ImportTableEntry
                     return resolved_type;
                 }
 
-                ConstExprValue *const_str_val = &get_resolved_expr(*str_node)->const_val;
+                ConstExprValue *const_str_val = &get_resolved_expr(g, *str_node)->const_val;
 
                 if (!const_str_val->ok) {
                     add_node_error(g, *str_node, buf_sprintf("@c_include requires constant expression"));
@@ -3611,15 +3890,15 @@ static TypeTableEntry *analyze_fn_call_raw(CodeGen *g, ImportTableEntry *import,
             AstNode *param_decl_node = fn_proto->params.at(fn_proto_i);
             assert(param_decl_node->type == NodeTypeParamDecl);
             AstNode *param_type_node = param_decl_node->data.param_decl.type;
-            TypeTableEntry *param_type_entry = get_resolved_expr(param_type_node)->type_entry;
+            TypeTableEntry *param_type_entry = get_resolved_expr(g, param_type_node)->type_entry;
             if (param_type_entry) {
-                expected_param_type = unwrapped_node_type(param_type_node);
+                expected_param_type = unwrapped_node_type(g, param_type_node);
             }
         }
         analyze_expression(g, import, context, expected_param_type, child);
     }
 
-    TypeTableEntry *return_type = unwrapped_node_type(fn_proto->return_type);
+    TypeTableEntry *return_type = unwrapped_node_type(g, fn_proto->return_type);
 
     if (return_type->id == TypeTableEntryIdInvalid) {
         return return_type;
@@ -3645,7 +3924,7 @@ static TypeTableEntry *analyze_fn_call_expr(CodeGen *g, ImportTableEntry *import
         fn_ref_expr->block_context = context;
         AstNode *first_param_expr = fn_ref_expr->data.field_access_expr.struct_expr;
         TypeTableEntry *struct_type = analyze_expression(g, import, context, nullptr, first_param_expr);
-        Buf *name = &fn_ref_expr->data.field_access_expr.field_name;
+        Buf *name = fn_ref_expr->data.field_access_expr.field_name;
         if (struct_type->id == TypeTableEntryIdStruct ||
             (struct_type->id == TypeTableEntryIdPointer &&
             struct_type->data.pointer.child_type->id == TypeTableEntryIdStruct))
@@ -3677,7 +3956,7 @@ static TypeTableEntry *analyze_fn_call_expr(CodeGen *g, ImportTableEntry *import
             if (enum_type->id == TypeTableEntryIdInvalid) {
                 return g->builtin_types.entry_invalid;
             } else if (enum_type->id == TypeTableEntryIdEnum) {
-                Buf *field_name = &fn_ref_expr->data.field_access_expr.field_name;
+                Buf *field_name = fn_ref_expr->data.field_access_expr.field_name;
                 int param_count = node->data.fn_call_expr.params.length;
                 if (param_count > 1) {
                     add_node_error(g, first_executing_node(node->data.fn_call_expr.params.at(1)),
@@ -3711,7 +3990,7 @@ static TypeTableEntry *analyze_fn_call_expr(CodeGen *g, ImportTableEntry *import
 
     // use constant expression evaluator to figure out the function at compile time.
     // otherwise we treat this as a function pointer.
-    ConstExprValue *const_val = &get_resolved_expr(fn_ref_expr)->const_val;
+    ConstExprValue *const_val = &get_resolved_expr(g, fn_ref_expr)->const_val;
 
     if (const_val->ok) {
         if (invoke_type_entry->id == TypeTableEntryIdMetaType) {
@@ -3751,7 +4030,7 @@ static TypeTableEntry *analyze_prefix_op_expr(CodeGen *g, ImportTableEntry *impo
                     return g->builtin_types.entry_bool;
                 }
 
-                ConstExprValue *target_const_val = &get_resolved_expr(expr_node)->const_val;
+                ConstExprValue *target_const_val = &get_resolved_expr(g, expr_node)->const_val;
                 if (!target_const_val->ok) {
                     return g->builtin_types.entry_bool;
                 }
@@ -3788,11 +4067,11 @@ static TypeTableEntry *analyze_prefix_op_expr(CodeGen *g, ImportTableEntry *impo
                             expr_type->id == TypeTableEntryIdNumLitInt ||
                             expr_type->id == TypeTableEntryIdNumLitFloat)
                 {
-                    ConstExprValue *target_const_val = &get_resolved_expr(expr_node)->const_val;
+                    ConstExprValue *target_const_val = &get_resolved_expr(g, expr_node)->const_val;
                     if (!target_const_val->ok) {
                         return expr_type;
                     }
-                    ConstExprValue *const_val = &get_resolved_expr(node)->const_val;
+                    ConstExprValue *const_val = &get_resolved_expr(g, node)->const_val;
                     const_val->ok = true;
                     bignum_negate(&const_val->data.x_bignum, &target_const_val->data.x_bignum);
                     return expr_type;
@@ -3950,7 +4229,7 @@ static TypeTableEntry *analyze_switch_expr(CodeGen *g, ImportTableEntry *import,
                         zig_panic("TODO range in switch statement");
                     }
                     analyze_expression(g, import, context, expr_type, item_node);
-                    ConstExprValue *const_val = &get_resolved_expr(item_node)->const_val;
+                    ConstExprValue *const_val = &get_resolved_expr(g, item_node)->const_val;
                     if (!const_val->ok) {
                         add_node_error(g, item_node, buf_sprintf("unable to resolve constant expression"));
                     }
@@ -3958,12 +4237,12 @@ static TypeTableEntry *analyze_switch_expr(CodeGen *g, ImportTableEntry *import,
                 var_type = expr_type;
             }
 
-            BlockContext *child_context = new_block_context(node, context);
+            BlockContext *child_context = new_block_context(g, node, context);
             prong_node->data.switch_prong.block_context = child_context;
             AstNode *var_node = prong_node->data.switch_prong.var_symbol;
             if (var_node) {
                 assert(var_node->type == NodeTypeSymbol);
-                Buf *var_name = &var_node->data.symbol_expr.symbol;
+                Buf *var_name = var_node->data.symbol_expr.symbol;
                 var_node->block_context = child_context;
                 prong_node->data.switch_prong.var = add_local_var(g, var_node, child_context, var_name,
                         var_type, true);
@@ -3971,6 +4250,7 @@ static TypeTableEntry *analyze_switch_expr(CodeGen *g, ImportTableEntry *import,
 
             analyze_expression(g, import, child_context, expected_type,
                     prong_node->data.switch_prong.expr);
+            end_block_context(child_context);
         }
     }
     return expected_type;
@@ -3989,7 +4269,7 @@ static TypeTableEntry *analyze_return_expr(CodeGen *g, ImportTableEntry *import,
         normalize_parent_ptrs(node);
     }
 
-    TypeTableEntry *expected_return_type = get_return_type(context);
+    TypeTableEntry *expected_return_type = get_return_type(g, context);
 
     switch (node->data.return_expr.kind) {
         case ReturnKindUnconditional:
@@ -4036,7 +4316,7 @@ static TypeTableEntry *analyze_string_literal_expr(CodeGen *g, ImportTableEntry
 static TypeTableEntry *analyze_block_expr(CodeGen *g, ImportTableEntry *import, BlockContext *context,
         TypeTableEntry *expected_type, AstNode *node)
 {
-    BlockContext *child_context = new_block_context(node, context);
+    BlockContext *child_context = new_block_context(g, node, context);
     node->data.block.block_context = child_context;
     TypeTableEntry *return_type = g->builtin_types.entry_void;
 
@@ -4071,6 +4351,7 @@ static TypeTableEntry *analyze_block_expr(CodeGen *g, ImportTableEntry *import,
             }
         }
     }
+    end_block_context(child_context);
     return return_type;
 }
 
@@ -4095,13 +4376,13 @@ static TypeTableEntry *analyze_expression(CodeGen *g, ImportTableEntry *import,
         case NodeTypeGoto:
             {
                 FnTableEntry *fn_table_entry = get_context_fn_entry(context);
-                auto table_entry = fn_table_entry->label_table.maybe_get(&node->data.goto_expr.name);
+                auto table_entry = fn_table_entry->label_table.maybe_get(node->data.goto_expr.name);
                 if (table_entry) {
                     node->data.goto_expr.label_entry = table_entry->value;
                     table_entry->value->used = true;
                 } else {
                     add_node_error(g, node,
-                            buf_sprintf("use of undeclared label '%s'", buf_ptr(&node->data.goto_expr.name)));
+                            buf_sprintf("use of undeclared label '%s'", buf_ptr(node->data.goto_expr.name)));
                 }
                 return_type = g->builtin_types.entry_unreachable;
                 break;
@@ -4127,7 +4408,8 @@ static TypeTableEntry *analyze_expression(CodeGen *g, ImportTableEntry *import,
                             break;
                         }
                     } else {
-                        analyze_variable_name(g, import, context, node, &asm_output->variable_name);
+                        asm_output->variable = analyze_variable_name(g, import, context, node,
+                                asm_output->variable_name);
                     }
                 }
                 for (int i = 0; i < node->data.asm_expr.input_list.length; i += 1) {
@@ -4231,7 +4513,7 @@ static TypeTableEntry *analyze_expression(CodeGen *g, ImportTableEntry *import,
     TypeTableEntry *resolved_type = resolve_type_compatibility(g, import, context, node,
             expected_type, return_type);
 
-    Expr *expr = get_resolved_expr(node);
+    Expr *expr = get_resolved_expr(g, node);
     expr->type_entry = return_type;
     node->block_context = context;
 
@@ -4246,13 +4528,11 @@ static void analyze_top_level_fn_def(CodeGen *g, ImportTableEntry *import, AstNo
     AstNode *fn_proto_node = node->data.fn_def.fn_proto;
     assert(fn_proto_node->type == NodeTypeFnProto);
 
-    if (fn_proto_node->data.fn_proto.skip) {
-        // we detected an error with this function definition which prevents us
-        // from further analyzing it.
-        return;
-    }
-
     BlockContext *context = node->data.fn_def.block_context;
+    FnTableEntry *fn_table_entry = fn_proto_node->data.fn_proto.fn_table_entry;
+    LocalScopes local_scopes = {};
+    local_scopes.names.init(16);
+    fn_table_entry->local_scopes = &local_scopes;
 
     AstNodeFnProto *fn_proto = &fn_proto_node->data.fn_proto;
     bool is_exported = (fn_proto->visib_mod == VisibModExport);
@@ -4262,7 +4542,7 @@ static void analyze_top_level_fn_def(CodeGen *g, ImportTableEntry *import, AstNo
 
         // define local variables for parameters
         AstNodeParamDecl *param_decl = &param_decl_node->data.param_decl;
-        TypeTableEntry *type = unwrapped_node_type(param_decl->type);
+        TypeTableEntry *type = unwrapped_node_type(g, param_decl->type);
 
         if (param_decl->is_noalias && type->id != TypeTableEntryIdPointer) {
             add_node_error(g, param_decl_node,
@@ -4274,20 +4554,23 @@ static void analyze_top_level_fn_def(CodeGen *g, ImportTableEntry *import, AstNo
                 buf_sprintf("byvalue struct parameters not yet supported on exported functions"));
         }
 
-        VariableTableEntry *var = add_local_var(g, param_decl_node, context, &param_decl->name, type, true);
+        VariableTableEntry *var = add_local_var(g, param_decl_node, context, param_decl->name, type, true);
         var->src_arg_index = i;
         param_decl_node->data.param_decl.variable = var;
 
         var->gen_arg_index = param_decl_node->data.param_decl.gen_index;
     }
 
-    TypeTableEntry *expected_type = unwrapped_node_type(fn_proto->return_type);
+    TypeTableEntry *expected_type = unwrapped_node_type(g, fn_proto->return_type);
     TypeTableEntry *block_return_type = analyze_expression(g, import, context, expected_type, node->data.fn_def.body);
 
     node->data.fn_def.implicit_return_type = block_return_type;
 
+    fn_table_entry->local_scopes = nullptr;
+    local_scopes.names.deinit();
+    local_scopes.bindings.deinit();
+
     {
-        FnTableEntry *fn_table_entry = fn_proto_node->data.fn_proto.fn_table_entry;
         auto it = fn_table_entry->label_table.entry_iterator();
         for (;;) {
             auto *entry = it.next();
@@ -4298,22 +4581,35 @@ static void analyze_top_level_fn_def(CodeGen *g, ImportTableEntry *import, AstNo
             if (!label_entry->used) {
                 add_node_error(g, label_entry->label_node,
                     buf_sprintf("label '%s' defined but not used",
-                        buf_ptr(&label_entry->label_node->data.label.name)));
+                        buf_ptr(label_entry->label_node->data.label.name)));
             }
         }
     }
 }
 
-static void analyze_top_level_decl(CodeGen *g, ImportTableEntry *import, AstNode *node) {
+static void add_fn_body_job(ZigList<FnBodyJob> *jobs, ImportTableEntry *import, AstNode *fn_def_node) {
+    assert(fn_def_node->type == NodeTypeFnDef);
+    if (fn_def_node->data.fn_def.fn_proto->data.fn_proto.skip) {
+        // we detected an error with this function definition which prevents us
+        // from further analyzing it.
+        return;
+    }
+    FnBodyJob job = {};
+    job.import = import;
+    job.fn_def_node = fn_def_node;
+    jobs->append(job);
+}
+
+static void collect_fn_body_jobs(ZigList<FnBodyJob> *jobs, ImportTableEntry *import, AstNode *node) {
     switch (node->type) {
         case NodeTypeFnDef:
-            analyze_top_level_fn_def(g, import, node);
+            add_fn_body_job(jobs, import, node);
             break;
         case NodeTypeStructDecl:
             {
                 for (int i = 0; i < node->data.struct_decl.fns.length; i += 1) {
                     AstNode *fn_def_node = node->data.struct_decl.fns.at(i);
-                    analyze_top_level_fn_def(g, import, fn_def_node);
+                    add_fn_body_job(jobs, import, fn_def_node);
                 }
                 break;
             }
@@ -4385,12 +4681,9 @@ static void collect_expr_decl_deps(CodeGen *g, ImportTableEntry *import, AstNode
             break;
         case NodeTypeSymbol:
             {
-                Buf *name = &node->data.symbol_expr.symbol;
+                Buf *name = node->data.symbol_expr.symbol;
                 auto table_entry = g->primitive_type_table.maybe_get(name);
-                if (!table_entry) {
-                    table_entry = import->block_context->type_table.maybe_get(name);
-                }
-                if (!table_entry) {
+                if (!table_entry && !scope_get_type(import->block_context, name)) {
                     decl_node->deps.put(name, node);
                 }
                 break;
@@ -4469,7 +4762,7 @@ static void collect_expr_decl_deps(CodeGen *g, ImportTableEntry *import, AstNode
                 if (asm_output->return_type) {
                     collect_expr_decl_deps(g, import, asm_output->return_type, decl_node);
                 } else {
-                    decl_node->deps.put(&asm_output->variable_name, node);
+                    decl_node->deps.put(asm_output->variable_name, node);
                 }
             }
             for (int i = 0; i < node->data.asm_expr.input_list.length; i += 1) {
@@ -4548,18 +4841,21 @@ static void detect_top_level_decl_deps(CodeGen *g, ImportTableEntry *import, Ast
             break;
         case NodeTypeStructDecl:
             {
-                Buf *name = &node->data.struct_decl.name;
+                Buf *name = node->data.struct_decl.name;
+                TypeTableEntry *existing_type = nullptr;
                 auto table_entry = g->primitive_type_table.maybe_get(name);
-                if (!table_entry) {
-                    table_entry = import->block_context->type_table.maybe_get(name);
-                }
                 if (table_entry) {
-                    node->data.struct_decl.type_entry = table_entry->value;
+                    existing_type = table_entry->value;
+                } else {
+                    existing_type = scope_get_type(import->block_context, name);
+                }
+                if (existing_type) {
+                    node->data.struct_decl.type_entry = existing_type;
                     add_node_error(g, node,
                             buf_sprintf("redefinition of '%s'", buf_ptr(name)));
                 } else {
                     TypeTableEntryId type_id = container_to_type(node->data.struct_decl.kind);
-                    TypeTableEntry *entry = new_type_table_entry(type_id);
+                    TypeTableEntry *entry = new_type_table_entry(g, type_id);
                     switch (node->data.struct_decl.kind) {
                         case ContainerKindStruct:
                             entry->data.structure.decl_node = node;
@@ -4577,27 +4873,26 @@ static void detect_top_level_decl_deps(CodeGen *g, ImportTableEntry *import, Ast
                     buf_init_from_buf(&entry->name, name);
                     // put off adding the debug type until we do the full struct body
                     // this type is incomplete until we do another pass
-                    import->block_context->type_table.put(&entry->name, entry);
+                    scope_put_type(g, import->block_context, name, entry);
                     node->data.struct_decl.type_entry = entry;
 
                     bool is_pub = (node->data.struct_decl.visib_mod != VisibModPrivate);
                     if (is_pub) {
                         for (int i = 0; i < import->importers.length; i += 1) {
                             ImporterInfo importer = import->importers.at(i);
-                            auto table_entry = importer.import->block_context->type_table.maybe_get(&entry->name);
-                            if (table_entry) {
+                            if (scope_get_type(importer.import->block_context, name)) {
                                 add_node_error(g, importer.source_node,
                                     buf_sprintf("import of type '%s' overrides existing definition",
                                         buf_ptr(&entry->name)));
                             } else {
-                                importer.import->block_context->type_table.put(&entry->name, entry);
+                                scope_put_type(g, importer.import->block_context, name, entry);
                             }
                         }
                     }
                 }
 
                 // determine which other top level declarations this struct depends on.
-                TopLevelDecl *decl_node = &node->data.struct_decl.top_level_decl;
+                TopLevelDecl *decl_node = get_resolved_top_level_decl(g, node);
                 decl_node->deps.init(1);
                 for (int i = 0; i < node->data.struct_decl.fields.length; i += 1) {
                     AstNode *field_node = node->data.struct_decl.fields.at(i);
@@ -4607,7 +4902,7 @@ static void detect_top_level_decl_deps(CodeGen *g, ImportTableEntry *import, Ast
                 decl_node->name = name;
                 decl_node->import = import;
                 if (decl_node->deps.size() > 0) {
-                    g->unresolved_top_level_decls.put(name, node);
+                    add_unresolved_decl(g, name, node);
                 } else {
                     resolve_top_level_decl(g, import, node);
                 }
@@ -4629,7 +4924,7 @@ static void detect_top_level_decl_deps(CodeGen *g, ImportTableEntry *import, Ast
         case NodeTypeVariableDeclaration:
             {
                 // determine which other top level declarations this variable declaration depends on.
-                TopLevelDecl *decl_node = &node->data.variable_declaration.top_level_decl;
+                TopLevelDecl *decl_node = get_resolved_top_level_decl(g, node);
                 decl_node->deps.init(1);
                 if (node->data.variable_declaration.type) {
                     collect_expr_decl_deps(g, import, node->data.variable_declaration.type, decl_node);
@@ -4637,11 +4932,11 @@ static void detect_top_level_decl_deps(CodeGen *g, ImportTableEntry *import, Ast
                 if (node->data.variable_declaration.expr) {
                     collect_expr_decl_deps(g, import, node->data.variable_declaration.expr, decl_node);
                 }
-                Buf *name = &node->data.variable_declaration.symbol;
+                Buf *name = node->data.variable_declaration.symbol;
                 decl_node->name = name;
                 decl_node->import = import;
                 if (decl_node->deps.size() > 0) {
-                    g->unresolved_top_level_decls.put(name, node);
+                    add_unresolved_decl(g, name, node);
                 } else {
                     resolve_top_level_decl(g, import, node);
                 }
@@ -4650,7 +4945,7 @@ static void detect_top_level_decl_deps(CodeGen *g, ImportTableEntry *import, Ast
         case NodeTypeFnProto:
             {
                 // determine which other top level declarations this function prototype depends on.
-                TopLevelDecl *decl_node = &node->data.fn_proto.top_level_decl;
+                TopLevelDecl *decl_node = get_resolved_top_level_decl(g, node);
                 decl_node->deps.init(1);
                 for (int i = 0; i < node->data.fn_proto.params.length; i += 1) {
                     AstNode *param_node = node->data.fn_proto.params.at(i);
@@ -4659,11 +4954,11 @@ static void detect_top_level_decl_deps(CodeGen *g, ImportTableEntry *import, Ast
                 }
                 collect_expr_decl_deps(g, import, node->data.fn_proto.return_type, decl_node);
 
-                Buf *name = &node->data.fn_proto.name;
+                Buf *name = node->data.fn_proto.name;
                 decl_node->name = name;
                 decl_node->import = import;
                 if (decl_node->deps.size() > 0) {
-                    g->unresolved_top_level_decls.put(name, node);
+                    add_unresolved_decl(g, name, node);
                 } else {
                     resolve_top_level_decl(g, import, node);
                 }
@@ -4677,14 +4972,14 @@ static void detect_top_level_decl_deps(CodeGen *g, ImportTableEntry *import, Ast
             break;
         case NodeTypeCImport:
             {
-                TopLevelDecl *decl_node = &node->data.c_import.top_level_decl;
+                TopLevelDecl *decl_node = get_resolved_top_level_decl(g, node);
                 decl_node->deps.init(1);
                 collect_expr_decl_deps(g, import, node->data.c_import.block, decl_node);
 
-                decl_node->name = buf_sprintf("c_import_%" PRIu32, node->create_index);
+                decl_node->name = intern_buf(buf_sprintf("c_import_%" PRIu32, node->create_index));
                 decl_node->import = import;
                 if (decl_node->deps.size() > 0) {
-                    g->unresolved_top_level_decls.put(decl_node->name, node);
+                    add_unresolved_decl(g, decl_node->name, node);
                 } else {
                     resolve_top_level_decl(g, import, node);
                 }
@@ -4735,7 +5030,7 @@ static void detect_top_level_decl_deps(CodeGen *g, ImportTableEntry *import, Ast
 }
 
 static void recursive_resolve_decl(CodeGen *g, ImportTableEntry *import, AstNode *node) {
-    auto it = get_resolved_top_level_decl(node)->deps.entry_iterator();
+    auto it = get_resolved_top_level_decl(g, node)->deps.entry_iterator();
     for (;;) {
         auto *entry = it.next();
         if (!entry)
@@ -4748,14 +5043,14 @@ static void recursive_resolve_decl(CodeGen *g, ImportTableEntry *import, AstNode
 
         AstNode *child_node = unresolved_entry->value;
 
-        if (get_resolved_top_level_decl(child_node)->in_current_deps) {
+        if (get_resolved_top_level_decl(g, child_node)->in_current_deps) {
             // dependency loop. we'll let the fact that it's not in the respective
             // table cause an error in resolve_top_level_decl.
             continue;
         }
 
         // set temporary flag
-        TopLevelDecl *top_level_decl = get_resolved_top_level_decl(child_node);
+        TopLevelDecl *top_level_decl = get_resolved_top_level_decl(g, child_node);
         top_level_decl->in_current_deps = true;
 
         recursive_resolve_decl(g, top_level_decl->import, child_node);
@@ -4767,27 +5062,18 @@ static void recursive_resolve_decl(CodeGen *g, ImportTableEntry *import, AstNode
     resolve_top_level_decl(g, import, node);
 }
 
-static void resolve_top_level_declarations_root(CodeGen *g, ImportTableEntry *import, AstNode *node) {
-    assert(node->type == NodeTypeRoot);
-
-    while (g->unresolved_top_level_decls.size() > 0) {
-        // for the sake of determinism, find the element with the lowest
-        // insert index and resolve that one.
-        AstNode *decl_node = nullptr;
-        auto it = g->unresolved_top_level_decls.entry_iterator();
-        for (;;) {
-            auto *entry = it.next();
-            if (!entry)
-                break;
-
-            AstNode *this_node = entry->value;
-            if (!decl_node || this_node->create_index < decl_node->create_index) {
-                decl_node = this_node;
-            }
+static void resolve_top_level_decls(CodeGen *g) {
+    // for the sake of determinism, resolve the decls in order of create index
+    while (g->unresolved_decl_queue.length > 0) {
+        AstNode *decl_node = pop_unresolved_decl(g);
+        TopLevelDecl *top_level_decl = get_resolved_top_level_decl(g, decl_node);
+        // resolved as a dependency of an earlier decl, or replaced by a later
+        // decl of the same name
+        auto entry = g->unresolved_top_level_decls.maybe_get(top_level_decl->name);
+        if (!entry || entry->value != decl_node)
+            continue;
 
-        }
         // set temporary flag
-        TopLevelDecl *top_level_decl = get_resolved_top_level_decl(decl_node);
         top_level_decl->in_current_deps = true;
 
         recursive_resolve_decl(g, top_level_decl->import, decl_node);
@@ -4797,17 +5083,145 @@ static void resolve_top_level_declarations_root(CodeGen *g, ImportTableEntry *im
     }
 }
 
-static void analyze_top_level_decls_root(CodeGen *g, ImportTableEntry *import, AstNode *node) {
+static void collect_fn_body_jobs_root(ZigList<FnBodyJob> *jobs, ImportTableEntry *import, AstNode *node) {
     assert(node->type == NodeTypeRoot);
 
     for (int i = 0; i < node->data.root.top_level_decls.length; i += 1) {
         AstNode *child = node->data.root.top_level_decls.at(i);
-        analyze_top_level_decl(g, import, child);
+        collect_fn_body_jobs(jobs, import, child);
     }
 }
 
+static Buf *fn_body_job_name(FnBodyJob *job) {
+    return job->fn_def_node->data.fn_def.fn_proto->data.fn_proto.name;
+}
+
+static int fn_body_job_block_contexts(FnBodyJob *job) {
+    AstNode *fn_proto_node = job->fn_def_node->data.fn_def.fn_proto;
+    return fn_proto_node->data.fn_proto.fn_table_entry->all_block_contexts.length;
+}
+
+struct FnBodyPool {
+    CodeGen *g;
+    ZigList<FnBodyJob> *jobs;
+    // the index of the next job to hand out, taken with an atomic add
+    int next_job;
+};
+
+struct FnBodyWorker {
+    FnBodyPool *pool;
+    int thread_id;
+    pthread_t thread;
+    int job_count;
+    double wall_start;
+    double wall_seconds;
+    double cpu_seconds;
+};
+
+static void run_fn_body_jobs(FnBodyWorker *worker) {
+    FnBodyPool *pool = worker->pool;
+    worker->wall_start = os_get_time();
+    double cpu_start = os_get_thread_cpu_time();
+    for (;;) {
+        int job_index = __atomic_fetch_add(&pool->next_job, 1, __ATOMIC_RELAXED);
+        if (job_index >= pool->jobs->length)
+            break;
+        FnBodyJob *job = &pool->jobs->at(job_index);
+        int first_block_context = fn_body_job_block_contexts(job);
+        job->thread_id = worker->thread_id;
+        job->wall_start = os_get_time();
+
+        current_fn_body_job = job;
+        analyze_top_level_fn_def(pool->g, job->import, job->fn_def_node);
+        current_fn_body_job = nullptr;
+
+        job->wall_seconds = os_get_time() - job->wall_start;
+        job->scope_count = fn_body_job_block_contexts(job) - first_block_context;
+        worker->job_count += 1;
+    }
+    worker->wall_seconds = os_get_time() - worker->wall_start;
+    worker->cpu_seconds = os_get_thread_cpu_time() - cpu_start;
+}
+
+static void *fn_body_worker_thread(void *arg) {
+    run_fn_body_jobs((FnBodyWorker *)arg);
+    return nullptr;
+}
+
+// Analyzing a body only writes to that function's own nodes and scopes, apart
+// from the type caches, the node counter and the side tables, which are
+// thread safe, and the errors and global constants, which are staged per job.
+static void analyze_fn_bodies_parallel(CodeGen *g, ZigList<FnBodyJob> *jobs, int thread_count) {
+    FnBodyPool pool = {};
+    pool.g = g;
+    pool.jobs = jobs;
+
+    FnBodyWorker *workers = allocate<FnBodyWorker>(thread_count);
+    for (int i = 0; i < thread_count; i += 1) {
+        workers[i].pool = &pool;
+        workers[i].thread_id = i + 1;
+    }
+    for (int i = 1; i < thread_count; i += 1) {
+        if (pthread_create(&workers[i].thread, nullptr, fn_body_worker_thread, &workers[i])) {
+            zig_panic("unable to create thread");
+        }
+    }
+    run_fn_body_jobs(&workers[0]);
+    for (int i = 1; i < thread_count; i += 1) {
+        pthread_join(workers[i].thread, nullptr);
+    }
+
+    for (int i = 0; i < jobs->length; i += 1) {
+        FnBodyJob *job = &jobs->at(i);
+        for (int j = 0; j < job->errors.length; j += 1) {
+            g->errors.append(job->errors.at(j));
+        }
+        for (int j = 0; j < job->global_consts.length; j += 1) {
+            g->global_const_list.append(job->global_consts.at(j));
+        }
+        job->errors.deinit();
+        job->global_consts.deinit();
+        trace_add_finished(g, "analyze", fn_body_job_name(job), job->thread_id,
+                job->wall_start, job->wall_seconds, "scopes", job->scope_count);
+    }
+    for (int i = 0; i < thread_count; i += 1) {
+        FnBodyWorker *worker = &workers[i];
+        timing_add_finished(g, "analyze thread", buf_sprintf("%d", worker->thread_id), worker->thread_id,
+                worker->wall_start, worker->wall_seconds, worker->cpu_seconds, "fns", worker->job_count);
+    }
+    deallocate(workers, thread_count);
+}
+
+static void analyze_fn_bodies(CodeGen *g) {
+    ZigList<FnBodyJob> jobs = {0};
+    auto it = g->import_table.entry_iterator();
+    for (;;) {
+        auto *entry = it.next();
+        if (!entry)
+            break;
+
+        ImportTableEntry *import = entry->value;
+        collect_fn_body_jobs_root(&jobs, import, import->root);
+    }
+
+    int thread_count = min(g->thread_count, jobs.length);
+    if (thread_count > 1) {
+        analyze_fn_bodies_parallel(g, &jobs, thread_count);
+    } else {
+        for (int i = 0; i < jobs.length; i += 1) {
+            FnBodyJob *job = &jobs.at(i);
+            int first_block_context = fn_body_job_block_contexts(job);
+            trace_begin(g, "analyze", fn_body_job_name(job));
+            analyze_top_level_fn_def(g, job->import, job->fn_def_node);
+            trace_end(g, "scopes", fn_body_job_block_contexts(job) - first_block_context);
+        }
+    }
+    jobs.deinit();
+}
+
 void semantic_analyze(CodeGen *g) {
     {
+        int phase = timing_begin(g, "collect imports", nullptr);
         auto it = g->import_table.entry_iterator();
         for (;;) {
             auto *entry = it.next();
@@ -4821,7 +5235,7 @@ void semantic_analyze(CodeGen *g) {
                 if (child->type == NodeTypeImport) {
                     for (int i = 0; i < child->data.import.directives->length; i += 1) {
                         AstNode *directive_node = child->data.import.directives->at(i);
-                        Buf *name = &directive_node->data.directive.name;
+                        Buf *name = directive_node->data.directive.name;
                         add_node_error(g, directive_node,
                                 buf_sprintf("invalid directive: '%s'", buf_ptr(name)));
                     }
@@ -4835,6 +5249,7 @@ void semantic_analyze(CodeGen *g) {
                 }
             }
         }
+        timing_end(g, phase);
     }
 
     {
@@ -4847,6 +5262,7 @@ void semantic_analyze(CodeGen *g) {
     }
 
     {
+        int phase = timing_begin(g, "detect decl dependencies", nullptr);
         auto it = g->import_table.entry_iterator();
         for (;;) {
             auto *entry = it.next();
@@ -4857,171 +5273,41 @@ void semantic_analyze(CodeGen *g) {
 
             detect_top_level_decl_deps(g, import, import->root);
         }
+        timing_end(g, phase);
     }
 
     assert(g->error_value_count == g->next_error_index);
 
     {
-        auto it = g->import_table.entry_iterator();
-        for (;;) {
-            auto *entry = it.next();
-            if (!entry)
-                break;
-
-            ImportTableEntry *import = entry->value;
-            resolve_top_level_declarations_root(g, import, import->root);
-        }
+        int phase = timing_begin(g, "resolve decls", nullptr);
+        resolve_top_level_decls(g);
+        timing_end(g, phase);
     }
     {
-        auto it = g->import_table.entry_iterator();
-        for (;;) {
-            auto *entry = it.next();
-            if (!entry)
-                break;
-
-            ImportTableEntry *import = entry->value;
-            analyze_top_level_decls_root(g, import, import->root);
-        }
+        int phase = timing_begin(g, "analyze fn bodies", nullptr);
+        analyze_fn_bodies(g);
+        timing_end(g, phase);
     }
 }
 
-Expr *get_resolved_expr(AstNode *node) {
-    switch (node->type) {
-        case NodeTypeReturnExpr:
-            return &node->data.return_expr.resolved_expr;
-        case NodeTypeBinOpExpr:
-            return &node->data.bin_op_expr.resolved_expr;
-        case NodeTypeUnwrapErrorExpr:
-            return &node->data.unwrap_err_expr.resolved_expr;
-        case NodeTypePrefixOpExpr:
-            return &node->data.prefix_op_expr.resolved_expr;
-        case NodeTypeFnCallExpr:
-            return &node->data.fn_call_expr.resolved_expr;
-        case NodeTypeArrayAccessExpr:
-            return &node->data.array_access_expr.resolved_expr;
-        case NodeTypeSliceExpr:
-            return &node->data.slice_expr.resolved_expr;
-        case NodeTypeFieldAccessExpr:
-            return &node->data.field_access_expr.resolved_expr;
-        case NodeTypeIfBoolExpr:
-            return &node->data.if_bool_expr.resolved_expr;
-        case NodeTypeIfVarExpr:
-            return &node->data.if_var_expr.resolved_expr;
-        case NodeTypeWhileExpr:
-            return &node->data.while_expr.resolved_expr;
-        case NodeTypeForExpr:
-            return &node->data.for_expr.resolved_expr;
-        case NodeTypeAsmExpr:
-            return &node->data.asm_expr.resolved_expr;
-        case NodeTypeContainerInitExpr:
-            return &node->data.container_init_expr.resolved_expr;
-        case NodeTypeNumberLiteral:
-            return &node->data.number_literal.resolved_expr;
-        case NodeTypeStringLiteral:
-            return &node->data.string_literal.resolved_expr;
-        case NodeTypeBlock:
-            return &node->data.block.resolved_expr;
-        case NodeTypeSymbol:
-            return &node->data.symbol_expr.resolved_expr;
-        case NodeTypeVariableDeclaration:
-            return &node->data.variable_declaration.resolved_expr;
-        case NodeTypeCharLiteral:
-            return &node->data.char_literal.resolved_expr;
-        case NodeTypeBoolLiteral:
-            return &node->data.bool_literal.resolved_expr;
-        case NodeTypeNullLiteral:
-            return &node->data.null_literal.resolved_expr;
-        case NodeTypeUndefinedLiteral:
-            return &node->data.undefined_literal.resolved_expr;
-        case NodeTypeGoto:
-            return &node->data.goto_expr.resolved_expr;
-        case NodeTypeBreak:
-            return &node->data.break_expr.resolved_expr;
-        case NodeTypeContinue:
-            return &node->data.continue_expr.resolved_expr;
-        case NodeTypeLabel:
-            return &node->data.label.resolved_expr;
-        case NodeTypeArrayType:
-            return &node->data.array_type.resolved_expr;
-        case NodeTypeErrorType:
-            return &node->data.error_type.resolved_expr;
-        case NodeTypeSwitchExpr:
-            return &node->data.switch_expr.resolved_expr;
-        case NodeTypeSwitchProng:
-        case NodeTypeSwitchRange:
-        case NodeTypeRoot:
-        case NodeTypeRootExportDecl:
-        case NodeTypeFnProto:
-        case NodeTypeFnDef:
-        case NodeTypeFnDecl:
-        case NodeTypeParamDecl:
-        case NodeTypeDirective:
-        case NodeTypeImport:
-        case NodeTypeCImport:
-        case NodeTypeStructDecl:
-        case NodeTypeStructField:
-        case NodeTypeStructValueField:
-        case NodeTypeErrorValueDecl:
-            zig_unreachable();
+Expr *get_resolved_expr(CodeGen *g, AstNode *node) {
+    return g->resolved_exprs.get(node->create_index);
+}
+
+StructValExprCodeGen *get_resolved_struct_val_expr(CodeGen *g, AstNode *node) {
+    StructValExprCodeGen **entry = g->resolved_struct_val_exprs.get(node->create_index);
+    if (!*entry) {
+        *entry = allocate<StructValExprCodeGen>(1);
     }
-    zig_unreachable();
+    return *entry;
 }
 
-TopLevelDecl *get_resolved_top_level_decl(AstNode *node) {
-    switch (node->type) {
-        case NodeTypeVariableDeclaration:
-            return &node->data.variable_declaration.top_level_decl;
-        case NodeTypeFnProto:
-            return &node->data.fn_proto.top_level_decl;
-        case NodeTypeStructDecl:
-            return &node->data.struct_decl.top_level_decl;
-        case NodeTypeErrorValueDecl:
-            return &node->data.error_value_decl.top_level_decl;
-        case NodeTypeCImport:
-            return &node->data.c_import.top_level_decl;
-        case NodeTypeNumberLiteral:
-        case NodeTypeReturnExpr:
-        case NodeTypeBinOpExpr:
-        case NodeTypeUnwrapErrorExpr:
-        case NodeTypePrefixOpExpr:
-        case NodeTypeFnCallExpr:
-        case NodeTypeArrayAccessExpr:
-        case NodeTypeSliceExpr:
-        case NodeTypeFieldAccessExpr:
-        case NodeTypeIfBoolExpr:
-        case NodeTypeIfVarExpr:
-        case NodeTypeWhileExpr:
-        case NodeTypeForExpr:
-        case NodeTypeSwitchExpr:
-        case NodeTypeSwitchProng:
-        case NodeTypeSwitchRange:
-        case NodeTypeAsmExpr:
-        case NodeTypeContainerInitExpr:
-        case NodeTypeRoot:
-        case NodeTypeRootExportDecl:
-        case NodeTypeFnDef:
-        case NodeTypeFnDecl:
-        case NodeTypeParamDecl:
-        case NodeTypeBlock:
-        case NodeTypeDirective:
-        case NodeTypeStringLiteral:
-        case NodeTypeCharLiteral:
-        case NodeTypeSymbol:
-        case NodeTypeImport:
-        case NodeTypeBoolLiteral:
-        case NodeTypeNullLiteral:
-        case NodeTypeUndefinedLiteral:
-        case NodeTypeLabel:
-        case NodeTypeGoto:
-        case NodeTypeBreak:
-        case NodeTypeContinue:
-        case NodeTypeStructField:
-        case NodeTypeStructValueField:
-        case NodeTypeArrayType:
-        case NodeTypeErrorType:
-            zig_unreachable();
+TopLevelDecl *get_resolved_top_level_decl(CodeGen *g, AstNode *node) {
+    TopLevelDecl **entry = g->resolved_top_level_decls.get(node->create_index);
+    if (!*entry) {
+        *entry = allocate<TopLevelDecl>(1);
     }
-    zig_unreachable();
+    return *entry;
 }
 
 bool is_node_void_expr(AstNode *node) {
@@ -5030,7 +5316,7 @@ bool is_node_void_expr(AstNode *node) {
     {
         AstNode *type_node = node->data.container_init_expr.type;
         if (type_node->type == NodeTypeSymbol &&
-            buf_eql_str(&type_node->data.symbol_expr.symbol, "void"))
+            buf_eql_str(type_node->data.symbol_expr.symbol, "void"))
         {
             return true;
         }
@@ -5098,11 +5384,11 @@ void find_libc_path(CodeGen *g) {
     }
     if (!g->libc_lib_path) {
         g->libc_lib_path = buf_alloc();
-        os_path_join(g->libc_path, buf_create_from_str("lib"), g->libc_lib_path);
+        os_path_join(buf_view(g->libc_path), buf_view_str("lib"), g->libc_lib_path);
     }
     if (!g->libc_include_path) {
         g->libc_include_path = buf_alloc();
-        os_path_join(g->libc_path, buf_create_from_str("include"), g->libc_include_path);
+        os_path_join(buf_view(g->libc_path), buf_view_str("include"), g->libc_include_path);
     }
 }
 
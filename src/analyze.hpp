@@ -12,13 +12,13 @@
 
 void semantic_analyze(CodeGen *g);
 ErrorMsg *add_node_error(CodeGen *g, AstNode *node, Buf *msg);
-TypeTableEntry *new_type_table_entry(TypeTableEntryId id);
+TypeTableEntry *new_type_table_entry(CodeGen *g, TypeTableEntryId id);
 TypeTableEntry *get_pointer_to_type(CodeGen *g, TypeTableEntry *child_type, bool is_const);
-VariableTableEntry *find_variable(BlockContext *context, Buf *name);
 TypeTableEntry *find_container(BlockContext *context, Buf *name);
-BlockContext *new_block_context(AstNode *node, BlockContext *parent);
-Expr *get_resolved_expr(AstNode *node);
-TopLevelDecl *get_resolved_top_level_decl(AstNode *node);
+BlockContext *new_block_context(CodeGen *g, AstNode *node, BlockContext *parent);
+Expr *get_resolved_expr(CodeGen *g, AstNode *node);
+StructValExprCodeGen *get_resolved_struct_val_expr(CodeGen *g, AstNode *node);
+TopLevelDecl *get_resolved_top_level_decl(CodeGen *g, AstNode *node);
 bool is_node_void_expr(AstNode *node);
 TypeTableEntry **get_int_type_ptr(CodeGen *g, bool is_signed, int size_in_bits);
 TypeTableEntry *get_int_type(CodeGen *g, bool is_signed, int size_in_bits);
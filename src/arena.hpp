@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2015 Andrew Kelley
+ *
+ * This file is part of zig, which is MIT licensed.
+ * See http://opensource.org/licenses/MIT
+ */
+
+#ifndef ZIG_ARENA_HPP
+#define ZIG_ARENA_HPP
+
+#include "util.hpp"
+
+// Bump allocator for objects which all live as long as their owner, such as
+// the AST of an import. Memory is zeroed, like allocate(), and is only ever
+// released all at once with arena_deinit().
+// A zero initialized Arena is ready to use; set category to have its chunks
+// counted as something other than AllocCategoryOther.
+
+static const size_t ARENA_CHUNK_SIZE = 64 * 1024;
+
+struct ArenaChunk {
+    ArenaChunk *prev;
+    size_t size;
+    size_t used;
+};
+
+struct Arena {
+    ArenaChunk *head;
+    size_t bytes_used;
+    size_t bytes_reserved;
+    AllocCategory category;
+};
+
+static inline void *arena_alloc_bytes(Arena *arena, size_t size, size_t align) {
+    ArenaChunk *chunk = arena->head;
+    if (chunk) {
+        size_t start = (chunk->used + align - 1) & ~(align - 1);
+        if (start + size <= chunk->size) {
+            chunk->used = start + size;
+            arena->bytes_used += size;
+            return reinterpret_cast<char *>(chunk) + start;
+        }
+    }
+
+    size_t header_size = (sizeof(ArenaChunk) + 15) & ~((size_t)15);
+    size_t chunk_size = max(ARENA_CHUNK_SIZE, header_size + size + align);
+    ArenaChunk *new_chunk = reinterpret_cast<ArenaChunk *>(allocate<char>(chunk_size, arena->category));
+    new_chunk->size = chunk_size;
+    new_chunk->used = header_size;
+    arena->bytes_reserved += chunk_size;
+
+    // an oversized allocation gets a chunk of its own so that the rest of
+    // the current chunk stays available for small objects
+    if (chunk && chunk_size > ARENA_CHUNK_SIZE) {
+        new_chunk->prev = chunk->prev;
+        chunk->prev = new_chunk;
+    } else {
+        new_chunk->prev = chunk;
+        arena->head = new_chunk;
+    }
+
+    size_t start = (new_chunk->used + align - 1) & ~(align - 1);
+    new_chunk->used = start + size;
+    arena->bytes_used += size;
+    return reinterpret_cast<char *>(new_chunk) + start;
+}
+
+template<typename T>
+__attribute__((malloc)) static inline T *arena_allocate(Arena *arena, size_t count) {
+    return reinterpret_cast<T *>(arena_alloc_bytes(arena, count * sizeof(T), alignof(T)));
+}
+
+static inline void arena_deinit(Arena *arena) {
+    ArenaChunk *chunk = arena->head;
+    while (chunk) {
+        ArenaChunk *prev = chunk->prev;
+        deallocate(reinterpret_cast<char *>(chunk), chunk->size, arena->category);
+        chunk = prev;
+    }
+    arena->head = nullptr;
+    arena->bytes_used = 0;
+    arena->bytes_reserved = 0;
+}
+
+#endif
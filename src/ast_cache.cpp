@@ -0,0 +1,889 @@
+/*
+ * Copyright (c) 2015 Andrew Kelley
+ *
+ * This file is part of zig, which is MIT licensed.
+ * See http://opensource.org/licenses/MIT
+ */
+
+#include "ast_cache.hpp"
+#include "error.hpp"
+#include "hash_map.hpp"
+#include "intern.hpp"
+#include "os.hpp"
+#include "parser.hpp"
+
+#include <inttypes.h>
+#include <limits.h>
+
+// bump this whenever the AST or the encoding below changes
+static const uint32_t ast_cache_format_version = 2;
+static const char ast_cache_magic[8] = {'z', 'i', 'g', ' ', 'a', 's', 't', '\n'};
+
+// An entry is this header followed by the payload: the line offsets, then a
+// table of the names the nodes use, then one record per node. Numbers in the
+// payload are LEB128 varints and node references are create_index + 1, with
+// 0 for null.
+struct AstCacheHeader {
+    char magic[8];
+    uint32_t format_version;
+    uint32_t node_count;
+    uint64_t source_len;
+    uint64_t source_hash;
+    uint64_t payload_len;
+    uint64_t payload_hash;
+    uint64_t compiler_id;
+};
+
+static void init_header(AstCacheHeader *header, uint64_t compiler_id, Buf *source_code) {
+    memset(header, 0, sizeof(AstCacheHeader));
+    memcpy(header->magic, ast_cache_magic, sizeof(ast_cache_magic));
+    header->format_version = ast_cache_format_version;
+    header->source_len = buf_len(source_code);
+    header->source_hash = hash_bytes(buf_ptr(source_code), buf_len(source_code));
+    header->compiler_id = compiler_id;
+}
+
+struct AstWriter {
+    Buf *out;
+    ZigList<AstNode *> pending;
+    HashMap<Buf *, uint32_t, intern_hash, intern_eql> name_ids;
+    ZigList<Buf *> names;
+};
+
+static void write_uint(AstWriter *w, uint64_t value) {
+    while (value >= 0x80) {
+        buf_append_char(w->out, (uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    buf_append_char(w->out, (uint8_t)value);
+}
+
+static void write_int(AstWriter *w, int64_t value) {
+    write_uint(w, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+static void write_bytes(AstWriter *w, Buf *buf) {
+    write_uint(w, buf_len(buf));
+    buf_append_buf(w->out, buf);
+}
+
+// a Buf embedded in a node, which the parser may have left uninitialized
+static void write_buf(AstWriter *w, Buf *buf) {
+    if (buf->list.length == 0) {
+        write_uint(w, 0);
+    } else {
+        write_uint(w, buf_len(buf) + 1);
+        buf_append_buf(w->out, buf);
+    }
+}
+
+// an interned name, or null
+static void write_name(AstWriter *w, Buf *name) {
+    if (!name) {
+        write_uint(w, 0);
+        return;
+    }
+    auto entry = w->name_ids.maybe_get(name);
+    if (entry) {
+        write_uint(w, entry->value + 1);
+    } else {
+        uint32_t id = w->names.length;
+        w->names.append(name);
+        w->name_ids.put(name, id);
+        write_uint(w, id + 1);
+    }
+}
+
+static void write_node(AstWriter *w, AstNode *node) {
+    if (!node) {
+        write_uint(w, 0);
+        return;
+    }
+    write_uint(w, (uint64_t)node->create_index + 1);
+    w->pending.append(node);
+}
+
+template<typename List>
+static void write_node_list(AstWriter *w, List *list) {
+    write_uint(w, list->length);
+    for (int i = 0; i < list->length; i += 1) {
+        write_node(w, list->at(i));
+    }
+}
+
+static void write_directives(AstWriter *w, ZigList<AstNode *> *directives) {
+    if (!directives) {
+        write_uint(w, 0);
+        return;
+    }
+    write_uint(w, directives->length + 1);
+    for (int i = 0; i < directives->length; i += 1) {
+        write_node(w, directives->at(i));
+    }
+}
+
+static void write_var_decl(AstWriter *w, AstNodeVariableDeclaration *var_decl) {
+    write_name(w, var_decl->symbol);
+    write_uint(w, var_decl->is_const);
+    write_uint(w, var_decl->is_extern);
+    write_uint(w, var_decl->visib_mod);
+    write_node(w, var_decl->type);
+    write_node(w, var_decl->expr);
+    write_directives(w, var_decl->directives);
+}
+
+static void write_node_record(AstWriter *w, AstNode *node) {
+    write_uint(w, node->create_index);
+    write_uint(w, node->type);
+    write_int(w, node->line);
+    write_int(w, node->column);
+
+    switch (node->type) {
+        case NodeTypeRoot:
+            write_node_list(w, &node->data.root.top_level_decls);
+            break;
+        case NodeTypeRootExportDecl:
+            write_name(w, node->data.root_export_decl.type);
+            write_buf(w, &node->data.root_export_decl.name);
+            write_directives(w, node->data.root_export_decl.directives);
+            break;
+        case NodeTypeFnProto:
+            write_directives(w, node->data.fn_proto.directives);
+            write_uint(w, node->data.fn_proto.visib_mod);
+            write_name(w, node->data.fn_proto.name);
+            write_node_list(w, &node->data.fn_proto.params);
+            write_node(w, node->data.fn_proto.return_type);
+            write_uint(w, node->data.fn_proto.is_var_args);
+            write_uint(w, node->data.fn_proto.is_extern);
+            break;
+        case NodeTypeFnDef:
+            write_node(w, node->data.fn_def.fn_proto);
+            write_node(w, node->data.fn_def.body);
+            break;
+        case NodeTypeFnDecl:
+            write_node(w, node->data.fn_decl.fn_proto);
+            break;
+        case NodeTypeParamDecl:
+            write_name(w, node->data.param_decl.name);
+            write_node(w, node->data.param_decl.type);
+            write_uint(w, node->data.param_decl.is_noalias);
+            break;
+        case NodeTypeBlock:
+            write_node_list(w, &node->data.block.statements);
+            break;
+        case NodeTypeDirective:
+            write_name(w, node->data.directive.name);
+            write_buf(w, &node->data.directive.param);
+            break;
+        case NodeTypeReturnExpr:
+            write_uint(w, node->data.return_expr.kind);
+            write_node(w, node->data.return_expr.expr);
+            break;
+        case NodeTypeVariableDeclaration:
+            write_var_decl(w, &node->data.variable_declaration);
+            break;
+        case NodeTypeErrorValueDecl:
+            write_name(w, node->data.error_value_decl.name);
+            write_uint(w, node->data.error_value_decl.visib_mod);
+            write_directives(w, node->data.error_value_decl.directives);
+            break;
+        case NodeTypeBinOpExpr:
+            write_node(w, node->data.bin_op_expr.op1);
+            write_uint(w, node->data.bin_op_expr.bin_op);
+            write_node(w, node->data.bin_op_expr.op2);
+            break;
+        case NodeTypeUnwrapErrorExpr:
+            write_node(w, node->data.unwrap_err_expr.op1);
+            write_node(w, node->data.unwrap_err_expr.symbol);
+            write_node(w, node->data.unwrap_err_expr.op2);
+            break;
+        case NodeTypeNumberLiteral:
+            write_uint(w, node->data.number_literal.kind);
+            write_uint(w, node->data.number_literal.overflow);
+            // the bits of either member
+            write_uint(w, node->data.number_literal.data.x_uint);
+            break;
+        case NodeTypeStringLiteral:
+            write_buf(w, &node->data.string_literal.buf);
+            write_uint(w, node->data.string_literal.c);
+            break;
+        case NodeTypeCharLiteral:
+            write_uint(w, node->data.char_literal.value);
+            break;
+        case NodeTypeSymbol:
+            write_name(w, node->data.symbol_expr.symbol);
+            break;
+        case NodeTypePrefixOpExpr:
+            write_uint(w, node->data.prefix_op_expr.prefix_op);
+            write_node(w, node->data.prefix_op_expr.primary_expr);
+            break;
+        case NodeTypeFnCallExpr:
+            write_node(w, node->data.fn_call_expr.fn_ref_expr);
+            write_node_list(w, &node->data.fn_call_expr.params);
+            write_uint(w, node->data.fn_call_expr.is_builtin);
+            break;
+        case NodeTypeArrayAccessExpr:
+            write_node(w, node->data.array_access_expr.array_ref_expr);
+            write_node(w, node->data.array_access_expr.subscript);
+            break;
+        case NodeTypeSliceExpr:
+            write_node(w, node->data.slice_expr.array_ref_expr);
+            write_node(w, node->data.slice_expr.start);
+            write_node(w, node->data.slice_expr.end);
+            write_uint(w, node->data.slice_expr.is_const);
+            break;
+        case NodeTypeFieldAccessExpr:
+            write_node(w, node->data.field_access_expr.struct_expr);
+            write_name(w, node->data.field_access_expr.field_name);
+            break;
+        case NodeTypeImport:
+            write_buf(w, &node->data.import.path);
+            write_directives(w, node->data.import.directives);
+            write_uint(w, node->data.import.visib_mod);
+            break;
+        case NodeTypeCImport:
+            write_directives(w, node->data.c_import.directives);
+            write_uint(w, node->data.c_import.visib_mod);
+            write_node(w, node->data.c_import.block);
+            break;
+        case NodeTypeBoolLiteral:
+            write_uint(w, node->data.bool_literal.value);
+            break;
+        case NodeTypeNullLiteral:
+        case NodeTypeUndefinedLiteral:
+        case NodeTypeBreak:
+        case NodeTypeContinue:
+        case NodeTypeErrorType:
+            break;
+        case NodeTypeIfBoolExpr:
+            write_node(w, node->data.if_bool_expr.condition);
+            write_node(w, node->data.if_bool_expr.then_block);
+            write_node(w, node->data.if_bool_expr.else_node);
+            break;
+        case NodeTypeIfVarExpr:
+            write_var_decl(w, &node->data.if_var_expr.var_decl);
+            write_node(w, node->data.if_var_expr.then_block);
+            write_node(w, node->data.if_var_expr.else_node);
+            break;
+        case NodeTypeWhileExpr:
+            write_node(w, node->data.while_expr.condition);
+            write_node(w, node->data.while_expr.body);
+            break;
+        case NodeTypeForExpr:
+            write_node(w, node->data.for_expr.elem_node);
+            write_node(w, node->data.for_expr.array_expr);
+            write_node(w, node->data.for_expr.index_node);
+            write_node(w, node->data.for_expr.body);
+            break;
+        case NodeTypeSwitchExpr:
+            write_node(w, node->data.switch_expr.expr);
+            write_node_list(w, &node->data.switch_expr.prongs);
+            break;
+        case NodeTypeSwitchProng:
+            write_node_list(w, &node->data.switch_prong.items);
+            write_node(w, node->data.switch_prong.var_symbol);
+            write_node(w, node->data.switch_prong.expr);
+            break;
+        case NodeTypeSwitchRange:
+            write_node(w, node->data.switch_range.start);
+            write_node(w, node->data.switch_range.end);
+            break;
+        case NodeTypeLabel:
+            write_name(w, node->data.label.name);
+            break;
+        case NodeTypeGoto:
+            write_name(w, node->data.goto_expr.name);
+            break;
+        case NodeTypeAsmExpr:
+            {
+                AstNodeAsmExpr *asm_expr = &node->data.asm_expr;
+                write_uint(w, asm_expr->is_volatile);
+                write_buf(w, &asm_expr->asm_template);
+                write_uint(w, asm_expr->offset_map.length);
+                for (int i = 0; i < asm_expr->offset_map.length; i += 1) {
+                    write_int(w, asm_expr->offset_map.at(i).line);
+                    write_int(w, asm_expr->offset_map.at(i).column);
+                }
+                write_uint(w, asm_expr->token_list.length);
+                for (int i = 0; i < asm_expr->token_list.length; i += 1) {
+                    AsmToken *asm_token = &asm_expr->token_list.at(i);
+                    write_uint(w, asm_token->id);
+                    write_int(w, asm_token->start);
+                    write_int(w, asm_token->end);
+                }
+                write_uint(w, asm_expr->output_list.length);
+                for (int i = 0; i < asm_expr->output_list.length; i += 1) {
+                    AsmOutput *asm_output = asm_expr->output_list.at(i);
+                    write_name(w, asm_output->asm_symbolic_name);
+                    write_buf(w, &asm_output->constraint);
+                    write_name(w, asm_output->variable_name);
+                    write_node(w, asm_output->return_type);
+                }
+                write_uint(w, asm_expr->input_list.length);
+                for (int i = 0; i < asm_expr->input_list.length; i += 1) {
+                    AsmInput *asm_input = asm_expr->input_list.at(i);
+                    write_name(w, asm_input->asm_symbolic_name);
+                    write_buf(w, &asm_input->constraint);
+                    write_node(w, asm_input->expr);
+                }
+                write_uint(w, asm_expr->clobber_list.length);
+                for (int i = 0; i < asm_expr->clobber_list.length; i += 1) {
+                    // clobbers are not interned
+                    write_bytes(w, asm_expr->clobber_list.at(i));
+                }
+                break;
+            }
+        case NodeTypeStructDecl:
+            write_name(w, node->data.struct_decl.name);
+            write_uint(w, node->data.struct_decl.kind);
+            write_node_list(w, &node->data.struct_decl.fields);
+            write_node_list(w, &node->data.struct_decl.fns);
+            write_directives(w, node->data.struct_decl.directives);
+            write_uint(w, node->data.struct_decl.visib_mod);
+            break;
+        case NodeTypeStructField:
+            write_name(w, node->data.struct_field.name);
+            write_node(w, node->data.struct_field.type);
+            write_directives(w, node->data.struct_field.directives);
+            write_uint(w, node->data.struct_field.visib_mod);
+            break;
+        case NodeTypeContainerInitExpr:
+            write_node(w, node->data.container_init_expr.type);
+            write_node_list(w, &node->data.container_init_expr.entries);
+            write_uint(w, node->data.container_init_expr.kind);
+            break;
+        case NodeTypeStructValueField:
+            write_name(w, node->data.struct_val_field.name);
+            write_node(w, node->data.struct_val_field.expr);
+            break;
+        case NodeTypeArrayType:
+            write_node(w, node->data.array_type.size);
+            write_node(w, node->data.array_type.child_type);
+            write_uint(w, node->data.array_type.is_const);
+            break;
+    }
+}
+
+void ast_serialize(Buf *out, uint64_t compiler_id, ImportTableEntry *owner, uint32_t node_count) {
+    AstWriter w = {0};
+    w.name_ids.init(64);
+
+    // the records go first into their own buffer, since the name table is
+    // only complete once every node has been written
+    Buf records = BUF_INIT;
+    buf_resize(&records, 0);
+    w.out = &records;
+    int record_count = 0;
+    write_node(&w, owner->root);
+    while (w.pending.length > 0) {
+        write_node_record(&w, w.pending.pop());
+        record_count += 1;
+    }
+
+    AstCacheHeader header;
+    init_header(&header, compiler_id, owner->source_code);
+    header.node_count = node_count;
+
+    buf_resize(out, sizeof(AstCacheHeader));
+    w.out = out;
+    ZigList<int> *line_offsets = owner->line_offsets;
+    write_uint(&w, line_offsets->length);
+    for (int i = 0; i < line_offsets->length; i += 1) {
+        write_uint(&w, line_offsets->at(i) - ((i == 0) ? 0 : line_offsets->at(i - 1)));
+    }
+    write_uint(&w, w.names.length);
+    for (int i = 0; i < w.names.length; i += 1) {
+        write_bytes(&w, w.names.at(i));
+    }
+    write_uint(&w, record_count);
+    buf_append_buf(out, &records);
+
+    header.payload_len = buf_len(out) - sizeof(AstCacheHeader);
+    header.payload_hash = hash_bytes(buf_ptr(out) + sizeof(AstCacheHeader), header.payload_len);
+    memcpy(buf_ptr(out), &header, sizeof(AstCacheHeader));
+
+    buf_deinit(&records);
+    w.pending.deinit();
+    w.name_ids.deinit();
+    w.names.deinit();
+}
+
+struct AstReader {
+    const uint8_t *ptr;
+    const uint8_t *end;
+    // once set, reads return zeroes and the entry is rejected at the end
+    bool failed;
+    ImportTableEntry *owner;
+    ZigList<Buf *> names;
+    uint32_t node_count;
+    // by create_index
+    AstNode **nodes;
+    bool *has_record;
+};
+
+static uint64_t read_uint(AstReader *r) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (r->ptr == r->end)
+            break;
+        uint8_t byte = *r->ptr;
+        r->ptr += 1;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return value;
+    }
+    r->failed = true;
+    return 0;
+}
+
+static uint64_t read_uint_max(AstReader *r, uint64_t max_value) {
+    uint64_t value = read_uint(r);
+    if (value > max_value) {
+        r->failed = true;
+        return 0;
+    }
+    return value;
+}
+
+static int read_int(AstReader *r) {
+    uint64_t value = read_uint(r);
+    int64_t result = (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+    if (result < INT_MIN || result > INT_MAX) {
+        r->failed = true;
+        return 0;
+    }
+    return (int)result;
+}
+
+static bool read_bool(AstReader *r) {
+    return read_uint_max(r, 1);
+}
+
+// a count of things which take at least a byte each
+static int read_length(AstReader *r) {
+    return (int)read_uint_max(r, r->end - r->ptr);
+}
+
+static const char *read_mem(AstReader *r, int len) {
+    const char *ptr = (const char *)r->ptr;
+    r->ptr += len;
+    return ptr;
+}
+
+static void read_buf(AstReader *r, Buf *buf) {
+    int len_plus_one = (int)read_uint_max(r, (r->end - r->ptr) + 1);
+    if (len_plus_one > 0) {
+        buf_init_from_mem(buf, read_mem(r, len_plus_one - 1), len_plus_one - 1);
+    }
+}
+
+static Buf *read_name(AstReader *r) {
+    uint64_t id_plus_one = read_uint_max(r, r->names.length);
+    return (id_plus_one == 0) ? nullptr : r->names.at((int)id_plus_one - 1);
+}
+
+static AstNode *read_node(AstReader *r) {
+    uint64_t index_plus_one = read_uint_max(r, r->node_count);
+    if (index_plus_one == 0)
+        return nullptr;
+    uint32_t index = (uint32_t)index_plus_one - 1;
+    if (!r->nodes[index]) {
+        r->nodes[index] = arena_allocate<AstNode>(&r->owner->ast_arena, 1);
+    }
+    return r->nodes[index];
+}
+
+template<typename List>
+static void read_node_list(AstReader *r, List *list) {
+    int len = read_length(r);
+    list->resize(len);
+    for (int i = 0; i < len; i += 1) {
+        list->at(i) = read_node(r);
+    }
+}
+
+static ZigList<AstNode *> *read_directives(AstReader *r) {
+    int len_plus_one = (int)read_uint_max(r, (r->end - r->ptr) + 1);
+    if (len_plus_one == 0)
+        return nullptr;
+    ZigList<AstNode *> *directives = arena_allocate<ZigList<AstNode *>>(&r->owner->ast_arena, 1);
+    directives->resize(len_plus_one - 1);
+    for (int i = 0; i < directives->length; i += 1) {
+        directives->at(i) = read_node(r);
+    }
+    return directives;
+}
+
+template<typename T>
+static T read_enum(AstReader *r, T last_value) {
+    return (T)read_uint_max(r, last_value);
+}
+
+static void read_var_decl(AstReader *r, AstNodeVariableDeclaration *var_decl) {
+    var_decl->symbol = read_name(r);
+    var_decl->is_const = read_bool(r);
+    var_decl->is_extern = read_bool(r);
+    var_decl->visib_mod = read_enum(r, VisibModExport);
+    var_decl->type = read_node(r);
+    var_decl->expr = read_node(r);
+    var_decl->directives = read_directives(r);
+}
+
+static void read_node_record(AstReader *r) {
+    uint64_t index = read_uint_max(r, r->node_count - 1);
+    if (r->failed || r->has_record[index]) {
+        r->failed = true;
+        return;
+    }
+    r->has_record[index] = true;
+    if (!r->nodes[index]) {
+        r->nodes[index] = arena_allocate<AstNode>(&r->owner->ast_arena, 1);
+    }
+    AstNode *node = r->nodes[index];
+    node->create_index = (uint32_t)index;
+    node->owner = r->owner;
+    node->type = read_enum(r, NodeTypeErrorType);
+    node->line = read_int(r);
+    node->column = read_int(r);
+
+    switch (node->type) {
+        case NodeTypeRoot:
+            read_node_list(r, &node->data.root.top_level_decls);
+            break;
+        case NodeTypeRootExportDecl:
+            node->data.root_export_decl.type = read_name(r);
+            read_buf(r, &node->data.root_export_decl.name);
+            node->data.root_export_decl.directives = read_directives(r);
+            break;
+        case NodeTypeFnProto:
+            node->data.fn_proto.directives = read_directives(r);
+            node->data.fn_proto.visib_mod = read_enum(r, VisibModExport);
+            node->data.fn_proto.name = read_name(r);
+            read_node_list(r, &node->data.fn_proto.params);
+            node->data.fn_proto.return_type = read_node(r);
+            node->data.fn_proto.is_var_args = read_bool(r);
+            node->data.fn_proto.is_extern = read_bool(r);
+            break;
+        case NodeTypeFnDef:
+            node->data.fn_def.fn_proto = read_node(r);
+            node->data.fn_def.body = read_node(r);
+            break;
+        case NodeTypeFnDecl:
+            node->data.fn_decl.fn_proto = read_node(r);
+            break;
+        case NodeTypeParamDecl:
+            node->data.param_decl.name = read_name(r);
+            node->data.param_decl.type = read_node(r);
+            node->data.param_decl.is_noalias = read_bool(r);
+            break;
+        case NodeTypeBlock:
+            read_node_list(r, &node->data.block.statements);
+            break;
+        case NodeTypeDirective:
+            node->data.directive.name = read_name(r);
+            read_buf(r, &node->data.directive.param);
+            break;
+        case NodeTypeReturnExpr:
+            node->data.return_expr.kind = read_enum(r, ReturnKindError);
+            node->data.return_expr.expr = read_node(r);
+            break;
+        case NodeTypeVariableDeclaration:
+            read_var_decl(r, &node->data.variable_declaration);
+            break;
+        case NodeTypeErrorValueDecl:
+            node->data.error_value_decl.name = read_name(r);
+            node->data.error_value_decl.visib_mod = read_enum(r, VisibModExport);
+            node->data.error_value_decl.directives = read_directives(r);
+            break;
+        case NodeTypeBinOpExpr:
+            node->data.bin_op_expr.op1 = read_node(r);
+            node->data.bin_op_expr.bin_op = read_enum(r, BinOpTypeStrCat);
+            node->data.bin_op_expr.op2 = read_node(r);
+            break;
+        case NodeTypeUnwrapErrorExpr:
+            node->data.unwrap_err_expr.op1 = read_node(r);
+            node->data.unwrap_err_expr.symbol = read_node(r);
+            node->data.unwrap_err_expr.op2 = read_node(r);
+            break;
+        case NodeTypeNumberLiteral:
+            node->data.number_literal.kind = read_enum(r, NumLitUInt);
+            node->data.number_literal.overflow = read_bool(r);
+            node->data.number_literal.data.x_uint = read_uint(r);
+            break;
+        case NodeTypeStringLiteral:
+            read_buf(r, &node->data.string_literal.buf);
+            node->data.string_literal.c = read_bool(r);
+            break;
+        case NodeTypeCharLiteral:
+            node->data.char_literal.value = (uint8_t)read_uint_max(r, UINT8_MAX);
+            break;
+        case NodeTypeSymbol:
+            node->data.symbol_expr.symbol = read_name(r);
+            break;
+        case NodeTypePrefixOpExpr:
+            node->data.prefix_op_expr.prefix_op = read_enum(r, PrefixOpUnwrapError);
+            node->data.prefix_op_expr.primary_expr = read_node(r);
+            break;
+        case NodeTypeFnCallExpr:
+            node->data.fn_call_expr.fn_ref_expr = read_node(r);
+            read_node_list(r, &node->data.fn_call_expr.params);
+            node->data.fn_call_expr.is_builtin = read_bool(r);
+            break;
+        case NodeTypeArrayAccessExpr:
+            node->data.array_access_expr.array_ref_expr = read_node(r);
+            node->data.array_access_expr.subscript = read_node(r);
+            break;
+        case NodeTypeSliceExpr:
+            node->data.slice_expr.array_ref_expr = read_node(r);
+            node->data.slice_expr.start = read_node(r);
+            node->data.slice_expr.end = read_node(r);
+            node->data.slice_expr.is_const = read_bool(r);
+            break;
+        case NodeTypeFieldAccessExpr:
+            node->data.field_access_expr.struct_expr = read_node(r);
+            node->data.field_access_expr.field_name = read_name(r);
+            break;
+        case NodeTypeImport:
+            read_buf(r, &node->data.import.path);
+            node->data.import.directives = read_directives(r);
+            node->data.import.visib_mod = read_enum(r, VisibModExport);
+            break;
+        case NodeTypeCImport:
+            node->data.c_import.directives = read_directives(r);
+            node->data.c_import.visib_mod = read_enum(r, VisibModExport);
+            node->data.c_import.block = read_node(r);
+            break;
+        case NodeTypeBoolLiteral:
+            node->data.bool_literal.value = read_bool(r);
+            break;
+        case NodeTypeNullLiteral:
+        case NodeTypeUndefinedLiteral:
+        case NodeTypeBreak:
+        case NodeTypeContinue:
+        case NodeTypeErrorType:
+            break;
+        case NodeTypeIfBoolExpr:
+            node->data.if_bool_expr.condition = read_node(r);
+            node->data.if_bool_expr.then_block = read_node(r);
+            node->data.if_bool_expr.else_node = read_node(r);
+            break;
+        case NodeTypeIfVarExpr:
+            read_var_decl(r, &node->data.if_var_expr.var_decl);
+            node->data.if_var_expr.then_block = read_node(r);
+            node->data.if_var_expr.else_node = read_node(r);
+            break;
+        case NodeTypeWhileExpr:
+            node->data.while_expr.condition = read_node(r);
+            node->data.while_expr.body = read_node(r);
+            break;
+        case NodeTypeForExpr:
+            node->data.for_expr.elem_node = read_node(r);
+            node->data.for_expr.array_expr = read_node(r);
+            node->data.for_expr.index_node = read_node(r);
+            node->data.for_expr.body = read_node(r);
+            break;
+        case NodeTypeSwitchExpr:
+            node->data.switch_expr.expr = read_node(r);
+            read_node_list(r, &node->data.switch_expr.prongs);
+            break;
+        case NodeTypeSwitchProng:
+            read_node_list(r, &node->data.switch_prong.items);
+            node->data.switch_prong.var_symbol = read_node(r);
+            node->data.switch_prong.expr = read_node(r);
+            break;
+        case NodeTypeSwitchRange:
+            node->data.switch_range.start = read_node(r);
+            node->data.switch_range.end = read_node(r);
+            break;
+        case NodeTypeLabel:
+            node->data.label.name = read_name(r);
+            break;
+        case NodeTypeGoto:
+            node->data.goto_expr.name = read_name(r);
+            break;
+        case NodeTypeAsmExpr:
+            {
+                AstNodeAsmExpr *asm_expr = &node->data.asm_expr;
+                asm_expr->is_volatile = read_bool(r);
+                read_buf(r, &asm_expr->asm_template);
+                asm_expr->offset_map.resize(read_length(r));
+                for (int i = 0; i < asm_expr->offset_map.length; i += 1) {
+                    asm_expr->offset_map.at(i).line = read_int(r);
+                    asm_expr->offset_map.at(i).column = read_int(r);
+                }
+                asm_expr->token_list.resize(read_length(r));
+                for (int i = 0; i < asm_expr->token_list.length; i += 1) {
+                    AsmToken *asm_token = &asm_expr->token_list.at(i);
+                    asm_token->id = read_enum(r, AsmTokenIdVar);
+                    asm_token->start = read_int(r);
+                    asm_token->end = read_int(r);
+                }
+                asm_expr->output_list.resize(read_length(r));
+                for (int i = 0; i < asm_expr->output_list.length; i += 1) {
+                    AsmOutput *asm_output = arena_allocate<AsmOutput>(&r->owner->ast_arena, 1);
+                    asm_output->asm_symbolic_name = read_name(r);
+                    read_buf(r, &asm_output->constraint);
+                    asm_output->variable_name = read_name(r);
+                    asm_output->return_type = read_node(r);
+                    asm_expr->output_list.at(i) = asm_output;
+                }
+                asm_expr->input_list.resize(read_length(r));
+                for (int i = 0; i < asm_expr->input_list.length; i += 1) {
+                    AsmInput *asm_input = arena_allocate<AsmInput>(&r->owner->ast_arena, 1);
+                    asm_input->asm_symbolic_name = read_name(r);
+                    read_buf(r, &asm_input->constraint);
+                    asm_input->expr = read_node(r);
+                    asm_expr->input_list.at(i) = asm_input;
+                }
+                asm_expr->clobber_list.resize(read_length(r));
+                for (int i = 0; i < asm_expr->clobber_list.length; i += 1) {
+                    int len = read_length(r);
+                    asm_expr->clobber_list.at(i) = buf_create_from_mem(read_mem(r, len), len);
+                }
+                break;
+            }
+        case NodeTypeStructDecl:
+            node->data.struct_decl.name = read_name(r);
+            node->data.struct_decl.kind = read_enum(r, ContainerKindEnum);
+            read_node_list(r, &node->data.struct_decl.fields);
+            read_node_list(r, &node->data.struct_decl.fns);
+            node->data.struct_decl.directives = read_directives(r);
+            node->data.struct_decl.visib_mod = read_enum(r, VisibModExport);
+            break;
+        case NodeTypeStructField:
+            node->data.struct_field.name = read_name(r);
+            node->data.struct_field.type = read_node(r);
+            node->data.struct_field.directives = read_directives(r);
+            node->data.struct_field.visib_mod = read_enum(r, VisibModExport);
+            break;
+        case NodeTypeContainerInitExpr:
+            node->data.container_init_expr.type = read_node(r);
+            read_node_list(r, &node->data.container_init_expr.entries);
+            node->data.container_init_expr.kind = read_enum(r, ContainerInitKindArray);
+            break;
+        case NodeTypeStructValueField:
+            node->data.struct_val_field.name = read_name(r);
+            node->data.struct_val_field.expr = read_node(r);
+            break;
+        case NodeTypeArrayType:
+            node->data.array_type.size = read_node(r);
+            node->data.array_type.child_type = read_node(r);
+            node->data.array_type.is_const = read_bool(r);
+            break;
+    }
+}
+
+// Rebuilds the AST in owner's arena. A rejected entry may leave some nodes
+// behind in the arena; they are never referenced.
+AstCacheResult ast_deserialize(Buf *data, uint64_t compiler_id, ImportTableEntry *owner, uint32_t *node_count) {
+    AstCacheHeader header;
+    AstCacheHeader expected;
+    init_header(&expected, compiler_id, owner->source_code);
+    if ((size_t)buf_len(data) < sizeof(AstCacheHeader))
+        return AstCacheResultStale;
+    size_t payload_len = buf_len(data) - sizeof(AstCacheHeader);
+    memcpy(&header, buf_ptr(data), sizeof(AstCacheHeader));
+    if (memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 ||
+        header.format_version != expected.format_version ||
+        header.compiler_id != expected.compiler_id ||
+        header.source_len != expected.source_len ||
+        header.source_hash != expected.source_hash ||
+        header.payload_len != payload_len ||
+        header.payload_hash != hash_bytes(buf_ptr(data) + sizeof(AstCacheHeader), payload_len) ||
+        header.node_count == 0)
+    {
+        return AstCacheResultStale;
+    }
+
+    AstReader r = {0};
+    r.ptr = (const uint8_t *)buf_ptr(data) + sizeof(AstCacheHeader);
+    r.end = (const uint8_t *)buf_ptr(data) + buf_len(data);
+    r.owner = owner;
+    r.node_count = header.node_count;
+    r.nodes = allocate<AstNode *>(r.node_count);
+    r.has_record = allocate<bool>(r.node_count);
+
+    ZigList<int> *line_offsets = allocate<ZigList<int>>(1);
+    line_offsets->resize(read_length(&r));
+    int offset = 0;
+    for (int i = 0; i < line_offsets->length; i += 1) {
+        offset += (int)read_uint_max(&r, header.source_len);
+        line_offsets->at(i) = offset;
+    }
+
+    r.names.resize(read_length(&r));
+    for (int i = 0; i < r.names.length; i += 1) {
+        int len = read_length(&r);
+        r.names.at(i) = intern_mem(read_mem(&r, len), len);
+    }
+
+    int record_count = read_length(&r);
+    AstNode *root = read_node(&r);
+    for (int i = 0; i < record_count && !r.failed; i += 1) {
+        read_node_record(&r);
+    }
+
+    // every referenced node needs a record
+    bool ok = !r.failed && r.ptr == r.end && root && root->type == NodeTypeRoot;
+    for (uint32_t i = 0; ok && i < r.node_count; i += 1) {
+        if (r.nodes[i] && !r.has_record[i])
+            ok = false;
+    }
+
+    if (ok) {
+        for (uint32_t i = 0; i < r.node_count; i += 1) {
+            if (r.nodes[i])
+                normalize_parent_ptrs(r.nodes[i]);
+        }
+        owner->root = root;
+        owner->line_offsets = line_offsets;
+        *node_count = header.node_count;
+    } else {
+        line_offsets->deinit();
+        deallocate(line_offsets, 1);
+    }
+
+    deallocate(r.nodes, r.node_count);
+    deallocate(r.has_record, r.node_count);
+    r.names.deinit();
+    return ok ? AstCacheResultHit : AstCacheResultStale;
+}
+
+static void get_entry_path(Buf *cache_dir, Buf *source_code, Buf *out_path) {
+    uint64_t source_hash = hash_bytes(buf_ptr(source_code), buf_len(source_code));
+    buf_init_from_buf(out_path, cache_dir);
+    buf_appendf(out_path, "/%016" PRIx64 ".ast", source_hash);
+}
+
+AstCacheResult ast_cache_load(Buf *cache_dir, uint64_t compiler_id, ImportTableEntry *owner,
+        uint32_t *node_count)
+{
+    Buf path = BUF_INIT;
+    get_entry_path(cache_dir, owner->source_code, &path);
+    AstCacheResult result;
+    OsMappedFile entry_file = {};
+    if (os_map_file(&path, &entry_file)) {
+        result = AstCacheResultMiss;
+    } else {
+        // nothing in the AST points into the entry
+        result = ast_deserialize(&entry_file.contents, compiler_id, owner, node_count);
+        os_unmap_file(&entry_file);
+    }
+    buf_deinit(&path);
+    return result;
+}
+
+int ast_cache_store(Buf *cache_dir, uint64_t compiler_id, ImportTableEntry *owner, uint32_t node_count) {
+    int err;
+    if ((err = os_make_path(cache_dir)))
+        return err;
+
+    Buf path = BUF_INIT;
+    Buf data = BUF_INIT;
+    get_entry_path(cache_dir, owner->source_code, &path);
+    ast_serialize(&data, compiler_id, owner, node_count);
+    err = os_write_file_atomic(&path, &data);
+    buf_deinit(&path);
+    buf_deinit(&data);
+    return err;
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2015 Andrew Kelley
+ *
+ * This file is part of zig, which is MIT licensed.
+ * See http://opensource.org/licenses/MIT
+ */
+
+#ifndef ZIG_AST_CACHE_HPP
+#define ZIG_AST_CACHE_HPP
+
+#include "all_types.hpp"
+
+// On-disk cache of parsed files. An entry holds the AST and line offsets of
+// one source file and is named after a hash of the file's contents, so an
+// edited file simply misses. Entries written by another build of the
+// compiler, as told by compiler_id, are stale and get replaced. Nodes refer
+// to each other by create_index rather than by address, so an entry can be
+// loaded into any import.
+
+enum AstCacheResult {
+    AstCacheResultMiss,
+    AstCacheResultHit,
+    // there was an entry, but for another build of the compiler, or damaged
+    AstCacheResultStale,
+};
+
+// Fills in owner->root and owner->line_offsets on a hit. owner->source_code
+// must be set. *node_count is what next_node_index advanced by when the file
+// was parsed.
+AstCacheResult ast_cache_load(Buf *cache_dir, uint64_t compiler_id, ImportTableEntry *owner,
+        uint32_t *node_count);
+// for a file which parsed without errors and whose create indexes start at 0
+int ast_cache_store(Buf *cache_dir, uint64_t compiler_id, ImportTableEntry *owner, uint32_t node_count);
+
+// the entry format, without the files
+void ast_serialize(Buf *out, uint64_t compiler_id, ImportTableEntry *owner, uint32_t node_count);
+AstCacheResult ast_deserialize(Buf *data, uint64_t compiler_id, ImportTableEntry *owner, uint32_t *node_count);
+
+#endif
@@ -192,7 +192,7 @@ void ast_print(FILE *f, AstNode *node, int indent) {
             break;
         case NodeTypeRootExportDecl:
             fprintf(f, "%s %s '%s'\n", node_type_str(node->type),
-                    buf_ptr(&node->data.root_export_decl.type),
+                    buf_ptr(node->data.root_export_decl.type),
                     buf_ptr(&node->data.root_export_decl.name));
             break;
         case NodeTypeFnDef:
@@ -205,7 +205,7 @@ void ast_print(FILE *f, AstNode *node, int indent) {
             }
         case NodeTypeFnProto:
             {
-                Buf *name_buf = &node->data.fn_proto.name;
+                Buf *name_buf = node->data.fn_proto.name;
                 fprintf(f, "%s '%s'\n", node_type_str(node->type), buf_ptr(name_buf));
 
                 for (int i = 0; i < node->data.fn_proto.params.length; i += 1) {
@@ -228,7 +228,7 @@ void ast_print(FILE *f, AstNode *node, int indent) {
             }
         case NodeTypeParamDecl:
             {
-                Buf *name_buf = &node->data.param_decl.name;
+                Buf *name_buf = node->data.param_decl.name;
                 fprintf(f, "%s '%s'\n", node_type_str(node->type), buf_ptr(name_buf));
 
                 ast_print(f, node->data.param_decl.type, indent + 2);
@@ -245,7 +245,7 @@ void ast_print(FILE *f, AstNode *node, int indent) {
             }
         case NodeTypeVariableDeclaration:
             {
-                Buf *name_buf = &node->data.variable_declaration.symbol;
+                Buf *name_buf = node->data.variable_declaration.symbol;
                 fprintf(f, "%s '%s'\n", node_type_str(node->type), buf_ptr(name_buf));
                 if (node->data.variable_declaration.type)
                     ast_print(f, node->data.variable_declaration.type, indent + 2);
@@ -255,7 +255,7 @@ void ast_print(FILE *f, AstNode *node, int indent) {
             }
         case NodeTypeErrorValueDecl:
             {
-                Buf *name_buf = &node->data.error_value_decl.name;
+                Buf *name_buf = node->data.error_value_decl.name;
                 fprintf(f, "%s '%s'\n", node_type_str(node->type), buf_ptr(name_buf));
                 break;
             }
@@ -330,7 +330,7 @@ void ast_print(FILE *f, AstNode *node, int indent) {
                 break;
             }
         case NodeTypeSymbol:
-            fprintf(f, "Symbol %s\n", buf_ptr(&node->data.symbol_expr.symbol));
+            fprintf(f, "Symbol %s\n", buf_ptr(node->data.symbol_expr.symbol));
             break;
         case NodeTypeImport:
             fprintf(f, "%s '%s'\n", node_type_str(node->type), buf_ptr(&node->data.import.path));
@@ -356,7 +356,7 @@ void ast_print(FILE *f, AstNode *node, int indent) {
             break;
         case NodeTypeIfVarExpr:
             {
-                Buf *name_buf = &node->data.if_var_expr.var_decl.symbol;
+                Buf *name_buf = node->data.if_var_expr.var_decl.symbol;
                 fprintf(f, "%s '%s'\n", node_type_str(node->type), buf_ptr(name_buf));
                 if (node->data.if_var_expr.var_decl.type)
                     ast_print(f, node->data.if_var_expr.var_decl.type, indent + 2);
@@ -406,10 +406,10 @@ void ast_print(FILE *f, AstNode *node, int indent) {
             ast_print(f, node->data.switch_range.end, indent + 2);
             break;
         case NodeTypeLabel:
-            fprintf(f, "%s '%s'\n", node_type_str(node->type), buf_ptr(&node->data.label.name));
+            fprintf(f, "%s '%s'\n", node_type_str(node->type), buf_ptr(node->data.label.name));
             break;
         case NodeTypeGoto:
-            fprintf(f, "%s '%s'\n", node_type_str(node->type), buf_ptr(&node->data.goto_expr.name));
+            fprintf(f, "%s '%s'\n", node_type_str(node->type), buf_ptr(node->data.goto_expr.name));
             break;
         case NodeTypeBreak:
             fprintf(f, "%s\n", node_type_str(node->type));
@@ -425,12 +425,12 @@ void ast_print(FILE *f, AstNode *node, int indent) {
             break;
         case NodeTypeFieldAccessExpr:
             fprintf(f, "%s '%s'\n", node_type_str(node->type),
-                    buf_ptr(&node->data.field_access_expr.field_name));
+                    buf_ptr(node->data.field_access_expr.field_name));
             ast_print(f, node->data.field_access_expr.struct_expr, indent + 2);
             break;
         case NodeTypeStructDecl:
             fprintf(f, "%s '%s'\n",
-                    node_type_str(node->type), buf_ptr(&node->data.struct_decl.name));
+                    node_type_str(node->type), buf_ptr(node->data.struct_decl.name));
             for (int i = 0; i < node->data.struct_decl.fields.length; i += 1) {
                 AstNode *child = node->data.struct_decl.fields.at(i);
                 ast_print(f, child, indent + 2);
@@ -441,13 +441,13 @@ void ast_print(FILE *f, AstNode *node, int indent) {
             }
             break;
         case NodeTypeStructField:
-            fprintf(f, "%s '%s'\n", node_type_str(node->type), buf_ptr(&node->data.struct_field.name));
+            fprintf(f, "%s '%s'\n", node_type_str(node->type), buf_ptr(node->data.struct_field.name));
             if (node->data.struct_field.type) {
                 ast_print(f, node->data.struct_field.type, indent + 2);
             }
             break;
         case NodeTypeStructValueField:
-            fprintf(f, "%s '%s'\n", node_type_str(node->type), buf_ptr(&node->data.struct_val_field.name));
+            fprintf(f, "%s '%s'\n", node_type_str(node->type), buf_ptr(node->data.struct_val_field.name));
             ast_print(f, node->data.struct_val_field.expr, indent + 2);
             break;
         case NodeTypeContainerInitExpr:
@@ -509,7 +509,7 @@ static void render_node(AstRender *ar, AstNode *node) {
             zig_panic("TODO");
         case NodeTypeFnProto:
             {
-                const char *fn_name = buf_ptr(&node->data.fn_proto.name);
+                const char *fn_name = buf_ptr(node->data.fn_proto.name);
                 const char *pub_str = visib_mod_string(node->data.fn_proto.visib_mod);
                 const char *extern_str = extern_string(node->data.fn_proto.is_extern);
                 fprintf(ar->f, "%s%sfn %s(", pub_str, extern_str, fn_name);
@@ -518,7 +518,7 @@ static void render_node(AstRender *ar, AstNode *node) {
                 for (int arg_i = 0; arg_i < arg_count; arg_i += 1) {
                     AstNode *param_decl = node->data.fn_proto.params.at(arg_i);
                     assert(param_decl->type == NodeTypeParamDecl);
-                    const char *arg_name = buf_ptr(&param_decl->data.param_decl.name);
+                    const char *arg_name = buf_ptr(param_decl->data.param_decl.name);
                     const char *noalias_str = param_decl->data.param_decl.is_noalias ? "noalias " : "";
                     fprintf(ar->f, "%s%s: ", noalias_str, arg_name);
                     render_node(ar, param_decl->data.param_decl.type);
@@ -534,7 +534,7 @@ static void render_node(AstRender *ar, AstNode *node) {
 
                 AstNode *return_type_node = node->data.fn_proto.return_type;
                 bool is_void = return_type_node->type != NodeTypeSymbol &&
-                    buf_eql_str(&return_type_node->data.symbol_expr.symbol, "void");
+                    buf_eql_str(return_type_node->data.symbol_expr.symbol, "void");
                 if (!is_void) {
                     fprintf(ar->f, " -> ");
                     render_node(ar, return_type_node);
@@ -558,7 +558,7 @@ static void render_node(AstRender *ar, AstNode *node) {
             {
                 const char *pub_str = visib_mod_string(node->data.variable_declaration.visib_mod);
                 const char *extern_str = extern_string(node->data.variable_declaration.is_extern);
-                const char *var_name = buf_ptr(&node->data.variable_declaration.symbol);
+                const char *var_name = buf_ptr(node->data.variable_declaration.symbol);
                 const char *const_or_var = const_or_var_string(node->data.variable_declaration.is_const);
                 fprintf(ar->f, "%s%s%s %s", pub_str, extern_str, const_or_var, var_name);
                 if (node->data.variable_declaration.type) {
@@ -584,7 +584,7 @@ static void render_node(AstRender *ar, AstNode *node) {
         case NodeTypeCharLiteral:
             zig_panic("TODO");
         case NodeTypeSymbol:
-            fprintf(ar->f, "%s", buf_ptr(&node->data.symbol_expr.symbol));
+            fprintf(ar->f, "%s", buf_ptr(node->data.symbol_expr.symbol));
             break;
         case NodeTypePrefixOpExpr:
             {
@@ -638,14 +638,14 @@ static void render_node(AstRender *ar, AstNode *node) {
             zig_panic("TODO");
         case NodeTypeStructDecl:
             {
-                const char *struct_name = buf_ptr(&node->data.struct_decl.name);
+                const char *struct_name = buf_ptr(node->data.struct_decl.name);
                 const char *pub_str = visib_mod_string(node->data.struct_decl.visib_mod);
                 fprintf(ar->f, "%sstruct %s {\n", pub_str, struct_name);
                 ar->indent += ar->indent_size;
                 for (int field_i = 0; field_i < node->data.struct_decl.fields.length; field_i += 1) {
                     AstNode *field_node = node->data.struct_decl.fields.at(field_i);
                     assert(field_node->type == NodeTypeStructField);
-                    const char *field_name = buf_ptr(&field_node->data.struct_field.name);
+                    const char *field_name = buf_ptr(field_node->data.struct_field.name);
                     print_indent(ar);
                     fprintf(ar->f, "%s: ", field_name);
                     render_node(ar, field_node->data.struct_field.type);
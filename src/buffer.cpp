@@ -60,11 +60,19 @@ bool buf_eql_buf(Buf *buf, Buf *other) {
 
 uint32_t buf_hash(Buf *buf) {
     assert(buf->list.length);
+    return buf_view_hash(buf_view(buf));
+}
+
+uint32_t buf_view_hash(BufView view) {
     // FNV 32-bit hash
     uint32_t h = 2166136261;
-    for (int i = 0; i < buf_len(buf); i += 1) {
-        h = h ^ ((uint8_t)buf->list.at(i));
+    for (int i = 0; i < view.len; i += 1) {
+        h = h ^ ((uint8_t)view.ptr[i]);
         h = h * 16777619;
     }
     return h;
 }
+
+bool buf_eql_view(Buf *buf, BufView view) {
+    return buf_eql_mem(buf, view.ptr, view.len);
+}
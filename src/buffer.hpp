@@ -23,6 +23,16 @@ struct Buf {
     ZigList<char> list;
 };
 
+ZIG_ALLOC_CATEGORY(Buf, AllocCategoryBufs);
+
+// Non-owning view of bytes inside a Buf, a source file, or a C string. A view
+// is only valid for as long as the memory it points into; copy it into a Buf
+// with buf_create_from_view when it has to outlive that.
+struct BufView {
+    const char *ptr;
+    int len;
+};
+
 Buf *buf_sprintf(const char *format, ...)
     __attribute__ ((format (printf, 1, 2)));
 Buf *buf_vprintf(const char *format, va_list ap);
@@ -88,6 +98,34 @@ static inline Buf *buf_create_from_buf(Buf *buf) {
     return buf_create_from_mem(buf_ptr(buf), buf_len(buf));
 }
 
+static inline BufView buf_view_mem(const char *ptr, int len) {
+    assert(len >= 0);
+    return {ptr, len};
+}
+
+static inline BufView buf_view_str(const char *str) {
+    return buf_view_mem(str, strlen(str));
+}
+
+static inline BufView buf_view(Buf *buf) {
+    return buf_view_mem(buf_ptr(buf), buf_len(buf));
+}
+
+static inline BufView buf_view_slice(Buf *buf, int start, int end) {
+    assert(start >= 0);
+    assert(start <= end);
+    assert(end <= buf_len(buf));
+    return buf_view_mem(buf_ptr(buf) + start, end - start);
+}
+
+static inline void buf_init_from_view(Buf *buf, BufView view) {
+    buf_init_from_mem(buf, view.ptr, view.len);
+}
+
+static inline Buf *buf_create_from_view(BufView view) {
+    return buf_create_from_mem(view.ptr, view.len);
+}
+
 static inline Buf *buf_slice(Buf *in_buf, int start, int end) {
     assert(in_buf->list.length);
     assert(start >= 0);
@@ -120,6 +158,10 @@ static inline void buf_append_buf(Buf *buf, Buf *append_buf) {
     buf_append_mem(buf, buf_ptr(append_buf), buf_len(append_buf));
 }
 
+static inline void buf_append_view(Buf *buf, BufView view) {
+    buf_append_mem(buf, view.ptr, view.len);
+}
+
 static inline void buf_append_char(Buf *buf, uint8_t c) {
     assert(buf->list.length);
     buf_append_mem(buf, (const char *)&c, 1);
@@ -140,9 +182,22 @@ static inline bool buf_eql_str(Buf *buf, const char *str) {
     return buf_eql_mem(buf, str, strlen(str));
 }
 
+static inline bool buf_view_eql_view(BufView a, BufView b) {
+    return a.len == b.len && memcmp(a.ptr, b.ptr, a.len) == 0;
+}
+
+static inline bool buf_view_eql_str(BufView view, const char *str) {
+    return buf_view_eql_view(view, buf_view_str(str));
+}
+
 bool buf_eql_buf(Buf *buf, Buf *other);
 uint32_t buf_hash(Buf *buf);
 
+// buf_view_hash of a view equals buf_hash of a Buf with the same contents, so
+// views can be used to look up Buf keys with HashMap::maybe_get_by
+uint32_t buf_view_hash(BufView view);
+bool buf_eql_view(Buf *buf, BufView view);
+
 static inline void buf_upcase(Buf *buf) {
     for (int i = 0; i < buf_len(buf); i += 1) {
         buf_ptr(buf)[i] = toupper(buf_ptr(buf)[i]);
@@ -14,9 +14,12 @@
 #include "analyze.hpp"
 #include "errmsg.hpp"
 #include "ast_render.hpp"
+#include "ast_cache.hpp"
+#include "timing.hpp"
 
 #include <stdio.h>
 #include <errno.h>
+#include <pthread.h>
 
 CodeGen *codegen_create(Buf *root_source_dir) {
     CodeGen *g = allocate<CodeGen>(1);
@@ -24,11 +27,13 @@ CodeGen *codegen_create(Buf *root_source_dir) {
     g->import_table.init(32);
     g->builtin_fn_table.init(32);
     g->primitive_type_table.init(32);
+    g->derived_type_table.init(32);
     g->unresolved_top_level_decls.init(32);
     g->build_type = CodeGenBuildTypeDebug;
     g->root_source_dir = root_source_dir;
     g->next_error_index = 1;
     g->error_value_count = 1;
+    g->thread_count = os_get_cpu_count();
 
     return g;
 }
@@ -50,6 +55,30 @@ void codegen_set_verbose(CodeGen *g, bool verbose) {
     g->verbose = verbose;
 }
 
+void codegen_set_time_report(CodeGen *g, bool time_report) {
+    g->time_report = time_report;
+    LLVMZigSetTimePasses(time_report);
+}
+
+void codegen_set_stats(CodeGen *g, StatsFormat format) {
+    stats_enabled = true;
+    g->print_stats = true;
+    g->stats_format = format;
+}
+
+void codegen_set_thread_count(CodeGen *g, int thread_count) {
+    g->thread_count = thread_count;
+}
+
+int codegen_set_cache_dir(CodeGen *g, Buf *cache_dir) {
+    int err;
+    if ((err = os_self_exe_hash(&g->compiler_id)))
+        return err;
+    g->ast_cache_dir = buf_alloc();
+    os_path_join(buf_view(cache_dir), buf_view_str("ast"), g->ast_cache_dir);
+    return 0;
+}
+
 void codegen_set_errmsg_color(CodeGen *g, ErrColor err_color) {
     g->err_color = err_color;
 }
@@ -71,6 +100,13 @@ void codegen_set_libc_path(CodeGen *g, Buf *libc_path) {
 }
 
 static LLVMValueRef gen_expr(CodeGen *g, AstNode *expr_node);
+
+__attribute__ ((noreturn))
+static void exit_with_errors(CodeGen *g) {
+    if (g->print_stats)
+        codegen_print_stats(g, stderr, g->stats_format);
+    exit(1);
+}
 static LLVMValueRef gen_lvalue(CodeGen *g, AstNode *expr_node, AstNode *node, TypeTableEntry **out_type_entry);
 static LLVMValueRef gen_field_access_expr(CodeGen *g, AstNode *node, bool is_lvalue);
 static LLVMValueRef gen_var_decl_raw(CodeGen *g, AstNode *source_node, AstNodeVariableDeclaration *var_decl,
@@ -79,8 +115,8 @@ static LLVMValueRef gen_assign_raw(CodeGen *g, AstNode *source_node, BinOpType b
         LLVMValueRef target_ref, LLVMValueRef value,
         TypeTableEntry *op1_type, TypeTableEntry *op2_type);
 
-static TypeTableEntry *get_type_for_type_node(AstNode *node) {
-    Expr *expr = get_resolved_expr(node);
+static TypeTableEntry *get_type_for_type_node(CodeGen *g, AstNode *node) {
+    Expr *expr = get_resolved_expr(g, node);
     assert(expr->type_entry->id == TypeTableEntryIdMetaType);
     ConstExprValue *const_val = &expr->const_val;
     assert(const_val->ok);
@@ -92,12 +128,12 @@ static void add_debug_source_node(CodeGen *g, AstNode *node) {
     LLVMZigSetCurrentDebugLocation(g->builder, node->line + 1, node->column + 1, node->block_context->di_scope);
 }
 
-static TypeTableEntry *get_expr_type(AstNode *node) {
-    return get_resolved_expr(node)->type_entry;
+static TypeTableEntry *get_expr_type(CodeGen *g, AstNode *node) {
+    return get_resolved_expr(g, node)->type_entry;
 }
 
 static TypeTableEntry *fn_proto_type_from_type_node(CodeGen *g, AstNode *type_node) {
-    TypeTableEntry *type_entry = get_type_for_type_node(type_node);
+    TypeTableEntry *type_entry = get_type_for_type_node(g, type_node);
 
     if (handle_is_ptr(type_entry)) {
         return get_pointer_to_type(g, type_entry, true);
@@ -194,7 +230,7 @@ static LLVMValueRef gen_builtin_fn_call_expr(CodeGen *g, AstNode *node) {
                 int fn_call_param_count = node->data.fn_call_expr.params.length;
                 assert(fn_call_param_count == 4);
 
-                TypeTableEntry *int_type = get_type_for_type_node(node->data.fn_call_expr.params.at(0));
+                TypeTableEntry *int_type = get_type_for_type_node(g, node->data.fn_call_expr.params.at(0));
                 AddSubMul add_sub_mul;
                 if (builtin_fn->id == BuiltinFnIdAddWithOverflow) {
                     add_sub_mul = AddSubMulAdd;
@@ -230,7 +266,7 @@ static LLVMValueRef gen_builtin_fn_call_expr(CodeGen *g, AstNode *node) {
                 assert(fn_call_param_count == 3);
 
                 AstNode *dest_node = node->data.fn_call_expr.params.at(0);
-                TypeTableEntry *dest_type = get_expr_type(dest_node);
+                TypeTableEntry *dest_type = get_expr_type(g, dest_node);
 
                 LLVMValueRef dest_ptr = gen_expr(g, dest_node);
                 LLVMValueRef src_ptr = gen_expr(g, node->data.fn_call_expr.params.at(1));
@@ -261,7 +297,7 @@ static LLVMValueRef gen_builtin_fn_call_expr(CodeGen *g, AstNode *node) {
                 assert(fn_call_param_count == 3);
 
                 AstNode *dest_node = node->data.fn_call_expr.params.at(0);
-                TypeTableEntry *dest_type = get_expr_type(dest_node);
+                TypeTableEntry *dest_type = get_expr_type(g, dest_node);
 
                 LLVMValueRef dest_ptr = gen_expr(g, dest_node);
                 LLVMValueRef char_val = gen_expr(g, node->data.fn_call_expr.params.at(1));
@@ -310,13 +346,13 @@ static LLVMValueRef gen_enum_value_expr(CodeGen *g, AstNode *node, TypeTableEntr
         TypeTableEntry *arg_node_type = nullptr;
         LLVMValueRef new_union_val = gen_expr(g, arg_node);
         if (arg_node) {
-            arg_node_type = get_expr_type(arg_node);
+            arg_node_type = get_expr_type(g, arg_node);
             new_union_val = gen_expr(g, arg_node);
         } else {
             arg_node_type = g->builtin_types.entry_void;
         }
 
-        LLVMValueRef tmp_struct_ptr = node->data.field_access_expr.resolved_struct_val_expr.ptr;
+        LLVMValueRef tmp_struct_ptr = get_resolved_struct_val_expr(g, node)->ptr;
 
         // populate the new tag value
         add_debug_source_node(g, node);
@@ -325,7 +361,7 @@ static LLVMValueRef gen_enum_value_expr(CodeGen *g, AstNode *node, TypeTableEntr
 
         if (arg_node_type->id != TypeTableEntryIdVoid) {
             // populate the union value
-            TypeTableEntry *union_val_type = get_expr_type(arg_node);
+            TypeTableEntry *union_val_type = get_expr_type(g, arg_node);
             LLVMValueRef union_field_ptr = LLVMBuildStructGEP(g->builder, tmp_struct_ptr, 1, "");
             LLVMValueRef bitcasted_union_field_ptr = LLVMBuildBitCast(g->builder, union_field_ptr,
                     LLVMPointerType(union_val_type->type_ref, 0), "");
@@ -366,8 +402,8 @@ static LLVMValueRef gen_cast_expr(CodeGen *g, AstNode *node) {
 
     LLVMValueRef expr_val = gen_expr(g, expr_node);
 
-    TypeTableEntry *actual_type = get_expr_type(expr_node);
-    TypeTableEntry *wanted_type = get_expr_type(node);
+    TypeTableEntry *actual_type = get_expr_type(g, expr_node);
+    TypeTableEntry *wanted_type = get_expr_type(g, node);
 
     AstNodeFnCallExpr *cast_expr = &node->data.fn_call_expr;
 
@@ -483,14 +519,14 @@ static LLVMValueRef gen_fn_call_expr(CodeGen *g, AstNode *node) {
     AstNode *first_param_expr = nullptr;
     if (fn_ref_expr->type == NodeTypeFieldAccessExpr) {
         first_param_expr = fn_ref_expr->data.field_access_expr.struct_expr;
-        struct_type = get_expr_type(first_param_expr);
+        struct_type = get_expr_type(g, first_param_expr);
         if (struct_type->id == TypeTableEntryIdStruct) {
             fn_table_entry = node->data.fn_call_expr.fn_entry;
         } else if (struct_type->id == TypeTableEntryIdPointer) {
             assert(struct_type->data.pointer.child_type->id == TypeTableEntryIdStruct);
             fn_table_entry = node->data.fn_call_expr.fn_entry;
         } else if (struct_type->id == TypeTableEntryIdMetaType) {
-            TypeTableEntry *enum_type = get_type_for_type_node(first_param_expr);
+            TypeTableEntry *enum_type = get_type_for_type_node(g, first_param_expr);
             int param_count = node->data.fn_call_expr.params.length;
             AstNode *arg1_node;
             if (param_count == 1) {
@@ -512,7 +548,7 @@ static LLVMValueRef gen_fn_call_expr(CodeGen *g, AstNode *node) {
         fn_type = fn_table_entry->type_entry;
     } else {
         fn_val = gen_expr(g, fn_ref_expr);
-        fn_type = get_expr_type(fn_ref_expr);
+        fn_type = get_expr_type(g, fn_ref_expr);
     }
 
     TypeTableEntry *src_return_type = fn_type->data.fn.src_return_type;
@@ -538,7 +574,7 @@ static LLVMValueRef gen_fn_call_expr(CodeGen *g, AstNode *node) {
     for (int i = 0; i < fn_call_param_count; i += 1) {
         AstNode *expr_node = node->data.fn_call_expr.params.at(i);
         LLVMValueRef param_value = gen_expr(g, expr_node);
-        TypeTableEntry *param_type = get_expr_type(expr_node);
+        TypeTableEntry *param_type = get_expr_type(g, expr_node);
         if (is_var_args || param_type->size_in_bits > 0) {
             gen_param_values[gen_param_index] = param_value;
             gen_param_index += 1;
@@ -559,7 +595,7 @@ static LLVMValueRef gen_fn_call_expr(CodeGen *g, AstNode *node) {
 }
 
 static LLVMValueRef gen_array_base_ptr(CodeGen *g, AstNode *node) {
-    TypeTableEntry *type_entry = get_expr_type(node);
+    TypeTableEntry *type_entry = get_expr_type(g, node);
 
     LLVMValueRef array_ptr;
     if (node->type == NodeTypeFieldAccessExpr) {
@@ -619,7 +655,7 @@ static LLVMValueRef gen_array_ptr(CodeGen *g, AstNode *node) {
     assert(node->type == NodeTypeArrayAccessExpr);
 
     AstNode *array_expr_node = node->data.array_access_expr.array_ref_expr;
-    TypeTableEntry *array_type = get_expr_type(array_expr_node);
+    TypeTableEntry *array_type = get_expr_type(g, array_expr_node);
 
     LLVMValueRef array_ptr = gen_array_base_ptr(g, array_expr_node);
 
@@ -635,8 +671,7 @@ static LLVMValueRef gen_field_ptr(CodeGen *g, AstNode *node, TypeTableEntry **ou
 
     LLVMValueRef struct_ptr;
     if (struct_expr_node->type == NodeTypeSymbol) {
-        VariableTableEntry *var = find_variable(struct_expr_node->block_context,
-                &struct_expr_node->data.symbol_expr.symbol);
+        VariableTableEntry *var = struct_expr_node->data.symbol_expr.variable;
         assert(var);
 
         if (var->is_ptr && var->type->id == TypeTableEntryIdPointer) {
@@ -647,7 +682,7 @@ static LLVMValueRef gen_field_ptr(CodeGen *g, AstNode *node, TypeTableEntry **ou
         }
     } else if (struct_expr_node->type == NodeTypeFieldAccessExpr) {
         struct_ptr = gen_field_access_expr(g, struct_expr_node, true);
-        TypeTableEntry *field_type = get_expr_type(struct_expr_node);
+        TypeTableEntry *field_type = get_expr_type(g, struct_expr_node);
         if (field_type->id == TypeTableEntryIdPointer) {
             // we have a double pointer so we must dereference it once
             add_debug_source_node(g, node);
@@ -673,9 +708,9 @@ static LLVMValueRef gen_slice_expr(CodeGen *g, AstNode *node) {
     assert(node->type == NodeTypeSliceExpr);
 
     AstNode *array_ref_node = node->data.slice_expr.array_ref_expr;
-    TypeTableEntry *array_type = get_expr_type(array_ref_node);
+    TypeTableEntry *array_type = get_expr_type(g, array_ref_node);
 
-    LLVMValueRef tmp_struct_ptr = node->data.slice_expr.resolved_struct_val_expr.ptr;
+    LLVMValueRef tmp_struct_ptr = get_resolved_struct_val_expr(g, node)->ptr;
     LLVMValueRef array_ptr = gen_array_base_ptr(g, array_ref_node);
 
     if (array_type->id == TypeTableEntryIdArray) {
@@ -753,7 +788,7 @@ static LLVMValueRef gen_array_access_expr(CodeGen *g, AstNode *node, bool is_lva
 
     LLVMValueRef ptr = gen_array_ptr(g, node);
     TypeTableEntry *child_type;
-    TypeTableEntry *array_type = get_expr_type(node->data.array_access_expr.array_ref_expr);
+    TypeTableEntry *array_type = get_expr_type(g, node->data.array_access_expr.array_ref_expr);
     if (array_type->id == TypeTableEntryIdPointer) {
         child_type = array_type->data.pointer.child_type;
     } else if (array_type->id == TypeTableEntryIdStruct) {
@@ -779,8 +814,8 @@ static LLVMValueRef gen_field_access_expr(CodeGen *g, AstNode *node, bool is_lva
     assert(node->type == NodeTypeFieldAccessExpr);
 
     AstNode *struct_expr = node->data.field_access_expr.struct_expr;
-    TypeTableEntry *struct_type = get_expr_type(struct_expr);
-    Buf *name = &node->data.field_access_expr.field_name;
+    TypeTableEntry *struct_type = get_expr_type(g, struct_expr);
+    Buf *name = node->data.field_access_expr.field_name;
 
     if (struct_type->id == TypeTableEntryIdArray) {
         if (buf_eql_str(name, "len")) {
@@ -810,7 +845,7 @@ static LLVMValueRef gen_field_access_expr(CodeGen *g, AstNode *node, bool is_lva
         }
     } else if (struct_type->id == TypeTableEntryIdMetaType) {
         assert(!is_lvalue);
-        TypeTableEntry *enum_type = get_type_for_type_node(struct_expr);
+        TypeTableEntry *enum_type = get_type_for_type_node(g, struct_expr);
         return gen_enum_value_expr(g, node, enum_type, nullptr);
     } else {
         zig_unreachable();
@@ -823,14 +858,13 @@ static LLVMValueRef gen_lvalue(CodeGen *g, AstNode *expr_node, AstNode *node,
     LLVMValueRef target_ref;
 
     if (node->type == NodeTypeSymbol) {
-        VariableTableEntry *var = find_variable(expr_node->block_context,
-                &node->data.symbol_expr.symbol);
+        VariableTableEntry *var = node->data.symbol_expr.variable;
         assert(var);
 
         *out_type_entry = var->type;
         target_ref = var->value_ref;
     } else if (node->type == NodeTypeArrayAccessExpr) {
-        TypeTableEntry *array_type = get_expr_type(node->data.array_access_expr.array_ref_expr);
+        TypeTableEntry *array_type = get_expr_type(g, node->data.array_access_expr.array_ref_expr);
         if (array_type->id == TypeTableEntryIdArray) {
             *out_type_entry = array_type->data.array.child_type;
             target_ref = gen_array_ptr(g, node);
@@ -849,7 +883,7 @@ static LLVMValueRef gen_lvalue(CodeGen *g, AstNode *expr_node, AstNode *node,
     } else if (node->type == NodeTypePrefixOpExpr) {
         assert(node->data.prefix_op_expr.prefix_op == PrefixOpDereference);
         AstNode *target_expr = node->data.prefix_op_expr.primary_expr;
-        TypeTableEntry *type_entry = get_expr_type(target_expr);
+        TypeTableEntry *type_entry = get_expr_type(g, target_expr);
         assert(type_entry->id == TypeTableEntryIdPointer);
         *out_type_entry = type_entry->data.pointer.child_type;
         return gen_expr(g, target_expr);
@@ -898,7 +932,7 @@ static LLVMValueRef gen_prefix_op_expr(CodeGen *g, AstNode *node) {
         case PrefixOpDereference:
             {
                 LLVMValueRef expr = gen_expr(g, expr_node);
-                TypeTableEntry *type_entry = get_expr_type(expr_node);
+                TypeTableEntry *type_entry = get_expr_type(g, expr_node);
                 if (type_entry->size_in_bits == 0) {
                     return nullptr;
                 } else {
@@ -917,7 +951,7 @@ static LLVMValueRef gen_prefix_op_expr(CodeGen *g, AstNode *node) {
         case PrefixOpUnwrapError:
             {
                 LLVMValueRef expr_val = gen_expr(g, expr_node);
-                TypeTableEntry *expr_type = get_expr_type(expr_node);
+                TypeTableEntry *expr_type = get_expr_type(g, expr_node);
                 assert(expr_type->id == TypeTableEntryIdErrorUnion);
                 TypeTableEntry *child_type = expr_type->data.error.child_type;
                 // TODO in debug mode, put a panic here if the error is not 0
@@ -1046,8 +1080,8 @@ static LLVMValueRef gen_arithmetic_bin_op_expr(CodeGen *g, AstNode *node) {
     LLVMValueRef val1 = gen_expr(g, node->data.bin_op_expr.op1);
     LLVMValueRef val2 = gen_expr(g, node->data.bin_op_expr.op2);
 
-    TypeTableEntry *op1_type = get_expr_type(node->data.bin_op_expr.op1);
-    TypeTableEntry *op2_type = get_expr_type(node->data.bin_op_expr.op2);
+    TypeTableEntry *op1_type = get_expr_type(g, node->data.bin_op_expr.op1);
+    TypeTableEntry *op2_type = get_expr_type(g, node->data.bin_op_expr.op2);
     return gen_arithmetic_bin_op(g, node, val1, val2, op1_type, op2_type, node->data.bin_op_expr.bin_op);
 
 }
@@ -1096,8 +1130,8 @@ static LLVMValueRef gen_cmp_expr(CodeGen *g, AstNode *node) {
     LLVMValueRef val1 = gen_expr(g, node->data.bin_op_expr.op1);
     LLVMValueRef val2 = gen_expr(g, node->data.bin_op_expr.op2);
 
-    TypeTableEntry *op1_type = get_expr_type(node->data.bin_op_expr.op1);
-    TypeTableEntry *op2_type = get_expr_type(node->data.bin_op_expr.op2);
+    TypeTableEntry *op1_type = get_expr_type(g, node->data.bin_op_expr.op1);
+    TypeTableEntry *op2_type = get_expr_type(g, node->data.bin_op_expr.op2);
     assert(op1_type == op2_type);
 
     add_debug_source_node(g, node);
@@ -1233,7 +1267,7 @@ static LLVMValueRef gen_assign_expr(CodeGen *g, AstNode *node) {
 
     LLVMValueRef target_ref = gen_lvalue(g, node, lhs_node, &op1_type);
 
-    TypeTableEntry *op2_type = get_expr_type(node->data.bin_op_expr.op2);
+    TypeTableEntry *op2_type = get_expr_type(g, node->data.bin_op_expr.op2);
 
     LLVMValueRef value = gen_expr(g, node->data.bin_op_expr.op2);
 
@@ -1268,8 +1302,8 @@ static LLVMValueRef gen_unwrap_maybe_expr(CodeGen *g, AstNode *node) {
     LLVMBasicBlockRef null_block = LLVMAppendBasicBlock(g->cur_fn->fn_value, "MaybeNull");
     LLVMBasicBlockRef end_block;
 
-    bool non_null_reachable = get_expr_type(op1_node)->id != TypeTableEntryIdUnreachable;
-    bool null_reachable = get_expr_type(op2_node)->id != TypeTableEntryIdUnreachable;
+    bool non_null_reachable = get_expr_type(g, op1_node)->id != TypeTableEntryIdUnreachable;
+    bool null_reachable = get_expr_type(g, op2_node)->id != TypeTableEntryIdUnreachable;
     bool end_reachable = non_null_reachable || null_reachable;
     if (end_reachable) {
         end_block = LLVMAppendBasicBlock(g->cur_fn->fn_value, "MaybeEnd");
@@ -1365,8 +1399,8 @@ static LLVMValueRef gen_unwrap_err_expr(CodeGen *g, AstNode *node) {
     VariableTableEntry *var = node->data.unwrap_err_expr.var;
 
     LLVMValueRef expr_val = gen_expr(g, op1);
-    TypeTableEntry *expr_type = get_expr_type(op1);
-    TypeTableEntry *op2_type = get_expr_type(op2);
+    TypeTableEntry *expr_type = get_expr_type(g, op1);
+    TypeTableEntry *op2_type = get_expr_type(g, op2);
     assert(expr_type->id == TypeTableEntryIdErrorUnion);
     TypeTableEntry *child_type = expr_type->data.error.child_type;
     LLVMValueRef err_val;
@@ -1447,7 +1481,7 @@ static LLVMValueRef gen_return_expr(CodeGen *g, AstNode *node) {
     AstNode *param_node = node->data.return_expr.expr;
     assert(param_node);
     LLVMValueRef value = gen_expr(g, param_node);
-    TypeTableEntry *value_type = get_expr_type(param_node);
+    TypeTableEntry *value_type = get_expr_type(g, param_node);
 
     switch (node->data.return_expr.kind) {
         case ReturnKindUnconditional:
@@ -1512,7 +1546,7 @@ static LLVMValueRef gen_return_expr(CodeGen *g, AstNode *node) {
 static LLVMValueRef gen_if_bool_expr_raw(CodeGen *g, AstNode *source_node, LLVMValueRef cond_value,
         AstNode *then_node, AstNode *else_node)
 {
-    TypeTableEntry *then_type = get_expr_type(then_node);
+    TypeTableEntry *then_type = get_expr_type(g, then_node);
     bool use_expr_value = (then_type->id != TypeTableEntryIdUnreachable &&
                            then_type->id != TypeTableEntryIdVoid);
 
@@ -1521,8 +1555,8 @@ static LLVMValueRef gen_if_bool_expr_raw(CodeGen *g, AstNode *source_node, LLVMV
         LLVMBasicBlockRef else_block = LLVMAppendBasicBlock(g->cur_fn->fn_value, "Else");
 
         LLVMBasicBlockRef endif_block;
-        bool then_endif_reachable = get_expr_type(then_node)->id != TypeTableEntryIdUnreachable;
-        bool else_endif_reachable = get_expr_type(else_node)->id != TypeTableEntryIdUnreachable;
+        bool then_endif_reachable = get_expr_type(g, then_node)->id != TypeTableEntryIdUnreachable;
+        bool else_endif_reachable = get_expr_type(g, else_node)->id != TypeTableEntryIdUnreachable;
         if (then_endif_reachable || else_endif_reachable) {
             endif_block = LLVMAppendBasicBlock(g->cur_fn->fn_value, "EndIf");
         }
@@ -1567,7 +1601,7 @@ static LLVMValueRef gen_if_bool_expr_raw(CodeGen *g, AstNode *source_node, LLVMV
 
     LLVMPositionBuilderAtEnd(g->builder, then_block);
     gen_expr(g, then_node);
-    if (get_expr_type(then_node)->id != TypeTableEntryIdUnreachable)
+    if (get_expr_type(g, then_node)->id != TypeTableEntryIdUnreachable)
         LLVMBuildBr(g->builder, endif_block);
 
     LLVMPositionBuilderAtEnd(g->builder, endif_block);
@@ -1584,7 +1618,7 @@ static LLVMValueRef gen_if_bool_expr(CodeGen *g, AstNode *node) {
     assert(node->data.if_bool_expr.condition);
     assert(node->data.if_bool_expr.then_block);
 
-    ConstExprValue *const_val = &get_resolved_expr(node->data.if_bool_expr.condition)->const_val;
+    ConstExprValue *const_val = &get_resolved_expr(g, node->data.if_bool_expr.condition)->const_val;
     if (const_val->ok) {
         if (const_val->data.x_bool) {
             return gen_expr(g, node->data.if_bool_expr.then_block);
@@ -1643,13 +1677,13 @@ static int find_asm_index(CodeGen *g, AstNode *node, AsmToken *tok) {
     int result = 0;
     for (int i = 0; i < node->data.asm_expr.output_list.length; i += 1, result += 1) {
         AsmOutput *asm_output = node->data.asm_expr.output_list.at(i);
-        if (buf_eql_mem(&asm_output->asm_symbolic_name, ptr, len)) {
+        if (buf_eql_mem(asm_output->asm_symbolic_name, ptr, len)) {
             return result;
         }
     }
     for (int i = 0; i < node->data.asm_expr.input_list.length; i += 1, result += 1) {
         AsmInput *asm_input = node->data.asm_expr.input_list.at(i);
-        if (buf_eql_mem(&asm_input->asm_symbolic_name, ptr, len)) {
+        if (buf_eql_mem(asm_input->asm_symbolic_name, ptr, len)) {
             return result;
         }
     }
@@ -1719,7 +1753,7 @@ static LLVMValueRef gen_asm_expr(CodeGen *g, AstNode *node) {
         }
 
         if (!is_return) {
-            VariableTableEntry *variable = find_variable( node->block_context, &asm_output->variable_name);
+            VariableTableEntry *variable = asm_output->variable;
             assert(variable);
             param_types[param_index] = LLVMTypeOf(variable->value_ref);
             param_values[param_index] = variable->value_ref;
@@ -1733,7 +1767,7 @@ static LLVMValueRef gen_asm_expr(CodeGen *g, AstNode *node) {
             buf_append_char(&constraint_buf, ',');
         }
 
-        TypeTableEntry *expr_type = get_expr_type(asm_input->expr);
+        TypeTableEntry *expr_type = get_expr_type(g, asm_input->expr);
         param_types[param_index] = expr_type->type_ref;
         param_values[param_index] = gen_expr(g, asm_input->expr);
     }
@@ -1749,7 +1783,7 @@ static LLVMValueRef gen_asm_expr(CodeGen *g, AstNode *node) {
     if (asm_expr->return_count == 0) {
         ret_type = LLVMVoidType();
     } else {
-        ret_type = get_expr_type(node)->type_ref;
+        ret_type = get_expr_type(g, node)->type_ref;
     }
     LLVMTypeRef function_type = LLVMFunctionType(ret_type, param_types, input_and_output_count, false);
 
@@ -1764,7 +1798,7 @@ static LLVMValueRef gen_asm_expr(CodeGen *g, AstNode *node) {
 static LLVMValueRef gen_container_init_expr(CodeGen *g, AstNode *node) {
     assert(node->type == NodeTypeContainerInitExpr);
 
-    TypeTableEntry *type_entry = get_expr_type(node);
+    TypeTableEntry *type_entry = get_expr_type(g, node);
 
     if (type_entry->id == TypeTableEntryIdStruct) {
         assert(node->data.container_init_expr.kind == ContainerInitKindStruct);
@@ -1772,7 +1806,7 @@ static LLVMValueRef gen_container_init_expr(CodeGen *g, AstNode *node) {
         int src_field_count = type_entry->data.structure.src_field_count;
         assert(src_field_count == node->data.container_init_expr.entries.length);
 
-        StructValExprCodeGen *struct_val_expr_node = &node->data.container_init_expr.resolved_struct_val_expr;
+        StructValExprCodeGen *struct_val_expr_node = get_resolved_struct_val_expr(g, node);
         LLVMValueRef tmp_struct_ptr = struct_val_expr_node->ptr;
 
         for (int i = 0; i < src_field_count; i += 1) {
@@ -1782,14 +1816,14 @@ static LLVMValueRef gen_container_init_expr(CodeGen *g, AstNode *node) {
             if (type_struct_field->type_entry->id == TypeTableEntryIdVoid) {
                 continue;
             }
-            assert(buf_eql_buf(type_struct_field->name, &field_node->data.struct_val_field.name));
+            assert(type_struct_field->name == field_node->data.struct_val_field.name);
 
             add_debug_source_node(g, field_node);
             LLVMValueRef field_ptr = LLVMBuildStructGEP(g->builder, tmp_struct_ptr, type_struct_field->gen_index, "");
             AstNode *expr_node = field_node->data.struct_val_field.expr;
             LLVMValueRef value = gen_expr(g, expr_node);
             gen_assign_raw(g, field_node, BinOpTypeAssign, field_ptr, value,
-                    type_struct_field->type_entry, get_expr_type(expr_node));
+                    type_struct_field->type_entry, get_expr_type(g, expr_node));
         }
 
         return tmp_struct_ptr;
@@ -1801,7 +1835,7 @@ static LLVMValueRef gen_container_init_expr(CodeGen *g, AstNode *node) {
         assert(node->data.container_init_expr.entries.length == 0);
         return nullptr;
     } else if (type_entry->id == TypeTableEntryIdArray) {
-        StructValExprCodeGen *struct_val_expr_node = &node->data.container_init_expr.resolved_struct_val_expr;
+        StructValExprCodeGen *struct_val_expr_node = get_resolved_struct_val_expr(g, node);
         LLVMValueRef tmp_array_ptr = struct_val_expr_node->ptr;
 
         int field_count = type_entry->data.array.len;
@@ -1820,7 +1854,7 @@ static LLVMValueRef gen_container_init_expr(CodeGen *g, AstNode *node) {
             add_debug_source_node(g, field_node);
             LLVMValueRef elem_ptr = LLVMBuildInBoundsGEP(g->builder, tmp_array_ptr, indices, 2, "");
             gen_assign_raw(g, field_node, BinOpTypeAssign, elem_ptr, elem_val,
-                    child_type, get_expr_type(field_node));
+                    child_type, get_expr_type(g, field_node));
         }
 
         return tmp_array_ptr;
@@ -1855,7 +1889,7 @@ static LLVMValueRef gen_while_expr(CodeGen *g, AstNode *node) {
         g->break_block_stack.pop();
         g->continue_block_stack.pop();
 
-        if (get_expr_type(node->data.while_expr.body)->id != TypeTableEntryIdUnreachable) {
+        if (get_expr_type(g, node->data.while_expr.body)->id != TypeTableEntryIdUnreachable) {
             add_debug_source_node(g, node);
             LLVMBuildBr(g->builder, body_block);
         }
@@ -1884,7 +1918,7 @@ static LLVMValueRef gen_while_expr(CodeGen *g, AstNode *node) {
         gen_expr(g, node->data.while_expr.body);
         g->break_block_stack.pop();
         g->continue_block_stack.pop();
-        if (get_expr_type(node->data.while_expr.body)->id != TypeTableEntryIdUnreachable) {
+        if (get_expr_type(g, node->data.while_expr.body)->id != TypeTableEntryIdUnreachable) {
             add_debug_source_node(g, node);
             LLVMBuildBr(g->builder, cond_block);
         }
@@ -1903,7 +1937,7 @@ static LLVMValueRef gen_for_expr(CodeGen *g, AstNode *node) {
     VariableTableEntry *elem_var = node->data.for_expr.elem_var;
     assert(elem_var);
 
-    TypeTableEntry *array_type = get_expr_type(node->data.for_expr.array_expr);
+    TypeTableEntry *array_type = get_expr_type(g, node->data.for_expr.array_expr);
 
     VariableTableEntry *index_var = node->data.for_expr.index_var;
     assert(index_var);
@@ -1950,7 +1984,7 @@ static LLVMValueRef gen_for_expr(CodeGen *g, AstNode *node) {
     gen_expr(g, node->data.for_expr.body);
     g->break_block_stack.pop();
     g->continue_block_stack.pop();
-    if (get_expr_type(node->data.for_expr.body)->id != TypeTableEntryIdUnreachable) {
+    if (get_expr_type(g, node->data.for_expr.body)->id != TypeTableEntryIdUnreachable) {
         add_debug_source_node(g, node);
         LLVMValueRef new_index_val = LLVMBuildAdd(g->builder, index_val, one_const, "");
         LLVMBuildStore(g->builder, new_index_val, index_ptr);
@@ -1994,13 +2028,13 @@ static LLVMValueRef gen_var_decl_raw(CodeGen *g, AstNode *source_node, AstNodeVa
 
     bool have_init_expr = false;
     if (var_decl->expr) {
-        ConstExprValue *const_val = &get_resolved_expr(var_decl->expr)->const_val;
+        ConstExprValue *const_val = &get_resolved_expr(g, var_decl->expr)->const_val;
         if (!const_val->ok || !const_val->undef) {
             have_init_expr = true;
         }
     }
     if (have_init_expr) {
-        TypeTableEntry *expr_type = get_expr_type(var_decl->expr);
+        TypeTableEntry *expr_type = get_expr_type(g, var_decl->expr);
         LLVMValueRef value;
         if (unwrap_maybe) {
             assert(var_decl->expr);
@@ -2014,14 +2048,14 @@ static LLVMValueRef gen_var_decl_raw(CodeGen *g, AstNode *source_node, AstNodeVa
                 value, variable->type, expr_type);
     } else {
         bool ignore_uninit = false;
-        TypeTableEntry *var_type = get_type_for_type_node(var_decl->type);
+        TypeTableEntry *var_type = get_type_for_type_node(g, var_decl->type);
         if (var_type->id == TypeTableEntryIdStruct &&
             var_type->data.structure.is_unknown_size_array)
         {
             assert(var_decl->type->type == NodeTypeArrayType);
             AstNode *size_node = var_decl->type->data.array_type.size;
             if (size_node) {
-                ConstExprValue *const_val = &get_resolved_expr(size_node)->const_val;
+                ConstExprValue *const_val = &get_resolved_expr(g, size_node)->const_val;
                 if (!const_val->ok) {
                     TypeTableEntry *ptr_type = var_type->data.structure.fields[0].type_entry;
                     assert(ptr_type->id == TypeTableEntryIdPointer);
@@ -2080,7 +2114,7 @@ static LLVMValueRef gen_var_decl_raw(CodeGen *g, AstNode *source_node, AstNodeVa
 static LLVMValueRef gen_var_decl_expr(CodeGen *g, AstNode *node) {
     AstNode *init_expr = node->data.variable_declaration.expr;
     if (node->data.variable_declaration.is_const && init_expr) {
-        TypeTableEntry *init_expr_type = get_expr_type(init_expr);
+        TypeTableEntry *init_expr_type = get_expr_type(g, init_expr);
         if (init_expr_type->id == TypeTableEntryIdNumLitFloat ||
             init_expr_type->id == TypeTableEntryIdNumLitInt)
         {
@@ -2125,7 +2159,7 @@ static LLVMValueRef gen_switch_expr(CodeGen *g, AstNode *node) {
 
     LLVMValueRef target_value = gen_expr(g, node->data.switch_expr.expr);
 
-    bool end_unreachable = (get_expr_type(node)->id == TypeTableEntryIdUnreachable);
+    bool end_unreachable = (get_expr_type(g, node)->id == TypeTableEntryIdUnreachable);
 
     LLVMBasicBlockRef end_block = end_unreachable ?
         nullptr : LLVMAppendBasicBlock(g->cur_fn->fn_value, "SwitchEnd");
@@ -2135,8 +2169,8 @@ static LLVMValueRef gen_switch_expr(CodeGen *g, AstNode *node) {
     add_debug_source_node(g, node);
     LLVMValueRef switch_instr = LLVMBuildSwitch(g->builder, target_value, else_block, prong_count);
 
-    ZigList<LLVMValueRef> incoming_values = {0};
-    ZigList<LLVMBasicBlockRef> incoming_blocks = {0};
+    SmallList<LLVMValueRef, 8> incoming_values = {0};
+    SmallList<LLVMBasicBlockRef, 8> incoming_blocks = {0};
 
     AstNode *else_prong = nullptr;
     for (int prong_i = 0; prong_i < prong_count; prong_i += 1) {
@@ -2151,7 +2185,7 @@ static LLVMValueRef gen_switch_expr(CodeGen *g, AstNode *node) {
             for (int item_i = 0; item_i < prong_node->data.switch_prong.items.length; item_i += 1) {
                 AstNode *item_node = prong_node->data.switch_prong.items.at(item_i);
                 assert(item_node->type != NodeTypeSwitchRange);
-                assert(get_resolved_expr(item_node)->const_val.ok);
+                assert(get_resolved_expr(g, item_node)->const_val.ok);
                 LLVMValueRef val = gen_expr(g, item_node);
                 LLVMAddCase(switch_instr, val, prong_block);
             }
@@ -2161,7 +2195,7 @@ static LLVMValueRef gen_switch_expr(CodeGen *g, AstNode *node) {
         AstNode *prong_expr = prong_node->data.switch_prong.expr;
         LLVMValueRef prong_val = gen_expr(g, prong_expr);
 
-        if (get_expr_type(prong_expr)->id != TypeTableEntryIdUnreachable) {
+        if (get_expr_type(g, prong_expr)->id != TypeTableEntryIdUnreachable) {
             add_debug_source_node(g, prong_expr);
             LLVMBuildBr(g->builder, end_block);
             incoming_values.append(prong_val);
@@ -2183,13 +2217,13 @@ static LLVMValueRef gen_switch_expr(CodeGen *g, AstNode *node) {
 
     add_debug_source_node(g, node);
     LLVMValueRef phi = LLVMBuildPhi(g->builder, LLVMTypeOf(incoming_values.at(0)), "");
-    LLVMAddIncoming(phi, incoming_values.items, incoming_blocks.items, incoming_values.length);
+    LLVMAddIncoming(phi, incoming_values.ptr(), incoming_blocks.ptr(), incoming_values.length);
 
     return phi;
 }
 
 static LLVMValueRef gen_expr(CodeGen *g, AstNode *node) {
-    Expr *expr = get_resolved_expr(node);
+    Expr *expr = get_resolved_expr(g, node);
     if (expr->const_val.ok) {
         if (expr->type_entry->size_in_bits == 0) {
             return nullptr;
@@ -2291,7 +2325,7 @@ static void build_label_blocks(CodeGen *g, AstNode *block_node) {
         if (label_node->type != NodeTypeLabel)
             continue;
 
-        Buf *name = &label_node->data.label.name;
+        Buf *name = label_node->data.label.name;
         label_node->data.label.label_entry->basic_block = LLVMAppendBasicBlock(
                 g->cur_fn->fn_value, buf_ptr(name));
     }
@@ -2489,7 +2523,7 @@ static void do_code_gen(CodeGen *g) {
         assert(var->decl_node->type == NodeTypeVariableDeclaration);
         AstNode *expr_node = var->decl_node->data.variable_declaration.expr;
         if (expr_node) {
-            Expr *expr = get_resolved_expr(expr_node);
+            Expr *expr = get_resolved_expr(g, expr_node);
             ConstExprValue *const_val = &expr->const_val;
             assert(const_val->ok);
             TypeTableEntry *type_entry = expr->type_entry;
@@ -2497,7 +2531,7 @@ static void do_code_gen(CodeGen *g) {
         } else {
             init_val = LLVMConstNull(var->type->type_ref);
         }
-        LLVMValueRef global_value = LLVMAddGlobal(g->module, LLVMTypeOf(init_val), buf_ptr(&var->name));
+        LLVMValueRef global_value = LLVMAddGlobal(g->module, LLVMTypeOf(init_val), buf_ptr(var->name));
         LLVMSetInitializer(global_value, init_val);
         LLVMSetGlobalConstant(global_value, var->is_const);
         LLVMSetUnnamedAddr(global_value, true);
@@ -2566,6 +2600,7 @@ static void do_code_gen(CodeGen *g) {
         AstNode *proto_node = fn_table_entry->proto_node;
         assert(proto_node->type == NodeTypeFnProto);
         AstNodeFnProto *fn_proto = &proto_node->data.fn_proto;
+        trace_begin(g, "codegen", fn_proto->name);
 
         LLVMBasicBlockRef entry_block = LLVMAppendBasicBlock(fn, "entry");
         LLVMPositionBuilderAtEnd(g->builder, entry_block);
@@ -2608,12 +2643,12 @@ static void do_code_gen(CodeGen *g) {
                     arg_no = 0;
 
                     add_debug_source_node(g, var->decl_node);
-                    var->value_ref = LLVMBuildAlloca(g->builder, var->type->type_ref, buf_ptr(&var->name));
+                    var->value_ref = LLVMBuildAlloca(g->builder, var->type->type_ref, buf_ptr(var->name));
                     LLVMSetAlignment(var->value_ref, var->type->align_in_bits / 8);
                 }
 
                 var->di_loc_var = LLVMZigCreateLocalVariable(g->dbuilder, tag,
-                        block_context->di_scope, buf_ptr(&var->name),
+                        block_context->di_scope, buf_ptr(var->name),
                         import->di_file, var->decl_node->line + 1,
                         var->type->di_type, !g->strip_debug_symbols, 0, arg_no);
             }
@@ -2622,7 +2657,7 @@ static void do_code_gen(CodeGen *g) {
             for (int cea_i = 0; cea_i < block_context->cast_alloca_list.length; cea_i += 1) {
                 AstNode *fn_call_node = block_context->cast_alloca_list.at(cea_i);
                 add_debug_source_node(g, fn_call_node);
-                Expr *expr = &fn_call_node->data.fn_call_expr.resolved_expr;
+                Expr *expr = get_resolved_expr(g, fn_call_node);
                 fn_call_node->data.fn_call_expr.tmp_ptr = LLVMBuildAlloca(g->builder,
                         expr->type_entry->type_ref, "");
             }
@@ -2656,6 +2691,7 @@ static void do_code_gen(CodeGen *g) {
         TypeTableEntry *implicit_return_type = fn_def_node->data.fn_def.implicit_return_type;
         gen_block(g, fn_def_node->data.fn_def.body, implicit_return_type);
 
+        trace_end(g, "basic_blocks", LLVMCountBasicBlocks(fn));
     }
     assert(!g->errors.length);
 
@@ -2668,8 +2704,10 @@ static void do_code_gen(CodeGen *g) {
     // in release mode, we're sooooo confident that we've generated correct ir,
     // that we skip the verify module step in order to get better performance.
 #ifndef NDEBUG
+    trace_begin(g, "verify module", nullptr);
     char *error = nullptr;
     LLVMVerifyModule(g->module, LLVMAbortProcessAction, &error);
+    trace_end(g, nullptr, 0);
 #endif
 }
 
@@ -2729,22 +2767,22 @@ static int get_c_type_size_in_bits(CodeGen *g, CIntType id) {
 static void define_builtin_types(CodeGen *g) {
     {
         // if this type is anywhere in the AST, we should never hit codegen.
-        TypeTableEntry *entry = new_type_table_entry(TypeTableEntryIdInvalid);
+        TypeTableEntry *entry = new_type_table_entry(g, TypeTableEntryIdInvalid);
         buf_init_from_str(&entry->name, "(invalid)");
         g->builtin_types.entry_invalid = entry;
     }
     {
-        TypeTableEntry *entry = new_type_table_entry(TypeTableEntryIdNumLitFloat);
+        TypeTableEntry *entry = new_type_table_entry(g, TypeTableEntryIdNumLitFloat);
         buf_init_from_str(&entry->name, "(float literal)");
         g->builtin_types.entry_num_lit_float = entry;
     }
     {
-        TypeTableEntry *entry = new_type_table_entry(TypeTableEntryIdNumLitInt);
+        TypeTableEntry *entry = new_type_table_entry(g, TypeTableEntryIdNumLitInt);
         buf_init_from_str(&entry->name, "(integer literal)");
         g->builtin_types.entry_num_lit_int = entry;
     }
     {
-        TypeTableEntry *entry = new_type_table_entry(TypeTableEntryIdUndefLit);
+        TypeTableEntry *entry = new_type_table_entry(g, TypeTableEntryIdUndefLit);
         buf_init_from_str(&entry->name, "(undefined)");
         g->builtin_types.entry_undef = entry;
     }
@@ -2753,7 +2791,7 @@ static void define_builtin_types(CodeGen *g) {
         int size_in_bits = int_sizes_in_bits[i];
         bool is_signed = true;
         for (;;) {
-            TypeTableEntry *entry = new_type_table_entry(TypeTableEntryIdInt);
+            TypeTableEntry *entry = new_type_table_entry(g, TypeTableEntryIdInt);
             entry->type_ref = LLVMIntType(size_in_bits);
 
             const char u_or_i = is_signed ? 'i' : 'u';
@@ -2766,7 +2804,7 @@ static void define_builtin_types(CodeGen *g) {
                     entry->size_in_bits, entry->align_in_bits,
                     is_signed ? LLVMZigEncoding_DW_ATE_signed() : LLVMZigEncoding_DW_ATE_unsigned());
             entry->data.integral.is_signed = is_signed;
-            g->primitive_type_table.put(&entry->name, entry);
+            g->primitive_type_table.put(intern_buf(&entry->name), entry);
 
             get_int_type_ptr(g, is_signed, size_in_bits)[0] = entry;
 
@@ -2783,7 +2821,7 @@ static void define_builtin_types(CodeGen *g) {
         uint64_t size_in_bits = get_c_type_size_in_bits(g, info->id);
         bool is_signed = info->is_signed;
 
-        TypeTableEntry *entry = new_type_table_entry(TypeTableEntryIdInt);
+        TypeTableEntry *entry = new_type_table_entry(g, TypeTableEntryIdInt);
         entry->type_ref = LLVMIntType(size_in_bits);
 
         buf_init_from_str(&entry->name, info->name);
@@ -2795,11 +2833,11 @@ static void define_builtin_types(CodeGen *g) {
                 entry->size_in_bits, entry->align_in_bits,
                 is_signed ? LLVMZigEncoding_DW_ATE_signed() : LLVMZigEncoding_DW_ATE_unsigned());
         entry->data.integral.is_signed = is_signed;
-        g->primitive_type_table.put(&entry->name, entry);
+        g->primitive_type_table.put(intern_buf(&entry->name), entry);
     }
 
     {
-        TypeTableEntry *entry = new_type_table_entry(TypeTableEntryIdBool);
+        TypeTableEntry *entry = new_type_table_entry(g, TypeTableEntryIdBool);
         entry->type_ref = LLVMInt1Type();
         buf_init_from_str(&entry->name, "bool");
         entry->size_in_bits = 8;
@@ -2808,10 +2846,10 @@ static void define_builtin_types(CodeGen *g) {
                 entry->size_in_bits, entry->align_in_bits,
                 LLVMZigEncoding_DW_ATE_unsigned());
         g->builtin_types.entry_bool = entry;
-        g->primitive_type_table.put(&entry->name, entry);
+        g->primitive_type_table.put(intern_buf(&entry->name), entry);
     }
     {
-        TypeTableEntry *entry = new_type_table_entry(TypeTableEntryIdInt);
+        TypeTableEntry *entry = new_type_table_entry(g, TypeTableEntryIdInt);
         entry->type_ref = LLVMIntType(g->pointer_size_bytes * 8);
         buf_init_from_str(&entry->name, "isize");
         entry->size_in_bits = g->pointer_size_bytes * 8;
@@ -2822,10 +2860,10 @@ static void define_builtin_types(CodeGen *g) {
                 entry->size_in_bits, entry->align_in_bits,
                 LLVMZigEncoding_DW_ATE_signed());
         g->builtin_types.entry_isize = entry;
-        g->primitive_type_table.put(&entry->name, entry);
+        g->primitive_type_table.put(intern_buf(&entry->name), entry);
     }
     {
-        TypeTableEntry *entry = new_type_table_entry(TypeTableEntryIdInt);
+        TypeTableEntry *entry = new_type_table_entry(g, TypeTableEntryIdInt);
         entry->type_ref = LLVMIntType(g->pointer_size_bytes * 8);
         buf_init_from_str(&entry->name, "usize");
         entry->size_in_bits = g->pointer_size_bytes * 8;
@@ -2836,10 +2874,10 @@ static void define_builtin_types(CodeGen *g) {
                 entry->size_in_bits, entry->align_in_bits,
                 LLVMZigEncoding_DW_ATE_unsigned());
         g->builtin_types.entry_usize = entry;
-        g->primitive_type_table.put(&entry->name, entry);
+        g->primitive_type_table.put(intern_buf(&entry->name), entry);
     }
     {
-        TypeTableEntry *entry = new_type_table_entry(TypeTableEntryIdFloat);
+        TypeTableEntry *entry = new_type_table_entry(g, TypeTableEntryIdFloat);
         entry->type_ref = LLVMFloatType();
         buf_init_from_str(&entry->name, "f32");
         entry->size_in_bits = 32;
@@ -2848,10 +2886,10 @@ static void define_builtin_types(CodeGen *g) {
                 entry->size_in_bits, entry->align_in_bits,
                 LLVMZigEncoding_DW_ATE_float());
         g->builtin_types.entry_f32 = entry;
-        g->primitive_type_table.put(&entry->name, entry);
+        g->primitive_type_table.put(intern_buf(&entry->name), entry);
     }
     {
-        TypeTableEntry *entry = new_type_table_entry(TypeTableEntryIdFloat);
+        TypeTableEntry *entry = new_type_table_entry(g, TypeTableEntryIdFloat);
         entry->type_ref = LLVMDoubleType();
         buf_init_from_str(&entry->name, "f64");
         entry->size_in_bits = 64;
@@ -2860,39 +2898,39 @@ static void define_builtin_types(CodeGen *g) {
                 entry->size_in_bits, entry->align_in_bits,
                 LLVMZigEncoding_DW_ATE_float());
         g->builtin_types.entry_f64 = entry;
-        g->primitive_type_table.put(&entry->name, entry);
+        g->primitive_type_table.put(intern_buf(&entry->name), entry);
     }
     {
-        TypeTableEntry *entry = new_type_table_entry(TypeTableEntryIdVoid);
+        TypeTableEntry *entry = new_type_table_entry(g, TypeTableEntryIdVoid);
         entry->type_ref = LLVMVoidType();
         buf_init_from_str(&entry->name, "void");
         entry->di_type = LLVMZigCreateDebugBasicType(g->dbuilder, buf_ptr(&entry->name),
                 entry->size_in_bits, entry->align_in_bits,
                 LLVMZigEncoding_DW_ATE_unsigned());
         g->builtin_types.entry_void = entry;
-        g->primitive_type_table.put(&entry->name, entry);
+        g->primitive_type_table.put(intern_buf(&entry->name), entry);
     }
     {
-        TypeTableEntry *entry = new_type_table_entry(TypeTableEntryIdUnreachable);
+        TypeTableEntry *entry = new_type_table_entry(g, TypeTableEntryIdUnreachable);
         entry->type_ref = LLVMVoidType();
         buf_init_from_str(&entry->name, "unreachable");
         entry->di_type = g->builtin_types.entry_void->di_type;
         g->builtin_types.entry_unreachable = entry;
-        g->primitive_type_table.put(&entry->name, entry);
+        g->primitive_type_table.put(intern_buf(&entry->name), entry);
     }
     {
-        TypeTableEntry *entry = new_type_table_entry(TypeTableEntryIdMetaType);
+        TypeTableEntry *entry = new_type_table_entry(g, TypeTableEntryIdMetaType);
         buf_init_from_str(&entry->name, "type");
         g->builtin_types.entry_type = entry;
-        g->primitive_type_table.put(&entry->name, entry);
+        g->primitive_type_table.put(intern_buf(&entry->name), entry);
     }
     {
         // partially complete the error type. we complete it later after we know
         // error_value_count.
-        TypeTableEntry *entry = new_type_table_entry(TypeTableEntryIdPureError);
+        TypeTableEntry *entry = new_type_table_entry(g, TypeTableEntryIdPureError);
         buf_init_from_str(&entry->name, "error");
         g->builtin_types.entry_pure_error = entry;
-        g->primitive_type_table.put(&entry->name, entry);
+        g->primitive_type_table.put(intern_buf(&entry->name), entry);
     }
 
     g->builtin_types.entry_u8 = get_int_type(g, false, 8);
@@ -2908,9 +2946,9 @@ static void define_builtin_types(CodeGen *g) {
 
 static BuiltinFnEntry *create_builtin_fn(CodeGen *g, BuiltinFnId id, const char *name) {
     BuiltinFnEntry *builtin_fn = allocate<BuiltinFnEntry>(1);
-    buf_init_from_str(&builtin_fn->name, name);
+    builtin_fn->name = intern_str(name);
     builtin_fn->id = id;
-    g->builtin_fn_table.put(&builtin_fn->name, builtin_fn);
+    g->builtin_fn_table.put(builtin_fn->name, builtin_fn);
     return builtin_fn;
 }
 
@@ -3073,12 +3111,253 @@ static void set_root_export_version(CodeGen *g, Buf *version_buf, AstNode *node)
 }
 
 
-static ImportTableEntry *codegen_add_code(CodeGen *g, Buf *abs_full_path,
+struct ImportLoad;
+
+// where one top level import declaration of a loaded file leads
+struct ImportTarget {
+    // null if the import could not be found or opened
+    ImportLoad *load;
+    int err;
+    // the search path joined with the import path, for error messages
+    Buf *full_path;
+};
+
+// A source file reached through imports. Files are read, tokenized and parsed
+// on a pool of threads and then added to the CodeGen on the main thread, in
+// the depth first order in which they are imported, so that node indexes and
+// error messages do not depend on how the work was split up.
+struct ImportLoad {
+    Buf *abs_full_path;
+    Buf *src_dirname;
+    Buf *src_basename;
+    Buf *full_path;
+    Buf *source_code;
+    int read_err;
+    Tokenization tokenization;
+    // its root is null if the file did not tokenize or parse
+    ImportTableEntry *import_entry;
+    ErrorMsg *parse_err;
+    uint32_t node_count;
+    // one for each import declaration, in order. Resolving stops at the first
+    // import which could not be opened.
+    ZigList<ImportTarget> targets;
+
+    // only looked at when the cache is on
+    AstCacheResult cache_result;
+    bool cache_stored;
+
+    int thread_id;
+    double cache_start;
+    double cache_seconds;
+    double cache_cpu_seconds;
+    double tokenize_start;
+    double tokenize_seconds;
+    double tokenize_cpu_seconds;
+    double parse_start;
+    double parse_seconds;
+    double parse_cpu_seconds;
+
+    // set once the file is in the import table
+    bool added;
+};
+
+struct ImportLoader {
+    CodeGen *g;
+    pthread_mutex_t mutex;
+    // signaled when a file is queued and when the last job finishes
+    pthread_cond_t cond;
+    ZigList<ImportLoad *> queue;
+    int queue_head;
+    int busy_count;
+    HashMap<Buf *, ImportLoad *, buf_hash, buf_eql_buf> loads;
+};
+
+struct ImportWorker {
+    ImportLoader *loader;
+    int thread_id;
+    pthread_t thread;
+};
+
+// source_code may be null, in which case the file is read when it is loaded
+static ImportLoad *find_or_queue_import(ImportLoader *loader, Buf *abs_full_path,
         Buf *src_dirname, Buf *src_basename, Buf *source_code)
 {
+    CodeGen *g = loader->g;
+    pthread_mutex_lock(&loader->mutex);
+    ImportLoad *load;
+    auto entry = loader->loads.maybe_get(abs_full_path);
+    if (entry) {
+        load = entry->value;
+    } else {
+        load = allocate<ImportLoad>(1);
+        load->abs_full_path = buf_create_from_buf(abs_full_path);
+        loader->loads.put(load->abs_full_path, load);
+
+        auto import_entry = g->import_table.maybe_get(abs_full_path);
+        if (import_entry) {
+            // added by an earlier call to codegen_add_code
+            load->import_entry = import_entry->value;
+            load->added = true;
+        } else {
+            load->src_dirname = src_dirname;
+            load->src_basename = src_basename;
+            load->source_code = source_code;
+            loader->queue.append(load);
+            pthread_cond_signal(&loader->cond);
+        }
+    }
+    pthread_mutex_unlock(&loader->mutex);
+    return load;
+}
+
+static void resolve_import_targets(ImportLoader *loader, ImportLoad *load) {
+    CodeGen *g = loader->g;
+    AstNode *root = load->import_entry->root;
+    Buf full_path = BUF_INIT;
+    Buf abs_path = BUF_INIT;
     int err;
-    Buf *full_path = buf_alloc();
-    os_path_join(src_dirname, src_basename, full_path);
+
+    for (int decl_i = 0; decl_i < root->data.root.top_level_decls.length; decl_i += 1) {
+        AstNode *top_level_decl = root->data.root.top_level_decls.at(decl_i);
+        if (top_level_decl->type != NodeTypeImport)
+            continue;
+
+        Buf *import_target_path = &top_level_decl->data.import.path;
+        load->targets.add_one();
+        ImportTarget *target = &load->targets.last();
+        target->load = nullptr;
+        target->err = ErrorFileNotFound;
+        target->full_path = nullptr;
+
+        for (int path_i = 0; path_i < g->lib_search_paths.length; path_i += 1) {
+            Buf *search_path = g->lib_search_paths.at(path_i);
+            os_path_join(buf_view(search_path), buf_view(import_target_path), &full_path);
+
+            if ((err = os_path_real(&full_path, &abs_path))) {
+                if (err == ErrorFileNotFound) {
+                    continue;
+                }
+                target->err = err;
+                target->full_path = buf_create_from_buf(&full_path);
+                break;
+            }
+
+            target->err = ErrorNone;
+            target->full_path = buf_create_from_buf(&full_path);
+            target->load = find_or_queue_import(loader, &abs_path, search_path, import_target_path, nullptr);
+            break;
+        }
+
+        if (target->err != ErrorNone && target->err != ErrorFileNotFound)
+            break;
+    }
+
+    buf_deinit(&full_path);
+    buf_deinit(&abs_path);
+}
+
+// tokenize_threads is how many threads tokenizing this one file may use
+static void load_import(ImportLoader *loader, ImportLoad *load, int thread_id, int tokenize_threads) {
+    CodeGen *g = loader->g;
+    load->thread_id = thread_id;
+    if (!load->source_code) {
+        // stays mapped for as long as the import, which is until exit
+        OsMappedFile *source_file = allocate<OsMappedFile>(1);
+        if ((load->read_err = os_map_file(load->abs_full_path, source_file)))
+            return;
+        load->source_code = &source_file->contents;
+    }
+
+    if (!load->full_path) {
+        load->full_path = buf_alloc();
+        os_path_join(buf_view(load->src_dirname), buf_view(load->src_basename), load->full_path);
+    }
+
+    // the hash maps are initialized when the file is added, on the main thread
+    ImportTableEntry *import_entry = allocate<ImportTableEntry>(1);
+    import_entry->ast_arena.category = AllocCategoryAst;
+    import_entry->source_code = load->source_code;
+    import_entry->path = load->full_path;
+    load->import_entry = import_entry;
+
+    // --verbose prints the tokens, which the cache does not keep
+    bool use_cache = g->ast_cache_dir && !g->verbose;
+    if (use_cache) {
+        load->cache_start = os_get_time();
+        double cpu_start = os_get_thread_cpu_time();
+        load->cache_result = ast_cache_load(g->ast_cache_dir, g->compiler_id, import_entry, &load->node_count);
+        load->cache_seconds = os_get_time() - load->cache_start;
+        load->cache_cpu_seconds = os_get_thread_cpu_time() - cpu_start;
+        if (load->cache_result == AstCacheResultHit) {
+            resolve_import_targets(loader, load);
+            return;
+        }
+    }
+
+    load->tokenize_start = os_get_time();
+    double cpu_start = os_get_thread_cpu_time();
+    tokenize_parallel(load->source_code, &load->tokenization, tokenize_threads);
+    load->tokenize_seconds = os_get_time() - load->tokenize_start;
+    load->tokenize_cpu_seconds = os_get_thread_cpu_time() - cpu_start;
+    import_entry->line_offsets = load->tokenization.line_offsets;
+
+    if (load->tokenization.err)
+        return;
+
+    load->parse_start = os_get_time();
+    cpu_start = os_get_thread_cpu_time();
+    import_entry->root = ast_try_parse(load->source_code, &load->tokenization, import_entry,
+            &load->node_count, &load->parse_err);
+    load->parse_seconds = os_get_time() - load->parse_start;
+    load->parse_cpu_seconds = os_get_thread_cpu_time() - cpu_start;
+
+    if (!import_entry->root)
+        return;
+
+    // a cache which cannot be written to only costs us the time to try
+    if (use_cache) {
+        load->cache_stored = !ast_cache_store(g->ast_cache_dir, g->compiler_id, import_entry, load->node_count);
+    }
+    resolve_import_targets(loader, load);
+}
+
+// runs queued jobs until the queue is empty and no job still running could
+// queue another
+static void run_import_jobs(ImportLoader *loader, int thread_id) {
+    pthread_mutex_lock(&loader->mutex);
+    for (;;) {
+        if (loader->queue_head < loader->queue.length) {
+            ImportLoad *load = loader->queue.at(loader->queue_head);
+            loader->queue_head += 1;
+            loader->busy_count += 1;
+            pthread_mutex_unlock(&loader->mutex);
+
+            load_import(loader, load, thread_id, 1);
+
+            pthread_mutex_lock(&loader->mutex);
+            loader->busy_count -= 1;
+        } else if (loader->busy_count == 0) {
+            pthread_cond_broadcast(&loader->cond);
+            break;
+        } else {
+            pthread_cond_wait(&loader->cond, &loader->mutex);
+        }
+    }
+    pthread_mutex_unlock(&loader->mutex);
+}
+
+static void *import_worker_thread(void *arg) {
+    ImportWorker *worker = (ImportWorker *)arg;
+    run_import_jobs(worker->loader, worker->thread_id);
+    return nullptr;
+}
+
+static ImportTableEntry *add_loaded_import(CodeGen *g, ImportLoad *load) {
+    assert(!load->added);
+    load->added = true;
+    Buf *full_path = load->full_path;
+    Buf *source_code = load->source_code;
+    Tokenization *tokenization = &load->tokenization;
 
     if (g->verbose) {
         fprintf(stderr, "\nOriginal Source (%s):\n", buf_ptr(full_path));
@@ -3089,46 +3368,78 @@ static ImportTableEntry *codegen_add_code(CodeGen *g, Buf *abs_full_path,
         fprintf(stderr, "---------\n");
     }
 
-    Tokenization tokenization = {0};
-    tokenize(source_code, &tokenization);
+    if (g->ast_cache_dir && !g->verbose) {
+        switch (load->cache_result) {
+            case AstCacheResultHit:
+                g->ast_cache_hits += 1;
+                g->ast_cache_load_seconds += load->cache_seconds;
+                break;
+            case AstCacheResultMiss:
+                g->ast_cache_misses += 1;
+                break;
+            case AstCacheResultStale:
+                g->ast_cache_stale += 1;
+                break;
+        }
+        if (load->cache_stored)
+            g->ast_cache_stores += 1;
+        timing_add_finished(g, "load cached ast", full_path, load->thread_id, load->cache_start,
+                load->cache_seconds, load->cache_cpu_seconds, nullptr, 0);
+    }
+
+    if (load->cache_result != AstCacheResultHit) {
+        timing_add_finished(g, "tokenize", full_path, load->thread_id, load->tokenize_start,
+                load->tokenize_seconds, load->tokenize_cpu_seconds,
+                "tokens", (uint64_t)tokenization->tokens->length);
+    }
 
-    if (tokenization.err) {
-        ErrorMsg *err = err_msg_create_with_line(full_path, tokenization.err_line, tokenization.err_column,
-                source_code, tokenization.line_offsets, tokenization.err);
+    if (tokenization->err) {
+        ErrorMsg *err = err_msg_create_with_line(full_path, tokenization->err_line, tokenization->err_column,
+                source_code, tokenization->line_offsets, tokenization->err);
 
         print_err_msg(err, g->err_color);
-        exit(1);
+        exit_with_errors(g);
     }
 
     if (g->verbose) {
-        print_tokens(source_code, tokenization.tokens);
+        print_tokens(source_code, tokenization->tokens);
 
         fprintf(stderr, "\nAST:\n");
         fprintf(stderr, "------\n");
     }
 
-    ImportTableEntry *import_entry = allocate<ImportTableEntry>(1);
-    import_entry->source_code = source_code;
-    import_entry->line_offsets = tokenization.line_offsets;
-    import_entry->path = full_path;
-    import_entry->fn_table.init(32);
-    import_entry->fn_type_table.init(32);
+    if (load->cache_result != AstCacheResultHit) {
+        timing_add_finished(g, "parse", full_path, load->thread_id, load->parse_start,
+                load->parse_seconds, load->parse_cpu_seconds, "nodes", load->node_count);
+    }
+
+    if (load->parse_err) {
+        print_err_msg(load->parse_err, g->err_color);
+        exit_with_errors(g);
+    }
 
-    import_entry->root = ast_parse(source_code, tokenization.tokens, import_entry, g->err_color,
-            &g->next_node_index);
+    ImportTableEntry *import_entry = load->import_entry;
     assert(import_entry->root);
+    ast_offset_create_indexes(import_entry->root, g->next_node_index);
+    g->next_node_index += load->node_count;
+    import_entry->fn_table.init(32);
+
     if (g->verbose) {
         ast_print(stderr, import_entry->root, 0);
+        fprintf(stderr, "\nAST memory: %zu bytes used, %zu bytes reserved\n",
+                import_entry->ast_arena.bytes_used, import_entry->ast_arena.bytes_reserved);
     }
 
-    import_entry->di_file = LLVMZigCreateFile(g->dbuilder, buf_ptr(src_basename), buf_ptr(src_dirname));
-    g->import_table.put(abs_full_path, import_entry);
+    import_entry->di_file = LLVMZigCreateFile(g->dbuilder, buf_ptr(load->src_basename),
+            buf_ptr(load->src_dirname));
+    g->import_table.put(load->abs_full_path, import_entry);
 
-    import_entry->block_context = new_block_context(import_entry->root, nullptr);
+    import_entry->block_context = new_block_context(g, import_entry->root, nullptr);
     import_entry->block_context->di_scope = LLVMZigFileToScope(import_entry->di_file);
 
 
     assert(import_entry->root->type == NodeTypeRoot);
+    int import_i = 0;
     for (int decl_i = 0; decl_i < import_entry->root->data.root.top_level_decls.length; decl_i += 1) {
         AstNode *top_level_decl = import_entry->root->data.root.top_level_decls.at(decl_i);
 
@@ -3139,7 +3450,7 @@ static ImportTableEntry *codegen_add_code(CodeGen *g, Buf *abs_full_path,
             } else {
                 for (int i = 0; i < top_level_decl->data.root_export_decl.directives->length; i += 1) {
                     AstNode *directive_node = top_level_decl->data.root_export_decl.directives->at(i);
-                    Buf *name = &directive_node->data.directive.name;
+                    Buf *name = directive_node->data.directive.name;
                     Buf *param = &directive_node->data.directive.param;
                     if (buf_eql_str(name, "version")) {
                         set_root_export_version(g, param, directive_node);
@@ -3163,7 +3474,7 @@ static ImportTableEntry *codegen_add_code(CodeGen *g, Buf *abs_full_path,
                     if (!g->root_out_name)
                         g->root_out_name = &top_level_decl->data.root_export_decl.name;
 
-                    Buf *out_type = &top_level_decl->data.root_export_decl.type;
+                    Buf *out_type = top_level_decl->data.root_export_decl.type;
                     OutType export_out_type;
                     if (buf_eql_str(out_type, "executable")) {
                         export_out_type = OutTypeExe;
@@ -3181,57 +3492,32 @@ static ImportTableEntry *codegen_add_code(CodeGen *g, Buf *abs_full_path,
                 }
             }
         } else if (top_level_decl->type == NodeTypeImport) {
-            Buf *import_target_path = &top_level_decl->data.import.path;
-            Buf full_path = BUF_INIT;
-            Buf *import_code = buf_alloc();
-            bool found_it = false;
-
-            for (int path_i = 0; path_i < g->lib_search_paths.length; path_i += 1) {
-                Buf *search_path = g->lib_search_paths.at(path_i);
-                os_path_join(search_path, import_target_path, &full_path);
-
-                Buf *abs_full_path = buf_alloc();
-                if ((err = os_path_real(&full_path, abs_full_path))) {
-                    if (err == ErrorFileNotFound) {
-                        continue;
-                    } else {
-                        g->error_during_imports = true;
-                        add_node_error(g, top_level_decl,
-                                buf_sprintf("unable to open '%s': %s", buf_ptr(&full_path), err_str(err)));
-                        goto done_looking_at_imports;
-                    }
-                }
+            ImportTarget *target = &load->targets.at(import_i);
+            import_i += 1;
+            ImportLoad *target_load = target->load;
 
-                auto entry = g->import_table.maybe_get(abs_full_path);
-                if (entry) {
-                    found_it = true;
-                    top_level_decl->data.import.import = entry->value;
-                } else {
-                    if ((err = os_fetch_file_path(abs_full_path, import_code))) {
-                        if (err == ErrorFileNotFound) {
-                            continue;
-                        } else {
-                            g->error_during_imports = true;
-                            add_node_error(g, top_level_decl,
-                                    buf_sprintf("unable to open '%s': %s", buf_ptr(&full_path), err_str(err)));
-                            goto done_looking_at_imports;
-                        }
-                    }
-                    top_level_decl->data.import.import = codegen_add_code(g,
-                            abs_full_path, search_path, &top_level_decl->data.import.path, import_code);
-                    found_it = true;
-                }
-                break;
-            }
-            if (!found_it) {
+            if (target_load && target_load->read_err) {
+                g->error_during_imports = true;
+                add_node_error(g, top_level_decl, buf_sprintf("unable to open '%s': %s",
+                            buf_ptr(target->full_path), err_str(target_load->read_err)));
+                goto done_looking_at_imports;
+            } else if (target_load) {
+                top_level_decl->data.import.import = target_load->added ?
+                    target_load->import_entry : add_loaded_import(g, target_load);
+            } else if (target->err == ErrorFileNotFound) {
                 g->error_during_imports = true;
                 add_node_error(g, top_level_decl,
-                        buf_sprintf("unable to find '%s'", buf_ptr(import_target_path)));
+                        buf_sprintf("unable to find '%s'", buf_ptr(&top_level_decl->data.import.path)));
+            } else {
+                g->error_during_imports = true;
+                add_node_error(g, top_level_decl, buf_sprintf("unable to open '%s': %s",
+                            buf_ptr(target->full_path), err_str(target->err)));
+                goto done_looking_at_imports;
             }
         } else if (top_level_decl->type == NodeTypeFnDef) {
             AstNode *proto_node = top_level_decl->data.fn_def.fn_proto;
             assert(proto_node->type == NodeTypeFnProto);
-            Buf *proto_name = &proto_node->data.fn_proto.name;
+            Buf *proto_name = proto_node->data.fn_proto.name;
 
             bool is_private = (proto_node->data.fn_proto.visib_mod == VisibModPrivate);
 
@@ -3246,27 +3532,78 @@ done_looking_at_imports:
     return import_entry;
 }
 
+// Adds the file and every file it imports, directly or not, which is not in
+// the import table yet.
+static ImportTableEntry *codegen_add_code(CodeGen *g, Buf *abs_full_path,
+        Buf *src_dirname, Buf *src_basename, Buf *source_code)
+{
+    Buf *full_path = buf_alloc();
+    os_path_join(buf_view(src_dirname), buf_view(src_basename), full_path);
+    int load_phase = timing_begin(g, "load imports", full_path);
+
+    ImportLoader loader = {};
+    loader.g = g;
+    pthread_mutex_init(&loader.mutex, nullptr);
+    pthread_cond_init(&loader.cond, nullptr);
+    loader.loads.init(32);
+
+    ImportLoad *root = find_or_queue_import(&loader, abs_full_path, src_dirname, src_basename, source_code);
+    assert(!root->added);
+    root->full_path = full_path;
+
+    // until the first file is parsed it is the only job, so it may use every
+    // thread for tokenizing
+    loader.queue_head = 1;
+    load_import(&loader, root, 1, g->thread_count);
+
+    int worker_count = (loader.queue.length > loader.queue_head) ? g->thread_count - 1 : 0;
+    ImportWorker *workers = worker_count ? allocate<ImportWorker>(worker_count) : nullptr;
+    for (int i = 0; i < worker_count; i += 1) {
+        ImportWorker *worker = &workers[i];
+        worker->loader = &loader;
+        worker->thread_id = i + 2;
+        if (pthread_create(&worker->thread, nullptr, import_worker_thread, worker)) {
+            zig_panic("unable to create thread");
+        }
+    }
+    run_import_jobs(&loader, 1);
+    for (int i = 0; i < worker_count; i += 1) {
+        pthread_join(workers[i].thread, nullptr);
+    }
+    deallocate(workers, worker_count);
+
+    ImportTableEntry *import_entry = add_loaded_import(g, root);
+
+    loader.loads.deinit();
+    loader.queue.deinit();
+    pthread_cond_destroy(&loader.cond);
+    pthread_mutex_destroy(&loader.mutex);
+
+    timing_end(g, load_phase);
+    return import_entry;
+}
+
 static ImportTableEntry *add_special_code(CodeGen *g, const char *basename) {
     Buf *std_dir = buf_create_from_str(ZIG_STD_DIR);
     Buf *code_basename = buf_create_from_str(basename);
     Buf path_to_code_src = BUF_INIT;
-    os_path_join(std_dir, code_basename, &path_to_code_src);
+    os_path_join(buf_view(std_dir), buf_view(code_basename), &path_to_code_src);
     Buf *abs_full_path = buf_alloc();
     int err;
     if ((err = os_path_real(&path_to_code_src, abs_full_path))) {
         zig_panic("unable to open '%s': %s", buf_ptr(&path_to_code_src), err_str(err));
     }
-    Buf *import_code = buf_alloc();
-    if ((err = os_fetch_file_path(abs_full_path, import_code))) {
+    OsMappedFile *import_file = allocate<OsMappedFile>(1);
+    if ((err = os_map_file(abs_full_path, import_file))) {
         zig_panic("unable to open '%s': %s", buf_ptr(&path_to_code_src), err_str(err));
     }
 
-    return codegen_add_code(g, abs_full_path, std_dir, code_basename, import_code);
+    return codegen_add_code(g, abs_full_path, std_dir, code_basename, &import_file->contents);
 }
 
-void codegen_add_root_code(CodeGen *g, Buf *src_dir, Buf *src_basename, Buf *source_code) {
+void codegen_analyze_root_code(CodeGen *g, Buf *src_dir, Buf *src_basename, Buf *source_code) {
     Buf source_path = BUF_INIT;
-    os_path_join(src_dir, src_basename, &source_path);
+    os_path_join(buf_view(src_dir), buf_view(src_basename), &source_path);
     init(g, &source_path);
 
     Buf *abs_full_path = buf_alloc();
@@ -3300,19 +3637,27 @@ void codegen_add_root_code(CodeGen *g, Buf *src_dir, Buf *src_basename, Buf *sou
         fprintf(stderr, "--------------------\n");
     }
     if (!g->error_during_imports) {
+        int analyze_phase = timing_begin(g, "semantic analysis", nullptr);
         semantic_analyze(g);
+        timing_end(g, analyze_phase);
     }
+}
+
+void codegen_add_root_code(CodeGen *g, Buf *src_dir, Buf *src_basename, Buf *source_code) {
+    codegen_analyze_root_code(g, src_dir, src_basename, source_code);
 
     if (g->errors.length == 0) {
         if (g->verbose) {
             fprintf(stderr, "OK\n");
+            fprintf(stderr, "Scopes: %" PRIu32 " created, %" PRIu32 " promoted to hash tables\n",
+                    g->block_context_count, g->promoted_scope_table_count);
         }
     } else {
         for (int i = 0; i < g->errors.length; i += 1) {
             ErrorMsg *err = g->errors.at(i);
             print_err_msg(err, g->err_color);
         }
-        exit(1);
+        exit_with_errors(g);
     }
 
     if (g->verbose) {
@@ -3320,12 +3665,14 @@ void codegen_add_root_code(CodeGen *g, Buf *src_dir, Buf *src_basename, Buf *sou
         fprintf(stderr, "------------------\n");
     }
 
+    int codegen_phase = timing_begin(g, "code generation", nullptr);
     do_code_gen(g);
+    timing_end(g, codegen_phase);
 }
 
 static void to_c_type(CodeGen *g, AstNode *type_node, Buf *out_buf) {
     zig_panic("TODO this function needs some love");
-    TypeTableEntry *type_entry = get_resolved_expr(type_node)->type_entry;
+    TypeTableEntry *type_entry = get_resolved_expr(g, type_node)->type_entry;
     assert(type_entry);
 
     if (type_entry == g->builtin_types.entry_u8) {
@@ -3379,7 +3726,7 @@ static void generate_h_file(CodeGen *g) {
         buf_appendf(&h_buf, "%s %s %s(",
                 buf_ptr(export_macro),
                 buf_ptr(&return_type_c),
-                buf_ptr(&fn_proto->name));
+                buf_ptr(fn_proto->name));
 
         Buf param_type_c = BUF_INIT;
         if (fn_proto->params.length) {
@@ -3389,7 +3736,7 @@ static void generate_h_file(CodeGen *g) {
                 to_c_type(g, param_type, &param_type_c);
                 buf_appendf(&h_buf, "%s %s",
                         buf_ptr(&param_type_c),
-                        buf_ptr(&param_decl_node->data.param_decl.name));
+                        buf_ptr(param_decl_node->data.param_decl.name));
                 if (param_i < fn_proto->params.length - 1)
                     buf_appendf(&h_buf, ", ");
             }
@@ -3438,7 +3785,7 @@ static void generate_h_file(CodeGen *g) {
 
 static const char *get_libc_file(CodeGen *g, const char *file) {
     Buf *out_buf = buf_alloc();
-    os_path_join(g->libc_lib_path, buf_create_from_str(file), out_buf);
+    os_path_join(buf_view(g->libc_lib_path), buf_view_str(file), out_buf);
     return buf_ptr(out_buf);
 }
 
@@ -3450,7 +3797,9 @@ void codegen_link(CodeGen *g, const char *out_file) {
             fprintf(stderr, "---------------\n");
         }
 
+        int optimize_phase = timing_begin(g, "optimize", nullptr);
         LLVMZigOptimizeModule(g->target_machine, g->module);
+        timing_end(g, optimize_phase);
 
         if (g->verbose) {
             LLVMDumpModule(g->module);
@@ -3472,12 +3821,14 @@ void codegen_link(CodeGen *g, const char *out_file) {
         buf_append_str(&out_file_o, ".o");
     }
 
+    int emit_phase = timing_begin(g, "emit object", nullptr);
     char *err_msg = nullptr;
     if (LLVMTargetMachineEmitToFile(g->target_machine, g->module, buf_ptr(&out_file_o),
                 LLVMObjectFile, &err_msg))
     {
         zig_panic("unable to write object file: %s", err_msg);
     }
+    timing_end(g, emit_phase);
 
     if (g->out_type == OutTypeObj) {
         if (g->verbose) {
@@ -3566,12 +3917,14 @@ void codegen_link(CodeGen *g, const char *out_file) {
     int return_code;
     Buf ld_stderr = BUF_INIT;
     Buf ld_stdout = BUF_INIT;
+    int link_phase = timing_begin(g, "link", nullptr);
     os_exec_process("ld", args, &return_code, &ld_stderr, &ld_stdout);
+    timing_end(g, link_phase);
 
     if (return_code != 0) {
         fprintf(stderr, "ld failed with return code %d\n", return_code);
         fprintf(stderr, "%s\n", buf_ptr(&ld_stderr));
-        exit(1);
+        exit_with_errors(g);
     } else if (buf_len(&ld_stderr)) {
         fprintf(stderr, "%s\n", buf_ptr(&ld_stderr));
     }
@@ -11,6 +11,8 @@
 #include "parser.hpp"
 #include "errmsg.hpp"
 
+#include <stdio.h>
+
 CodeGen *codegen_create(Buf *root_source_dir);
 
 void codegen_set_clang_argv(CodeGen *codegen, const char **args, int len);
@@ -18,13 +20,36 @@ void codegen_set_build_type(CodeGen *codegen, CodeGenBuildType build_type);
 void codegen_set_is_static(CodeGen *codegen, bool is_static);
 void codegen_set_strip(CodeGen *codegen, bool strip);
 void codegen_set_verbose(CodeGen *codegen, bool verbose);
+void codegen_set_time_report(CodeGen *codegen, bool time_report);
+void codegen_set_thread_count(CodeGen *codegen, int thread_count);
+// parsed files are cached in the ast directory under cache_dir. fails if the
+// compiler cannot tell which build it is, leaving caching off.
+int codegen_set_cache_dir(CodeGen *codegen, Buf *cache_dir);
 void codegen_set_errmsg_color(CodeGen *codegen, ErrColor err_color);
 void codegen_set_out_type(CodeGen *codegen, OutType out_type);
 void codegen_set_out_name(CodeGen *codegen, Buf *out_name);
 void codegen_set_libc_path(CodeGen *codegen, Buf *libc_path);
 
 void codegen_add_root_code(CodeGen *g, Buf *source_dir, Buf *source_basename, Buf *source_code);
+// The front half of codegen_add_root_code: loads the file and its imports and
+// runs semantic analysis, leaving any errors in g->errors. Syntax errors are
+// still printed and exit the process.
+void codegen_analyze_root_code(CodeGen *g, Buf *source_dir, Buf *source_basename, Buf *source_code);
 
 void codegen_link(CodeGen *g, const char *out_file);
 
+// turns on the allocation and hash lookup counters; the statistics are printed
+// to stderr when the compile fails, otherwise by the caller
+void codegen_set_stats(CodeGen *codegen, StatsFormat format);
+void codegen_print_stats(CodeGen *g, FILE *f, StatsFormat format);
+
+// the LLVM pass timings which follow always go to stderr. call this after
+// codegen_link; LLVM cannot be used afterwards.
+void codegen_print_time_report(CodeGen *g, FILE *f);
+
+// writes a Chrome trace format timeline of the compilation to f. call
+// codegen_finish_trace when done; closing f is up to the caller.
+void codegen_set_trace_out(CodeGen *g, FILE *f);
+void codegen_finish_trace(CodeGen *g);
+
 #endif
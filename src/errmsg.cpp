@@ -15,7 +15,7 @@ void print_err_msg(ErrorMsg *err, ErrColor color) {
                 err->line_start + 1, err->column_start + 1,
                 buf_ptr(err->msg));
 
-        fprintf(stderr, "%s\n", buf_ptr(&err->line_buf));
+        fprintf(stderr, "%.*s\n", err->line.len, err->line.ptr);
         for (int i = 0; i < err->column_start; i += 1) {
             fprintf(stderr, " ");
         }
@@ -63,7 +63,10 @@ ErrorMsg *err_msg_create_with_offset(Buf *path, int line, int column, int offset
         line_end_offset += 1;
     }
 
-    buf_init_from_mem(&err_msg->line_buf, source + line_start_offset, line_end_offset - line_start_offset);
+    // copied, because the source belongs to clang, which frees it before the
+    // error is printed
+    err_msg->line = buf_view(buf_create_from_mem(source + line_start_offset,
+                line_end_offset - line_start_offset));
 
     return err_msg;
 }
@@ -85,7 +88,7 @@ ErrorMsg *err_msg_create_with_line(Buf *path, int line, int column,
         len = 0;
     }
 
-    buf_init_from_mem(&err_msg->line_buf, buf_ptr(source) + line_start_offset, len);
+    err_msg->line = buf_view_slice(source, line_start_offset, line_start_offset + len);
 
     return err_msg;
 }
@@ -22,7 +22,8 @@ struct ErrorMsg {
     int column_start;
     Buf *msg;
     Buf *path;
-    Buf line_buf;
+    // the source line, which points into the source itself
+    BufView line;
 
     ZigList<ErrorMsg *> notes;
 };
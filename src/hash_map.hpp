@@ -12,29 +12,57 @@
 
 #include <stdint.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Lookup statistics for --stats, one per HashMap instantiation. Bucket i of
+// the histogram counts lookups which probed i + 1 groups; the last bucket
+// also counts everything longer.
+static const int HASH_MAP_PROBE_BUCKETS = 8;
+
+struct HashMapStats {
+    const char *name;
+    uint64_t lookups;
+    uint64_t probe_histogram[HASH_MAP_PROBE_BUCKETS];
+    HashMapStats *next;
+};
+
+// every instantiation which has been init()ed at least once
+extern HashMapStats *hash_map_stats_list;
+
+// adds stats to hash_map_stats_list unless another thread got there first
+void hash_map_stats_register(HashMapStats *stats, const char *name);
+
+// Open addressing table in the style of Swiss tables. Each slot has a control
+// byte in a separate array: empty, deleted, or the top 7 bits of the slot's
+// hash. Slots are probed in aligned groups of 16 control bytes which are
+// compared against the wanted hash bits all at once. The capacity is always a
+// power of two and the full hash of every entry is cached so that growing the
+// table never calls HashFunction again.
 template<typename K, typename V, uint32_t (*HashFunction)(K key), bool (*EqualFn)(K a, K b)>
 class HashMap {
 public:
     void init(int capacity) {
+        if (!__atomic_load_n(&stats.name, __ATOMIC_ACQUIRE))
+            hash_map_stats_register(&stats, __PRETTY_FUNCTION__);
         init_capacity(capacity);
     }
     void deinit(void) {
-        free(_entries);
+        deallocate(_entries, _capacity, AllocCategoryHashMap);
+        deallocate(_ctrl, _capacity, AllocCategoryHashMap);
     }
 
     struct Entry {
-        bool used;
-        int distance_from_start_index;
         K key;
         V value;
+        uint32_t hash;
     };
 
     void clear() {
-        for (int i = 0; i < _capacity; i += 1) {
-            _entries[i].used = false;
-        }
+        memset(_ctrl, ctrl_empty, _capacity);
         _size = 0;
-        _max_distance_from_start_index = 0;
+        _deleted_count = 0;
         _modification_count += 1;
     }
 
@@ -44,32 +72,43 @@ public:
 
     void put(const K &key, const V &value) {
         _modification_count += 1;
-        internal_put(key, value);
-
-        // if we get too full (80%), double the capacity
-        if (_size * 5 >= _capacity * 4) {
-            Entry *old_entries = _entries;
-            int old_capacity = _capacity;
-            init_capacity(_capacity * 2);
-            // dump all of the old elements into the new table
-            for (int i = 0; i < old_capacity; i += 1) {
-                Entry *old_entry = &old_entries[i];
-                if (old_entry->used)
-                    internal_put(old_entry->key, old_entry->value);
+        uint32_t hash = hash_key(key);
+        Entry *entry = internal_get(key, hash);
+        if (entry) {
+            entry->value = value;
+            return;
+        }
+
+        // if we get too full (87.5%), counting deleted slots, make room. the
+        // table only grows when live entries make up the bulk of the load;
+        // otherwise rehashing at the same capacity gets rid of the tombstones.
+        if ((_size + _deleted_count + 1) * 8 > _capacity * 7) {
+            if ((_size + 1) * 2 > _capacity) {
+                resize(_capacity * 2);
+            } else {
+                resize(_capacity);
             }
-            free(old_entries);
         }
+
+        internal_put(key, value, hash);
     }
 
     const V &get(const K &key) const {
-        Entry *entry = internal_get(key);
+        Entry *entry = internal_get(key, hash_key(key));
         if (!entry)
             zig_panic("key not found");
         return entry->value;
     }
 
     Entry *maybe_get(const K &key) const {
-        return internal_get(key);
+        return internal_get(key, hash_key(key));
+    }
+
+    // look up with a key of another type, such as a BufView for Buf * keys,
+    // without building a K. LookupHash must agree with HashFunction.
+    template<typename L, uint32_t (*LookupHash)(L key), bool (*LookupEqlFn)(K a, L b)>
+    Entry *maybe_get_by(const L &key) const {
+        return find<L, LookupEqlFn>(key, mix_hash(LookupHash(key)));
     }
 
     void maybe_remove(const K &key) {
@@ -80,44 +119,36 @@ public:
 
     void remove(const K &key) {
         _modification_count += 1;
-        int start_index = key_to_index(key);
-        for (int roll_over = 0; roll_over <= _max_distance_from_start_index; roll_over += 1) {
-            int index = (start_index + roll_over) % _capacity;
-            Entry *entry = &_entries[index];
-
-            if (!entry->used)
-                zig_panic("key not found");
-
-            if (!EqualFn(entry->key, key))
-                continue;
-
-            for (; roll_over < _capacity; roll_over += 1) {
-                int next_index = (start_index + roll_over + 1) % _capacity;
-                Entry *next_entry = &_entries[next_index];
-                if (!next_entry->used || next_entry->distance_from_start_index == 0) {
-                    entry->used = false;
-                    _size -= 1;
-                    return;
-                }
-                *entry = *next_entry;
-                entry->distance_from_start_index -= 1;
-                entry = next_entry;
-            }
-            zig_panic("shifting everything in the table");
+        Entry *entry = internal_get(key, hash_key(key));
+        if (!entry)
+            zig_panic("key not found");
+
+        int index = (int)(entry - _entries);
+        int group_start = index & ~(group_width - 1);
+        // a lookup stops at the first group which has an empty slot, so if
+        // this group already has one no probe sequence goes through it and the
+        // slot can become empty again instead of a tombstone.
+        if (match_empty(&_ctrl[group_start])) {
+            _ctrl[index] = ctrl_empty;
+        } else {
+            _ctrl[index] = ctrl_deleted;
+            _deleted_count += 1;
         }
-        zig_panic("key not found");
+        _size -= 1;
     }
 
     class Iterator {
     public:
         Entry *next() {
+#ifndef NDEBUG
             if (_inital_modification_count != _table->_modification_count)
                 zig_panic("concurrent modification");
+#endif
             if (_count >= _table->size())
                 return NULL;
             for (; _index < _table->_capacity; _index += 1) {
-                Entry *entry = &_table->_entries[_index];
-                if (entry->used) {
+                if (is_full(_table->_ctrl[_index])) {
+                    Entry *entry = &_table->_entries[_index];
                     _index += 1;
                     _count += 1;
                     return entry;
@@ -145,89 +176,175 @@ public:
     }
 
 private:
+    static HashMapStats stats;
+
+    static const int group_width = 16;
+    static const uint8_t ctrl_empty = 0x80;
+    static const uint8_t ctrl_deleted = 0xfe;
 
     Entry *_entries;
+    uint8_t *_ctrl;
     int _capacity;
     int _size;
-    int _max_distance_from_start_index;
+    int _deleted_count;
     // this is used to detect bugs where a hashtable is edited while an iterator is running.
     uint32_t _modification_count = 0;
 
-    void init_capacity(int capacity) {
-        _capacity = capacity;
-        _entries = allocate<Entry>(_capacity);
-        _size = 0;
-        _max_distance_from_start_index = 0;
-        for (int i = 0; i < _capacity; i += 1) {
-            _entries[i].used = false;
-        }
+    // the group index comes from the low bits and the control byte from the
+    // high bits, so spread weak hashes (such as int_hash) over both
+    static uint32_t hash_key(const K &key) {
+        return mix_hash(HashFunction(key));
     }
 
-    void internal_put(K key, V value) {
-        int start_index = key_to_index(key);
-        for (int roll_over = 0, distance_from_start_index = 0;
-                roll_over < _capacity; roll_over += 1, distance_from_start_index += 1)
-        {
-            int index = (start_index + roll_over) % _capacity;
-            Entry *entry = &_entries[index];
-
-            if (entry->used && !EqualFn(entry->key, key)) {
-                if (entry->distance_from_start_index < distance_from_start_index) {
-                    // robin hood to the rescue
-                    Entry tmp = *entry;
-                    if (distance_from_start_index > _max_distance_from_start_index)
-                        _max_distance_from_start_index = distance_from_start_index;
-                    *entry = {
-                        true,
-                        distance_from_start_index,
-                        key,
-                        value,
-                    };
-                    key = tmp.key;
-                    value = tmp.value;
-                    distance_from_start_index = tmp.distance_from_start_index;
-                }
-                continue;
-            }
+    static uint32_t mix_hash(uint32_t hash) {
+        hash ^= hash >> 16;
+        hash *= 0x85ebca6b;
+        hash ^= hash >> 13;
+        return hash;
+    }
 
-            if (!entry->used) {
-                // adding an entry. otherwise overwriting old value with
-                // same key
-                _size += 1;
-            }
+    static bool is_full(uint8_t ctrl) {
+        return (ctrl & 0x80) == 0;
+    }
 
-            if (distance_from_start_index > _max_distance_from_start_index)
-                _max_distance_from_start_index = distance_from_start_index;
-            *entry = {
-                true,
-                distance_from_start_index,
-                key,
-                value,
-            };
-            return;
+    static uint8_t hash_to_ctrl(uint32_t hash) {
+        return (uint8_t)(hash >> 25);
+    }
+
+    // bit i of the result is set when ctrl[i] == value
+    static uint32_t match_byte(const uint8_t *ctrl, uint8_t value) {
+#if defined(__SSE2__)
+        __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ctrl));
+        return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)value)));
+#else
+        uint32_t mask = 0;
+        for (int i = 0; i < group_width; i += 1) {
+            if (ctrl[i] == value)
+                mask |= ((uint32_t)1) << i;
         }
-        zig_panic("put into a full HashMap");
+        return mask;
+#endif
     }
 
+    static uint32_t match_empty(const uint8_t *ctrl) {
+        return match_byte(ctrl, ctrl_empty);
+    }
 
-    Entry *internal_get(const K &key) const {
-        int start_index = key_to_index(key);
-        for (int roll_over = 0; roll_over <= _max_distance_from_start_index; roll_over += 1) {
-            int index = (start_index + roll_over) % _capacity;
-            Entry *entry = &_entries[index];
+    // empty or deleted
+    static uint32_t match_free(const uint8_t *ctrl) {
+#if defined(__SSE2__)
+        __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ctrl));
+        return (uint32_t)_mm_movemask_epi8(group);
+#else
+        uint32_t mask = 0;
+        for (int i = 0; i < group_width; i += 1) {
+            if (!is_full(ctrl[i]))
+                mask |= ((uint32_t)1) << i;
+        }
+        return mask;
+#endif
+    }
 
-            if (!entry->used)
-                return NULL;
+    static int round_up_capacity(int capacity) {
+        int result = group_width;
+        while (result < capacity) {
+            result *= 2;
+        }
+        return result;
+    }
+
+    void init_capacity(int capacity) {
+        _capacity = round_up_capacity(capacity);
+        _entries = allocate_nonzero<Entry>(_capacity, AllocCategoryHashMap);
+        _ctrl = allocate_nonzero<uint8_t>(_capacity, AllocCategoryHashMap);
+        memset(_ctrl, ctrl_empty, _capacity);
+        _size = 0;
+        _deleted_count = 0;
+    }
 
-            if (EqualFn(entry->key, key))
-                return entry;
+    void resize(int new_capacity) {
+        Entry *old_entries = _entries;
+        uint8_t *old_ctrl = _ctrl;
+        int old_capacity = _capacity;
+        init_capacity(new_capacity);
+        // dump all of the old elements into the new table, reusing the cached hashes
+        for (int i = 0; i < old_capacity; i += 1) {
+            if (is_full(old_ctrl[i])) {
+                Entry *old_entry = &old_entries[i];
+                internal_put(old_entry->key, old_entry->value, old_entry->hash);
+            }
+        }
+        deallocate(old_entries, old_capacity, AllocCategoryHashMap);
+        deallocate(old_ctrl, old_capacity, AllocCategoryHashMap);
+    }
+
+    // the caller has checked that the key is not already present and that
+    // there is a free slot
+    void internal_put(const K &key, const V &value, uint32_t hash) {
+        int group_mask = (_capacity / group_width) - 1;
+        int group = (int)hash & group_mask;
+        for (int probe = 1;; probe += 1) {
+            int group_start = group * group_width;
+            uint32_t free_mask = match_free(&_ctrl[group_start]);
+            if (free_mask) {
+                int index = group_start + __builtin_ctz(free_mask);
+                if (_ctrl[index] == ctrl_deleted)
+                    _deleted_count -= 1;
+                _ctrl[index] = hash_to_ctrl(hash);
+                Entry *entry = &_entries[index];
+                entry->key = key;
+                entry->value = value;
+                entry->hash = hash;
+                _size += 1;
+                return;
+            }
+            if (probe > group_mask)
+                zig_panic("put into a full HashMap");
+            group = (group + probe) & group_mask;
         }
-        return NULL;
     }
 
-    int key_to_index(const K &key) const {
-        return (int)(HashFunction(key) % ((uint32_t)_capacity));
+    Entry *internal_get(const K &key, uint32_t hash) const {
+        return find<K, EqualFn>(key, hash);
+    }
+
+    template<typename L, bool (*LookupEqlFn)(K a, L b)>
+    Entry *find(const L &key, uint32_t hash) const {
+        uint8_t ctrl = hash_to_ctrl(hash);
+        int group_mask = (_capacity / group_width) - 1;
+        int group = (int)hash & group_mask;
+        // triangular probing visits every group once
+        int probe;
+        Entry *result = NULL;
+        for (probe = 1; probe <= group_mask + 1; probe += 1) {
+            int group_start = group * group_width;
+            uint32_t match_mask = match_byte(&_ctrl[group_start], ctrl);
+            while (match_mask) {
+                int index = group_start + __builtin_ctz(match_mask);
+                Entry *entry = &_entries[index];
+                if (entry->hash == hash && LookupEqlFn(entry->key, key)) {
+                    result = entry;
+                    goto done;
+                }
+                match_mask &= match_mask - 1;
+            }
+            if (match_empty(&_ctrl[group_start]))
+                goto done;
+            group = (group + probe) & group_mask;
+        }
+        probe -= 1;
+    done:
+        // maps of the same instantiation are used from several threads
+        if (stats_enabled) {
+            __atomic_fetch_add(&stats.lookups, 1, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&stats.probe_histogram[min(probe, HASH_MAP_PROBE_BUCKETS) - 1], 1,
+                    __ATOMIC_RELAXED);
+        }
+        return result;
     }
 };
 
+template<typename K, typename V, uint32_t (*HashFunction)(K key), bool (*EqualFn)(K a, K b)>
+HashMapStats HashMap<K, V, HashFunction, EqualFn>::stats;
+
 #endif
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2015 Andrew Kelley
+ *
+ * This file is part of zig, which is MIT licensed.
+ * See http://opensource.org/licenses/MIT
+ */
+
+#include "intern.hpp"
+#include "arena.hpp"
+
+#include <pthread.h>
+
+struct InternEntry {
+    Buf buf; // must be first; intern_id casts back from the Buf
+    uint32_t id;
+    uint32_t hash;
+};
+
+static Arena intern_arena = {nullptr, 0, 0, AllocCategoryBufs};
+static ZigList<InternEntry *> intern_entries;
+static InternEntry **intern_slots;
+static uint32_t intern_slot_count;
+static pthread_mutex_t intern_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void intern_grow(void) {
+    uint32_t new_slot_count = intern_slot_count ? intern_slot_count * 2 : 1024;
+    InternEntry **new_slots = allocate<InternEntry *>(new_slot_count);
+    uint32_t mask = new_slot_count - 1;
+    for (int i = 0; i < intern_entries.length; i += 1) {
+        InternEntry *entry = intern_entries.at(i);
+        uint32_t index = entry->hash & mask;
+        while (new_slots[index]) {
+            index = (index + 1) & mask;
+        }
+        new_slots[index] = entry;
+    }
+    deallocate(intern_slots, intern_slot_count);
+    intern_slots = new_slots;
+    intern_slot_count = new_slot_count;
+}
+
+Buf *intern_view(BufView view) {
+    const char *ptr = view.ptr;
+    int len = view.len;
+    uint32_t hash = buf_view_hash(view);
+
+    pthread_mutex_lock(&intern_mutex);
+    if ((uint32_t)(intern_entries.length + 1) * 2 > intern_slot_count) {
+        intern_grow();
+    }
+
+    uint32_t mask = intern_slot_count - 1;
+    uint32_t index = hash & mask;
+    for (;;) {
+        InternEntry *entry = intern_slots[index];
+        if (!entry) {
+            break;
+        }
+        if (entry->hash == hash && buf_len(&entry->buf) == len &&
+            memcmp(buf_ptr(&entry->buf), ptr, len) == 0)
+        {
+            pthread_mutex_unlock(&intern_mutex);
+            return &entry->buf;
+        }
+        index = (index + 1) & mask;
+    }
+
+    InternEntry *entry = arena_allocate<InternEntry>(&intern_arena, 1);
+    char *chars = arena_allocate<char>(&intern_arena, len + 1);
+    memcpy(chars, ptr, len);
+    entry->buf.list.items = chars;
+    entry->buf.list.length = len + 1;
+    entry->buf.list.capacity = len + 1;
+    entry->id = intern_entries.length;
+    entry->hash = hash;
+    intern_entries.append(entry);
+    intern_slots[index] = entry;
+    pthread_mutex_unlock(&intern_mutex);
+    return &entry->buf;
+}
+
+Buf *intern_mem(const char *ptr, int len) {
+    return intern_view(buf_view_mem(ptr, len));
+}
+
+Buf *intern_str(const char *str) {
+    return intern_view(buf_view_str(str));
+}
+
+Buf *intern_buf(Buf *buf) {
+    return intern_view(buf_view(buf));
+}
+
+uint32_t intern_id(Buf *name) {
+    InternEntry *entry = reinterpret_cast<InternEntry *>(name);
+    return entry->id;
+}
+
+int intern_count(void) {
+    pthread_mutex_lock(&intern_mutex);
+    int count = intern_entries.length;
+    pthread_mutex_unlock(&intern_mutex);
+    return count;
+}
+
+uint32_t intern_hash(Buf *name) {
+    InternEntry *entry = reinterpret_cast<InternEntry *>(name);
+    return entry->hash;
+}
+
+bool intern_eql(Buf *a, Buf *b) {
+    return a == b;
+}
@@ -0,0 +1,32 @@
+/*
+ * Copyright (c) 2015 Andrew Kelley
+ *
+ * This file is part of zig, which is MIT licensed.
+ * See http://opensource.org/licenses/MIT
+ */
+
+#ifndef ZIG_INTERN_HPP
+#define ZIG_INTERN_HPP
+
+#include "buffer.hpp"
+
+// Compiler-wide identifier table. Every distinct name is stored exactly once
+// and gets a 32-bit id, so two interned names are equal if and only if they
+// are the same pointer. Interned buffers are immutable and live until exit.
+// Interning is thread safe. Files are parsed on several threads at once, so
+// ids depend on scheduling; don't let them decide the order of anything.
+
+Buf *intern_view(BufView view);
+Buf *intern_mem(const char *ptr, int len);
+Buf *intern_str(const char *str);
+Buf *intern_buf(Buf *buf);
+
+uint32_t intern_id(Buf *name);
+int intern_count(void);
+
+// for tables keyed by interned names. this is a hash of the characters, not
+// of the id, so that iterating over such a table is deterministic.
+uint32_t intern_hash(Buf *name);
+bool intern_eql(Buf *a, Buf *b);
+
+#endif
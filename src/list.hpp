@@ -15,7 +15,7 @@
 template<typename T>
 struct ZigList {
     void deinit() {
-        free(items);
+        deallocate(items, capacity);
     }
     void append(T item) {
         ensure_capacity(length + 1);
@@ -67,16 +67,140 @@ struct ZigList {
         while (better_capacity < new_capacity)
             better_capacity = better_capacity * 2;
         if (better_capacity != capacity) {
-            items = reallocate_nonzero(items, better_capacity);
+            items = reallocate_nonzero(items, capacity, better_capacity);
             capacity = better_capacity;
         }
     }
 
+    // allocate room for exactly new_capacity items, for when the final
+    // length is known up front
+    void reserve(int new_capacity) {
+        if (new_capacity > capacity) {
+            items = reallocate_nonzero(items, capacity, new_capacity);
+            capacity = new_capacity;
+        }
+    }
+
+    void shrink_to_fit() {
+        if (length == capacity)
+            return;
+        if (length == 0) {
+            deallocate(items, capacity);
+            items = nullptr;
+        } else {
+            items = reallocate_nonzero(items, capacity, length);
+        }
+        capacity = length;
+    }
+
     T * items;
     int length;
     int capacity;
 };
 
+// Like ZigList, but the first N items are stored inline and the heap is only
+// used once the list grows past that. Meant for lists which are almost always
+// short, such as call arguments. Items are moved with memcpy, so T must be
+// trivially copyable, and ptr() is invalidated by any change in length.
+// A zero initialized SmallList is ready to use.
+template<typename T, int N>
+struct SmallList {
+    void deinit() {
+        deallocate(heap_items, heap_capacity);
+    }
+    void append(T item) {
+        ensure_capacity(length + 1);
+        ptr()[length++] = item;
+    }
+    const T & at(int index) const {
+        assert(index >= 0);
+        assert(index < length);
+        return ptr()[index];
+    }
+    T & at(int index) {
+        assert(index >= 0);
+        assert(index < length);
+        return ptr()[index];
+    }
+    T pop() {
+        assert(length >= 1);
+        return ptr()[--length];
+    }
+
+    const T & last() const {
+        assert(length >= 1);
+        return ptr()[length - 1];
+    }
+
+    T & last() {
+        assert(length >= 1);
+        return ptr()[length - 1];
+    }
+
+    void resize(int new_length) {
+        assert(new_length >= 0);
+        ensure_capacity(new_length);
+        length = new_length;
+    }
+
+    void clear() {
+        length = 0;
+    }
+
+    T *ptr() {
+        return heap_items ? heap_items : inline_items;
+    }
+
+    const T *ptr() const {
+        return heap_items ? heap_items : inline_items;
+    }
+
+    int capacity() const {
+        return heap_items ? heap_capacity : N;
+    }
+
+    void ensure_capacity(int new_capacity) {
+        if (new_capacity <= capacity())
+            return;
+        int better_capacity = max(capacity() * 2, 8);
+        while (better_capacity < new_capacity)
+            better_capacity = better_capacity * 2;
+        reserve(better_capacity);
+    }
+
+    void reserve(int new_capacity) {
+        if (new_capacity <= capacity())
+            return;
+        if (heap_items) {
+            heap_items = reallocate_nonzero(heap_items, heap_capacity, new_capacity);
+        } else {
+            heap_items = allocate_nonzero<T>(new_capacity);
+            memcpy(heap_items, inline_items, length * sizeof(T));
+        }
+        heap_capacity = new_capacity;
+    }
+
+    // moves the items back inline if they fit
+    void shrink_to_fit() {
+        if (!heap_items || length == heap_capacity)
+            return;
+        if (length <= N) {
+            memcpy(inline_items, heap_items, length * sizeof(T));
+            deallocate(heap_items, heap_capacity);
+            heap_items = nullptr;
+            heap_capacity = 0;
+        } else {
+            heap_items = reallocate_nonzero(heap_items, heap_capacity, length);
+            heap_capacity = length;
+        }
+    }
+
+    T *heap_items; // null while the items are inline
+    int length;
+    int heap_capacity;
+    T inline_items[N];
+};
+
 #endif
 
 
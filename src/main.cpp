@@ -14,6 +14,7 @@
 #include "ast_render.hpp"
 
 #include <stdio.h>
+#include <errno.h>
 
 static int usage(const char *arg0) {
     fprintf(stderr, "Usage: %s [command] [options]\n"
@@ -34,6 +35,12 @@ static int usage(const char *arg0) {
         "  -isystem [dir]         add additional search path for other .h files\n"
         "  -dirafter [dir]        same as -isystem but do it last\n"
         "  --c-import-warnings    enable warnings when importing .h files\n"
+        "  --stats [text|json]    print memory and object statistics to stderr\n"
+        "  --time-report          print time spent in each compiler stage to stderr\n"
+        "  --trace-out [file]     write a Chrome trace format timeline of the build\n"
+        "  --threads [count]      number of threads to use, defaults to the CPU count\n"
+        "  --cache                cache parsed files in $XDG_CACHE_HOME/zig\n"
+        "  --cache-dir [path]     cache parsed files in path\n"
     , arg0);
     return EXIT_FAILURE;
 }
@@ -55,6 +62,13 @@ struct Build {
     ErrColor color;
     const char *libc_path;
     ZigList<const char *> clang_argv;
+    bool stats;
+    StatsFormat stats_format;
+    bool time_report;
+    const char *trace_out;
+    int thread_count;
+    const char *cache_dir;
+    bool cache;
 };
 
 static int build(const char *arg0, int argc, char **argv) {
@@ -72,6 +86,10 @@ static int build(const char *arg0, int argc, char **argv) {
                 b.is_static = true;
             } else if (strcmp(arg, "--verbose") == 0) {
                 b.verbose = true;
+            } else if (strcmp(arg, "--time-report") == 0) {
+                b.time_report = true;
+            } else if (strcmp(arg, "--cache") == 0) {
+                b.cache = true;
             } else if (i + 1 >= argc) {
                 return usage(arg0);
             } else {
@@ -100,8 +118,27 @@ static int build(const char *arg0, int argc, char **argv) {
                     } else {
                         return usage(arg0);
                     }
+                } else if (strcmp(arg, "--stats") == 0) {
+                    b.stats = true;
+                    if (strcmp(argv[i], "text") == 0) {
+                        b.stats_format = StatsFormatText;
+                    } else if (strcmp(argv[i], "json") == 0) {
+                        b.stats_format = StatsFormatJson;
+                    } else {
+                        return usage(arg0);
+                    }
                 } else if (strcmp(arg, "--name") == 0) {
                     b.out_name = argv[i];
+                } else if (strcmp(arg, "--trace-out") == 0) {
+                    b.trace_out = argv[i];
+                } else if (strcmp(arg, "--threads") == 0) {
+                    b.thread_count = atoi(argv[i]);
+                    if (b.thread_count < 1) {
+                        return usage(arg0);
+                    }
+                } else if (strcmp(arg, "--cache-dir") == 0) {
+                    b.cache_dir = argv[i];
+                    b.cache = true;
                 } else if (strcmp(arg, "--libc-path") == 0) {
                     b.libc_path = argv[i];
                 } else if (strcmp(arg, "-isystem") == 0) {
@@ -128,18 +165,18 @@ static int build(const char *arg0, int argc, char **argv) {
     buf_init_from_str(&in_file_buf, b.in_file);
 
     Buf root_source_dir = BUF_INIT;
-    Buf root_source_code = BUF_INIT;
+    OsMappedFile root_source_file = {};
     Buf root_source_name = BUF_INIT;
     if (buf_eql_str(&in_file_buf, "-")) {
         os_get_cwd(&root_source_dir);
-        if ((err = os_fetch_file(stdin, &root_source_code))) {
+        if ((err = os_map_fd(fileno(stdin), &root_source_file))) {
             fprintf(stderr, "unable to read stdin: %s\n", err_str(err));
             return 1;
         }
         buf_init_from_str(&root_source_name, "");
     } else {
         os_path_split(&in_file_buf, &root_source_dir, &root_source_name);
-        if ((err = os_fetch_file_path(buf_create_from_str(b.in_file), &root_source_code))) {
+        if ((err = os_map_file(&in_file_buf, &root_source_file))) {
             fprintf(stderr, "unable to open '%s': %s\n", b.in_file, err_str(err));
             return 1;
         }
@@ -157,9 +194,49 @@ static int build(const char *arg0, int argc, char **argv) {
     if (b.libc_path)
         codegen_set_libc_path(g, buf_create_from_str(b.libc_path));
     codegen_set_verbose(g, b.verbose);
+    codegen_set_time_report(g, b.time_report);
+    if (b.stats)
+        codegen_set_stats(g, b.stats_format);
+    if (b.thread_count)
+        codegen_set_thread_count(g, b.thread_count);
+    if (b.cache) {
+        Buf cache_dir = BUF_INIT;
+        if (b.cache_dir) {
+            buf_init_from_str(&cache_dir, b.cache_dir);
+        } else if ((err = os_get_user_cache_dir(&cache_dir))) {
+            fprintf(stderr, "unable to find the user cache directory: %s\n", err_str(err));
+            return 1;
+        } else {
+            buf_append_str(&cache_dir, "/zig");
+        }
+        if ((err = codegen_set_cache_dir(g, &cache_dir))) {
+            fprintf(stderr, "unable to identify the compiler for the cache: %s\n", err_str(err));
+            return 1;
+        }
+        buf_deinit(&cache_dir);
+    }
+    FILE *trace_file = nullptr;
+    if (b.trace_out) {
+        trace_file = fopen(b.trace_out, "wb");
+        if (!trace_file) {
+            fprintf(stderr, "unable to open '%s': %s\n", b.trace_out, strerror(errno));
+            return 1;
+        }
+        codegen_set_trace_out(g, trace_file);
+    }
     codegen_set_errmsg_color(g, b.color);
-    codegen_add_root_code(g, &root_source_dir, &root_source_name, &root_source_code);
+    codegen_add_root_code(g, &root_source_dir, &root_source_name, &root_source_file.contents);
     codegen_link(g, b.out_file);
+    if (b.stats) {
+        codegen_print_stats(g, stderr, b.stats_format);
+    }
+    if (trace_file) {
+        codegen_finish_trace(g);
+        fclose(trace_file);
+    }
+    if (b.time_report) {
+        codegen_print_time_report(g, stderr);
+    }
 
     return 0;
 }
@@ -215,13 +292,15 @@ static int parseh(const char *arg0, int argc, char **argv) {
     clang_argv.append(in_file);
 
     Buf *libc_include_path = buf_alloc();
-    os_path_join(buf_create_from_str(ZIG_LIBC_DIR), buf_create_from_str("include"), libc_include_path);
+    os_path_join(buf_view_str(ZIG_LIBC_DIR), buf_view_str("include"), libc_include_path);
     clang_argv.append("-isystem");
     clang_argv.append(buf_ptr(libc_include_path));
 
     ImportTableEntry import = {0};
+    import.ast_arena.category = AllocCategoryAst;
     ZigList<ErrorMsg *> errors = {0};
-    int err = parse_h_file(&import, &errors, &clang_argv, warnings_on);
+    uint32_t next_node_index = 0;
+    int err = parse_h_file(&import, &errors, &clang_argv, warnings_on, &next_node_index);
 
     if (err) {
         fprintf(stderr, "unable to parse .h file: %s\n", err_str(err));
@@ -13,9 +13,12 @@
 #include <errno.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <sys/wait.h>
+#include <sys/resource.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <time.h>
 
 void os_spawn_process(const char *exe, ZigList<const char *> &args, bool detached) {
     pid_t pid = fork();
@@ -39,12 +42,14 @@ void os_spawn_process(const char *exe, ZigList<const char *> &args, bool detache
 }
 
 static int read_all_fd_stream(int fd, Buf *out_buf) {
-    static const ssize_t buf_size = 0x2000;
-    buf_resize(out_buf, buf_size);
+    static const ssize_t min_read_size = 0x2000;
+    buf_resize(out_buf, min_read_size);
     ssize_t actual_buf_len = 0;
     for (;;) {
-        ssize_t amt_read = read(fd, buf_ptr(out_buf), buf_len(out_buf));
+        ssize_t amt_read = read(fd, buf_ptr(out_buf) + actual_buf_len, buf_len(out_buf) - actual_buf_len);
         if (amt_read < 0) {
+            if (errno == EINTR)
+                continue;
             return ErrorFileSystem;
         }
         actual_buf_len += amt_read;
@@ -53,11 +58,34 @@ static int read_all_fd_stream(int fd, Buf *out_buf) {
             return 0;
         }
 
-        buf_resize(out_buf, actual_buf_len + buf_size);
+        // grow by doubling so that the number of reads stays logarithmic
+        if (buf_len(out_buf) - actual_buf_len < min_read_size) {
+            buf_resize(out_buf, buf_len(out_buf) * 2);
+        }
     }
     zig_unreachable();
 }
 
+static int open_errno_to_error(int open_errno) {
+    switch (open_errno) {
+        case EACCES:
+            return ErrorAccess;
+        case EINTR:
+            return ErrorInterrupted;
+        case EINVAL:
+            zig_unreachable();
+        case ENFILE:
+        case EMFILE:
+        case ENOMEM:
+            return ErrorSystemResources;
+        case ENOENT:
+        case ENOTDIR:
+            return ErrorFileNotFound;
+        default:
+            return ErrorFileSystem;
+    }
+}
+
 void os_path_split(Buf *full_path, Buf *out_dirname, Buf *out_basename) {
     int last_index = buf_len(full_path) - 1;
     if (last_index >= 0 && buf_ptr(full_path)[last_index] == '/') {
@@ -75,12 +103,11 @@ void os_path_split(Buf *full_path, Buf *out_dirname, Buf *out_basename) {
     buf_init_from_buf(out_basename, full_path);
 }
 
-void os_path_join(Buf *dirname, Buf *basename, Buf *out_full_path) {
-    buf_init_from_buf(out_full_path, dirname);
-    uint8_t c = *(buf_ptr(out_full_path) + buf_len(out_full_path) - 1);
-    if (c != '/')
+void os_path_join(BufView dirname, BufView basename, Buf *out_full_path) {
+    buf_init_from_view(out_full_path, dirname);
+    if (dirname.len == 0 || dirname.ptr[dirname.len - 1] != '/')
         buf_append_char(out_full_path, '/');
-    buf_append_buf(out_full_path, basename);
+    buf_append_view(out_full_path, basename);
 }
 
 int os_path_real(Buf *rel_path, Buf *out_abs_path) {
@@ -169,29 +196,78 @@ int os_fetch_file(FILE *f, Buf *out_contents) {
 }
 
 int os_fetch_file_path(Buf *full_path, Buf *out_contents) {
-    FILE *f = fopen(buf_ptr(full_path), "rb");
-    if (!f) {
-        switch (errno) {
-            case EACCES:
-                return ErrorAccess;
-            case EINTR:
-                return ErrorInterrupted;
-            case EINVAL:
-                zig_unreachable();
-            case ENFILE:
-            case ENOMEM:
-                return ErrorSystemResources;
-            case ENOENT:
-                return ErrorFileNotFound;
-            default:
-                return ErrorFileSystem;
+    int fd = open(buf_ptr(full_path), O_RDONLY|O_CLOEXEC);
+    if (fd == -1)
+        return open_errno_to_error(errno);
+    int result = read_all_fd_stream(fd, out_contents);
+    close(fd);
+    return result;
+}
+
+int os_map_fd(int fd, OsMappedFile *out_file) {
+    out_file->map_ptr = nullptr;
+    out_file->map_len = 0;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 && st.st_size < INT_MAX) {
+        size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+        size_t file_len = (size_t)st.st_size;
+        size_t map_len = (file_len + 1 + page_size - 1) & ~(page_size - 1);
+        // Reserve the whole range with anonymous zero pages and put the file
+        // over the start of it. The terminating 0 comes from the zero fill
+        // of the file's last page or, when the file ends on a page boundary,
+        // from the page after it.
+        void *ptr = mmap(nullptr, map_len, PROT_READ, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+        if (ptr != MAP_FAILED) {
+            if (mmap(ptr, file_len, PROT_READ, MAP_PRIVATE|MAP_FIXED, fd, 0) != MAP_FAILED) {
+                out_file->map_ptr = ptr;
+                out_file->map_len = map_len;
+                out_file->contents.list.items = (char *)ptr;
+                out_file->contents.list.length = (int)file_len + 1;
+                out_file->contents.list.capacity = (int)file_len + 1;
+                return 0;
+            }
+            munmap(ptr, map_len);
         }
     }
-    int result = os_fetch_file(f, out_contents);
-    fclose(f);
+
+    // pipes, terminals and empty files
+    return read_all_fd_stream(fd, &out_file->contents);
+}
+
+int os_map_file(Buf *full_path, OsMappedFile *out_file) {
+    int fd = open(buf_ptr(full_path), O_RDONLY|O_CLOEXEC);
+    if (fd == -1)
+        return open_errno_to_error(errno);
+    // the mapping outlives the descriptor
+    int result = os_map_fd(fd, out_file);
+    close(fd);
     return result;
 }
 
+void os_unmap_file(OsMappedFile *file) {
+    if (file->map_ptr) {
+        munmap(file->map_ptr, file->map_len);
+        memset(&file->contents, 0, sizeof(Buf));
+        file->map_ptr = nullptr;
+    } else {
+        buf_deinit(&file->contents);
+    }
+}
+
+int os_self_exe_hash(uint64_t *out_hash) {
+    Buf path = BUF_INIT;
+    buf_init_from_str(&path, "/proc/self/exe");
+    OsMappedFile exe_file = {};
+    int err = os_map_file(&path, &exe_file);
+    buf_deinit(&path);
+    if (err)
+        return err;
+    *out_hash = hash_bytes(buf_ptr(&exe_file.contents), buf_len(&exe_file.contents));
+    os_unmap_file(&exe_file);
+    return 0;
+}
+
 int os_get_cwd(Buf *out_cwd) {
     int err = ERANGE;
     buf_resize(out_cwd, 512);
@@ -234,3 +310,95 @@ int os_delete_file(Buf *path) {
         return 0;
     }
 }
+
+int os_make_path(Buf *path) {
+    Buf partial = BUF_INIT;
+    int err = 0;
+    for (int i = 0; i <= buf_len(path); i += 1) {
+        if (i < buf_len(path) && (buf_ptr(path)[i] != '/' || i == 0))
+            continue;
+        buf_init_from_mem(&partial, buf_ptr(path), i);
+        if (mkdir(buf_ptr(&partial), 0777) == -1 && errno != EEXIST) {
+            err = (errno == EACCES) ? ErrorAccess : ErrorFileSystem;
+            break;
+        }
+    }
+    buf_deinit(&partial);
+    return err;
+}
+
+int os_write_file_atomic(Buf *full_path, Buf *contents) {
+    Buf tmp_path = BUF_INIT;
+    buf_init_from_buf(&tmp_path, full_path);
+    buf_append_str(&tmp_path, ".XXXXXX");
+
+    int err = 0;
+    int fd = mkstemp(buf_ptr(&tmp_path));
+    if (fd == -1) {
+        err = (errno == EACCES) ? ErrorAccess : ErrorFileSystem;
+    } else {
+        ssize_t amt_written = write(fd, buf_ptr(contents), buf_len(contents));
+        if (close(fd) == -1 || amt_written != buf_len(contents) ||
+            rename(buf_ptr(&tmp_path), buf_ptr(full_path)) == -1)
+        {
+            remove(buf_ptr(&tmp_path));
+            err = ErrorFileSystem;
+        }
+    }
+    buf_deinit(&tmp_path);
+    return err;
+}
+
+int os_get_user_cache_dir(Buf *out_path) {
+    const char *xdg_cache_home = getenv("XDG_CACHE_HOME");
+    if (xdg_cache_home && xdg_cache_home[0] == '/') {
+        buf_init_from_str(out_path, xdg_cache_home);
+        return 0;
+    }
+    const char *home = getenv("HOME");
+    if (!home || home[0] != '/')
+        return ErrorFileNotFound;
+    buf_init_from_str(out_path, home);
+    buf_append_str(out_path, "/.cache");
+    return 0;
+}
+
+size_t os_get_peak_rss(void) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+    // linux reports kilobytes
+    return ((size_t)usage.ru_maxrss) * 1024;
+}
+
+double os_get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static double timeval_seconds(struct timeval tv) {
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+double os_get_cpu_time(void) {
+    // children are included so that the time spent in ld shows up
+    double result = 0.0;
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        result += timeval_seconds(usage.ru_utime) + timeval_seconds(usage.ru_stime);
+    if (getrusage(RUSAGE_CHILDREN, &usage) == 0)
+        result += timeval_seconds(usage.ru_utime) + timeval_seconds(usage.ru_stime);
+    return result;
+}
+
+double os_get_thread_cpu_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+int os_get_cpu_count(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (count > 0) ? (int)count : 1;
+}
@@ -18,7 +18,7 @@ void os_exec_process(const char *exe, ZigList<const char *> &args,
         int *return_code, Buf *out_stderr, Buf *out_stdout);
 
 void os_path_split(Buf *full_path, Buf *out_dirname, Buf *out_basename);
-void os_path_join(Buf *dirname, Buf *basename, Buf *out_full_path);
+void os_path_join(BufView dirname, BufView basename, Buf *out_full_path);
 int os_path_real(Buf *rel_path, Buf *out_abs_path);
 
 void os_write_file(Buf *full_path, Buf *contents);
@@ -27,6 +27,24 @@ void os_write_file(Buf *full_path, Buf *contents);
 int os_fetch_file(FILE *file, Buf *out_contents);
 int os_fetch_file_path(Buf *full_path, Buf *out_contents);
 
+// The contents of a file, mapped into memory when it is a regular file and
+// read otherwise. Either way contents is 0 terminated like any Buf, but it is
+// read only and must never be resized.
+struct OsMappedFile {
+    Buf contents;
+    // null when the file was read
+    void *map_ptr;
+    size_t map_len;
+};
+
+int os_map_file(Buf *full_path, OsMappedFile *out_file);
+int os_map_fd(int fd, OsMappedFile *out_file);
+void os_unmap_file(OsMappedFile *file);
+
+// a hash of the contents of the running executable, which tells apart any
+// two builds of the compiler
+int os_self_exe_hash(uint64_t *out_hash);
+
 int os_get_cwd(Buf *out_cwd);
 
 bool os_stderr_tty(void);
@@ -34,4 +52,26 @@ bool os_stderr_tty(void);
 int os_buf_to_tmp_file(Buf *contents, Buf *suffix, Buf *out_tmp_path);
 int os_delete_file(Buf *path);
 
+// creates the directory and any missing parents
+int os_make_path(Buf *path);
+// Writes a temporary file next to full_path and renames it into place, so
+// that other processes see either the old file or the whole new one.
+int os_write_file_atomic(Buf *full_path, Buf *contents);
+// $XDG_CACHE_HOME, or ~/.cache if that is not set
+int os_get_user_cache_dir(Buf *out_path);
+
+// bytes, or 0 if the platform cannot tell us
+size_t os_get_peak_rss(void);
+
+// seconds since an arbitrary point, for measuring intervals
+double os_get_time(void);
+// seconds of user and system time used by this process and by the child
+// processes it has waited for
+double os_get_cpu_time(void);
+// seconds of user and system time used by the calling thread
+double os_get_thread_cpu_time(void);
+
+// the number of processors online, at least 1
+int os_get_cpu_count(void);
+
 #endif
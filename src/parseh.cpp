@@ -29,6 +29,7 @@ struct Context {
     HashMap<Buf *, bool, buf_hash, buf_eql_buf> type_table;
     HashMap<Buf *, bool, buf_hash, buf_eql_buf> fn_table;
     SourceManager *source_manager;
+    uint32_t *next_node_index;
 };
 
 __attribute__ ((format (printf, 3, 4)))
@@ -60,33 +61,37 @@ static void emit_warning(Context *c, const Decl *decl, const char *format, ...)
 static AstNode *make_qual_type_node(Context *c, QualType qt, Decl *decl);
 
 static AstNode *create_node(Context *c, NodeType type) {
-    AstNode *node = allocate<AstNode>(1);
+    AstNode *node = arena_allocate<AstNode>(&c->import->ast_arena, 1);
     node->type = type;
     node->owner = c->import;
+    node->create_index = *c->next_node_index;
+    *c->next_node_index += 1;
     return node;
 }
 
 static AstNode *simple_type_node(Context *c, const char *type_name) {
     AstNode *node = create_node(c, NodeTypeSymbol);
-    buf_init_from_str(&node->data.symbol_expr.symbol, type_name);
+    node->data.symbol_expr.symbol = intern_str(type_name);
     return node;
 }
 
-static const char *decl_name(const Decl *decl) {
+// points into clang's identifier table, which lives as long as the ASTUnit
+static BufView decl_name_view(const Decl *decl) {
     const NamedDecl *named_decl = static_cast<const NamedDecl *>(decl);
-    return (const char *)named_decl->getName().bytes_begin();
+    StringRef name = named_decl->getName();
+    return buf_view_mem(name.data(), (int)name.size());
 }
 
 static ZigList<AstNode *> *create_empty_directives(Context *c) {
-    return allocate<ZigList<AstNode*>>(1);
+    return arena_allocate<ZigList<AstNode*>>(&c->import->ast_arena, 1);
 }
 
-static AstNode *create_typedef_node(Context *c, Buf *new_name, AstNode *target_node) {
+static AstNode *create_typedef_node(Context *c, BufView new_name, AstNode *target_node) {
     if (!target_node) {
         return nullptr;
     }
     AstNode *node = create_node(c, NodeTypeVariableDeclaration);
-    buf_init_from_buf(&node->data.variable_declaration.symbol, new_name);
+    node->data.variable_declaration.symbol = intern_view(new_name);
     node->data.variable_declaration.is_const = true;
     node->data.variable_declaration.visib_mod = c->visib_mod;
     node->data.variable_declaration.expr = target_node;
@@ -99,10 +104,10 @@ static AstNode *create_typedef_node(Context *c, Buf *new_name, AstNode *target_n
 
 static AstNode *convert_to_c_void(Context *c, AstNode *type_node) {
     if (type_node->type == NodeTypeSymbol &&
-        buf_eql_str(&type_node->data.symbol_expr.symbol, "void"))
+        buf_eql_str(type_node->data.symbol_expr.symbol, "void"))
     {
         if (!c->c_void_decl_node) {
-            c->c_void_decl_node = create_typedef_node(c, buf_create_from_str("c_void"),
+            c->c_void_decl_node = create_typedef_node(c, buf_view_str("c_void"),
                     simple_type_node(c, "u8"));
             assert(c->c_void_decl_node);
         }
@@ -202,31 +207,31 @@ static AstNode *make_type_node(Context *c, const Type *ty, Decl *decl) {
             {
                 const TypedefType *typedef_ty = static_cast<const TypedefType*>(ty);
                 const TypedefNameDecl *typedef_decl = typedef_ty->getDecl();
-                Buf *type_name = buf_create_from_str(decl_name(typedef_decl));
-                if (buf_eql_str(type_name, "uint8_t")) {
+                BufView type_name = decl_name_view(typedef_decl);
+                if (buf_view_eql_str(type_name, "uint8_t")) {
                     return simple_type_node(c, "u8");
-                } else if (buf_eql_str(type_name, "int8_t")) {
+                } else if (buf_view_eql_str(type_name, "int8_t")) {
                     return simple_type_node(c, "i8");
-                } else if (buf_eql_str(type_name, "uint16_t")) {
+                } else if (buf_view_eql_str(type_name, "uint16_t")) {
                     return simple_type_node(c, "u16");
-                } else if (buf_eql_str(type_name, "int16_t")) {
+                } else if (buf_view_eql_str(type_name, "int16_t")) {
                     return simple_type_node(c, "i16");
-                } else if (buf_eql_str(type_name, "uint32_t")) {
+                } else if (buf_view_eql_str(type_name, "uint32_t")) {
                     return simple_type_node(c, "u32");
-                } else if (buf_eql_str(type_name, "int32_t")) {
+                } else if (buf_view_eql_str(type_name, "int32_t")) {
                     return simple_type_node(c, "i32");
-                } else if (buf_eql_str(type_name, "uint64_t")) {
+                } else if (buf_view_eql_str(type_name, "uint64_t")) {
                     return simple_type_node(c, "u64");
-                } else if (buf_eql_str(type_name, "int64_t")) {
+                } else if (buf_view_eql_str(type_name, "int64_t")) {
                     return simple_type_node(c, "i64");
-                } else if (buf_eql_str(type_name, "intptr_t")) {
+                } else if (buf_view_eql_str(type_name, "intptr_t")) {
                     return simple_type_node(c, "isize");
-                } else if (buf_eql_str(type_name, "uintptr_t")) {
+                } else if (buf_view_eql_str(type_name, "uintptr_t")) {
                     return simple_type_node(c, "usize");
                 } else {
-                    auto entry = c->type_table.maybe_get(type_name);
+                    auto entry = c->type_table.maybe_get_by<BufView, buf_view_hash, buf_eql_view>(type_name);
                     if (entry) {
-                        return simple_type_node(c, buf_ptr(type_name));
+                        return simple_type_node(c, buf_ptr(entry->key));
                     } else {
                         return nullptr;
                     }
@@ -286,9 +291,9 @@ static AstNode *make_qual_type_node(Context *c, QualType qt, Decl *decl) {
 
 static void visit_fn_decl(Context *c, const FunctionDecl *fn_decl) {
     AstNode *node = create_node(c, NodeTypeFnProto);
-    buf_init_from_str(&node->data.fn_proto.name, decl_name(fn_decl));
+    node->data.fn_proto.name = intern_view(decl_name_view(fn_decl));
 
-    auto fn_entry = c->fn_table.maybe_get(&node->data.fn_proto.name);
+    auto fn_entry = c->fn_table.maybe_get(node->data.fn_proto.name);
     if (fn_entry) {
         // we already saw this function
         return;
@@ -304,11 +309,12 @@ static void visit_fn_decl(Context *c, const FunctionDecl *fn_decl) {
     for (int i = 0; i < arg_count; i += 1) {
         const ParmVarDecl *param = fn_decl->getParamDecl(i);
         AstNode *param_decl_node = create_node(c, NodeTypeParamDecl);
-        const char *name = decl_name(param);
-        if (strlen(name) == 0) {
-            name = buf_ptr(buf_sprintf("arg%d", i));
+        BufView name = decl_name_view(param);
+        if (name.len == 0) {
+            param_decl_node->data.param_decl.name = intern_buf(buf_sprintf("arg%d", i));
+        } else {
+            param_decl_node->data.param_decl.name = intern_view(name);
         }
-        buf_init_from_str(&param_decl_node->data.param_decl.name, name);
         QualType qt = param->getOriginalType();
         param_decl_node->data.param_decl.is_noalias = qt.isRestrictQualified();
         param_decl_node->data.param_decl.type = make_qual_type_node(c, qt, (Decl*)fn_decl);
@@ -332,30 +338,30 @@ static void visit_fn_decl(Context *c, const FunctionDecl *fn_decl) {
     }
     if (!all_ok) {
         // not all the types could be resolved, so we give up on the function decl
-        emit_warning(c, (Decl*)fn_decl, "skipping function %s\n", buf_ptr(&node->data.fn_proto.name));
+        emit_warning(c, (Decl*)fn_decl, "skipping function %s\n", buf_ptr(node->data.fn_proto.name));
         return;
     }
 
     normalize_parent_ptrs(node);
 
-    c->fn_table.put(&node->data.fn_proto.name, true);
+    c->fn_table.put(node->data.fn_proto.name, true);
     c->root->data.root.top_level_decls.append(node);
 }
 
 static void visit_typedef_decl(Context *c, const TypedefNameDecl *typedef_decl) {
     QualType child_qt = typedef_decl->getUnderlyingType();
-    Buf *type_name = buf_create_from_str(decl_name(typedef_decl));
-
-    if (buf_eql_str(type_name, "uint8_t") ||
-        buf_eql_str(type_name, "int8_t") ||
-        buf_eql_str(type_name, "uint16_t") ||
-        buf_eql_str(type_name, "int16_t") ||
-        buf_eql_str(type_name, "uint32_t") ||
-        buf_eql_str(type_name, "int32_t") ||
-        buf_eql_str(type_name, "uint64_t") ||
-        buf_eql_str(type_name, "int64_t") ||
-        buf_eql_str(type_name, "intptr_t") ||
-        buf_eql_str(type_name, "uintptr_t"))
+    BufView type_name = decl_name_view(typedef_decl);
+
+    if (buf_view_eql_str(type_name, "uint8_t") ||
+        buf_view_eql_str(type_name, "int8_t") ||
+        buf_view_eql_str(type_name, "uint16_t") ||
+        buf_view_eql_str(type_name, "int16_t") ||
+        buf_view_eql_str(type_name, "uint32_t") ||
+        buf_view_eql_str(type_name, "int32_t") ||
+        buf_view_eql_str(type_name, "uint64_t") ||
+        buf_view_eql_str(type_name, "int64_t") ||
+        buf_view_eql_str(type_name, "intptr_t") ||
+        buf_view_eql_str(type_name, "uintptr_t"))
     {
         // special case we can just use the builtin types
         return;
@@ -365,7 +371,7 @@ static void visit_typedef_decl(Context *c, const TypedefNameDecl *typedef_decl)
 
     if (node) {
         normalize_parent_ptrs(node);
-        c->type_table.put(type_name, true);
+        c->type_table.put(buf_create_from_view(type_name), true);
     }
 }
 
@@ -387,7 +393,8 @@ static bool decl_visitor(void *context, const Decl *decl) {
 }
 
 int parse_h_buf(ImportTableEntry *import, ZigList<ErrorMsg *> *errors, Buf *source,
-        const char **args, int args_len, const char *libc_include_path, bool warnings_on)
+        const char **args, int args_len, const char *libc_include_path, bool warnings_on,
+        uint32_t *next_node_index)
 {
     int err;
     Buf tmp_file_path = BUF_INIT;
@@ -404,7 +411,7 @@ int parse_h_buf(ImportTableEntry *import, ZigList<ErrorMsg *> *errors, Buf *sour
         clang_argv.append(args[i]);
     }
 
-    err = parse_h_file(import, errors, &clang_argv, warnings_on);
+    err = parse_h_file(import, errors, &clang_argv, warnings_on, next_node_index);
 
     os_delete_file(&tmp_file_path);
 
@@ -412,13 +419,14 @@ int parse_h_buf(ImportTableEntry *import, ZigList<ErrorMsg *> *errors, Buf *sour
 }
 
 int parse_h_file(ImportTableEntry *import, ZigList<ErrorMsg *> *errors,
-        ZigList<const char *> *clang_argv, bool warnings_on)
+        ZigList<const char *> *clang_argv, bool warnings_on, uint32_t *next_node_index)
 {
     Context context = {0};
     Context *c = &context;
     c->warnings_on = warnings_on;
     c->import = import;
     c->errors = errors;
+    c->next_node_index = next_node_index;
     c->visib_mod = VisibModPub;
     c->type_table.init(32);
     c->fn_table.init(32);
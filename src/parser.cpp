@@ -13,17 +13,35 @@
 #include <stdio.h>
 #include <limits.h>
 #include <errno.h>
+#include <setjmp.h>
 
 struct ParseContext {
     Buf *buf;
     AstNode *root;
     ZigList<Token> *tokens;
+    ZigList<NumberLiteralInfo> *number_literals;
     ImportTableEntry *owner;
+    // the line of the last token whose position was looked up
+    int line_cursor;
     ErrColor err_color;
     bool parsed_root_export;
     uint32_t *next_node_index;
+    // when set, a syntax error is stored in *err_out and parsing stops by
+    // jumping here, instead of printing the error and exiting
+    jmp_buf *err_jmp;
+    ErrorMsg **err_out;
 };
 
+__attribute__ ((noreturn))
+static void ast_fail(ParseContext *pc, ErrorMsg *err) {
+    if (pc->err_jmp) {
+        *pc->err_out = err;
+        longjmp(*pc->err_jmp, 1);
+    }
+    print_err_msg(err, pc->err_color);
+    exit(EXIT_FAILURE);
+}
+
 __attribute__ ((format (printf, 4, 5)))
 __attribute__ ((noreturn))
 static void ast_asm_error(ParseContext *pc, AstNode *node, int offset, const char *format, ...) {
@@ -40,8 +58,37 @@ static void ast_asm_error(ParseContext *pc, AstNode *node, int offset, const cha
     ErrorMsg *err = err_msg_create_with_line(pc->owner->path, pos.line, pos.column,
             pc->owner->source_code, pc->owner->line_offsets, msg);
 
-    print_err_msg(err, pc->err_color);
-    exit(EXIT_FAILURE);
+    ast_fail(pc, err);
+}
+
+// nodes are created in roughly source order, so the line is usually the one
+// from the previous lookup or just after it; otherwise binary search
+static SrcPos ast_token_src_pos(ParseContext *pc, Token *token) {
+    ZigList<int> *line_offsets = pc->owner->line_offsets;
+    int pos = token->start_pos;
+    int line = pc->line_cursor;
+    for (int i = 0; i < 4; i += 1) {
+        if (line + 1 == line_offsets->length || line_offsets->at(line + 1) > pos)
+            break;
+        line += 1;
+    }
+    bool on_line = line_offsets->at(line) <= pos &&
+        (line + 1 == line_offsets->length || line_offsets->at(line + 1) > pos);
+    if (!on_line) {
+        int low = 0;
+        int high = line_offsets->length - 1;
+        while (low < high) {
+            int mid = low + (high - low + 1) / 2;
+            if (line_offsets->at(mid) <= pos) {
+                low = mid;
+            } else {
+                high = mid - 1;
+            }
+        }
+        line = low;
+    }
+    pc->line_cursor = line;
+    return {line, pos - line_offsets->at(line)};
 }
 
 __attribute__ ((format (printf, 3, 4)))
@@ -52,18 +99,17 @@ static void ast_error(ParseContext *pc, Token *token, const char *format, ...) {
     Buf *msg = buf_vprintf(format, ap);
     va_end(ap);
 
-
-    ErrorMsg *err = err_msg_create_with_line(pc->owner->path, token->start_line, token->start_column,
+    SrcPos pos = ast_token_src_pos(pc, token);
+    ErrorMsg *err = err_msg_create_with_line(pc->owner->path, pos.line, pos.column,
             pc->owner->source_code, pc->owner->line_offsets, msg);
-    err->line_start = token->start_line;
-    err->column_start = token->start_column;
+    err->line_start = pos.line;
+    err->column_start = pos.column;
 
-    print_err_msg(err, pc->err_color);
-    exit(EXIT_FAILURE);
+    ast_fail(pc, err);
 }
 
 static AstNode *ast_create_node_no_line_info(ParseContext *pc, NodeType type) {
-    AstNode *node = allocate<AstNode>(1);
+    AstNode *node = arena_allocate<AstNode>(&pc->owner->ast_arena, 1);
     node->type = type;
     node->owner = pc->owner;
     node->create_index = *pc->next_node_index;
@@ -71,14 +117,11 @@ static AstNode *ast_create_node_no_line_info(ParseContext *pc, NodeType type) {
     return node;
 }
 
-static void ast_update_node_line_info(AstNode *node, Token *first_token) {
-    node->line = first_token->start_line;
-    node->column = first_token->start_column;
-}
-
 static AstNode *ast_create_node(ParseContext *pc, NodeType type, Token *first_token) {
     AstNode *node = ast_create_node_no_line_info(pc, type);
-    ast_update_node_line_info(node, first_token);
+    SrcPos pos = ast_token_src_pos(pc, first_token);
+    node->line = pos.line;
+    node->column = pos.column;
     return node;
 }
 
@@ -91,12 +134,16 @@ static AstNode *ast_create_node_with_node(ParseContext *pc, NodeType type, AstNo
 
 static AstNode *ast_create_void_type_node(ParseContext *pc, Token *token) {
     AstNode *node = ast_create_node(pc, NodeTypeSymbol, token);
-    buf_init_from_str(&node->data.symbol_expr.symbol, "void");
+    node->data.symbol_expr.symbol = intern_str("void");
     return node;
 }
 
-static void ast_buf_from_token(ParseContext *pc, Token *token, Buf *buf) {
-    buf_init_from_mem(buf, buf_ptr(pc->buf) + token->start_pos, token->end_pos - token->start_pos);
+static BufView ast_token_view(ParseContext *pc, Token *token) {
+    return buf_view_slice(pc->buf, token->start_pos, token->end_pos);
+}
+
+static Buf *ast_intern_token(ParseContext *pc, Token *token) {
+    return intern_view(ast_token_view(pc, token));
 }
 
 static void parse_asm_template(ParseContext *pc, AstNode *node) {
@@ -241,7 +288,7 @@ static void parse_string_literal(ParseContext *pc, Token *token, Buf *buf, bool
     buf_resize(buf, 0);
     bool escape = false;
     bool skip_quote;
-    SrcPos pos = {token->start_line, token->start_column};
+    SrcPos pos = ast_token_src_pos(pc, token);
     for (int i = token->start_pos; i < token->end_pos - 1; i += 1) {
         uint8_t c = *((uint8_t*)buf_ptr(pc->buf) + i);
         if (i == token->start_pos) {
@@ -325,26 +372,44 @@ static unsigned long long parse_int_digits(ParseContext *pc, int digits_start, i
     return x;
 }
 
+static NumberLiteralInfo *ast_number_literal_info(ParseContext *pc, Token *token) {
+    int token_index = (int)(token - pc->tokens->items);
+    int low = 0;
+    int high = pc->number_literals->length - 1;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (pc->number_literals->at(mid).token_index < token_index) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    NumberLiteralInfo *info = &pc->number_literals->at(low);
+    assert(info->token_index == token_index);
+    return info;
+}
+
 static void parse_number_literal(ParseContext *pc, Token *token, AstNodeNumberLiteral *num_lit) {
     assert(token->id == TokenIdNumberLiteral);
+    NumberLiteralInfo *info = ast_number_literal_info(pc, token);
 
     int whole_number_start = token->start_pos;
-    if (token->radix != 10) {
+    if (info->radix != 10) {
         // skip the "0x"
         whole_number_start += 2;
     }
 
-    int whole_number_end = token->decimal_point_pos;
+    int whole_number_end = info->decimal_point_pos;
     if (whole_number_end <= whole_number_start) {
         // TODO: error for empty whole number part
         num_lit->overflow = true;
         return;
     }
 
-    if (token->decimal_point_pos == token->end_pos) {
+    if (info->decimal_point_pos == token->end_pos) {
         // integer
         unsigned long long whole_number = parse_int_digits(pc, whole_number_start, whole_number_end,
-            token->radix, -1, &num_lit->overflow);
+            info->radix, -1, &num_lit->overflow);
         if (num_lit->overflow) return;
 
         num_lit->data.x_uint = whole_number;
@@ -352,7 +417,7 @@ static void parse_number_literal(ParseContext *pc, Token *token, AstNodeNumberLi
     } else {
         // float
 
-        if (token->radix == 10) {
+        if (info->radix == 10) {
             // use a third-party base-10 float parser
             char *str_begin = buf_ptr(pc->buf) + whole_number_start;
             char *str_end;
@@ -369,10 +434,10 @@ static void parse_number_literal(ParseContext *pc, Token *token, AstNodeNumberLi
             return;
         }
 
-        if (token->decimal_point_pos < token->exponent_marker_pos) {
+        if (info->decimal_point_pos < info->exponent_marker_pos) {
             // fraction
-            int fraction_start = token->decimal_point_pos + 1;
-            int fraction_end = token->exponent_marker_pos;
+            int fraction_start = info->decimal_point_pos + 1;
+            int fraction_end = info->exponent_marker_pos;
             if (fraction_end <= fraction_start) {
                 // TODO: error for empty fraction part
                 num_lit->overflow = true;
@@ -382,17 +447,17 @@ static void parse_number_literal(ParseContext *pc, Token *token, AstNodeNumberLi
 
         // trim leading and trailing zeros in the significand digit sequence
         int significand_start = whole_number_start;
-        for (; significand_start < token->exponent_marker_pos; significand_start++) {
-            if (significand_start == token->decimal_point_pos)
+        for (; significand_start < info->exponent_marker_pos; significand_start++) {
+            if (significand_start == info->decimal_point_pos)
                 continue;
             uint8_t c = *((uint8_t*)buf_ptr(pc->buf) + significand_start);
             if (c != '0')
                 break;
         }
-        int significand_end = token->exponent_marker_pos;
+        int significand_end = info->exponent_marker_pos;
         for (; significand_end - 1 > significand_start; significand_end--) {
-            if (significand_end - 1 <= token->decimal_point_pos) {
-                significand_end = token->decimal_point_pos;
+            if (significand_end - 1 <= info->decimal_point_pos) {
+                significand_end = info->decimal_point_pos;
                 break;
             }
             uint8_t c = *((uint8_t*)buf_ptr(pc->buf) + significand_end - 1);
@@ -401,26 +466,26 @@ static void parse_number_literal(ParseContext *pc, Token *token, AstNodeNumberLi
         }
 
         unsigned long long significand_as_int = parse_int_digits(pc, significand_start, significand_end,
-            token->radix, token->decimal_point_pos, &num_lit->overflow);
+            info->radix, info->decimal_point_pos, &num_lit->overflow);
         if (num_lit->overflow) return;
 
         int exponent_in_bin_or_dec = 0;
-        if (significand_end > token->decimal_point_pos) {
-            exponent_in_bin_or_dec = token->decimal_point_pos + 1 - significand_end;
-            if (token->radix == 2) {
+        if (significand_end > info->decimal_point_pos) {
+            exponent_in_bin_or_dec = info->decimal_point_pos + 1 - significand_end;
+            if (info->radix == 2) {
                 // already good
-            } else if (token->radix == 8) {
+            } else if (info->radix == 8) {
                 exponent_in_bin_or_dec *= 3;
-            } else if (token->radix == 10) {
+            } else if (info->radix == 10) {
                 // already good
-            } else if (token->radix == 16) {
+            } else if (info->radix == 16) {
                 exponent_in_bin_or_dec *= 4;
             } else zig_unreachable();
         }
 
-        if (token->exponent_marker_pos < token->end_pos) {
+        if (info->exponent_marker_pos < token->end_pos) {
             // exponent
-            int exponent_start = token->exponent_marker_pos + 1;
+            int exponent_start = info->exponent_marker_pos + 1;
             int exponent_end = token->end_pos;
             if (exponent_end <= exponent_start) {
                 // TODO: error for empty exponent part
@@ -461,7 +526,7 @@ static void parse_number_literal(ParseContext *pc, Token *token, AstNodeNumberLi
         uint64_t exponent_bits;
         if (significand_as_int != 0) {
             // normalize the significand
-            if (token->radix == 10) {
+            if (info->radix == 10) {
                 zig_panic("TODO: decimal floats");
             } else {
                 int significand_magnitude_in_bin = __builtin_clzll(1) - __builtin_clzll(significand_as_int);
@@ -492,9 +557,8 @@ static void parse_number_literal(ParseContext *pc, Token *token, AstNodeNumberLi
 
 __attribute__ ((noreturn))
 static void ast_invalid_token_error(ParseContext *pc, Token *token) {
-    Buf token_value = BUF_INIT;
-    ast_buf_from_token(pc, token, &token_value);
-    ast_error(pc, token, "invalid token: '%s'", buf_ptr(&token_value));
+    BufView token_value = ast_token_view(pc, token);
+    ast_error(pc, token, "invalid token: '%.*s'", token_value.len, token_value.ptr);
 }
 
 static AstNode *ast_parse_expression(ParseContext *pc, int *token_index, bool mandatory);
@@ -509,8 +573,6 @@ static void ast_expect_token(ParseContext *pc, Token *token, TokenId token_id) {
         return;
     }
 
-    Buf token_value = BUF_INIT;
-    ast_buf_from_token(pc, token, &token_value);
     ast_error(pc, token, "expected token '%s', found '%s'", token_name(token_id), token_name(token->id));
 }
 
@@ -533,7 +595,7 @@ static AstNode *ast_parse_directive(ParseContext *pc, int *token_index) {
     *token_index += 1;
     ast_expect_token(pc, name_symbol, TokenIdSymbol);
 
-    ast_buf_from_token(pc, name_symbol, &node->data.directive.name);
+    node->data.directive.name = ast_intern_token(pc, name_symbol);
 
     Token *l_paren = &pc->tokens->at(*token_index);
     *token_index += 1;
@@ -593,7 +655,7 @@ static AstNode *ast_parse_param_decl(ParseContext *pc, int *token_index) {
         ast_invalid_token_error(pc, first_token);
     }
 
-    ast_buf_from_token(pc, name_token, &node->data.param_decl.name);
+    node->data.param_decl.name = ast_intern_token(pc, name_token);
 
     Token *colon = &pc->tokens->at(*token_index);
     *token_index += 1;
@@ -607,7 +669,7 @@ static AstNode *ast_parse_param_decl(ParseContext *pc, int *token_index) {
 
 
 static void ast_parse_param_decl_list(ParseContext *pc, int *token_index,
-        ZigList<AstNode *> *params, bool *is_var_args)
+        SmallList<AstNode *, 3> *params, bool *is_var_args)
 {
     *is_var_args = false;
 
@@ -644,7 +706,9 @@ static void ast_parse_param_decl_list(ParseContext *pc, int *token_index,
     zig_unreachable();
 }
 
-static void ast_parse_fn_call_param_list(ParseContext *pc, int *token_index, ZigList<AstNode*> *params) {
+static void ast_parse_fn_call_param_list(ParseContext *pc, int *token_index,
+        SmallList<AstNode *, 4> *params)
+{
     Token *token = &pc->tokens->at(*token_index);
     if (token->id == TokenIdRParen) {
         *token_index += 1;
@@ -736,8 +800,8 @@ static void ast_parse_asm_input_item(ParseContext *pc, int *token_index, AstNode
     AstNode *expr_node = ast_parse_expression(pc, token_index, true);
     ast_eat_token(pc, token_index, TokenIdRParen);
 
-    AsmInput *asm_input = allocate<AsmInput>(1);
-    ast_buf_from_token(pc, alias, &asm_input->asm_symbolic_name);
+    AsmInput *asm_input = arena_allocate<AsmInput>(&pc->owner->ast_arena, 1);
+    asm_input->asm_symbolic_name = ast_intern_token(pc, alias);
     parse_string_literal(pc, constraint, &asm_input->constraint, nullptr, nullptr);
     asm_input->expr = expr_node;
     node->data.asm_expr.input_list.append(asm_input);
@@ -753,14 +817,14 @@ static void ast_parse_asm_output_item(ParseContext *pc, int *token_index, AstNod
 
     Token *constraint = ast_eat_token(pc, token_index, TokenIdStringLiteral);
 
-    AsmOutput *asm_output = allocate<AsmOutput>(1);
+    AsmOutput *asm_output = arena_allocate<AsmOutput>(&pc->owner->ast_arena, 1);
 
     ast_eat_token(pc, token_index, TokenIdLParen);
 
     Token *token = &pc->tokens->at(*token_index);
     *token_index += 1;
     if (token->id == TokenIdSymbol) {
-        ast_buf_from_token(pc, token, &asm_output->variable_name);
+        asm_output->variable_name = ast_intern_token(pc, token);
     } else if (token->id == TokenIdArrow) {
         asm_output->return_type = ast_parse_prefix_op_expr(pc, token_index, true);
     } else {
@@ -769,7 +833,7 @@ static void ast_parse_asm_output_item(ParseContext *pc, int *token_index, AstNod
 
     ast_eat_token(pc, token_index, TokenIdRParen);
 
-    ast_buf_from_token(pc, alias, &asm_output->asm_symbolic_name);
+    asm_output->asm_symbolic_name = ast_intern_token(pc, alias);
     parse_string_literal(pc, constraint, &asm_output->constraint, nullptr, nullptr);
     node->data.asm_expr.output_list.append(asm_output);
 }
@@ -962,7 +1026,7 @@ static AstNode *ast_parse_primary_expr(ParseContext *pc, int *token_index, bool
         *token_index += 1;
         Token *name_tok = ast_eat_token(pc, token_index, TokenIdSymbol);
         AstNode *name_node = ast_create_node(pc, NodeTypeSymbol, name_tok);
-        ast_buf_from_token(pc, name_tok, &name_node->data.symbol_expr.symbol);
+        name_node->data.symbol_expr.symbol = ast_intern_token(pc, name_tok);
 
         AstNode *node = ast_create_node(pc, NodeTypeFnCallExpr, token);
         node->data.fn_call_expr.fn_ref_expr = name_node;
@@ -975,7 +1039,7 @@ static AstNode *ast_parse_primary_expr(ParseContext *pc, int *token_index, bool
     } else if (token->id == TokenIdSymbol) {
         *token_index += 1;
         AstNode *node = ast_create_node(pc, NodeTypeSymbol, token);
-        ast_buf_from_token(pc, token, &node->data.symbol_expr.symbol);
+        node->data.symbol_expr.symbol = ast_intern_token(pc, token);
         return node;
     } else if (token->id == TokenIdKeywordGoto) {
         AstNode *node = ast_create_node(pc, NodeTypeGoto, token);
@@ -985,7 +1049,7 @@ static AstNode *ast_parse_primary_expr(ParseContext *pc, int *token_index, bool
         *token_index += 1;
         ast_expect_token(pc, dest_symbol, TokenIdSymbol);
 
-        ast_buf_from_token(pc, dest_symbol, &node->data.goto_expr.name);
+        node->data.goto_expr.name = ast_intern_token(pc, dest_symbol);
         return node;
     }
 
@@ -1045,7 +1109,7 @@ static AstNode *ast_parse_curly_suffix_expr(ParseContext *pc, int *token_index,
 
                         AstNode *field_node = ast_create_node(pc, NodeTypeStructValueField, token);
 
-                        ast_buf_from_token(pc, field_name_tok, &field_node->data.struct_val_field.name);
+                        field_node->data.struct_val_field.name = ast_intern_token(pc, field_name_tok);
                         field_node->data.struct_val_field.expr = ast_parse_expression(pc, token_index, true);
 
                         normalize_parent_ptrs(field_node);
@@ -1172,7 +1236,7 @@ static AstNode *ast_parse_suffix_op_expr(ParseContext *pc, int *token_index, boo
 
             AstNode *node = ast_create_node(pc, NodeTypeFieldAccessExpr, first_token);
             node->data.field_access_expr.struct_expr = primary_expr;
-            ast_buf_from_token(pc, name_token, &node->data.field_access_expr.field_name);
+            node->data.field_access_expr.field_name = ast_intern_token(pc, name_token);
 
             normalize_parent_ptrs(node);
             primary_expr = node;
@@ -1239,314 +1303,115 @@ static AstNode *ast_parse_prefix_op_expr(ParseContext *pc, int *token_index, boo
 }
 
 
-static BinOpType tok_to_mult_op(Token *token) {
-    switch (token->id) {
-        case TokenIdStar: return BinOpTypeMult;
-        case TokenIdSlash: return BinOpTypeDiv;
-        case TokenIdPercent: return BinOpTypeMod;
-        default: return BinOpTypeInvalid;
-    }
-}
-
-/*
-MultiplyOperator : token(Star) | token(Slash) | token(Percent)
-*/
-static BinOpType ast_parse_mult_op(ParseContext *pc, int *token_index, bool mandatory) {
-    Token *token = &pc->tokens->at(*token_index);
-    BinOpType result = tok_to_mult_op(token);
-    if (result == BinOpTypeInvalid) {
-        if (mandatory) {
-            ast_invalid_token_error(pc, token);
-        } else {
-            return BinOpTypeInvalid;
-        }
-    }
-    *token_index += 1;
-    return result;
-}
-
-/*
-MultiplyExpression : CurlySuffixExpression MultiplyOperator MultiplyExpression | CurlySuffixExpression
-*/
-static AstNode *ast_parse_mult_expr(ParseContext *pc, int *token_index, bool mandatory) {
-    AstNode *operand_1 = ast_parse_curly_suffix_expr(pc, token_index, mandatory);
-    if (!operand_1)
-        return nullptr;
-
-    while (true) {
-        Token *token = &pc->tokens->at(*token_index);
-        BinOpType mult_op = ast_parse_mult_op(pc, token_index, false);
-        if (mult_op == BinOpTypeInvalid)
-            return operand_1;
-
-        AstNode *operand_2 = ast_parse_curly_suffix_expr(pc, token_index, true);
-
-        AstNode *node = ast_create_node(pc, NodeTypeBinOpExpr, token);
-        node->data.bin_op_expr.op1 = operand_1;
-        node->data.bin_op_expr.bin_op = mult_op;
-        node->data.bin_op_expr.op2 = operand_2;
-
-        normalize_parent_ptrs(node);
-        operand_1 = node;
-    }
-}
-
-static BinOpType tok_to_add_op(Token *token) {
-    switch (token->id) {
-        case TokenIdPlus: return BinOpTypeAdd;
-        case TokenIdDash: return BinOpTypeSub;
-        case TokenIdPlusPlus: return BinOpTypeStrCat;
-        default: return BinOpTypeInvalid;
-    }
-}
-
-/*
-AdditionOperator : "+" | "-" | "++"
-*/
-static BinOpType ast_parse_add_op(ParseContext *pc, int *token_index, bool mandatory) {
-    Token *token = &pc->tokens->at(*token_index);
-    BinOpType result = tok_to_add_op(token);
-    if (result == BinOpTypeInvalid) {
-        if (mandatory) {
-            ast_invalid_token_error(pc, token);
-        } else {
-            return BinOpTypeInvalid;
-        }
-    }
-    *token_index += 1;
-    return result;
-}
-
-/*
-AdditionExpression : MultiplyExpression AdditionOperator AdditionExpression | MultiplyExpression
-*/
-static AstNode *ast_parse_add_expr(ParseContext *pc, int *token_index, bool mandatory) {
-    AstNode *operand_1 = ast_parse_mult_expr(pc, token_index, mandatory);
-    if (!operand_1)
-        return nullptr;
-
-    while (true) {
-        Token *token = &pc->tokens->at(*token_index);
-        BinOpType add_op = ast_parse_add_op(pc, token_index, false);
-        if (add_op == BinOpTypeInvalid)
-            return operand_1;
-
-        AstNode *operand_2 = ast_parse_mult_expr(pc, token_index, true);
-
-        AstNode *node = ast_create_node(pc, NodeTypeBinOpExpr, token);
-        node->data.bin_op_expr.op1 = operand_1;
-        node->data.bin_op_expr.bin_op = add_op;
-        node->data.bin_op_expr.op2 = operand_2;
-
-        normalize_parent_ptrs(node);
-        operand_1 = node;
-    }
-}
+// binding strength of each binary operator; higher binds tighter. the
+// comparison operators do not associate: a == b == c is a syntax error.
+enum BinOpPrecedence {
+    BinOpPrecedenceNone,
+    BinOpPrecedenceBoolOr,
+    BinOpPrecedenceBoolAnd,
+    BinOpPrecedenceComparison,
+    BinOpPrecedenceBinOr,
+    BinOpPrecedenceBinXor,
+    BinOpPrecedenceBinAnd,
+    BinOpPrecedenceBitShift,
+    BinOpPrecedenceAdd,
+    BinOpPrecedenceMult,
+};
 
-static BinOpType tok_to_bit_shift_op(Token *token) {
+static BinOpPrecedence tok_to_bin_op(Token *token, BinOpType *bin_op) {
     switch (token->id) {
-        case TokenIdBitShiftLeft: return BinOpTypeBitShiftLeft;
-        case TokenIdBitShiftRight: return BinOpTypeBitShiftRight;
-        default: return BinOpTypeInvalid;
-    }
-}
-
-/*
-BitShiftOperator : token(BitShiftLeft) | token(BitShiftRight)
-*/
-static BinOpType ast_parse_bit_shift_op(ParseContext *pc, int *token_index, bool mandatory) {
-    Token *token = &pc->tokens->at(*token_index);
-    BinOpType result = tok_to_bit_shift_op(token);
-    if (result == BinOpTypeInvalid) {
-        if (mandatory) {
-            ast_invalid_token_error(pc, token);
-        } else {
-            return BinOpTypeInvalid;
-        }
-    }
-    *token_index += 1;
-    return result;
-}
-
-/*
-BitShiftExpression : AdditionExpression BitShiftOperator BitShiftExpression | AdditionExpression
-*/
-static AstNode *ast_parse_bit_shift_expr(ParseContext *pc, int *token_index, bool mandatory) {
-    AstNode *operand_1 = ast_parse_add_expr(pc, token_index, mandatory);
-    if (!operand_1)
-        return nullptr;
-
-    while (true) {
-        Token *token = &pc->tokens->at(*token_index);
-        BinOpType bit_shift_op = ast_parse_bit_shift_op(pc, token_index, false);
-        if (bit_shift_op == BinOpTypeInvalid)
-            return operand_1;
-
-        AstNode *operand_2 = ast_parse_add_expr(pc, token_index, true);
-
-        AstNode *node = ast_create_node(pc, NodeTypeBinOpExpr, token);
-        node->data.bin_op_expr.op1 = operand_1;
-        node->data.bin_op_expr.bin_op = bit_shift_op;
-        node->data.bin_op_expr.op2 = operand_2;
-
-        normalize_parent_ptrs(node);
-        operand_1 = node;
-    }
-}
-
-
-/*
-BinaryAndExpression : BitShiftExpression token(Ampersand) BinaryAndExpression | BitShiftExpression
-*/
-static AstNode *ast_parse_bin_and_expr(ParseContext *pc, int *token_index, bool mandatory) {
-    AstNode *operand_1 = ast_parse_bit_shift_expr(pc, token_index, mandatory);
-    if (!operand_1)
-        return nullptr;
-
-    while (true) {
-        Token *token = &pc->tokens->at(*token_index);
-        if (token->id != TokenIdAmpersand)
-            return operand_1;
-        *token_index += 1;
-
-        AstNode *operand_2 = ast_parse_bit_shift_expr(pc, token_index, true);
-
-        AstNode *node = ast_create_node(pc, NodeTypeBinOpExpr, token);
-        node->data.bin_op_expr.op1 = operand_1;
-        node->data.bin_op_expr.bin_op = BinOpTypeBinAnd;
-        node->data.bin_op_expr.op2 = operand_2;
-
-        normalize_parent_ptrs(node);
-        operand_1 = node;
-    }
-}
-
-/*
-BinaryXorExpression : BinaryAndExpression token(BinXor) BinaryXorExpression | BinaryAndExpression
-*/
-static AstNode *ast_parse_bin_xor_expr(ParseContext *pc, int *token_index, bool mandatory) {
-    AstNode *operand_1 = ast_parse_bin_and_expr(pc, token_index, mandatory);
-    if (!operand_1)
-        return nullptr;
-
-    while (true) {
-        Token *token = &pc->tokens->at(*token_index);
-        if (token->id != TokenIdBinXor)
-            return operand_1;
-        *token_index += 1;
-
-        AstNode *operand_2 = ast_parse_bin_and_expr(pc, token_index, true);
-
-        AstNode *node = ast_create_node(pc, NodeTypeBinOpExpr, token);
-        node->data.bin_op_expr.op1 = operand_1;
-        node->data.bin_op_expr.bin_op = BinOpTypeBinXor;
-        node->data.bin_op_expr.op2 = operand_2;
-
-        normalize_parent_ptrs(node);
-        operand_1 = node;
-    }
-}
-
-/*
-BinaryOrExpression : BinaryXorExpression token(BinOr) BinaryOrExpression | BinaryXorExpression
-*/
-static AstNode *ast_parse_bin_or_expr(ParseContext *pc, int *token_index, bool mandatory) {
-    AstNode *operand_1 = ast_parse_bin_xor_expr(pc, token_index, mandatory);
-    if (!operand_1)
-        return nullptr;
-
+        case TokenIdBoolOr: *bin_op = BinOpTypeBoolOr; return BinOpPrecedenceBoolOr;
+        case TokenIdBoolAnd: *bin_op = BinOpTypeBoolAnd; return BinOpPrecedenceBoolAnd;
+        case TokenIdCmpEq: *bin_op = BinOpTypeCmpEq; return BinOpPrecedenceComparison;
+        case TokenIdCmpNotEq: *bin_op = BinOpTypeCmpNotEq; return BinOpPrecedenceComparison;
+        case TokenIdCmpLessThan: *bin_op = BinOpTypeCmpLessThan; return BinOpPrecedenceComparison;
+        case TokenIdCmpGreaterThan: *bin_op = BinOpTypeCmpGreaterThan; return BinOpPrecedenceComparison;
+        case TokenIdCmpLessOrEq: *bin_op = BinOpTypeCmpLessOrEq; return BinOpPrecedenceComparison;
+        case TokenIdCmpGreaterOrEq: *bin_op = BinOpTypeCmpGreaterOrEq; return BinOpPrecedenceComparison;
+        case TokenIdBinOr: *bin_op = BinOpTypeBinOr; return BinOpPrecedenceBinOr;
+        case TokenIdBinXor: *bin_op = BinOpTypeBinXor; return BinOpPrecedenceBinXor;
+        case TokenIdAmpersand: *bin_op = BinOpTypeBinAnd; return BinOpPrecedenceBinAnd;
+        case TokenIdBitShiftLeft: *bin_op = BinOpTypeBitShiftLeft; return BinOpPrecedenceBitShift;
+        case TokenIdBitShiftRight: *bin_op = BinOpTypeBitShiftRight; return BinOpPrecedenceBitShift;
+        case TokenIdPlus: *bin_op = BinOpTypeAdd; return BinOpPrecedenceAdd;
+        case TokenIdDash: *bin_op = BinOpTypeSub; return BinOpPrecedenceAdd;
+        case TokenIdPlusPlus: *bin_op = BinOpTypeStrCat; return BinOpPrecedenceAdd;
+        case TokenIdStar: *bin_op = BinOpTypeMult; return BinOpPrecedenceMult;
+        case TokenIdSlash: *bin_op = BinOpTypeDiv; return BinOpPrecedenceMult;
+        case TokenIdPercent: *bin_op = BinOpTypeMod; return BinOpPrecedenceMult;
+        default: *bin_op = BinOpTypeInvalid; return BinOpPrecedenceNone;
+    }
+}
+
+// takes operators binding at least as tightly as min_precedence onto lhs.
+// the operands of an operator are parsed by a recursive call only for the
+// tighter operators to their right, so a chain of operators with the same
+// precedence is a loop and the recursion is at most one level per
+// precedence. ends_in_comparison is set when the rightmost operand, since the
+// last && or ||, holds a comparison; a second one may not follow it.
+static AstNode *ast_parse_bin_op_rhs(ParseContext *pc, int *token_index, AstNode *lhs,
+        BinOpPrecedence min_precedence, bool *ends_in_comparison)
+{
+    bool lhs_has_comparison = false;
     while (true) {
         Token *token = &pc->tokens->at(*token_index);
-        if (token->id != TokenIdBinOr)
-            return operand_1;
+        BinOpType bin_op;
+        BinOpPrecedence precedence = tok_to_bin_op(token, &bin_op);
+        if (precedence < min_precedence)
+            break;
+        if (precedence == BinOpPrecedenceComparison && lhs_has_comparison)
+            break;
         *token_index += 1;
 
-        AstNode *operand_2 = ast_parse_bin_xor_expr(pc, token_index, true);
+        AstNode *rhs = ast_parse_curly_suffix_expr(pc, token_index, true);
+        bool rhs_has_comparison = false;
+        if (precedence < BinOpPrecedenceMult) {
+            rhs = ast_parse_bin_op_rhs(pc, token_index, rhs,
+                    (BinOpPrecedence)(precedence + 1), &rhs_has_comparison);
+        }
 
         AstNode *node = ast_create_node(pc, NodeTypeBinOpExpr, token);
-        node->data.bin_op_expr.op1 = operand_1;
-        node->data.bin_op_expr.bin_op = BinOpTypeBinOr;
-        node->data.bin_op_expr.op2 = operand_2;
+        node->data.bin_op_expr.op1 = lhs;
+        node->data.bin_op_expr.bin_op = bin_op;
+        node->data.bin_op_expr.op2 = rhs;
 
         normalize_parent_ptrs(node);
-        operand_1 = node;
-    }
-}
-
-static BinOpType tok_to_cmp_op(Token *token) {
-    switch (token->id) {
-        case TokenIdCmpEq: return BinOpTypeCmpEq;
-        case TokenIdCmpNotEq: return BinOpTypeCmpNotEq;
-        case TokenIdCmpLessThan: return BinOpTypeCmpLessThan;
-        case TokenIdCmpGreaterThan: return BinOpTypeCmpGreaterThan;
-        case TokenIdCmpLessOrEq: return BinOpTypeCmpLessOrEq;
-        case TokenIdCmpGreaterOrEq: return BinOpTypeCmpGreaterOrEq;
-        default: return BinOpTypeInvalid;
-    }
-}
+        lhs = node;
 
-static BinOpType ast_parse_comparison_operator(ParseContext *pc, int *token_index, bool mandatory) {
-    Token *token = &pc->tokens->at(*token_index);
-    BinOpType result = tok_to_cmp_op(token);
-    if (result == BinOpTypeInvalid) {
-        if (mandatory) {
-            ast_invalid_token_error(pc, token);
-        } else {
-            return BinOpTypeInvalid;
+        if (precedence == BinOpPrecedenceComparison) {
+            lhs_has_comparison = true;
+        } else if (precedence < BinOpPrecedenceComparison) {
+            lhs_has_comparison = rhs_has_comparison;
         }
     }
-    *token_index += 1;
-    return result;
+    *ends_in_comparison = lhs_has_comparison;
+    return lhs;
 }
 
 /*
+BoolOrExpression : BoolAndExpression token(BoolOr) BoolOrExpression | BoolAndExpression
+BoolAndExpression : ComparisonExpression token(BoolAnd) BoolAndExpression | ComparisonExpression
 ComparisonExpression : BinaryOrExpression ComparisonOperator BinaryOrExpression | BinaryOrExpression
-*/
-static AstNode *ast_parse_comparison_expr(ParseContext *pc, int *token_index, bool mandatory) {
-    AstNode *operand_1 = ast_parse_bin_or_expr(pc, token_index, mandatory);
-    if (!operand_1)
-        return nullptr;
-
-    Token *token = &pc->tokens->at(*token_index);
-    BinOpType cmp_op = ast_parse_comparison_operator(pc, token_index, false);
-    if (cmp_op == BinOpTypeInvalid)
-        return operand_1;
-
-    AstNode *operand_2 = ast_parse_bin_or_expr(pc, token_index, true);
-
-    AstNode *node = ast_create_node(pc, NodeTypeBinOpExpr, token);
-    node->data.bin_op_expr.op1 = operand_1;
-    node->data.bin_op_expr.bin_op = cmp_op;
-    node->data.bin_op_expr.op2 = operand_2;
-
-    normalize_parent_ptrs(node);
-    return node;
-}
+BinaryOrExpression : BinaryXorExpression token(BinOr) BinaryOrExpression | BinaryXorExpression
+BinaryXorExpression : BinaryAndExpression token(BinXor) BinaryXorExpression | BinaryAndExpression
+BinaryAndExpression : BitShiftExpression token(Ampersand) BinaryAndExpression | BitShiftExpression
+BitShiftExpression : AdditionExpression BitShiftOperator BitShiftExpression | AdditionExpression
+AdditionExpression : MultiplyExpression AdditionOperator AdditionExpression | MultiplyExpression
+MultiplyExpression : CurlySuffixExpression MultiplyOperator MultiplyExpression | CurlySuffixExpression
+BitShiftOperator : token(BitShiftLeft) | token(BitShiftRight)
+AdditionOperator : "+" | "-" | "++"
+MultiplyOperator : token(Star) | token(Slash) | token(Percent)
 
-/*
-BoolAndExpression : ComparisonExpression token(BoolAnd) BoolAndExpression | ComparisonExpression
- */
-static AstNode *ast_parse_bool_and_expr(ParseContext *pc, int *token_index, bool mandatory) {
-    AstNode *operand_1 = ast_parse_comparison_expr(pc, token_index, mandatory);
-    if (!operand_1)
+All of these levels are parsed by precedence climbing rather than one
+function per level. Every operator associates to the left.
+*/
+static AstNode *ast_parse_bool_or_expr(ParseContext *pc, int *token_index, bool mandatory) {
+    AstNode *operand = ast_parse_curly_suffix_expr(pc, token_index, mandatory);
+    if (!operand)
         return nullptr;
 
-    while (true) {
-        Token *token = &pc->tokens->at(*token_index);
-        if (token->id != TokenIdBoolAnd)
-            return operand_1;
-        *token_index += 1;
-
-        AstNode *operand_2 = ast_parse_comparison_expr(pc, token_index, true);
-
-        AstNode *node = ast_create_node(pc, NodeTypeBinOpExpr, token);
-        node->data.bin_op_expr.op1 = operand_1;
-        node->data.bin_op_expr.bin_op = BinOpTypeBoolAnd;
-        node->data.bin_op_expr.op2 = operand_2;
-
-        normalize_parent_ptrs(node);
-        operand_1 = node;
-    }
+    bool ends_in_comparison;
+    return ast_parse_bin_op_rhs(pc, token_index, operand, BinOpPrecedenceBoolOr, &ends_in_comparison);
 }
 
 /*
@@ -1592,7 +1457,7 @@ static AstNode *ast_parse_if_expr(ParseContext *pc, int *token_index, bool manda
         *token_index += 1;
 
         Token *name_token = ast_eat_token(pc, token_index, TokenIdSymbol);
-        ast_buf_from_token(pc, name_token, &node->data.if_var_expr.var_decl.symbol);
+        node->data.if_var_expr.var_decl.symbol = ast_intern_token(pc, name_token);
 
         Token *eq_or_colon = &pc->tokens->at(*token_index);
         if (eq_or_colon->id == TokenIdMaybeAssign) {
@@ -1699,7 +1564,7 @@ static AstNode *ast_parse_variable_declaration_expr(ParseContext *pc, int *token
     node->data.variable_declaration.directives = directives;
 
     Token *name_token = ast_eat_token(pc, token_index, TokenIdSymbol);
-    ast_buf_from_token(pc, name_token, &node->data.variable_declaration.symbol);
+    node->data.variable_declaration.symbol = ast_intern_token(pc, name_token);
 
     Token *eq_or_colon = &pc->tokens->at(*token_index);
     *token_index += 1;
@@ -1724,32 +1589,6 @@ static AstNode *ast_parse_variable_declaration_expr(ParseContext *pc, int *token
     }
 }
 
-/*
-BoolOrExpression : BoolAndExpression token(BoolOr) BoolOrExpression | BoolAndExpression
-*/
-static AstNode *ast_parse_bool_or_expr(ParseContext *pc, int *token_index, bool mandatory) {
-    AstNode *operand_1 = ast_parse_bool_and_expr(pc, token_index, mandatory);
-    if (!operand_1)
-        return nullptr;
-
-    while (true) {
-        Token *token = &pc->tokens->at(*token_index);
-        if (token->id != TokenIdBoolOr)
-            return operand_1;
-        *token_index += 1;
-
-        AstNode *operand_2 = ast_parse_bool_and_expr(pc, token_index, true);
-
-        AstNode *node = ast_create_node(pc, NodeTypeBinOpExpr, token);
-        node->data.bin_op_expr.op1 = operand_1;
-        node->data.bin_op_expr.bin_op = BinOpTypeBoolOr;
-        node->data.bin_op_expr.op2 = operand_2;
-
-        normalize_parent_ptrs(node);
-        operand_1 = node;
-    }
-}
-
 /*
 WhileExpression : token(While) token(LParen) Expression token(RParen) Expression
 */
@@ -1781,7 +1620,7 @@ static AstNode *ast_parse_while_expr(ParseContext *pc, int *token_index, bool ma
 static AstNode *ast_parse_symbol(ParseContext *pc, int *token_index) {
     Token *token = ast_eat_token(pc, token_index, TokenIdSymbol);
     AstNode *node = ast_create_node(pc, NodeTypeSymbol, token);
-    ast_buf_from_token(pc, token, &node->data.symbol_expr.symbol);
+    node->data.symbol_expr.symbol = ast_intern_token(pc, token);
     return node;
 }
 
@@ -2102,7 +1941,7 @@ static AstNode *ast_parse_label(ParseContext *pc, int *token_index, bool mandato
     *token_index += 2;
 
     AstNode *node = ast_create_node(pc, NodeTypeLabel, symbol_token);
-    ast_buf_from_token(pc, symbol_token, &node->data.label.name);
+    node->data.label.name = ast_intern_token(pc, symbol_token);
     return node;
 }
 
@@ -2110,7 +1949,7 @@ static AstNode *ast_create_void_expr(ParseContext *pc, Token *token) {
     AstNode *node = ast_create_node(pc, NodeTypeContainerInitExpr, token);
     node->data.container_init_expr.type = ast_create_node(pc, NodeTypeSymbol, token);
     node->data.container_init_expr.kind = ContainerInitKindArray;
-    buf_init_from_str(&node->data.container_init_expr.type->data.symbol_expr.symbol, "void");
+    node->data.container_init_expr.type->data.symbol_expr.symbol = intern_str("void");
     normalize_parent_ptrs(node);
     return node;
 }
@@ -2203,7 +2042,7 @@ static AstNode *ast_parse_fn_proto(ParseContext *pc, int *token_index, bool mand
     *token_index += 1;
     ast_expect_token(pc, fn_name, TokenIdSymbol);
 
-    ast_buf_from_token(pc, fn_name, &node->data.fn_proto.name);
+    node->data.fn_proto.name = ast_intern_token(pc, fn_name);
 
 
     ast_parse_param_decl_list(pc, token_index, &node->data.fn_proto.params, &node->data.fn_proto.is_var_args);
@@ -2277,7 +2116,7 @@ static AstNode *ast_parse_root_export_decl(ParseContext *pc, int *token_index,
     AstNode *node = ast_create_node(pc, NodeTypeRootExportDecl, export_type);
     node->data.root_export_decl.directives = directives;
 
-    ast_buf_from_token(pc, export_type, &node->data.root_export_decl.type);
+    node->data.root_export_decl.type = ast_intern_token(pc, export_type);
 
     Token *export_name = &pc->tokens->at(*token_index);
     *token_index += 1;
@@ -2362,7 +2201,7 @@ static AstNode *ast_parse_struct_decl(ParseContext *pc, int *token_index,
 
     AstNode *node = ast_create_node(pc, NodeTypeStructDecl, first_token);
     node->data.struct_decl.kind = kind;
-    ast_buf_from_token(pc, struct_name, &node->data.struct_decl.name);
+    node->data.struct_decl.name = ast_intern_token(pc, struct_name);
     node->data.struct_decl.visib_mod = visib_mod;
     node->data.struct_decl.directives = directives;
 
@@ -2370,7 +2209,7 @@ static AstNode *ast_parse_struct_decl(ParseContext *pc, int *token_index,
 
     for (;;) {
         Token *directive_token = &pc->tokens->at(*token_index);
-        ZigList<AstNode *> *directive_list = allocate<ZigList<AstNode*>>(1);
+        ZigList<AstNode *> *directive_list = arena_allocate<ZigList<AstNode*>>(&pc->owner->ast_arena, 1);
         ast_parse_directives(pc, token_index, directive_list);
 
         Token *visib_tok = &pc->tokens->at(*token_index);
@@ -2407,7 +2246,7 @@ static AstNode *ast_parse_struct_decl(ParseContext *pc, int *token_index,
             field_node->data.struct_field.visib_mod = visib_mod;
             field_node->data.struct_field.directives = directive_list;
 
-            ast_buf_from_token(pc, token, &field_node->data.struct_field.name);
+            field_node->data.struct_field.name = ast_intern_token(pc, token);
 
             Token *expr_or_comma = &pc->tokens->at(*token_index);
             if (expr_or_comma->id == TokenIdComma) {
@@ -2449,7 +2288,7 @@ static AstNode *ast_parse_error_value_decl(ParseContext *pc, int *token_index,
     AstNode *node = ast_create_node(pc, NodeTypeErrorValueDecl, first_token);
     node->data.error_value_decl.visib_mod = visib_mod;
     node->data.error_value_decl.directives = directives;
-    ast_buf_from_token(pc, name_tok, &node->data.error_value_decl.name);
+    node->data.error_value_decl.name = ast_intern_token(pc, name_tok);
 
     normalize_parent_ptrs(node);
     return node;
@@ -2461,7 +2300,7 @@ TopLevelDecl : many(Directive) option(FnVisibleMod) (FnDef | ExternFnProto | Roo
 static void ast_parse_top_level_decls(ParseContext *pc, int *token_index, ZigList<AstNode *> *top_level_decls) {
     for (;;) {
         Token *directive_token = &pc->tokens->at(*token_index);
-        ZigList<AstNode *> *directives = allocate<ZigList<AstNode*>>(1);
+        ZigList<AstNode *> *directives = arena_allocate<ZigList<AstNode*>>(&pc->owner->ast_arena, 1);
         ast_parse_directives(pc, token_index, directives);
 
         Token *visib_tok = &pc->tokens->at(*token_index);
@@ -2556,79 +2395,112 @@ static AstNode *ast_parse_root(ParseContext *pc, int *token_index) {
     return node;
 }
 
-AstNode *ast_parse(Buf *buf, ZigList<Token> *tokens, ImportTableEntry *owner,
+static void init_parse_context(ParseContext *pc, Buf *buf, Tokenization *tokenization,
+        ImportTableEntry *owner, uint32_t *next_node_index)
+{
+    pc->owner = owner;
+    pc->buf = buf;
+    pc->tokens = tokenization->tokens;
+    pc->number_literals = tokenization->number_literals;
+    pc->next_node_index = next_node_index;
+}
+
+AstNode *ast_parse(Buf *buf, Tokenization *tokenization, ImportTableEntry *owner,
         ErrColor err_color, uint32_t *next_node_index)
 {
     ParseContext pc = {0};
+    init_parse_context(&pc, buf, tokenization, owner, next_node_index);
     pc.err_color = err_color;
-    pc.owner = owner;
-    pc.buf = buf;
-    pc.tokens = tokens;
-    pc.next_node_index = next_node_index;
     int token_index = 0;
     pc.root = ast_parse_root(&pc, &token_index);
     return pc.root;
 }
 
-static void set_field(AstNode **field) {
+AstNode *ast_try_parse(Buf *buf, Tokenization *tokenization, ImportTableEntry *owner,
+        uint32_t *next_node_index, ErrorMsg **out_err)
+{
+    // nothing in the parser needs cleaning up on the way out, so the error
+    // path can jump straight back here
+    jmp_buf err_jmp;
+    ParseContext pc = {0};
+    init_parse_context(&pc, buf, tokenization, owner, next_node_index);
+    pc.err_jmp = &err_jmp;
+    pc.err_out = out_err;
+    *out_err = nullptr;
+    if (setjmp(err_jmp))
+        return nullptr;
+    int token_index = 0;
+    return ast_parse_root(&pc, &token_index);
+}
+
+typedef void (*FieldVisitor)(AstNode **field, void *context);
+
+template<FieldVisitor visit>
+static void visit_field(AstNode **field, void *context) {
     if (*field) {
-        (*field)->parent_field = field;
+        visit(field, context);
     }
 }
 
-static void set_list_fields(ZigList<AstNode*> *list) {
+template<FieldVisitor visit, typename List>
+static void visit_list_fields(List *list, void *context) {
+    if (!list)
+        return;
     for (int i = 0; i < list->length; i += 1) {
-        set_field(&list->at(i));
+        visit_field<visit>(&list->at(i), context);
     }
 }
 
-void normalize_parent_ptrs(AstNode *node) {
+// calls visit with the address of each non null child pointer of node
+template<FieldVisitor visit>
+static void visit_node_fields(AstNode *node, void *context) {
     switch (node->type) {
         case NodeTypeRoot:
-            set_list_fields(&node->data.root.top_level_decls);
+            visit_list_fields<visit>(&node->data.root.top_level_decls, context);
             break;
         case NodeTypeRootExportDecl:
-            set_list_fields(node->data.root_export_decl.directives);
+            visit_list_fields<visit>(node->data.root_export_decl.directives, context);
             break;
         case NodeTypeFnProto:
-            set_field(&node->data.fn_proto.return_type);
-            set_list_fields(node->data.fn_proto.directives);
-            set_list_fields(&node->data.fn_proto.params);
+            visit_field<visit>(&node->data.fn_proto.return_type, context);
+            visit_list_fields<visit>(node->data.fn_proto.directives, context);
+            visit_list_fields<visit>(&node->data.fn_proto.params, context);
             break;
         case NodeTypeFnDef:
-            set_field(&node->data.fn_def.fn_proto);
-            set_field(&node->data.fn_def.body);
+            visit_field<visit>(&node->data.fn_def.fn_proto, context);
+            visit_field<visit>(&node->data.fn_def.body, context);
             break;
         case NodeTypeFnDecl:
-            set_field(&node->data.fn_decl.fn_proto);
+            visit_field<visit>(&node->data.fn_decl.fn_proto, context);
             break;
         case NodeTypeParamDecl:
-            set_field(&node->data.param_decl.type);
+            visit_field<visit>(&node->data.param_decl.type, context);
             break;
         case NodeTypeBlock:
-            set_list_fields(&node->data.block.statements);
+            visit_list_fields<visit>(&node->data.block.statements, context);
             break;
         case NodeTypeDirective:
             // none
             break;
         case NodeTypeReturnExpr:
-            set_field(&node->data.return_expr.expr);
+            visit_field<visit>(&node->data.return_expr.expr, context);
             break;
         case NodeTypeVariableDeclaration:
-            set_field(&node->data.variable_declaration.type);
-            set_field(&node->data.variable_declaration.expr);
+            visit_field<visit>(&node->data.variable_declaration.type, context);
+            visit_field<visit>(&node->data.variable_declaration.expr, context);
+            visit_list_fields<visit>(node->data.variable_declaration.directives, context);
             break;
         case NodeTypeErrorValueDecl:
-            // none
+            visit_list_fields<visit>(node->data.error_value_decl.directives, context);
             break;
         case NodeTypeBinOpExpr:
-            set_field(&node->data.bin_op_expr.op1);
-            set_field(&node->data.bin_op_expr.op2);
+            visit_field<visit>(&node->data.bin_op_expr.op1, context);
+            visit_field<visit>(&node->data.bin_op_expr.op2, context);
             break;
         case NodeTypeUnwrapErrorExpr:
-            set_field(&node->data.unwrap_err_expr.op1);
-            set_field(&node->data.unwrap_err_expr.symbol);
-            set_field(&node->data.unwrap_err_expr.op2);
+            visit_field<visit>(&node->data.unwrap_err_expr.op1, context);
+            visit_field<visit>(&node->data.unwrap_err_expr.symbol, context);
+            visit_field<visit>(&node->data.unwrap_err_expr.op2, context);
             break;
         case NodeTypeNumberLiteral:
             // none
@@ -2643,30 +2515,30 @@ void normalize_parent_ptrs(AstNode *node) {
             // none
             break;
         case NodeTypePrefixOpExpr:
-            set_field(&node->data.prefix_op_expr.primary_expr);
+            visit_field<visit>(&node->data.prefix_op_expr.primary_expr, context);
             break;
         case NodeTypeFnCallExpr:
-            set_field(&node->data.fn_call_expr.fn_ref_expr);
-            set_list_fields(&node->data.fn_call_expr.params);
+            visit_field<visit>(&node->data.fn_call_expr.fn_ref_expr, context);
+            visit_list_fields<visit>(&node->data.fn_call_expr.params, context);
             break;
         case NodeTypeArrayAccessExpr:
-            set_field(&node->data.array_access_expr.array_ref_expr);
-            set_field(&node->data.array_access_expr.subscript);
+            visit_field<visit>(&node->data.array_access_expr.array_ref_expr, context);
+            visit_field<visit>(&node->data.array_access_expr.subscript, context);
             break;
         case NodeTypeSliceExpr:
-            set_field(&node->data.slice_expr.array_ref_expr);
-            set_field(&node->data.slice_expr.start);
-            set_field(&node->data.slice_expr.end);
+            visit_field<visit>(&node->data.slice_expr.array_ref_expr, context);
+            visit_field<visit>(&node->data.slice_expr.start, context);
+            visit_field<visit>(&node->data.slice_expr.end, context);
             break;
         case NodeTypeFieldAccessExpr:
-            set_field(&node->data.field_access_expr.struct_expr);
+            visit_field<visit>(&node->data.field_access_expr.struct_expr, context);
             break;
         case NodeTypeImport:
-            set_list_fields(node->data.import.directives);
+            visit_list_fields<visit>(node->data.import.directives, context);
             break;
         case NodeTypeCImport:
-            set_list_fields(node->data.c_import.directives);
-            set_field(&node->data.c_import.block);
+            visit_list_fields<visit>(node->data.c_import.directives, context);
+            visit_field<visit>(&node->data.c_import.block, context);
             break;
         case NodeTypeBoolLiteral:
             // none
@@ -2678,38 +2550,38 @@ void normalize_parent_ptrs(AstNode *node) {
             // none
             break;
         case NodeTypeIfBoolExpr:
-            set_field(&node->data.if_bool_expr.condition);
-            set_field(&node->data.if_bool_expr.then_block);
-            set_field(&node->data.if_bool_expr.else_node);
+            visit_field<visit>(&node->data.if_bool_expr.condition, context);
+            visit_field<visit>(&node->data.if_bool_expr.then_block, context);
+            visit_field<visit>(&node->data.if_bool_expr.else_node, context);
             break;
         case NodeTypeIfVarExpr:
-            set_field(&node->data.if_var_expr.var_decl.type);
-            set_field(&node->data.if_var_expr.var_decl.expr);
-            set_field(&node->data.if_var_expr.then_block);
-            set_field(&node->data.if_var_expr.else_node);
+            visit_field<visit>(&node->data.if_var_expr.var_decl.type, context);
+            visit_field<visit>(&node->data.if_var_expr.var_decl.expr, context);
+            visit_field<visit>(&node->data.if_var_expr.then_block, context);
+            visit_field<visit>(&node->data.if_var_expr.else_node, context);
             break;
         case NodeTypeWhileExpr:
-            set_field(&node->data.while_expr.condition);
-            set_field(&node->data.while_expr.body);
+            visit_field<visit>(&node->data.while_expr.condition, context);
+            visit_field<visit>(&node->data.while_expr.body, context);
             break;
         case NodeTypeForExpr:
-            set_field(&node->data.for_expr.elem_node);
-            set_field(&node->data.for_expr.array_expr);
-            set_field(&node->data.for_expr.index_node);
-            set_field(&node->data.for_expr.body);
+            visit_field<visit>(&node->data.for_expr.elem_node, context);
+            visit_field<visit>(&node->data.for_expr.array_expr, context);
+            visit_field<visit>(&node->data.for_expr.index_node, context);
+            visit_field<visit>(&node->data.for_expr.body, context);
             break;
         case NodeTypeSwitchExpr:
-            set_field(&node->data.switch_expr.expr);
-            set_list_fields(&node->data.switch_expr.prongs);
+            visit_field<visit>(&node->data.switch_expr.expr, context);
+            visit_list_fields<visit>(&node->data.switch_expr.prongs, context);
             break;
         case NodeTypeSwitchProng:
-            set_list_fields(&node->data.switch_prong.items);
-            set_field(&node->data.switch_prong.var_symbol);
-            set_field(&node->data.switch_prong.expr);
+            visit_list_fields<visit>(&node->data.switch_prong.items, context);
+            visit_field<visit>(&node->data.switch_prong.var_symbol, context);
+            visit_field<visit>(&node->data.switch_prong.expr, context);
             break;
         case NodeTypeSwitchRange:
-            set_field(&node->data.switch_range.start);
-            set_field(&node->data.switch_range.end);
+            visit_field<visit>(&node->data.switch_range.start, context);
+            visit_field<visit>(&node->data.switch_range.end, context);
             break;
         case NodeTypeLabel:
             // none
@@ -2726,35 +2598,58 @@ void normalize_parent_ptrs(AstNode *node) {
         case NodeTypeAsmExpr:
             for (int i = 0; i < node->data.asm_expr.input_list.length; i += 1) {
                 AsmInput *asm_input = node->data.asm_expr.input_list.at(i);
-                set_field(&asm_input->expr);
+                visit_field<visit>(&asm_input->expr, context);
             }
             for (int i = 0; i < node->data.asm_expr.output_list.length; i += 1) {
                 AsmOutput *asm_output = node->data.asm_expr.output_list.at(i);
-                set_field(&asm_output->return_type);
+                visit_field<visit>(&asm_output->return_type, context);
             }
             break;
         case NodeTypeStructDecl:
-            set_list_fields(&node->data.struct_decl.fields);
-            set_list_fields(&node->data.struct_decl.fns);
-            set_list_fields(node->data.struct_decl.directives);
+            visit_list_fields<visit>(&node->data.struct_decl.fields, context);
+            visit_list_fields<visit>(&node->data.struct_decl.fns, context);
+            visit_list_fields<visit>(node->data.struct_decl.directives, context);
             break;
         case NodeTypeStructField:
-            set_field(&node->data.struct_field.type);
-            set_list_fields(node->data.struct_field.directives);
+            visit_field<visit>(&node->data.struct_field.type, context);
+            visit_list_fields<visit>(node->data.struct_field.directives, context);
             break;
         case NodeTypeContainerInitExpr:
-            set_field(&node->data.container_init_expr.type);
-            set_list_fields(&node->data.container_init_expr.entries);
+            visit_field<visit>(&node->data.container_init_expr.type, context);
+            visit_list_fields<visit>(&node->data.container_init_expr.entries, context);
             break;
         case NodeTypeStructValueField:
-            set_field(&node->data.struct_val_field.expr);
+            visit_field<visit>(&node->data.struct_val_field.expr, context);
             break;
         case NodeTypeArrayType:
-            set_field(&node->data.array_type.size);
-            set_field(&node->data.array_type.child_type);
+            visit_field<visit>(&node->data.array_type.size, context);
+            visit_field<visit>(&node->data.array_type.child_type, context);
             break;
         case NodeTypeErrorType:
             // none
             break;
     }
 }
+
+static void set_parent_field(AstNode **field, void *context) {
+    (*field)->parent_field = field;
+}
+
+void normalize_parent_ptrs(AstNode *node) {
+    visit_node_fields<set_parent_field>(node, nullptr);
+}
+
+static void push_field(AstNode **field, void *context) {
+    reinterpret_cast<ZigList<AstNode *> *>(context)->append(*field);
+}
+
+void ast_offset_create_indexes(AstNode *root, uint32_t offset) {
+    ZigList<AstNode *> stack = {0};
+    stack.append(root);
+    while (stack.length > 0) {
+        AstNode *node = stack.pop();
+        node->create_index += offset;
+        visit_node_fields<push_field>(node, &stack);
+    }
+    stack.deinit();
+}
@@ -17,8 +17,17 @@ void ast_token_error(Token *token, const char *format, ...);
 
 
 // This function is provided by generated code, generated by parsergen.cpp
-AstNode * ast_parse(Buf *buf, ZigList<Token> *tokens, ImportTableEntry *owner, ErrColor err_color,
+AstNode * ast_parse(Buf *buf, Tokenization *tokenization, ImportTableEntry *owner, ErrColor err_color,
         uint32_t *next_node_index);
+// Like ast_parse, but a syntax error is returned in out_err, with a null
+// result, instead of being printed. Files may be parsed on several threads at
+// once as long as each has its own owner and next_node_index.
+AstNode *ast_try_parse(Buf *buf, Tokenization *tokenization, ImportTableEntry *owner,
+        uint32_t *next_node_index, ErrorMsg **out_err);
+
+// adds offset to the create_index of every node in the tree, for a tree which
+// was parsed with its own next_node_index
+void ast_offset_create_indexes(AstNode *root, uint32_t offset);
 
 const char *node_type_str(NodeType node_type);
 
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2015 Andrew Kelley
+ *
+ * This file is part of zig, which is MIT licensed.
+ * See http://opensource.org/licenses/MIT
+ */
+
+#ifndef ZIG_SCOPE_TABLE_HPP
+#define ZIG_SCOPE_TABLE_HPP
+
+#include "hash_map.hpp"
+#include "intern.hpp"
+
+// Name to value table for a single scope. Most scopes declare only a handful
+// of names, so they are kept in a small inline array and searched linearly;
+// once the array overflows the table is promoted to a HashMap.
+// Keys must be interned. A zero initialized ScopeTable is ready to use.
+template<typename V>
+struct ScopeTable {
+    static const int inline_count = 4;
+
+    // returns nullptr when the name is not in the table
+    V *maybe_get(Buf *name) {
+        if (map) {
+            auto entry = map->maybe_get(name);
+            return entry ? &entry->value : nullptr;
+        }
+        for (int i = 0; i < count; i += 1) {
+            if (names[i] == name)
+                return &values[i];
+        }
+        return nullptr;
+    }
+
+    // returns true when this insertion promoted the table to a HashMap
+    bool put(Buf *name, V value) {
+        V *existing = maybe_get(name);
+        if (existing) {
+            *existing = value;
+            return false;
+        }
+        if (map) {
+            map->put(name, value);
+            return false;
+        }
+        if (count < inline_count) {
+            names[count] = name;
+            values[count] = value;
+            count += 1;
+            return false;
+        }
+
+        map = allocate<HashMap<Buf *, V, intern_hash, intern_eql>>(1, AllocCategoryScopes);
+        map->init(inline_count * 4);
+        for (int i = 0; i < count; i += 1) {
+            map->put(names[i], values[i]);
+        }
+        map->put(name, value);
+        return true;
+    }
+
+    Buf *names[inline_count];
+    V values[inline_count];
+    int count;
+    HashMap<Buf *, V, intern_hash, intern_eql> *map;
+};
+
+template<typename V>
+struct AllocCategoryOf<ScopeTable<V>> {
+    static const AllocCategory value = AllocCategoryScopes;
+};
+
+#endif
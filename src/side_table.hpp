@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2015 Andrew Kelley
+ *
+ * This file is part of zig, which is MIT licensed.
+ * See http://opensource.org/licenses/MIT
+ */
+
+#ifndef ZIG_SIDE_TABLE_HPP
+#define ZIG_SIDE_TABLE_HPP
+
+#include "util.hpp"
+
+// Dense table of T indexed by AstNode::create_index. Storage is allocated in
+// zeroed chunks which never move, so pointers to entries stay valid as the
+// table grows. The chunks hang off a fixed two level directory whose blocks
+// are installed with compare and swap, so get() may be called from several
+// threads at once; distinct threads must use distinct entries.
+template<typename T>
+struct SideTable {
+    static const uint32_t chunk_shift = 10;
+    static const uint32_t chunk_size = 1 << chunk_shift;
+    static const uint32_t block_shift = 10;
+    static const uint32_t block_size = 1 << block_shift;
+    static const uint32_t dir_size = 1 << (32 - chunk_shift - block_shift);
+
+    T *get(uint32_t index) {
+        T **block = install(&dir[index >> (chunk_shift + block_shift)], block_size);
+        T *chunk = install(&block[(index >> chunk_shift) & (block_size - 1)], chunk_size);
+        return &chunk[index & (chunk_size - 1)];
+    }
+
+    void deinit() {
+        for (uint32_t i = 0; i < dir_size; i += 1) {
+            T **block = dir[i];
+            if (!block)
+                continue;
+            for (uint32_t j = 0; j < block_size; j += 1) {
+                deallocate(block[j], chunk_size);
+            }
+            deallocate(block, block_size);
+            dir[i] = nullptr;
+        }
+    }
+
+    T **dir[dir_size];
+
+private:
+    // returns *slot, first filling it with count zeroed elements if it is
+    // null. When two threads race, the loser frees its allocation.
+    template<typename E>
+    static E *install(E **slot, uint32_t count) {
+        E *existing = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+        if (existing)
+            return existing;
+        E *fresh = allocate<E>(count);
+        if (__atomic_compare_exchange_n(slot, &existing, fresh, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            return fresh;
+        deallocate(fresh, count);
+        return existing;
+    }
+};
+
+#endif
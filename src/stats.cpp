@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2015 Andrew Kelley
+ *
+ * This file is part of zig, which is MIT licensed.
+ * See http://opensource.org/licenses/MIT
+ */
+
+#include "codegen.hpp"
+#include "hash_map.hpp"
+#include "intern.hpp"
+#include "os.hpp"
+
+#include <stdio.h>
+
+static const char *alloc_category_name(AllocCategory category) {
+    switch (category) {
+        case AllocCategoryOther: return "other";
+        case AllocCategoryAst: return "ast";
+        case AllocCategoryTypes: return "types";
+        case AllocCategoryScopes: return "scopes";
+        case AllocCategoryBufs: return "bufs";
+        case AllocCategoryLlvm: return "llvm";
+        case AllocCategoryHashMap: return "hash_map";
+        case AllocCategoryCount: break;
+    }
+    zig_unreachable();
+}
+
+// Turns the __PRETTY_FUNCTION__ recorded by HashMap::init into something
+// like "HashMap<Buf*, AstNode*, intern_hash>". GCC lists the template
+// arguments as "[with K = ...; V = ...]" and clang as "[K = ..., V = ...]".
+static void hash_map_display_name(const char *pretty_function, Buf *out) {
+    buf_resize(out, 0);
+    const char *args = strrchr(pretty_function, '[');
+    if (!args) {
+        buf_append_str(out, pretty_function);
+        return;
+    }
+    args += 1;
+    if (strncmp(args, "with ", 5) == 0)
+        args += 5;
+    char separator = strchr(args, ';') ? ';' : ',';
+
+    buf_append_str(out, "HashMap<");
+    int arg_index = 0;
+    int depth = 0;
+    const char *value = nullptr;
+    for (const char *p = args; *p; p += 1) {
+        if (*p == '<' || *p == '(') {
+            depth += 1;
+        } else if (*p == '>' || *p == ')') {
+            depth -= 1;
+        } else if (depth == 0 && *p == '=' && !value) {
+            value = p + 2;
+        } else if (depth == 0 && (*p == separator || *p == ']')) {
+            // K, V and the hash function are enough to tell maps apart
+            if (value && arg_index < 3) {
+                if (arg_index > 0)
+                    buf_append_str(out, ", ");
+                if (*value == '&')
+                    value += 1;
+                buf_append_mem(out, value, (int)(p - value));
+            }
+            arg_index += 1;
+            value = nullptr;
+            if (*p == ']')
+                break;
+        }
+    }
+    buf_append_str(out, ">");
+}
+
+static void print_json_string(FILE *f, Buf *str) {
+    fputc('"', f);
+    for (int i = 0; i < buf_len(str); i += 1) {
+        char c = buf_ptr(str)[i];
+        if (c == '"' || c == '\\')
+            fputc('\\', f);
+        fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+void codegen_print_stats(CodeGen *g, FILE *f, StatsFormat format) {
+    size_t peak_rss = os_get_peak_rss();
+
+    struct {
+        const char *name;
+        uint64_t value;
+    } counts[] = {
+        {"ast_nodes", g->next_node_index},
+        {"types", g->type_entry_count},
+        {"functions", (uint64_t)g->fn_protos.length},
+        {"function_definitions", (uint64_t)g->fn_defs.length},
+        {"imports", (uint64_t)g->import_table.size()},
+        {"scopes", g->block_context_count},
+        {"promoted_scope_tables", g->promoted_scope_table_count},
+        {"interned_names", (uint64_t)intern_count()},
+    };
+
+    uint64_t ast_cache_lookups = g->ast_cache_hits + g->ast_cache_misses + g->ast_cache_stale;
+    double ast_cache_hit_rate = ast_cache_lookups ?
+        (double)g->ast_cache_hits / (double)ast_cache_lookups : 0.0;
+
+    Buf name = BUF_INIT;
+    buf_resize(&name, 0);
+
+    if (format == StatsFormatJson) {
+        fprintf(f, "{\n  \"memory\": {\n");
+        for (int i = 0; i <= AllocCategoryCount; i += 1) {
+            AllocCategoryStats *stats = (i < AllocCategoryCount) ? &alloc_stats[i] : &alloc_stats_total;
+            fprintf(f, "    \"%s\": {\"bytes\": %" PRIu64 ", \"allocations\": %" PRIu64
+                    ", \"live_bytes\": %" PRId64 ", \"peak_bytes\": %" PRId64 "}%s\n",
+                    (i < AllocCategoryCount) ? alloc_category_name((AllocCategory)i) : "total",
+                    stats->bytes, stats->count, stats->live_bytes, stats->peak_bytes,
+                    (i < AllocCategoryCount) ? "," : "");
+        }
+        fprintf(f, "  },\n");
+        fprintf(f, "  \"peak_rss_bytes\": %zu,\n", peak_rss);
+        fprintf(f, "  \"counts\": {\n");
+        for (int i = 0; i < array_length(counts); i += 1) {
+            fprintf(f, "    \"%s\": %" PRIu64 "%s\n", counts[i].name, counts[i].value,
+                    (i + 1 < array_length(counts)) ? "," : "");
+        }
+        fprintf(f, "  },\n  \"ast_cache\": {\"enabled\": %s, \"hits\": %" PRIu64 ", \"misses\": %" PRIu64
+                ", \"stale\": %" PRIu64 ", \"stores\": %" PRIu64 ", \"hit_rate\": %.3f, \"load_ms\": %.3f},\n",
+                g->ast_cache_dir ? "true" : "false", g->ast_cache_hits, g->ast_cache_misses,
+                g->ast_cache_stale, g->ast_cache_stores, ast_cache_hit_rate, g->ast_cache_load_seconds * 1000.0);
+        fprintf(f, "  \"hash_maps\": [");
+        for (HashMapStats *stats = hash_map_stats_list; stats; stats = stats->next) {
+            hash_map_display_name(stats->name, &name);
+            fprintf(f, "\n    {\"type\": ");
+            print_json_string(f, &name);
+            fprintf(f, ", \"lookups\": %" PRIu64 ", \"probe_histogram\": [", stats->lookups);
+            for (int i = 0; i < HASH_MAP_PROBE_BUCKETS; i += 1) {
+                fprintf(f, "%s%" PRIu64, (i == 0) ? "" : ", ", stats->probe_histogram[i]);
+            }
+            fprintf(f, "]}%s", stats->next ? "," : "\n  ");
+        }
+        fprintf(f, "]\n}\n");
+    } else {
+        fprintf(f, "Memory (allocated over the whole run):\n");
+        fprintf(f, "  %-12s %14s %12s %14s %14s\n", "category", "bytes", "allocations", "live", "peak");
+        for (int i = 0; i <= AllocCategoryCount; i += 1) {
+            AllocCategoryStats *stats = (i < AllocCategoryCount) ? &alloc_stats[i] : &alloc_stats_total;
+            fprintf(f, "  %-12s %14" PRIu64 " %12" PRIu64 " %14" PRId64 " %14" PRId64 "\n",
+                    (i < AllocCategoryCount) ? alloc_category_name((AllocCategory)i) : "total",
+                    stats->bytes, stats->count, stats->live_bytes, stats->peak_bytes);
+        }
+        fprintf(f, "Peak RSS: %zu bytes\n", peak_rss);
+
+        fprintf(f, "\nCounts:\n");
+        for (int i = 0; i < array_length(counts); i += 1) {
+            fprintf(f, "  %-22s %10" PRIu64 "\n", counts[i].name, counts[i].value);
+        }
+
+        if (g->ast_cache_dir) {
+            fprintf(f, "\nAST cache (%s):\n", buf_ptr(g->ast_cache_dir));
+            fprintf(f, "  %-22s %10" PRIu64 "\n", "hits", g->ast_cache_hits);
+            fprintf(f, "  %-22s %10" PRIu64 "\n", "misses", g->ast_cache_misses);
+            fprintf(f, "  %-22s %10" PRIu64 "\n", "stale", g->ast_cache_stale);
+            fprintf(f, "  %-22s %10" PRIu64 "\n", "stores", g->ast_cache_stores);
+            fprintf(f, "  %-22s %9.1f%%\n", "hit rate", ast_cache_hit_rate * 100.0);
+            fprintf(f, "  %-22s %10.3f\n", "load time (ms)", g->ast_cache_load_seconds * 1000.0);
+        } else {
+            fprintf(f, "\nAST cache: off\n");
+        }
+
+        fprintf(f, "\nHash map probe lengths (groups probed per lookup):\n");
+        fprintf(f, "  %10s", "lookups");
+        for (int i = 0; i < HASH_MAP_PROBE_BUCKETS; i += 1) {
+            if (i + 1 == HASH_MAP_PROBE_BUCKETS) {
+                fprintf(f, " %7d+", i + 1);
+            } else {
+                fprintf(f, " %8d", i + 1);
+            }
+        }
+        fprintf(f, "  type\n");
+        for (HashMapStats *stats = hash_map_stats_list; stats; stats = stats->next) {
+            hash_map_display_name(stats->name, &name);
+            fprintf(f, "  %10" PRIu64, stats->lookups);
+            for (int i = 0; i < HASH_MAP_PROBE_BUCKETS; i += 1) {
+                fprintf(f, " %8" PRIu64, stats->probe_histogram[i]);
+            }
+            fprintf(f, "  %s\n", buf_ptr(&name));
+        }
+    }
+
+    buf_deinit(&name);
+}
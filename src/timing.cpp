@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2015 Andrew Kelley
+ *
+ * This file is part of zig, which is MIT licensed.
+ * See http://opensource.org/licenses/MIT
+ */
+
+#include "timing.hpp"
+#include "codegen.hpp"
+#include "os.hpp"
+#include "zig_llvm.hpp"
+
+static void trace_print_string(FILE *f, const char *str, int len) {
+    for (int i = 0; i < len; i += 1) {
+        uint8_t c = (uint8_t)str[i];
+        if (c == '"' || c == '\\') {
+            fprintf(f, "\\%c", c);
+        } else if (c < 0x20) {
+            fprintf(f, "\\u%04x", c);
+        } else {
+            fputc(c, f);
+        }
+    }
+}
+
+// time is from os_get_time. duration is only written for complete ('X')
+// events.
+static void trace_event(CodeGen *g, char phase, int thread_id, double time, double duration,
+        const char *name, Buf *detail, const char *count_name, uint64_t count)
+{
+    FILE *f = g->trace_file;
+    double timestamp_us = (time - g->trace_start) * 1000000.0;
+    fprintf(f, "%s{\"ph\": \"%c\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f",
+            g->trace_need_comma ? ",\n" : "", phase, thread_id, timestamp_us);
+    g->trace_need_comma = true;
+    if (phase == 'X') {
+        fprintf(f, ", \"dur\": %.3f", duration * 1000000.0);
+    }
+    if (name) {
+        fprintf(f, ", \"name\": \"");
+        trace_print_string(f, name, (int)strlen(name));
+        if (detail) {
+            fputc(' ', f);
+            trace_print_string(f, buf_ptr(detail), buf_len(detail));
+        }
+        fputc('"', f);
+    }
+    if (count_name) {
+        fprintf(f, ", \"args\": {\"%s\": %" PRIu64 "}", count_name, count);
+    }
+    fputc('}', f);
+}
+
+void trace_begin(CodeGen *g, const char *name, Buf *detail) {
+    if (g->trace_file)
+        trace_event(g, 'B', 1, os_get_time(), 0.0, name, detail, nullptr, 0);
+}
+
+void trace_end(CodeGen *g, const char *count_name, uint64_t count) {
+    if (g->trace_file)
+        trace_event(g, 'E', 1, os_get_time(), 0.0, nullptr, nullptr, count_name, count);
+}
+
+void trace_add_finished(CodeGen *g, const char *name, Buf *detail, int thread_id,
+        double wall_start, double wall_seconds, const char *count_name, uint64_t count)
+{
+    if (g->trace_file)
+        trace_event(g, 'X', thread_id, wall_start, wall_seconds, name, detail, count_name, count);
+}
+
+int timing_begin(CodeGen *g, const char *name, Buf *detail) {
+    trace_begin(g, name, detail);
+    if (!g->time_report)
+        return -1;
+
+    g->time_phases.add_one();
+    TimePhase *phase = &g->time_phases.last();
+    phase->name = name;
+    phase->detail = detail;
+    phase->depth = g->time_phase_depth;
+    phase->wall_seconds = 0.0;
+    phase->cpu_seconds = 0.0;
+    g->time_phase_depth += 1;
+    // read the clocks last so that the bookkeeping above is not measured
+    phase->wall_start = os_get_time();
+    phase->cpu_start = os_get_cpu_time();
+    return g->time_phases.length - 1;
+}
+
+void timing_end_with_count(CodeGen *g, int phase_index, const char *count_name, uint64_t count) {
+    if (phase_index >= 0) {
+        double wall_end = os_get_time();
+        double cpu_end = os_get_cpu_time();
+        TimePhase *phase = &g->time_phases.at(phase_index);
+        assert(phase->depth == g->time_phase_depth - 1);
+        phase->wall_seconds = wall_end - phase->wall_start;
+        phase->cpu_seconds = cpu_end - phase->cpu_start;
+        g->time_phase_depth -= 1;
+    }
+    trace_end(g, count_name, count);
+}
+
+void timing_end(CodeGen *g, int phase_index) {
+    timing_end_with_count(g, phase_index, nullptr, 0);
+}
+
+void timing_add_finished(CodeGen *g, const char *name, Buf *detail, int thread_id,
+        double wall_start, double wall_seconds, double cpu_seconds,
+        const char *count_name, uint64_t count)
+{
+    trace_add_finished(g, name, detail, thread_id, wall_start, wall_seconds, count_name, count);
+    if (g->time_report) {
+        g->time_phases.add_one();
+        TimePhase *phase = &g->time_phases.last();
+        phase->name = name;
+        phase->detail = detail;
+        phase->depth = g->time_phase_depth;
+        phase->wall_start = wall_start;
+        phase->cpu_start = 0.0;
+        phase->wall_seconds = wall_seconds;
+        phase->cpu_seconds = cpu_seconds;
+    }
+}
+
+void codegen_set_trace_out(CodeGen *g, FILE *f) {
+    g->trace_file = f;
+    g->trace_start = os_get_time();
+    // the JSON array form of the trace format, which tools accept without
+    // the closing bracket, so a trace cut short by a compile error still loads
+    fprintf(f, "[\n");
+    fprintf(f, "{\"ph\": \"M\", \"pid\": 1, \"tid\": 1, \"name\": \"process_name\", "
+            "\"args\": {\"name\": \"zig\"}}");
+    g->trace_need_comma = true;
+}
+
+void codegen_finish_trace(CodeGen *g) {
+    fprintf(g->trace_file, "\n]\n");
+    g->trace_file = nullptr;
+}
+
+void codegen_print_time_report(CodeGen *g, FILE *f) {
+    double total_wall = 0.0;
+    double total_cpu = 0.0;
+    Buf label = BUF_INIT;
+
+    fprintf(f, "Time report:\n");
+    fprintf(f, "  %-56s %12s %12s\n", "phase", "wall (ms)", "cpu (ms)");
+    for (int i = 0; i < g->time_phases.length; i += 1) {
+        TimePhase *phase = &g->time_phases.at(i);
+        buf_resize(&label, 0);
+        for (int depth = 0; depth < phase->depth; depth += 1) {
+            buf_append_str(&label, "  ");
+        }
+        buf_append_str(&label, phase->name);
+        if (phase->detail) {
+            buf_append_char(&label, ' ');
+            buf_append_buf(&label, phase->detail);
+        }
+        fprintf(f, "  %-56s %12.3f %12.3f\n", buf_ptr(&label),
+                phase->wall_seconds * 1000.0, phase->cpu_seconds * 1000.0);
+        if (phase->depth == 0) {
+            total_wall += phase->wall_seconds;
+            total_cpu += phase->cpu_seconds;
+        }
+    }
+    fprintf(f, "  %-56s %12.3f %12.3f\n", "total", total_wall * 1000.0, total_cpu * 1000.0);
+    buf_deinit(&label);
+
+    fprintf(f, "\n");
+    fflush(f);
+    LLVMZigPrintPassTimings();
+}
@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2015 Andrew Kelley
+ *
+ * This file is part of zig, which is MIT licensed.
+ * See http://opensource.org/licenses/MIT
+ */
+
+#ifndef ZIG_TIMING_HPP
+#define ZIG_TIMING_HPP
+
+#include "all_types.hpp"
+
+// Phases are the coarse stages listed by --time-report; they also appear in
+// the --trace-out timeline. Phases nest: a phase begun while another is
+// running is reported as part of it. Pass the return value of timing_begin to
+// the matching timing_end. detail may be nullptr.
+int timing_begin(CodeGen *g, const char *name, Buf *detail);
+void timing_end(CodeGen *g, int phase_index);
+// count_name names a metric attached to the trace event, such as "nodes"
+void timing_end_with_count(CodeGen *g, int phase_index, const char *count_name, uint64_t count);
+// A phase which ran on another thread, reported once it is over. It is listed
+// in the running phase and drawn on timeline row thread_id; the main thread is
+// row 1. wall_start is from os_get_time and cpu_seconds is the thread's own.
+void timing_add_finished(CodeGen *g, const char *name, Buf *detail, int thread_id,
+        double wall_start, double wall_seconds, double cpu_seconds,
+        const char *count_name, uint64_t count);
+
+// Fine grained events which only go to the --trace-out timeline, such as one
+// per function. These must nest as well. count_name may be nullptr.
+void trace_begin(CodeGen *g, const char *name, Buf *detail);
+void trace_end(CodeGen *g, const char *count_name, uint64_t count);
+// An event which ran on another thread, like timing_add_finished
+void trace_add_finished(CodeGen *g, const char *name, Buf *detail, int thread_id,
+        double wall_start, double wall_seconds, const char *count_name, uint64_t count);
+
+#endif
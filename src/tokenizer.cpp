@@ -11,6 +11,12 @@
 #include <stdarg.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ZIG_TOKENIZE_AVX2
+#endif
 
 #define WHITESPACE \
          ' ': \
@@ -130,17 +136,39 @@ enum TokenizeState {
     TokenizeStateError,
 };
 
+// Runs of bytes which the state machine would otherwise step over one at a
+// time. Each kind of run ends at a different set of bytes.
+enum SkipRun {
+    SkipRunWhitespace, // ends at anything but ' ' and '\n'
+    SkipRunSymbol, // ends at anything but SYMBOL_CHAR
+    SkipRunString, // ends at '"'
+    SkipRunLineComment, // ends at '\n'
+    SkipRunMultiLineComment, // ends at '*' or '/'
+};
+
+struct Tokenize;
+
+// returns the position of the first byte at or after pos which ends the run,
+// or the start of the last partial block if the run goes that far
+typedef int (*SkipBlocksFn)(Tokenize *t, const uint8_t *ptr, int pos, int end, SkipRun run);
 
 struct Tokenize {
     Buf *buf;
     int pos;
+    // where tokenize_range stops; the end of the buffer except for chunks
+    int end;
     TokenizeState state;
     ZigList<Token> *tokens;
     int line;
     int column;
     Token *cur_tok;
+    int cur_tok_line;
+    int cur_tok_column;
+    // when cur_tok is a number literal
+    NumberLiteralInfo *cur_num;
     int multi_line_comment_count;
     Tokenization *out;
+    SkipBlocksFn skip_blocks;
 };
 
 __attribute__ ((format (printf, 2, 3)))
@@ -148,8 +176,8 @@ static void tokenize_error(Tokenize *t, const char *format, ...) {
     t->state = TokenizeStateError;
 
     if (t->cur_tok) {
-        t->out->err_line = t->cur_tok->start_line;
-        t->out->err_column = t->cur_tok->start_column;
+        t->out->err_line = t->cur_tok_line;
+        t->out->err_column = t->cur_tok_column;
     } else {
         t->out->err_line = t->line;
         t->out->err_column = t->column;
@@ -165,14 +193,25 @@ static void begin_token(Tokenize *t, TokenId id) {
     assert(!t->cur_tok);
     t->tokens->add_one();
     Token *token = &t->tokens->last();
-    token->start_line = t->line;
-    token->start_column = t->column;
     token->id = id;
     token->start_pos = t->pos;
-    token->radix = 0;
-    token->decimal_point_pos = 0;
-    token->exponent_marker_pos = 0;
+    // set properly by end_token; a token cut short by an error keeps this
+    token->end_pos = t->pos;
     t->cur_tok = token;
+    t->cur_tok_line = t->line;
+    t->cur_tok_column = t->column;
+
+    if (id == TokenIdNumberLiteral) {
+        t->out->number_literals->add_one();
+        NumberLiteralInfo *num = &t->out->number_literals->last();
+        num->token_index = t->tokens->length - 1;
+        num->radix = 0;
+        num->decimal_point_pos = 0;
+        num->exponent_marker_pos = 0;
+        t->cur_num = num;
+    } else {
+        t->cur_num = nullptr;
+    }
 }
 
 static void cancel_token(Tokenize *t) {
@@ -180,77 +219,115 @@ static void cancel_token(Tokenize *t) {
     t->cur_tok = nullptr;
 }
 
+struct KeywordSlot {
+    const char *text;
+    int len;
+    TokenId id;
+};
+
+// Perfect hash of the keywords: keyword_hash gives every keyword its own
+// slot, so classifying an identifier is one hash and at most one memcmp.
+// The multipliers were found by searching for a collision free pair; when
+// adding a keyword, pick new ones if its slot is already taken.
+static const int keyword_table_size = 64;
+
+static uint32_t keyword_hash(const char *mem, int len) {
+    return ((uint8_t)mem[0] * 9 + (uint8_t)mem[len - 1] * 61 + len) & (keyword_table_size - 1);
+}
+
+static const KeywordSlot keyword_table[keyword_table_size] = {
+    {nullptr, 0, TokenIdSymbol},
+    {"if", 2, TokenIdKeywordIf},
+    {nullptr, 0, TokenIdSymbol},
+    {"for", 3, TokenIdKeywordFor},
+    {nullptr, 0, TokenIdSymbol},
+    {"while", 5, TokenIdKeywordWhile},
+    {nullptr, 0, TokenIdSymbol},
+    {nullptr, 0, TokenIdSymbol},
+    {nullptr, 0, TokenIdSymbol},
+    {"extern", 6, TokenIdKeywordExtern},
+    {"enum", 4, TokenIdKeywordEnum},
+    {nullptr, 0, TokenIdSymbol},
+    {"noalias", 7, TokenIdKeywordNoAlias},
+    {"pub", 3, TokenIdKeywordPub},
+    {"fn", 2, TokenIdKeywordFn},
+    {nullptr, 0, TokenIdSymbol},
+    {nullptr, 0, TokenIdSymbol},
+    {nullptr, 0, TokenIdSymbol},
+    {nullptr, 0, TokenIdSymbol},
+    {"var", 3, TokenIdKeywordVar},
+    {"continue", 8, TokenIdKeywordContinue},
+    {nullptr, 0, TokenIdSymbol},
+    {"goto", 4, TokenIdKeywordGoto},
+    {nullptr, 0, TokenIdSymbol},
+    {nullptr, 0, TokenIdSymbol},
+    {"switch", 6, TokenIdKeywordSwitch},
+    {nullptr, 0, TokenIdSymbol},
+    {"import", 6, TokenIdKeywordImport},
+    {nullptr, 0, TokenIdSymbol},
+    {nullptr, 0, TokenIdSymbol},
+    {"null", 4, TokenIdKeywordNull},
+    {nullptr, 0, TokenIdSymbol},
+    {nullptr, 0, TokenIdSymbol},
+    {nullptr, 0, TokenIdSymbol},
+    {"else", 4, TokenIdKeywordElse},
+    {nullptr, 0, TokenIdSymbol},
+    {"const", 5, TokenIdKeywordConst},
+    {"asm", 3, TokenIdKeywordAsm},
+    {nullptr, 0, TokenIdSymbol},
+    {"c_import", 8, TokenIdKeywordCImport},
+    {nullptr, 0, TokenIdSymbol},
+    {"true", 4, TokenIdKeywordTrue},
+    {nullptr, 0, TokenIdSymbol},
+    {nullptr, 0, TokenIdSymbol},
+    {"false", 5, TokenIdKeywordFalse},
+    {nullptr, 0, TokenIdSymbol},
+    {nullptr, 0, TokenIdSymbol},
+    {nullptr, 0, TokenIdSymbol},
+    {nullptr, 0, TokenIdSymbol},
+    {nullptr, 0, TokenIdSymbol},
+    {nullptr, 0, TokenIdSymbol},
+    {nullptr, 0, TokenIdSymbol},
+    {nullptr, 0, TokenIdSymbol},
+    {"struct", 6, TokenIdKeywordStruct},
+    {"break", 5, TokenIdKeywordBreak},
+    {"export", 6, TokenIdKeywordExport},
+    {nullptr, 0, TokenIdSymbol},
+    {nullptr, 0, TokenIdSymbol},
+    {"undefined", 9, TokenIdKeywordUndefined},
+    {nullptr, 0, TokenIdSymbol},
+    {"error", 5, TokenIdKeywordError},
+    {nullptr, 0, TokenIdSymbol},
+    {"return", 6, TokenIdKeywordReturn},
+    {"volatile", 8, TokenIdKeywordVolatile},
+};
+
+static TokenId get_keyword_id(const char *mem, int len) {
+    const KeywordSlot *slot = &keyword_table[keyword_hash(mem, len)];
+    if (slot->len == len && memcmp(slot->text, mem, len) == 0)
+        return slot->id;
+    return TokenIdSymbol;
+}
+
 static void end_token(Tokenize *t) {
     assert(t->cur_tok);
     t->cur_tok->end_pos = t->pos + 1;
 
     // normalize number literal parsing stuff
     if (t->cur_tok->id == TokenIdNumberLiteral) {
-        if (t->cur_tok->exponent_marker_pos == 0) {
-            t->cur_tok->exponent_marker_pos = t->cur_tok->end_pos;
+        if (t->cur_num->exponent_marker_pos == 0) {
+            t->cur_num->exponent_marker_pos = t->cur_tok->end_pos;
         }
-        if (t->cur_tok->decimal_point_pos == 0) {
-            t->cur_tok->decimal_point_pos = t->cur_tok->exponent_marker_pos;
+        if (t->cur_num->decimal_point_pos == 0) {
+            t->cur_num->decimal_point_pos = t->cur_num->exponent_marker_pos;
         }
     }
 
     char *token_mem = buf_ptr(t->buf) + t->cur_tok->start_pos;
     int token_len = t->cur_tok->end_pos - t->cur_tok->start_pos;
 
-    if (mem_eql_str(token_mem, token_len, "fn")) {
-        t->cur_tok->id = TokenIdKeywordFn;
-    } else if (mem_eql_str(token_mem, token_len, "return")) {
-        t->cur_tok->id = TokenIdKeywordReturn;
-    } else if (mem_eql_str(token_mem, token_len, "var")) {
-        t->cur_tok->id = TokenIdKeywordVar;
-    } else if (mem_eql_str(token_mem, token_len, "const")) {
-        t->cur_tok->id = TokenIdKeywordConst;
-    } else if (mem_eql_str(token_mem, token_len, "extern")) {
-        t->cur_tok->id = TokenIdKeywordExtern;
-    } else if (mem_eql_str(token_mem, token_len, "pub")) {
-        t->cur_tok->id = TokenIdKeywordPub;
-    } else if (mem_eql_str(token_mem, token_len, "export")) {
-        t->cur_tok->id = TokenIdKeywordExport;
-    } else if (mem_eql_str(token_mem, token_len, "c_import")) {
-        t->cur_tok->id = TokenIdKeywordCImport;
-    } else if (mem_eql_str(token_mem, token_len, "import")) {
-        t->cur_tok->id = TokenIdKeywordImport;
-    } else if (mem_eql_str(token_mem, token_len, "true")) {
-        t->cur_tok->id = TokenIdKeywordTrue;
-    } else if (mem_eql_str(token_mem, token_len, "false")) {
-        t->cur_tok->id = TokenIdKeywordFalse;
-    } else if (mem_eql_str(token_mem, token_len, "if")) {
-        t->cur_tok->id = TokenIdKeywordIf;
-    } else if (mem_eql_str(token_mem, token_len, "else")) {
-        t->cur_tok->id = TokenIdKeywordElse;
-    } else if (mem_eql_str(token_mem, token_len, "goto")) {
-        t->cur_tok->id = TokenIdKeywordGoto;
-    } else if (mem_eql_str(token_mem, token_len, "volatile")) {
-        t->cur_tok->id = TokenIdKeywordVolatile;
-    } else if (mem_eql_str(token_mem, token_len, "asm")) {
-        t->cur_tok->id = TokenIdKeywordAsm;
-    } else if (mem_eql_str(token_mem, token_len, "struct")) {
-        t->cur_tok->id = TokenIdKeywordStruct;
-    } else if (mem_eql_str(token_mem, token_len, "enum")) {
-        t->cur_tok->id = TokenIdKeywordEnum;
-    } else if (mem_eql_str(token_mem, token_len, "for")) {
-        t->cur_tok->id = TokenIdKeywordFor;
-    } else if (mem_eql_str(token_mem, token_len, "while")) {
-        t->cur_tok->id = TokenIdKeywordWhile;
-    } else if (mem_eql_str(token_mem, token_len, "continue")) {
-        t->cur_tok->id = TokenIdKeywordContinue;
-    } else if (mem_eql_str(token_mem, token_len, "break")) {
-        t->cur_tok->id = TokenIdKeywordBreak;
-    } else if (mem_eql_str(token_mem, token_len, "null")) {
-        t->cur_tok->id = TokenIdKeywordNull;
-    } else if (mem_eql_str(token_mem, token_len, "noalias")) {
-        t->cur_tok->id = TokenIdKeywordNoAlias;
-    } else if (mem_eql_str(token_mem, token_len, "switch")) {
-        t->cur_tok->id = TokenIdKeywordSwitch;
-    } else if (mem_eql_str(token_mem, token_len, "undefined")) {
-        t->cur_tok->id = TokenIdKeywordUndefined;
-    } else if (mem_eql_str(token_mem, token_len, "error")) {
-        t->cur_tok->id = TokenIdKeywordError;
+    if (t->cur_tok->id == TokenIdSymbol) {
+        t->cur_tok->id = get_keyword_id(token_mem, token_len);
     }
 
     t->cur_tok = nullptr;
@@ -277,16 +354,223 @@ int get_digit_value(uint8_t c) {
     return -1;
 }
 
-void tokenize(Buf *buf, Tokenization *out) {
-    Tokenize t = {0};
-    t.out = out;
-    t.tokens = out->tokens = allocate<ZigList<Token>>(1);
-    t.buf = buf;
+static bool ends_run(uint8_t c, SkipRun run) {
+    switch (run) {
+        case SkipRunWhitespace:
+            return c != ' ' && c != '\n';
+        case SkipRunSymbol:
+            switch (c) {
+                case SYMBOL_CHAR:
+                    return false;
+                default:
+                    return true;
+            }
+        case SkipRunString:
+            return c == '"';
+        case SkipRunLineComment:
+            return c == '\n';
+        case SkipRunMultiLineComment:
+            return c == '*' || c == '/';
+    }
+    zig_unreachable();
+}
+
+static void record_newline(Tokenize *t, int pos) {
+    t->out->line_offsets->append(pos + 1);
+    t->line += 1;
+}
+
+// bit i of newline_mask is set when ptr[block_start + i] is a newline
+static void record_newlines(Tokenize *t, int block_start, uint32_t newline_mask) {
+    while (newline_mask) {
+        record_newline(t, block_start + __builtin_ctz(newline_mask));
+        newline_mask &= newline_mask - 1;
+    }
+}
+
+#if defined(__SSE2__)
+// bit i of the result is set when byte i of block ends the run
+static uint32_t run_end_mask_sse2(__m128i block, SkipRun run) {
+    switch (run) {
+        case SkipRunWhitespace:
+            {
+                __m128i space = _mm_cmpeq_epi8(block, _mm_set1_epi8(' '));
+                __m128i newline = _mm_cmpeq_epi8(block, _mm_set1_epi8('\n'));
+                return ~(uint32_t)_mm_movemask_epi8(_mm_or_si128(space, newline)) & 0xffff;
+            }
+        case SkipRunSymbol:
+            {
+                // bytes >= 0x80 compare as negative, so they are never in range
+                __m128i lower = _mm_or_si128(block, _mm_set1_epi8(0x20));
+                __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                        _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+                __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(block, _mm_set1_epi8('0' - 1)),
+                        _mm_cmplt_epi8(block, _mm_set1_epi8('9' + 1)));
+                __m128i underscore = _mm_cmpeq_epi8(block, _mm_set1_epi8('_'));
+                __m128i symbol = _mm_or_si128(_mm_or_si128(alpha, digit), underscore);
+                return ~(uint32_t)_mm_movemask_epi8(symbol) & 0xffff;
+            }
+        case SkipRunString:
+            return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8('"')));
+        case SkipRunLineComment:
+            return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8('\n')));
+        case SkipRunMultiLineComment:
+            {
+                __m128i star = _mm_cmpeq_epi8(block, _mm_set1_epi8('*'));
+                __m128i slash = _mm_cmpeq_epi8(block, _mm_set1_epi8('/'));
+                return (uint32_t)_mm_movemask_epi8(_mm_or_si128(star, slash));
+            }
+    }
+    zig_unreachable();
+}
+
+static int skip_blocks_sse2(Tokenize *t, const uint8_t *ptr, int pos, int end, SkipRun run) {
+    for (; pos + 16 <= end; pos += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr + pos));
+        uint32_t end_mask = run_end_mask_sse2(block, run);
+        uint32_t newline_mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8('\n')));
+        if (end_mask) {
+            int index = __builtin_ctz(end_mask);
+            record_newlines(t, pos, newline_mask & ((1u << index) - 1));
+            return pos + index;
+        }
+        record_newlines(t, pos, newline_mask);
+    }
+    return pos;
+}
+#endif
+
+#if defined(ZIG_TOKENIZE_AVX2)
+// the same as run_end_mask_sse2 for 32 bytes
+__attribute__((target("avx2")))
+static uint32_t run_end_mask_avx2(__m256i block, SkipRun run) {
+    switch (run) {
+        case SkipRunWhitespace:
+            {
+                __m256i space = _mm256_cmpeq_epi8(block, _mm256_set1_epi8(' '));
+                __m256i newline = _mm256_cmpeq_epi8(block, _mm256_set1_epi8('\n'));
+                return ~(uint32_t)_mm256_movemask_epi8(_mm256_or_si256(space, newline));
+            }
+        case SkipRunSymbol:
+            {
+                __m256i lower = _mm256_or_si256(block, _mm256_set1_epi8(0x20));
+                __m256i alpha = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+                        _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lower));
+                __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(block, _mm256_set1_epi8('0' - 1)),
+                        _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), block));
+                __m256i underscore = _mm256_cmpeq_epi8(block, _mm256_set1_epi8('_'));
+                __m256i symbol = _mm256_or_si256(_mm256_or_si256(alpha, digit), underscore);
+                return ~(uint32_t)_mm256_movemask_epi8(symbol);
+            }
+        case SkipRunString:
+            return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, _mm256_set1_epi8('"')));
+        case SkipRunLineComment:
+            return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, _mm256_set1_epi8('\n')));
+        case SkipRunMultiLineComment:
+            {
+                __m256i star = _mm256_cmpeq_epi8(block, _mm256_set1_epi8('*'));
+                __m256i slash = _mm256_cmpeq_epi8(block, _mm256_set1_epi8('/'));
+                return (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(star, slash));
+            }
+    }
+    zig_unreachable();
+}
+
+__attribute__((target("avx2")))
+static int skip_blocks_avx2(Tokenize *t, const uint8_t *ptr, int pos, int end, SkipRun run) {
+    for (; pos + 32 <= end; pos += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(ptr + pos));
+        uint32_t end_mask = run_end_mask_avx2(block, run);
+        uint32_t newline_mask = (uint32_t)_mm256_movemask_epi8(
+                _mm256_cmpeq_epi8(block, _mm256_set1_epi8('\n')));
+        if (end_mask) {
+            int index = __builtin_ctz(end_mask);
+            record_newlines(t, pos, newline_mask & ((1u << index) - 1));
+            return pos + index;
+        }
+        record_newlines(t, pos, newline_mask);
+    }
+    return pos;
+}
+#endif
+
+static SkipBlocksFn get_skip_blocks_fn(void) {
+#if defined(ZIG_TOKENIZE_AVX2)
+    if (__builtin_cpu_supports("avx2"))
+        return skip_blocks_avx2;
+#endif
+#if defined(__SSE2__)
+    return skip_blocks_sse2;
+#else
+    return nullptr;
+#endif
+}
+
+// moves t->pos to the first byte which ends the run, or to t->end, keeping
+// line_offsets, line and column up to date
+static void skip_run(Tokenize *t, SkipRun run) {
+    const uint8_t *ptr = (const uint8_t *)buf_ptr(t->buf);
+    int end = t->end;
+    int pos = t->pos;
+    // most runs are empty or a single byte; don't bother with a block for those
+    if (ends_run(ptr[pos], run))
+        return;
+    if (t->skip_blocks)
+        pos = t->skip_blocks(t, ptr, pos, end, run);
+    while (pos < end && !ends_run(ptr[pos], run)) {
+        if (ptr[pos] == '\n')
+            record_newline(t, pos);
+        pos += 1;
+    }
+    t->pos = pos;
+    t->column = pos - t->out->line_offsets->last();
+}
+
+// start is the beginning of a line. line numbers are counted from there.
+static void tokenize_init(Tokenize *t, Buf *buf, Tokenization *out, int start, int end,
+        SkipBlocksFn skip_blocks)
+{
+    t->out = out;
+    t->tokens = out->tokens = allocate<ZigList<Token>>(1);
+    t->buf = buf;
+    t->pos = start;
+    t->end = end;
+    t->skip_blocks = skip_blocks;
 
     out->line_offsets = allocate<ZigList<int>>(1);
+    out->number_literals = allocate<ZigList<NumberLiteralInfo>>(1);
+
+    out->line_offsets->append(start);
+}
+
+// runs the state machine from t->pos up to end, which must be at least
+// t->pos. the state is copied into a local so that it can live in registers.
+static void tokenize_range(Tokenize *t_ptr, int end) {
+    Tokenize t = *t_ptr;
+    t.end = end;
+    for (; t.pos < end; t.pos += 1) {
+        switch (t.state) {
+            case TokenizeStateStart:
+                skip_run(&t, SkipRunWhitespace);
+                break;
+            case TokenizeStateSymbol:
+                skip_run(&t, SkipRunSymbol);
+                break;
+            case TokenizeStateString:
+                skip_run(&t, SkipRunString);
+                break;
+            case TokenizeStateLineComment:
+                skip_run(&t, SkipRunLineComment);
+                break;
+            case TokenizeStateMultiLineComment:
+                skip_run(&t, SkipRunMultiLineComment);
+                break;
+            default:
+                break;
+        }
+        if (t.pos == end)
+            break;
 
-    out->line_offsets->append(0);
-    for (t.pos = 0; t.pos < buf_len(t.buf); t.pos += 1) {
         uint8_t c = buf_ptr(t.buf)[t.pos];
         switch (t.state) {
             case TokenizeStateError:
@@ -307,12 +591,12 @@ void tokenize(Buf *buf, Tokenization *out) {
                     case '0':
                         t.state = TokenizeStateZero;
                         begin_token(&t, TokenIdNumberLiteral);
-                        t.cur_tok->radix = 10;
+                        t.cur_num->radix = 10;
                         break;
                     case DIGIT_NON_ZERO:
                         t.state = TokenizeStateNumber;
                         begin_token(&t, TokenIdNumberLiteral);
-                        t.cur_tok->radix = 10;
+                        t.cur_num->radix = 10;
                         break;
                     case '"':
                         begin_token(&t, TokenIdStringLiteral);
@@ -830,13 +1114,13 @@ void tokenize(Buf *buf, Tokenization *out) {
             case TokenizeStateZero:
                 switch (c) {
                     case 'b':
-                        t.cur_tok->radix = 2;
+                        t.cur_num->radix = 2;
                         break;
                     case 'o':
-                        t.cur_tok->radix = 8;
+                        t.cur_num->radix = 8;
                         break;
                     case 'x':
-                        t.cur_tok->radix = 16;
+                        t.cur_num->radix = 16;
                         break;
                     default:
                         // reinterpret as normal number
@@ -857,12 +1141,12 @@ void tokenize(Buf *buf, Tokenization *out) {
                                 continue;
                             }
                         }
-                        t.cur_tok->decimal_point_pos = t.pos;
+                        t.cur_num->decimal_point_pos = t.pos;
                         t.state = TokenizeStateFloatFraction;
                         break;
                     }
-                    if (is_exponent_signifier(c, t.cur_tok->radix)) {
-                        t.cur_tok->exponent_marker_pos = t.pos;
+                    if (is_exponent_signifier(c, t.cur_num->radix)) {
+                        t.cur_num->exponent_marker_pos = t.pos;
                         t.state = TokenizeStateFloatExponentUnsigned;
                         break;
                     }
@@ -872,7 +1156,7 @@ void tokenize(Buf *buf, Tokenization *out) {
                     }
                     int digit_value = get_digit_value(c);
                     if (digit_value >= 0) {
-                        if (digit_value >= t.cur_tok->radix) {
+                        if (digit_value >= t.cur_num->radix) {
                             tokenize_error(&t, "invalid character: '%c'", c);
                         }
                         // normal digit
@@ -887,8 +1171,8 @@ void tokenize(Buf *buf, Tokenization *out) {
                 }
             case TokenizeStateFloatFraction:
                 {
-                    if (is_exponent_signifier(c, t.cur_tok->radix)) {
-                        t.cur_tok->exponent_marker_pos = t.pos;
+                    if (is_exponent_signifier(c, t.cur_num->radix)) {
+                        t.cur_num->exponent_marker_pos = t.pos;
                         t.state = TokenizeStateFloatExponentUnsigned;
                         break;
                     }
@@ -898,7 +1182,7 @@ void tokenize(Buf *buf, Tokenization *out) {
                     }
                     int digit_value = get_digit_value(c);
                     if (digit_value >= 0) {
-                        if (digit_value >= t.cur_tok->radix) {
+                        if (digit_value >= t.cur_num->radix) {
                             tokenize_error(&t, "invalid character: '%c'", c);
                         }
                         // normal digit
@@ -960,23 +1244,26 @@ void tokenize(Buf *buf, Tokenization *out) {
                 break;
         }
         if (c == '\n') {
-            out->line_offsets->append(t.pos + 1);
+            t.out->line_offsets->append(t.pos + 1);
             t.line += 1;
             t.column = 0;
         } else {
             t.column += 1;
         }
     }
-    // EOF
-    switch (t.state) {
+    *t_ptr = t;
+}
+
+static void tokenize_eof(Tokenize *t) {
+    switch (t->state) {
         case TokenizeStateStart:
         case TokenizeStateError:
             break;
         case TokenizeStateString:
-            tokenize_error(&t, "unterminated string");
+            tokenize_error(t, "unterminated string");
             break;
         case TokenizeStateCharLiteral:
-            tokenize_error(&t, "unterminated character literal");
+            tokenize_error(t, "unterminated character literal");
             break;
         case TokenizeStateSymbol:
         case TokenizeStateSymbolFirst:
@@ -1003,34 +1290,175 @@ void tokenize(Buf *buf, Tokenization *out) {
         case TokenizeStateSawGreaterThanGreaterThan:
         case TokenizeStateSawDot:
         case TokenizeStateSawQuestionMark:
-            end_token(&t);
+            end_token(t);
             break;
         case TokenizeStateSawDotDot:
-            tokenize_error(&t, "unexpected EOF");
+            tokenize_error(t, "unexpected EOF");
             break;
         case TokenizeStateLineComment:
             break;
         case TokenizeStateMultiLineComment:
         case TokenizeStateMultiLineCommentSlash:
         case TokenizeStateMultiLineCommentStar:
-            tokenize_error(&t, "unterminated multi-line comment");
+            tokenize_error(t, "unterminated multi-line comment");
             break;
     }
-    if (t.state != TokenizeStateError) {
-        if (t.tokens->length > 0) {
-            Token *last_token = &t.tokens->last();
-            t.line = last_token->start_line;
-            t.column = last_token->start_column;
-            t.pos = last_token->start_pos;
+    if (t->state != TokenizeStateError) {
+        if (t->tokens->length > 0) {
+            Token *last_token = &t->tokens->last();
+            t->pos = last_token->start_pos;
         } else {
-            t.pos = 0;
+            t->pos = 0;
         }
-        begin_token(&t, TokenIdEof);
-        end_token(&t);
-        assert(!t.cur_tok);
+        begin_token(t, TokenIdEof);
+        end_token(t);
+        assert(!t->cur_tok);
     }
 }
 
+void tokenize(Buf *buf, Tokenization *out) {
+    Tokenize t = {0};
+    tokenize_init(&t, buf, out, 0, buf_len(buf), get_skip_blocks_fn());
+    tokenize_range(&t, buf_len(buf));
+    tokenize_eof(&t);
+}
+
+// below this many bytes per thread the threads cost more than they save
+static const int min_parallel_chunk_size = 1024 * 1024;
+
+// a piece of the buffer which starts at the beginning of a line. it is
+// tokenized speculatively, as if no string or comment were open there.
+struct TokenizeChunk {
+    Tokenize t;
+    Tokenization out;
+    int start;
+    int end;
+    pthread_t thread;
+};
+
+static void *tokenize_chunk_thread(void *arg) {
+    TokenizeChunk *chunk = reinterpret_cast<TokenizeChunk *>(arg);
+    tokenize_range(&chunk->t, chunk->end);
+    return nullptr;
+}
+
+static void free_chunk(TokenizeChunk *chunk) {
+    chunk->out.tokens->deinit();
+    chunk->out.line_offsets->deinit();
+    chunk->out.number_literals->deinit();
+    deallocate(chunk->out.tokens, 1);
+    deallocate(chunk->out.line_offsets, 1);
+    deallocate(chunk->out.number_literals, 1);
+}
+
+// appends the results of a chunk which turned out to start in the start
+// state, and takes over the state it ended in
+static void append_chunk(Tokenize *t, TokenizeChunk *chunk) {
+    Tokenization *out = t->out;
+    ZigList<Token> *tokens = chunk->out.tokens;
+    ZigList<int> *line_offsets = chunk->out.line_offsets;
+    ZigList<NumberLiteralInfo> *number_literals = chunk->out.number_literals;
+    int token_base = t->tokens->length;
+    int number_base = out->number_literals->length;
+    int line_base = t->line;
+
+    t->tokens->resize(token_base + tokens->length);
+    memcpy(&t->tokens->at(token_base), tokens->items, tokens->length * sizeof(Token));
+
+    // the first offset is the chunk start, which is already there
+    int line_offset_base = out->line_offsets->length;
+    out->line_offsets->resize(line_offset_base + line_offsets->length - 1);
+    memcpy(&out->line_offsets->items[line_offset_base], &line_offsets->items[1],
+            (line_offsets->length - 1) * sizeof(int));
+
+    out->number_literals->resize(number_base + number_literals->length);
+    for (int i = 0; i < number_literals->length; i += 1) {
+        NumberLiteralInfo *num = &out->number_literals->at(number_base + i);
+        *num = number_literals->at(i);
+        num->token_index += token_base;
+    }
+
+    Tokenize *last = &chunk->t;
+    t->pos = last->pos;
+    t->state = last->state;
+    t->line = line_base + last->line;
+    t->column = last->column;
+    t->multi_line_comment_count = last->multi_line_comment_count;
+    if (last->cur_tok) {
+        t->cur_tok = &t->tokens->at(token_base + (int)(last->cur_tok - tokens->items));
+        t->cur_tok_line = line_base + last->cur_tok_line;
+        t->cur_tok_column = last->cur_tok_column;
+        t->cur_num = last->cur_num ?
+            &out->number_literals->at(number_base + (int)(last->cur_num - number_literals->items)) : nullptr;
+    } else {
+        t->cur_tok = nullptr;
+        t->cur_num = nullptr;
+    }
+    if (chunk->out.err) {
+        out->err = chunk->out.err;
+        out->err_line = line_base + chunk->out.err_line;
+        out->err_column = chunk->out.err_column;
+    }
+}
+
+void tokenize_parallel(Buf *buf, Tokenization *out, int thread_count) {
+    int len = buf_len(buf);
+    int chunk_count = min(thread_count, len / min_parallel_chunk_size);
+    if (chunk_count < 2) {
+        tokenize(buf, out);
+        return;
+    }
+
+    SkipBlocksFn skip_blocks = get_skip_blocks_fn();
+    const char *ptr = buf_ptr(buf);
+    TokenizeChunk *chunks = allocate<TokenizeChunk>(chunk_count);
+    int start = 0;
+    int actual_count = 0;
+    for (int i = 0; i < chunk_count && start < len; i += 1) {
+        int end = len;
+        if (i + 1 < chunk_count) {
+            int target = max(start, (int)((int64_t)len * (i + 1) / chunk_count));
+            const char *newline = (const char *)memchr(ptr + target, '\n', len - target);
+            end = newline ? (int)(newline - ptr) + 1 : len;
+        }
+        TokenizeChunk *chunk = &chunks[actual_count];
+        chunk->start = start;
+        chunk->end = end;
+        actual_count += 1;
+        start = end;
+    }
+
+    // the first chunk really does start in the start state, so it goes
+    // straight into the result on this thread
+    Tokenize t = {0};
+    tokenize_init(&t, buf, out, 0, len, skip_blocks);
+    for (int i = 1; i < actual_count; i += 1) {
+        TokenizeChunk *chunk = &chunks[i];
+        tokenize_init(&chunk->t, buf, &chunk->out, chunk->start, chunk->end, skip_blocks);
+        if (pthread_create(&chunk->thread, nullptr, tokenize_chunk_thread, chunk))
+            zig_panic("unable to create tokenizer thread");
+    }
+    tokenize_range(&t, chunks[0].end);
+
+    for (int i = 1; i < actual_count; i += 1) {
+        TokenizeChunk *chunk = &chunks[i];
+        if (pthread_join(chunk->thread, nullptr))
+            zig_panic("unable to join tokenizer thread");
+        if (t.state == TokenizeStateStart && !t.cur_tok) {
+            append_chunk(&t, chunk);
+        } else {
+            // the guess was wrong: the chunk starts inside a string or a
+            // comment, or after an error. do it again from the real state.
+            tokenize_range(&t, chunk->end);
+        }
+        free_chunk(chunk);
+    }
+    deallocate(chunks, chunk_count);
+
+    t.end = len;
+    tokenize_eof(&t);
+}
+
 const char * token_name(TokenId id) {
     switch (id) {
         case TokenIdEof: return "EOF";
@@ -99,14 +99,17 @@ enum TokenId {
     TokenIdPercentDot,
 };
 
+// Tokens are walked over and over by the parser, so they are kept small.
+// The line and column of a token can be found from line_offsets.
 struct Token {
     TokenId id;
     int start_pos;
     int end_pos;
-    int start_line;
-    int start_column;
+};
 
-    // for id == TokenIdNumberLiteral
+// the extra information for a TokenIdNumberLiteral token
+struct NumberLiteralInfo {
+    int token_index;
     int radix; // if != 10, then skip the first 2 characters
     int decimal_point_pos; // either exponent_marker_pos or the position of the '.'
     int exponent_marker_pos; // either end_pos or the position of the 'e'/'p'
@@ -115,6 +118,8 @@ struct Token {
 struct Tokenization {
     ZigList<Token> *tokens;
     ZigList<int> *line_offsets;
+    // one for each number literal, in token order
+    ZigList<NumberLiteralInfo> *number_literals;
 
     // if an error occurred
     Buf *err;
@@ -123,6 +128,9 @@ struct Tokenization {
 };
 
 void tokenize(Buf *buf, Tokenization *out_tokenization);
+// the same result as tokenize. large buffers are split at line boundaries and
+// the pieces tokenized on up to thread_count threads.
+void tokenize_parallel(Buf *buf, Tokenization *out_tokenization, int thread_count);
 
 void print_tokens(Buf *buf, ZigList<Token> *tokens);
 
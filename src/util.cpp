@@ -8,8 +8,56 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <pthread.h>
 
 #include "util.hpp"
+#include "hash_map.hpp"
+
+AllocCategoryStats alloc_stats[AllocCategoryCount];
+AllocCategoryStats alloc_stats_total;
+bool stats_enabled;
+HashMapStats *hash_map_stats_list;
+static pthread_mutex_t hash_map_stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+void hash_map_stats_register(HashMapStats *stats, const char *name) {
+    pthread_mutex_lock(&hash_map_stats_mutex);
+    if (!stats->name) {
+        stats->next = hash_map_stats_list;
+        hash_map_stats_list = stats;
+        __atomic_store_n(&stats->name, name, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&hash_map_stats_mutex);
+}
+
+// the tokenizer and the worker pools allocate from several threads
+static void update_category(AllocCategoryStats *stats, size_t old_bytes, size_t new_bytes) {
+    if (old_bytes == 0 && new_bytes != 0)
+        __atomic_fetch_add(&stats->count, 1, __ATOMIC_RELAXED);
+    if (new_bytes > old_bytes)
+        __atomic_fetch_add(&stats->bytes, new_bytes - old_bytes, __ATOMIC_RELAXED);
+    int64_t delta = (int64_t)new_bytes - (int64_t)old_bytes;
+    int64_t live = __atomic_add_fetch(&stats->live_bytes, delta, __ATOMIC_RELAXED);
+    int64_t peak = __atomic_load_n(&stats->peak_bytes, __ATOMIC_RELAXED);
+    while (live > peak) {
+        if (__atomic_compare_exchange_n(&stats->peak_bytes, &peak, live, true,
+                    __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        {
+            break;
+        }
+    }
+}
+
+void alloc_stats_update(AllocCategory category, size_t old_bytes, size_t new_bytes) {
+    update_category(&alloc_stats[category], old_bytes, new_bytes);
+    update_category(&alloc_stats_total, old_bytes, new_bytes);
+}
+
+void alloc_stats_reset_peak(void) {
+    for (int i = 0; i < AllocCategoryCount; i += 1) {
+        alloc_stats[i].peak_bytes = alloc_stats[i].live_bytes;
+    }
+    alloc_stats_total.peak_bytes = alloc_stats_total.live_bytes;
+}
 
 void zig_panic(const char *format, ...) {
     va_list ap;
@@ -20,6 +68,16 @@ void zig_panic(const char *format, ...) {
     abort();
 }
 
+uint64_t hash_bytes(const char *ptr, size_t len) {
+    // FNV 64-bit hash
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i += 1) {
+        h = h ^ ((uint8_t)ptr[i]);
+        h = h * 1099511628211ULL;
+    }
+    return h;
+}
+
 uint32_t int_hash(int i) {
     return (uint32_t)(i % UINT32_MAX);
 }
@@ -28,8 +28,63 @@ static inline void zig_unreachable(void) {
     zig_panic("unreachable");
 }
 
+// With --stats, every allocation made through allocate() and friends is
+// counted under a category so that --stats can show where memory goes. The
+// category comes from the allocated type; see ZIG_ALLOC_CATEGORY. bytes is
+// the total allocated over the run, where growing a block counts only the
+// bytes it grew by. live_bytes and peak_bytes only see memory which is given
+// back through deallocate(), as the containers do.
+enum AllocCategory {
+    AllocCategoryOther,
+    AllocCategoryAst,
+    AllocCategoryTypes,
+    AllocCategoryScopes,
+    AllocCategoryBufs,
+    AllocCategoryLlvm,
+    AllocCategoryHashMap,
+
+    AllocCategoryCount,
+};
+
+struct AllocCategoryStats {
+    uint64_t bytes;
+    uint64_t count;
+    int64_t live_bytes;
+    int64_t peak_bytes;
+};
+
+extern AllocCategoryStats alloc_stats[AllocCategoryCount];
+// the sum over all categories, whose peak is not the sum of their peaks
+extern AllocCategoryStats alloc_stats_total;
+
+// Set by --stats before any thread starts. The allocation and hash lookup
+// counters are shared by all threads, so they are only updated when asked for.
+extern bool stats_enabled;
+
 template<typename T>
-__attribute__((malloc)) static inline T *allocate_nonzero(size_t count) {
+struct AllocCategoryOf {
+    static const AllocCategory value = AllocCategoryOther;
+};
+
+#define ZIG_ALLOC_CATEGORY(T, category) \
+    template<> struct AllocCategoryOf<T> { static const AllocCategory value = category; }
+
+// a block of old_bytes became new_bytes; either may be 0
+void alloc_stats_update(AllocCategory category, size_t old_bytes, size_t new_bytes);
+// starts every peak over from the live bytes, to measure the peak of one piece
+// of work. not safe while other threads allocate.
+void alloc_stats_reset_peak(void);
+
+static inline void alloc_stats_record(AllocCategory category, size_t old_bytes, size_t new_bytes) {
+    if (stats_enabled)
+        alloc_stats_update(category, old_bytes, new_bytes);
+}
+
+template<typename T>
+__attribute__((malloc)) static inline T *allocate_nonzero(size_t count,
+        AllocCategory category = AllocCategoryOf<T>::value)
+{
+    alloc_stats_record(category, 0, count * sizeof(T));
     T *ptr = reinterpret_cast<T*>(malloc(count * sizeof(T)));
     if (!ptr)
         zig_panic("allocation failed");
@@ -37,7 +92,10 @@ __attribute__((malloc)) static inline T *allocate_nonzero(size_t count) {
 }
 
 template<typename T>
-__attribute__((malloc)) static inline T *allocate(size_t count) {
+__attribute__((malloc)) static inline T *allocate(size_t count,
+        AllocCategory category = AllocCategoryOf<T>::value)
+{
+    alloc_stats_record(category, 0, count * sizeof(T));
     T *ptr = reinterpret_cast<T*>(calloc(count, sizeof(T)));
     if (!ptr)
         zig_panic("allocation failed");
@@ -45,13 +103,27 @@ __attribute__((malloc)) static inline T *allocate(size_t count) {
 }
 
 template<typename T>
-static inline T *reallocate_nonzero(T * old, size_t new_count) {
+static inline T *reallocate_nonzero(T * old, size_t old_count, size_t new_count,
+        AllocCategory category = AllocCategoryOf<T>::value)
+{
+    alloc_stats_record(category, old_count * sizeof(T), new_count * sizeof(T));
     T *ptr = reinterpret_cast<T*>(realloc(old, new_count * sizeof(T)));
     if (!ptr)
         zig_panic("allocation failed");
     return ptr;
 }
 
+// frees what allocate() or reallocate_nonzero() returned for count items
+template<typename T>
+static inline void deallocate(T *ptr, size_t count, AllocCategory category = AllocCategoryOf<T>::value) {
+    if (!ptr)
+        return;
+    alloc_stats_record(category, count * sizeof(T), 0);
+    free(ptr);
+}
+
+ZIG_ALLOC_CATEGORY(char, AllocCategoryBufs);
+
 template <typename T, long n>
 constexpr long array_length(const T (&)[n]) {
     return n;
@@ -79,6 +151,9 @@ static inline bool mem_eql_str(const char *mem, size_t mem_len, const char *str)
     return memcmp(mem, str, mem_len) == 0;
 }
 
+// for content hashes which are kept on disk, so it must never change
+uint64_t hash_bytes(const char *ptr, size_t len);
+
 uint32_t int_hash(int i);
 bool int_eq(int a, int b);
 uint32_t uint64_hash(uint64_t i);
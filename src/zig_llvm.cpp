@@ -22,10 +22,12 @@
  */
 
 #include <llvm/InitializePasses.h>
+#include <llvm/Pass.h>
 #include <llvm/PassRegistry.h>
 #include <llvm/MC/SubtargetFeature.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Support/FileSystem.h>
+#include <llvm/Support/ManagedStatic.h>
 #include <llvm/Support/TargetParser.h>
 #include <llvm/Target/TargetMachine.h>
 #include <llvm/IR/LegacyPassManager.h>
@@ -132,6 +134,16 @@ void LLVMZigOptimizeModule(LLVMTargetMachineRef targ_machine_ref, LLVMModuleRef
     MPM->run(*module);
 }
 
+void LLVMZigSetTimePasses(bool enabled) {
+    TimePassesIsEnabled = enabled;
+}
+
+void LLVMZigPrintPassTimings(void) {
+    // the pass timers live in a ManagedStatic which prints its report when
+    // it is destroyed
+    llvm_shutdown();
+}
+
 LLVMValueRef LLVMZigBuildCall(LLVMBuilderRef B, LLVMValueRef Fn, LLVMValueRef *Args,
         unsigned NumArgs, unsigned CC, const char *Name)
 {
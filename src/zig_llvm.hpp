@@ -36,6 +36,13 @@ char *LLVMZigGetNativeFeatures(void);
 
 void LLVMZigOptimizeModule(LLVMTargetMachineRef targ_machine_ref, LLVMModuleRef module_ref);
 
+// same as passing -time-passes to an LLVM tool. must be set before any pass
+// manager runs.
+void LLVMZigSetTimePasses(bool enabled);
+// prints the pass timing report to stderr. no LLVM functions may be called
+// afterwards.
+void LLVMZigPrintPassTimings(void);
+
 LLVMValueRef LLVMZigBuildCall(LLVMBuilderRef B, LLVMValueRef Fn, LLVMValueRef *Args,
         unsigned NumArgs, unsigned CC, const char *Name);
 
@@ -0,0 +1,822 @@
+/*
+ * Copyright (c) 2015 Andrew Kelley
+ *
+ * This file is part of zig, which is MIT licensed.
+ * See http://opensource.org/licenses/MIT
+ */
+
+// Looks for inputs on which the tokenizer, the parser or semantic analysis
+// scale worse than linearly. A case is a source file with a repeated middle:
+//
+//     prefix open^N middle close^N suffix
+//
+// such as N nested blocks or a struct with N members. In the parts, $i is the
+// index of the repetition, $n is $i + 1 and $N is N. A case is run at N, 2N
+// and 4N; if a phase takes time t(N) = c + a * N^p, then
+// (t(4N) - t(N)) / (t(2N) - t(N)) = 2^p + 1, whatever the fixed cost c. N is
+// grown until the differences are large enough to measure, and a case is
+// superlinear when p exceeds --bound for the time of any phase or for the peak
+// memory of the process. Each measurement runs in a child process, so that
+// timeouts, crashes and memory can be told apart.
+//
+// Case files list the parts, each after a line "@@ <part>". Lines before the
+// first part are comments, except for a line "xfail", which marks a case
+// that is known to be superlinear. Usage:
+//
+//     frontend_fuzz --check test/fuzz_cases
+//     frontend_fuzz --fuzz 1000 [--seed N] [--save dir] test/fuzz_cases
+//
+// --check runs the cases and fails if any which is not marked xfail is
+// superlinear. --fuzz mutates the cases, minimizes any mutant which is
+// superlinear and saves it as a new case, in the first directory given
+// unless --save says otherwise.
+//
+// Built with -DZIG_LIBFUZZER and -fsanitize=fuzzer, this is a libFuzzer
+// target instead. The input is a case with its parts separated by zero bytes,
+// and a superlinear case aborts. That build measures in process, so memory is
+// the bytes allocated through allocate() and hangs are left to -timeout.
+
+#include "codegen.hpp"
+#include "tokenizer.hpp"
+#include "parser.hpp"
+#include "os.hpp"
+#include "error.hpp"
+
+#include <dirent.h>
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+enum CasePart {
+    CasePartPrefix,
+    CasePartOpen,
+    CasePartMiddle,
+    CasePartClose,
+    CasePartSuffix,
+
+    CasePartCount,
+};
+
+struct FuzzCase {
+    Buf *name;
+    Buf *parts[CasePartCount];
+    bool xfail;
+};
+
+enum Phase {
+    PhaseTokenize,
+    PhaseParse,
+    PhaseAnalyze,
+
+    PhaseCount,
+};
+
+static const char *phase_names[] = {"tokenize", "parse", "analyze"};
+
+struct Measurement {
+    double seconds[PhaseCount];
+    // peak RSS of the child process, or bytes allocated when in process
+    double memory_bytes;
+};
+
+enum MeasureResult {
+    MeasureResultOk,
+    MeasureResultTimeout,
+    MeasureResultCrash,
+};
+
+struct FuzzConfig {
+    double bound;
+    int runs;
+    int timeout_seconds;
+    // growth below these is noise, and too little to judge
+    double min_seconds;
+    double min_memory_bytes;
+    int max_bytes;
+    bool in_process;
+    // where the source is written for semantic analysis
+    Buf *tmp_dir;
+};
+
+enum CaseVerdict {
+    CaseVerdictLinear,
+    CaseVerdictSuperlinear,
+    // timed out before it could be measured, or the limits were reached
+    CaseVerdictInconclusive,
+    CaseVerdictCrash,
+};
+
+struct CaseResult {
+    CaseVerdict verdict;
+    int count;
+    // negative when the phase did not take long enough to judge
+    double time_exponents[PhaseCount];
+    double memory_exponent;
+    // which measurement timed out, if any
+    bool timed_out;
+};
+
+static FuzzCase *case_create(Buf *name) {
+    FuzzCase *fuzz_case = allocate<FuzzCase>(1);
+    fuzz_case->name = name;
+    for (int i = 0; i < CasePartCount; i += 1) {
+        fuzz_case->parts[i] = buf_alloc();
+    }
+    return fuzz_case;
+}
+
+// nothing to repeat means nothing to scale
+static bool case_repeats(FuzzCase *fuzz_case) {
+    return buf_len(fuzz_case->parts[CasePartOpen]) != 0 || buf_len(fuzz_case->parts[CasePartClose]) != 0;
+}
+
+static void expand_part(Buf *out, Buf *part, int index, int count) {
+    const char *ptr = buf_ptr(part);
+    int len = buf_len(part);
+    for (int i = 0; i < len; i += 1) {
+        if (ptr[i] == '$' && i + 1 < len) {
+            char c = ptr[i + 1];
+            if (c == 'i' || c == 'n' || c == 'N') {
+                buf_appendf(out, "%d", (c == 'i') ? index : (c == 'n') ? index + 1 : count);
+                i += 1;
+                continue;
+            }
+        }
+        buf_append_char(out, ptr[i]);
+    }
+}
+
+static void case_render(Buf *out, FuzzCase *fuzz_case, int count) {
+    buf_resize(out, 0);
+    expand_part(out, fuzz_case->parts[CasePartPrefix], 0, count);
+    for (int i = 0; i < count; i += 1) {
+        expand_part(out, fuzz_case->parts[CasePartOpen], i, count);
+    }
+    expand_part(out, fuzz_case->parts[CasePartMiddle], 0, count);
+    for (int i = 0; i < count; i += 1) {
+        expand_part(out, fuzz_case->parts[CasePartClose], i, count);
+    }
+    expand_part(out, fuzz_case->parts[CasePartSuffix], 0, count);
+}
+
+// memory is the peak of the live bytes over what was live before
+static void measure_in_process(FuzzConfig *config, Buf *source, Measurement *out) {
+    alloc_stats_reset_peak();
+    int64_t live_start = alloc_stats_total.live_bytes;
+
+    double start = os_get_time();
+    Tokenization tokenization = {0};
+    tokenize(source, &tokenization);
+    out->seconds[PhaseTokenize] = os_get_time() - start;
+
+    if (!tokenization.err) {
+        ImportTableEntry *import_entry = allocate<ImportTableEntry>(1);
+        import_entry->ast_arena.category = AllocCategoryAst;
+        import_entry->source_code = source;
+        import_entry->path = buf_create_from_str("fuzz.zig");
+        import_entry->line_offsets = tokenization.line_offsets;
+
+        uint32_t next_node_index = 0;
+        ErrorMsg *parse_err = nullptr;
+        start = os_get_time();
+        AstNode *root = ast_try_parse(source, &tokenization, import_entry, &next_node_index, &parse_err);
+        out->seconds[PhaseParse] = os_get_time() - start;
+
+        arena_deinit(&import_entry->ast_arena);
+        deallocate(import_entry, 1);
+
+        // the analyzer exits on syntax errors, so it only sees files which parse
+        if (root) {
+            Buf *basename = buf_create_from_str("fuzz.zig");
+            Buf path = BUF_INIT;
+            os_path_join(buf_view(config->tmp_dir), buf_view(basename), &path);
+            os_write_file(&path, source);
+
+            // the CodeGen is not freed; the child process exits after one
+            // measurement and libFuzzer runs are short
+            CodeGen *g = codegen_create(config->tmp_dir);
+            codegen_set_out_type(g, OutTypeObj);
+            codegen_set_out_name(g, buf_create_from_str("fuzz"));
+            codegen_set_errmsg_color(g, ErrColorOff);
+            codegen_set_thread_count(g, 1);
+            codegen_set_time_report(g, true);
+            codegen_analyze_root_code(g, config->tmp_dir, basename, source);
+            for (int i = 0; i < g->time_phases.length; i += 1) {
+                TimePhase *phase = &g->time_phases.at(i);
+                if (strcmp(phase->name, "semantic analysis") == 0)
+                    out->seconds[PhaseAnalyze] = phase->wall_seconds;
+            }
+        }
+    }
+
+    tokenization.tokens->deinit();
+    tokenization.line_offsets->deinit();
+    tokenization.number_literals->deinit();
+    deallocate(tokenization.tokens, 1);
+    deallocate(tokenization.line_offsets, 1);
+    deallocate(tokenization.number_literals, 1);
+
+    out->memory_bytes = (double)(alloc_stats_total.peak_bytes - live_start);
+}
+
+struct MeasureJob {
+    FuzzConfig *config;
+    Buf *source;
+    Measurement *out;
+};
+
+static void *measure_thread(void *arg) {
+    MeasureJob *job = reinterpret_cast<MeasureJob *>(arg);
+    measure_in_process(job->config, job->source, job->out);
+    return nullptr;
+}
+
+static MeasureResult measure_forked(FuzzConfig *config, Buf *source, Measurement *out) {
+    int fds[2];
+    if (pipe(fds) == -1)
+        zig_panic("pipe failed");
+
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid == -1)
+        zig_panic("fork failed");
+    if (pid == 0) {
+        close(fds[0]);
+        alarm(config->timeout_seconds);
+        // the parser and the analyzer recurse once per level of nesting
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setstacksize(&attr, (size_t)1024 * 1024 * 1024);
+        Measurement measurement = {};
+        MeasureJob job = {config, source, &measurement};
+        pthread_t thread;
+        if (pthread_create(&thread, &attr, measure_thread, &job))
+            _exit(2);
+        pthread_join(thread, nullptr);
+        ssize_t amt_written = write(fds[1], &measurement, sizeof(Measurement));
+        _exit(amt_written == sizeof(Measurement) ? 0 : 2);
+    }
+
+    close(fds[1]);
+    Measurement measurement;
+    ssize_t amt_read = read(fds[0], &measurement, sizeof(Measurement));
+    close(fds[0]);
+
+    int status;
+    struct rusage usage;
+    while (wait4(pid, &status, 0, &usage) == -1) {
+        if (errno != EINTR)
+            zig_panic("wait failed");
+    }
+
+    if (WIFSIGNALED(status) && WTERMSIG(status) == SIGALRM)
+        return MeasureResultTimeout;
+    if (amt_read != sizeof(Measurement) || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        return MeasureResultCrash;
+    *out = measurement;
+    out->memory_bytes = usage.ru_maxrss * 1024.0;
+    return MeasureResultOk;
+}
+
+// the best of config->runs runs for each phase; memory hardly varies
+static MeasureResult measure(FuzzConfig *config, Buf *source, Measurement *out) {
+    for (int run = 0; run < config->runs; run += 1) {
+        Measurement measurement = {};
+        if (config->in_process) {
+            measure_in_process(config, source, &measurement);
+        } else {
+            MeasureResult result = measure_forked(config, source, &measurement);
+            if (result != MeasureResultOk)
+                return result;
+        }
+        if (run == 0) {
+            *out = measurement;
+            continue;
+        }
+        for (int i = 0; i < PhaseCount; i += 1) {
+            out->seconds[i] = min(out->seconds[i], measurement.seconds[i]);
+        }
+        out->memory_bytes = min(out->memory_bytes, measurement.memory_bytes);
+    }
+    return MeasureResultOk;
+}
+
+// the exponent p of a cost c + a * N^p, measured at N, 2N and 4N
+static double scaling_exponent(double at_1, double at_2, double at_4, double min_growth) {
+    double growth_2 = at_2 - at_1;
+    double growth_4 = at_4 - at_1;
+    if (growth_4 < min_growth)
+        return -1.0;
+    if (growth_2 <= 0.0 || growth_4 / growth_2 <= 2.0)
+        return 0.0;
+    return log2(growth_4 / growth_2 - 1.0);
+}
+
+static void check_case(FuzzConfig *config, FuzzCase *fuzz_case, CaseResult *result) {
+    memset(result, 0, sizeof(CaseResult));
+    result->verdict = CaseVerdictInconclusive;
+    if (!case_repeats(fuzz_case))
+        return;
+
+    Buf source = BUF_INIT;
+    for (int count = 64;; count *= 4) {
+        case_render(&source, fuzz_case, count * 4);
+        if (buf_len(&source) > config->max_bytes)
+            break;
+
+        result->count = count;
+        Measurement measurements[3];
+        for (int i = 0; i < 3; i += 1) {
+            case_render(&source, fuzz_case, count << i);
+            MeasureResult measure_result = measure(config, &source, &measurements[i]);
+            if (measure_result == MeasureResultCrash) {
+                result->verdict = CaseVerdictCrash;
+                return;
+            } else if (measure_result == MeasureResultTimeout) {
+                // at N the input was too small to judge; at 2N or 4N it was
+                // fast enough, the last time around
+                result->timed_out = true;
+                result->verdict = (i == 0 && count == 64) ?
+                    CaseVerdictInconclusive : CaseVerdictSuperlinear;
+                return;
+            }
+        }
+
+        bool time_judged = false;
+        bool superlinear = false;
+        // timings just over min_seconds are noisy enough to look superlinear
+        bool certain = false;
+        for (int i = 0; i < PhaseCount; i += 1) {
+            double exponent = scaling_exponent(measurements[0].seconds[i], measurements[1].seconds[i],
+                    measurements[2].seconds[i], config->min_seconds);
+            result->time_exponents[i] = exponent;
+            time_judged = time_judged || exponent >= 0.0;
+            if (exponent > config->bound) {
+                superlinear = true;
+                double growth = measurements[2].seconds[i] - measurements[0].seconds[i];
+                certain = certain || growth >= 4 * config->min_seconds;
+            }
+        }
+        result->memory_exponent = scaling_exponent(measurements[0].memory_bytes,
+                measurements[1].memory_bytes, measurements[2].memory_bytes, config->min_memory_bytes);
+        if (result->memory_exponent > config->bound) {
+            superlinear = true;
+            certain = true;
+        }
+
+        if (superlinear) {
+            // stands unless a larger N says otherwise
+            result->verdict = CaseVerdictSuperlinear;
+            if (certain)
+                return;
+            continue;
+        }
+        // memory grows enough to judge long before time does, and the time
+        // is what usually goes wrong
+        result->verdict = (result->memory_exponent >= 0.0) ? CaseVerdictLinear : CaseVerdictInconclusive;
+        if (time_judged)
+            return;
+    }
+}
+
+static void print_case_result(FuzzCase *fuzz_case, CaseResult *result, const char *note) {
+    static const char *verdict_names[] = {"linear", "superlinear", "inconclusive", "crash"};
+    fprintf(stderr, "%s: %s%s", buf_ptr(fuzz_case->name), verdict_names[result->verdict], note);
+    if (result->timed_out) {
+        fprintf(stderr, ", timed out at N = %d\n", result->count);
+        return;
+    }
+    if (result->verdict == CaseVerdictCrash) {
+        fprintf(stderr, "\n");
+        return;
+    }
+    fprintf(stderr, ", N = %d", result->count);
+    for (int i = 0; i < PhaseCount; i += 1) {
+        if (result->time_exponents[i] >= 0.0)
+            fprintf(stderr, ", %s N^%.2f", phase_names[i], result->time_exponents[i]);
+    }
+    if (result->memory_exponent >= 0.0)
+        fprintf(stderr, ", memory N^%.2f", result->memory_exponent);
+    fprintf(stderr, "\n");
+}
+
+static void init_config(FuzzConfig *config) {
+    config->bound = 1.5;
+    config->runs = 3;
+    config->timeout_seconds = 20;
+    config->min_seconds = 0.05;
+    config->min_memory_bytes = 32.0 * 1024 * 1024;
+    config->max_bytes = 4 * 1024 * 1024;
+
+    char tmp_template[] = "/tmp/zig-fuzz-XXXXXX";
+    if (!mkdtemp(tmp_template))
+        zig_panic("unable to create a temporary directory");
+    config->tmp_dir = buf_create_from_str(tmp_template);
+}
+
+#ifdef ZIG_LIBFUZZER
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    static FuzzConfig config;
+    if (!config.tmp_dir) {
+        init_config(&config);
+        config.in_process = true;
+        config.runs = 1;
+        config.min_seconds = 0.05;
+        config.max_bytes = 1024 * 1024;
+        stats_enabled = true;
+    }
+
+    FuzzCase *fuzz_case = case_create(buf_create_from_str("input"));
+    int part = 0;
+    for (size_t i = 0; i < size; i += 1) {
+        if (data[i] == 0) {
+            part += 1;
+            if (part == CasePartCount)
+                break;
+        } else {
+            buf_append_char(fuzz_case->parts[part], data[i]);
+        }
+    }
+
+    CaseResult result;
+    check_case(&config, fuzz_case, &result);
+    if (result.verdict == CaseVerdictSuperlinear) {
+        print_case_result(fuzz_case, &result, "");
+        abort();
+    }
+    for (int i = 0; i < CasePartCount; i += 1) {
+        buf_deinit(fuzz_case->parts[i]);
+        free(fuzz_case->parts[i]);
+    }
+    buf_deinit(fuzz_case->name);
+    free(fuzz_case->name);
+    free(fuzz_case);
+    return 0;
+}
+
+#else
+
+static const char *case_part_names[] = {"prefix", "open", "middle", "close", "suffix"};
+
+static FuzzCase *case_clone(FuzzCase *other, Buf *name) {
+    FuzzCase *fuzz_case = allocate<FuzzCase>(1);
+    fuzz_case->name = name;
+    for (int i = 0; i < CasePartCount; i += 1) {
+        fuzz_case->parts[i] = buf_create_from_buf(other->parts[i]);
+    }
+    return fuzz_case;
+}
+
+// A part is the text between its "@@" line and the newline before the next
+// one, so that case_write and case_parse round trip.
+static bool case_parse(FuzzCase *fuzz_case, Buf *contents) {
+    int part = -1;
+    int pos = 0;
+    int len = buf_len(contents);
+    const char *ptr = buf_ptr(contents);
+    while (pos < len) {
+        const char *newline = (const char *)memchr(ptr + pos, '\n', len - pos);
+        int line_end = newline ? (int)(newline - ptr) : len;
+        int next_pos = newline ? line_end + 1 : len;
+        BufView line = {ptr + pos, line_end - pos};
+
+        if (line.len >= 3 && memcmp(line.ptr, "@@ ", 3) == 0) {
+            BufView name = {line.ptr + 3, line.len - 3};
+            part = -1;
+            for (int i = 0; i < CasePartCount; i += 1) {
+                if (buf_view_eql_str(name, case_part_names[i]))
+                    part = i;
+            }
+            if (part == -1)
+                return false;
+            buf_resize(fuzz_case->parts[part], 0);
+        } else if (part == -1) {
+            if (buf_view_eql_str(line, "xfail"))
+                fuzz_case->xfail = true;
+        } else {
+            Buf *buf = fuzz_case->parts[part];
+            buf_append_view(buf, line);
+            // the newline belongs to the part unless a part or the end follows
+            bool last_line = next_pos == len || (len - next_pos >= 3 && memcmp(ptr + next_pos, "@@ ", 3) == 0);
+            if (newline && !last_line)
+                buf_append_char(buf, '\n');
+        }
+        pos = next_pos;
+    }
+    return true;
+}
+
+static void case_write(FuzzCase *fuzz_case, Buf *out, const char *comment) {
+    buf_resize(out, 0);
+    buf_appendf(out, "# %s\n", comment);
+    if (fuzz_case->xfail)
+        buf_append_str(out, "xfail\n");
+    for (int i = 0; i < CasePartCount; i += 1) {
+        buf_appendf(out, "@@ %s\n", case_part_names[i]);
+        buf_append_buf(out, fuzz_case->parts[i]);
+        buf_append_char(out, '\n');
+    }
+}
+
+static bool is_superlinear(FuzzConfig *config, FuzzCase *fuzz_case) {
+    CaseResult result;
+    check_case(config, fuzz_case, &result);
+    return result.verdict == CaseVerdictSuperlinear;
+}
+
+static void load_case_file(ZigList<FuzzCase *> *cases, Buf *path, Buf *name) {
+    Buf contents = BUF_INIT;
+    int err;
+    if ((err = os_fetch_file_path(path, &contents))) {
+        fprintf(stderr, "unable to open '%s': %s\n", buf_ptr(path), err_str(err));
+        exit(1);
+    }
+    FuzzCase *fuzz_case = case_create(name);
+    if (!case_parse(fuzz_case, &contents)) {
+        fprintf(stderr, "%s: unknown part\n", buf_ptr(path));
+        exit(1);
+    }
+    cases->append(fuzz_case);
+}
+
+static int compare_names(const void *a, const void *b) {
+    return strcmp(buf_ptr(*(Buf * const *)a), buf_ptr(*(Buf * const *)b));
+}
+
+// a directory contributes its *.case files, in name order
+static void load_cases(ZigList<FuzzCase *> *cases, Buf *path) {
+    DIR *dir = opendir(buf_ptr(path));
+    if (!dir) {
+        load_case_file(cases, path, path);
+        return;
+    }
+    ZigList<Buf *> names = {0};
+    struct dirent *entry;
+    while ((entry = readdir(dir))) {
+        int len = strlen(entry->d_name);
+        if (len > 5 && strcmp(entry->d_name + len - 5, ".case") == 0)
+            names.append(buf_create_from_str(entry->d_name));
+    }
+    closedir(dir);
+    qsort(names.items, names.length, sizeof(Buf *), compare_names);
+    for (int i = 0; i < names.length; i += 1) {
+        Buf *file_path = buf_alloc();
+        os_path_join(buf_view(path), buf_view(names.at(i)), file_path);
+        Buf *name = buf_create_from_mem(buf_ptr(names.at(i)), buf_len(names.at(i)) - 5);
+        load_case_file(cases, file_path, name);
+    }
+    names.deinit();
+}
+
+static uint64_t rand_state;
+
+// xorshift64, so that a seed gives the same mutants everywhere
+static uint32_t fuzz_rand(uint32_t bound) {
+    uint64_t x = rand_state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    rand_state = x;
+    return (uint32_t)(x % bound);
+}
+
+static const char *fuzz_fragments[] = {
+    "{", "}", "(", ")", "[", "]", ",", ";", ".", "\n", " ",
+    "a", "a + ", " * ", " == ", " && ", " ?? ", " %% ", "-", "!", "~", "&", "?",
+    "$i", "$n", "x$i", "0x$i", "1.5", "\"s\"", "'c'", "true", "null", "undefined",
+    "if (a) ", " else ", "while (a) ", "for (x, a) ", "return ", "break", "continue",
+    "defer ", "goto l$i", "l$i:", "switch (a) {", "$i => $i,", "else => 0,",
+    "fn f$i() {}", "fn f$i(a: i32) -> i32 {", "f$n(a)", "const c$i = ", "c$n", "var v$i: i32 = 0;",
+    "struct S$i {", "enum E$i {", "f$i: i32,", "A$i,", "S$i { .f$i = $i, }",
+    "[]i32 {", "@sizeof(", "@typeof(", "%return ", "error E$i;", "error.E$i",
+};
+
+static void mutate_part(Buf *part) {
+    int len = buf_len(part);
+    int pos = len ? fuzz_rand(len + 1) : 0;
+    Buf *out = buf_alloc();
+    switch (len ? fuzz_rand(4) : 0) {
+        case 0:
+            // insert a fragment
+            buf_append_mem(out, buf_ptr(part), pos);
+            buf_append_str(out, fuzz_fragments[fuzz_rand(array_length(fuzz_fragments))]);
+            buf_append_mem(out, buf_ptr(part) + pos, len - pos);
+            break;
+        case 1:
+            {
+                // delete a range
+                int end = pos + fuzz_rand(len - pos + 1);
+                buf_append_mem(out, buf_ptr(part), pos);
+                buf_append_mem(out, buf_ptr(part) + end, len - end);
+                break;
+            }
+        case 2:
+            {
+                // duplicate a range
+                int end = pos + fuzz_rand(len - pos + 1);
+                buf_append_mem(out, buf_ptr(part), end);
+                buf_append_mem(out, buf_ptr(part) + pos, len - pos);
+                break;
+            }
+        default:
+            // replace the part
+            buf_append_str(out, fuzz_fragments[fuzz_rand(array_length(fuzz_fragments))]);
+            break;
+    }
+    buf_resize(part, 0);
+    buf_append_buf(part, out);
+    buf_deinit(out);
+    free(out);
+}
+
+// Removes ever smaller pieces of each part for as long as the case stays
+// superlinear. Every attempt is a full check, so there is a limit.
+static void minimize_case(FuzzConfig *config, FuzzCase *fuzz_case, int max_checks) {
+    int checks = 0;
+    for (int part = 0; part < CasePartCount; part += 1) {
+        Buf *buf = fuzz_case->parts[part];
+        for (int chunk = max(buf_len(buf) / 2, 1); chunk >= 1; chunk /= 2) {
+            int pos = 0;
+            while (pos < buf_len(buf)) {
+                if (checks >= max_checks)
+                    return;
+                Buf *saved = buf_create_from_buf(buf);
+                int end = min(pos + chunk, buf_len(buf));
+                buf_resize(buf, 0);
+                buf_append_mem(buf, buf_ptr(saved), pos);
+                buf_append_mem(buf, buf_ptr(saved) + end, buf_len(saved) - end);
+                checks += 1;
+                if (!is_superlinear(config, fuzz_case)) {
+                    buf_resize(buf, 0);
+                    buf_append_buf(buf, saved);
+                    pos += chunk;
+                }
+                buf_deinit(saved);
+                free(saved);
+            }
+        }
+    }
+}
+
+static void remove_tmp_dir(FuzzConfig *config) {
+    Buf path = BUF_INIT;
+    os_path_join(buf_view(config->tmp_dir), buf_view_str("fuzz.zig"), &path);
+    unlink(buf_ptr(&path));
+    rmdir(buf_ptr(config->tmp_dir));
+}
+
+static int usage(const char *arg0) {
+    fprintf(stderr, "Usage: %s (--check | --fuzz count) [options] path...\n"
+        "Options:\n"
+        "  --bound [exponent]     largest allowed growth exponent, default 1.5\n"
+        "  --runs [count]         measurements per size, the fastest is used, default 3\n"
+        "  --timeout [seconds]    per measurement, default 20\n"
+        "  --min-seconds [time]   least growth in time which is judged, default 0.05\n"
+        "  --max-size [KiB]       largest input to measure, default 4096\n"
+        "  --seed [number]        for --fuzz, default 1\n"
+        "  --save [dir]           for --fuzz, where new cases go\n"
+        "  --minimize [count]     for --fuzz, most checks spent minimizing a case, default 200\n"
+    , arg0);
+    return 1;
+}
+
+static int check_cases(FuzzConfig *config, ZigList<FuzzCase *> *cases) {
+    int failures = 0;
+    for (int i = 0; i < cases->length; i += 1) {
+        FuzzCase *fuzz_case = cases->at(i);
+        CaseResult result;
+        check_case(config, fuzz_case, &result);
+        bool superlinear = result.verdict == CaseVerdictSuperlinear;
+        const char *note = "";
+        if (fuzz_case->xfail) {
+            note = superlinear ? " (expected)" : " (marked xfail)";
+        } else if (superlinear || result.verdict == CaseVerdictCrash) {
+            failures += 1;
+        }
+        print_case_result(fuzz_case, &result, note);
+    }
+    fprintf(stderr, "%d of %d cases failed\n", failures, cases->length);
+    return failures ? 1 : 0;
+}
+
+static int fuzz_cases(FuzzConfig *config, ZigList<FuzzCase *> *cases, int iterations,
+        Buf *save_dir, int max_minimize_checks)
+{
+    // cases which are already known to be slow would only be found again
+    ZigList<FuzzCase *> seeds = {0};
+    for (int i = 0; i < cases->length; i += 1) {
+        if (!cases->at(i)->xfail)
+            seeds.append(cases->at(i));
+    }
+    if (seeds.length == 0) {
+        fprintf(stderr, "no cases to start from\n");
+        return 1;
+    }
+
+    int found = 0;
+    for (int iteration = 0; iteration < iterations; iteration += 1) {
+        FuzzCase *seed = seeds.at(fuzz_rand(seeds.length));
+        FuzzCase *mutant = case_clone(seed, buf_sprintf("%s-%d", buf_ptr(seed->name), iteration));
+        int mutation_count = 1 + fuzz_rand(3);
+        for (int i = 0; i < mutation_count; i += 1) {
+            mutate_part(mutant->parts[fuzz_rand(CasePartCount)]);
+        }
+
+        CaseResult result;
+        check_case(config, mutant, &result);
+        if (result.verdict != CaseVerdictSuperlinear)
+            continue;
+        print_case_result(mutant, &result, "");
+
+        minimize_case(config, mutant, max_minimize_checks);
+        Buf rendered = BUF_INIT;
+        case_render(&rendered, mutant, 1);
+        Buf *basename = buf_sprintf("slow-%08x.case", buf_hash(&rendered));
+        Buf path = BUF_INIT;
+        os_path_join(buf_view(save_dir), buf_view(basename), &path);
+        Buf contents = BUF_INIT;
+        case_write(mutant, &contents, "found by frontend_fuzz");
+        os_write_file(&path, &contents);
+        fprintf(stderr, "saved %s\n", buf_ptr(&path));
+        found += 1;
+    }
+    fprintf(stderr, "%d of %d mutants were superlinear\n", found, iterations);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    FuzzConfig config = {};
+    init_config(&config);
+    bool check = false;
+    int fuzz_iterations = 0;
+    Buf *save_dir = nullptr;
+    int max_minimize_checks = 200;
+    rand_state = 1;
+    ZigList<Buf *> paths = {0};
+    stats_enabled = true;
+
+    for (int i = 1; i < argc; i += 1) {
+        char *arg = argv[i];
+        if (strcmp(arg, "--check") == 0) {
+            check = true;
+        } else if (arg[0] == '-') {
+            if (i + 1 >= argc)
+                return usage(argv[0]);
+            char *value = argv[++i];
+            if (strcmp(arg, "--fuzz") == 0) {
+                fuzz_iterations = atoi(value);
+            } else if (strcmp(arg, "--bound") == 0) {
+                config.bound = atof(value);
+            } else if (strcmp(arg, "--runs") == 0) {
+                config.runs = atoi(value);
+            } else if (strcmp(arg, "--timeout") == 0) {
+                config.timeout_seconds = atoi(value);
+            } else if (strcmp(arg, "--min-seconds") == 0) {
+                config.min_seconds = atof(value);
+            } else if (strcmp(arg, "--max-size") == 0) {
+                config.max_bytes = atoi(value) * 1024;
+            } else if (strcmp(arg, "--seed") == 0) {
+                rand_state = strtoull(value, nullptr, 10) * 2654435761u + 1;
+            } else if (strcmp(arg, "--save") == 0) {
+                save_dir = buf_create_from_str(value);
+            } else if (strcmp(arg, "--minimize") == 0) {
+                max_minimize_checks = atoi(value);
+            } else {
+                return usage(argv[0]);
+            }
+        } else {
+            paths.append(buf_create_from_str(arg));
+        }
+    }
+    if (check == (fuzz_iterations > 0) || paths.length == 0 || config.runs <= 0 ||
+        config.timeout_seconds <= 0 || config.max_bytes <= 0)
+    {
+        return usage(argv[0]);
+    }
+
+    ZigList<FuzzCase *> cases = {0};
+    for (int i = 0; i < paths.length; i += 1) {
+        load_cases(&cases, paths.at(i));
+    }
+
+    int result;
+    if (check) {
+        result = check_cases(&config, &cases);
+    } else {
+        result = fuzz_cases(&config, &cases, fuzz_iterations, save_dir ? save_dir : paths.at(0),
+                max_minimize_checks);
+    }
+    remove_tmp_dir(&config);
+    return result;
+}
+
+#endif
@@ -8,6 +8,10 @@
 #include "list.hpp"
 #include "buffer.hpp"
 #include "os.hpp"
+#include "tokenizer.hpp"
+#include "parser.hpp"
+#include "ast_cache.hpp"
+#include "ast_render.hpp"
 
 #include <stdio.h>
 #include <stdarg.h>
@@ -1474,6 +1478,23 @@ fn f(a : i32) {
 }
     )SOURCE", 1, ".tmp_source.zig:3:5: error: redeclaration of variable 'a'");
 
+    add_compile_fail_case("local variable out of scope", R"SOURCE(
+fn f() -> i32 {
+    {
+        const a : i32 = 1;
+    }
+    {
+        const a : i32 = 2;
+        {
+            const a : i32 = 3;
+        }
+    }
+    a
+}
+    )SOURCE", 2,
+            ".tmp_source.zig:9:13: error: redeclaration of variable 'a'",
+            ".tmp_source.zig:12:5: error: use of undeclared identifier 'a'");
+
     add_compile_fail_case("variable has wrong type", R"SOURCE(
 fn f() -> i32 {
     const a = c"a";
@@ -1879,6 +1900,311 @@ static void run_all_tests(bool reverse) {
     printf("%d tests passed.\n", test_cases.length);
 }
 
+static void unit_test_fail(const char *case_name, const char *format, ...) {
+    va_list ap;
+    va_start(ap, format);
+    printf("\nTest failed: %s\n", case_name);
+    vprintf(format, ap);
+    printf("\n");
+    va_end(ap);
+    exit(1);
+}
+
+// tokenize_parallel must give exactly what tokenize gives
+static void check_parallel_tokenize(const char *case_name, Buf *source) {
+    printf("Tokenizer test %s...", case_name);
+    Tokenization serial = {0};
+    tokenize(source, &serial);
+    Tokenization parallel = {0};
+    tokenize_parallel(source, &parallel, 4);
+
+    if (!serial.err != !parallel.err) {
+        unit_test_fail(case_name, "error mismatch");
+    }
+    if (serial.err && (!buf_eql_buf(serial.err, parallel.err) ||
+        serial.err_line != parallel.err_line || serial.err_column != parallel.err_column))
+    {
+        unit_test_fail(case_name, "expected error '%s' at %d:%d, got '%s' at %d:%d",
+                buf_ptr(serial.err), serial.err_line, serial.err_column,
+                buf_ptr(parallel.err), parallel.err_line, parallel.err_column);
+    }
+    if (serial.tokens->length != parallel.tokens->length) {
+        unit_test_fail(case_name, "expected %d tokens, got %d",
+                serial.tokens->length, parallel.tokens->length);
+    }
+    for (int i = 0; i < serial.tokens->length; i += 1) {
+        Token *a = &serial.tokens->at(i);
+        Token *b = &parallel.tokens->at(i);
+        if (a->id != b->id || a->start_pos != b->start_pos || a->end_pos != b->end_pos) {
+            unit_test_fail(case_name, "token %d differs", i);
+        }
+    }
+    if (serial.line_offsets->length != parallel.line_offsets->length) {
+        unit_test_fail(case_name, "expected %d lines, got %d",
+                serial.line_offsets->length, parallel.line_offsets->length);
+    }
+    for (int i = 0; i < serial.line_offsets->length; i += 1) {
+        if (serial.line_offsets->at(i) != parallel.line_offsets->at(i)) {
+            unit_test_fail(case_name, "line offset %d differs", i);
+        }
+    }
+    if (serial.number_literals->length != parallel.number_literals->length) {
+        unit_test_fail(case_name, "expected %d number literals, got %d",
+                serial.number_literals->length, parallel.number_literals->length);
+    }
+    for (int i = 0; i < serial.number_literals->length; i += 1) {
+        NumberLiteralInfo *a = &serial.number_literals->at(i);
+        NumberLiteralInfo *b = &parallel.number_literals->at(i);
+        if (a->token_index != b->token_index || a->radix != b->radix ||
+            a->decimal_point_pos != b->decimal_point_pos ||
+            a->exponent_marker_pos != b->exponent_marker_pos)
+        {
+            unit_test_fail(case_name, "number literal %d differs", i);
+        }
+    }
+    printf("OK\n");
+}
+
+static void append_code_lines(Buf *source, int byte_count) {
+    int target = buf_len(source) + byte_count;
+    for (int i = 0; buf_len(source) < target; i += 1) {
+        buf_appendf(source, "const value_%d: u32 = %d + 0x1f * 2.5e3; // \"comment\"\n", i, i);
+        buf_appendf(source, "fn f_%d(a: i32) -> i32 { if (a > 0) { return a %% 7; } else { return -a; } }\n", i);
+    }
+}
+
+// the inputs are big enough to be split in 4 chunks, and the strings and
+// comments are big enough that some chunks start inside them
+static void run_tokenizer_tests(void) {
+    int mib = 1024 * 1024;
+    Buf *source = buf_alloc();
+
+    append_code_lines(source, 5 * mib);
+    check_parallel_tokenize("parallel plain code", source);
+
+    buf_resize(source, 0);
+    append_code_lines(source, mib);
+    buf_append_str(source, "const s = \"\n");
+    append_code_lines(source, mib);
+    buf_append_str(source, "/* not a comment\n");
+    append_code_lines(source, mib);
+    buf_append_str(source, "\";\n");
+    append_code_lines(source, 2 * mib);
+    check_parallel_tokenize("parallel multi-line string", source);
+
+    buf_resize(source, 0);
+    append_code_lines(source, mib);
+    buf_append_str(source, "/* outer /* nested\n");
+    append_code_lines(source, mib);
+    buf_append_str(source, "*/ \"still a comment\n");
+    append_code_lines(source, mib);
+    buf_append_str(source, "*/\n");
+    append_code_lines(source, 2 * mib);
+    check_parallel_tokenize("parallel nested comment", source);
+
+    buf_resize(source, 0);
+    append_code_lines(source, 3 * mib);
+    buf_append_str(source, "const bad = $;\n");
+    append_code_lines(source, 2 * mib);
+    check_parallel_tokenize("parallel error in a later chunk", source);
+
+    buf_resize(source, 0);
+    append_code_lines(source, 2 * mib);
+    buf_append_str(source, "/* unterminated\n");
+    append_code_lines(source, 3 * mib);
+    check_parallel_tokenize("parallel unterminated comment", source);
+}
+
+static AstNode *parse_test_source(const char *case_name, Buf *source) {
+    Tokenization tokenization = {0};
+    tokenize(source, &tokenization);
+    if (tokenization.err) {
+        unit_test_fail(case_name, "%s", buf_ptr(tokenization.err));
+    }
+    ImportTableEntry *import = allocate<ImportTableEntry>(1);
+    import->source_code = source;
+    import->line_offsets = tokenization.line_offsets;
+    import->path = buf_create_from_str(case_name);
+    import->ast_arena.category = AllocCategoryAst;
+    uint32_t next_node_index = 0;
+    import->root = ast_parse(source, &tokenization, import, ErrColorOff, &next_node_index);
+    return import->root;
+}
+
+static AstNode *root_var_expr(AstNode *root) {
+    AstNode *decl = root->data.root.top_level_decls.at(0);
+    assert(decl->type == NodeTypeVariableDeclaration);
+    return decl->data.variable_declaration.expr;
+}
+
+static int test_bin_op_precedence(BinOpType bin_op) {
+    switch (bin_op) {
+        case BinOpTypeBoolOr: return 1;
+        case BinOpTypeBoolAnd: return 2;
+        case BinOpTypeCmpEq: return 3;
+        case BinOpTypeBinOr: return 4;
+        case BinOpTypeBinXor: return 5;
+        case BinOpTypeBinAnd: return 6;
+        case BinOpTypeBitShiftLeft: return 7;
+        case BinOpTypeAdd: return 8;
+        case BinOpTypeMult: return 9;
+        default: zig_unreachable();
+    }
+}
+
+// long operator chains such as those in generated code must neither
+// recurse once per operand nor change shape
+static void run_parser_tests(void) {
+    static const int term_count = 100000;
+    Buf *source = buf_alloc();
+
+    printf("Parser test 100k term addition...");
+    buf_append_str(source, "const x = a");
+    for (int i = 1; i < term_count; i += 1) {
+        buf_append_str(source, " + a");
+    }
+    buf_append_str(source, ";\n");
+    AstNode *node = root_var_expr(parse_test_source("100k term addition", source));
+    int depth = 0;
+    while (node->type == NodeTypeBinOpExpr) {
+        if (node->data.bin_op_expr.bin_op != BinOpTypeAdd ||
+            node->data.bin_op_expr.op2->type != NodeTypeSymbol)
+        {
+            unit_test_fail("100k term addition", "not left associative at depth %d", depth);
+        }
+        node = node->data.bin_op_expr.op1;
+        depth += 1;
+    }
+    if (depth != term_count - 1) {
+        unit_test_fail("100k term addition", "expected %d operators, got %d", term_count - 1, depth);
+    }
+    printf("OK\n");
+
+    // every operator binds at least as tightly as its parent, and strictly
+    // more tightly when it is the right operand
+    printf("Parser test 100k term mixed operators...");
+    static const char *ops[] = {" * ", " + ", " << ", " & ", " ^ ", " | ", " == ", " && ", " || "};
+    buf_resize(source, 0);
+    buf_append_str(source, "const x = a");
+    for (int i = 1; i < term_count; i += 1) {
+        buf_append_str(source, ops[i % array_length(ops)]);
+        buf_append_str(source, "a");
+    }
+    buf_append_str(source, ";\n");
+    node = root_var_expr(parse_test_source("100k term mixed operators", source));
+    ZigList<AstNode *> stack = {0};
+    stack.append(node);
+    int op_count = 0;
+    while (stack.length > 0) {
+        node = stack.pop();
+        if (node->type != NodeTypeBinOpExpr)
+            continue;
+        op_count += 1;
+        int precedence = test_bin_op_precedence(node->data.bin_op_expr.bin_op);
+        AstNode *op1 = node->data.bin_op_expr.op1;
+        AstNode *op2 = node->data.bin_op_expr.op2;
+        if ((op1->type == NodeTypeBinOpExpr &&
+                test_bin_op_precedence(op1->data.bin_op_expr.bin_op) < precedence) ||
+            (op2->type == NodeTypeBinOpExpr &&
+                test_bin_op_precedence(op2->data.bin_op_expr.bin_op) <= precedence))
+        {
+            unit_test_fail("100k term mixed operators", "operator %d binds wrong", op_count);
+        }
+        stack.append(op1);
+        stack.append(op2);
+    }
+    if (op_count != term_count - 1) {
+        unit_test_fail("100k term mixed operators", "expected %d operators, got %d",
+                term_count - 1, op_count);
+    }
+    stack.deinit();
+    printf("OK\n");
+}
+
+static void ast_print_to_buf(AstNode *root, Buf *out) {
+    char *ptr;
+    size_t len;
+    FILE *f = open_memstream(&ptr, &len);
+    ast_print(f, root, 0);
+    fclose(f);
+    buf_init_from_mem(out, ptr, (int)len);
+    free(ptr);
+}
+
+// every test program which parses must come back from the AST cache format
+// unchanged
+static void run_ast_cache_tests(void) {
+    printf("AST cache test round trip of test sources...");
+    Buf data = BUF_INIT;
+    Buf data_again = BUF_INIT;
+    Buf printed = BUF_INIT;
+    Buf printed_again = BUF_INIT;
+    int file_count = 0;
+    for (int case_i = 0; case_i < test_cases.length; case_i += 1) {
+        TestCase *test_case = test_cases.at(case_i);
+        for (int file_i = 0; file_i < test_case->source_files.length; file_i += 1) {
+            Buf *source = buf_create_from_str(test_case->source_files.at(file_i).source_code);
+            Tokenization tokenization = {0};
+            tokenize(source, &tokenization);
+            if (tokenization.err)
+                continue;
+            ImportTableEntry *import = allocate<ImportTableEntry>(1);
+            import->source_code = source;
+            import->line_offsets = tokenization.line_offsets;
+            import->path = buf_create_from_str(test_case->case_name);
+            import->ast_arena.category = AllocCategoryAst;
+            uint32_t node_count = 0;
+            ErrorMsg *parse_err;
+            import->root = ast_try_parse(source, &tokenization, import, &node_count, &parse_err);
+            if (!import->root)
+                continue;
+            ast_serialize(&data, 1, import, node_count);
+
+            ImportTableEntry *cached = allocate<ImportTableEntry>(1);
+            cached->source_code = source;
+            cached->path = import->path;
+            cached->ast_arena.category = AllocCategoryAst;
+            uint32_t cached_node_count = 0;
+            if (ast_deserialize(&data, 1, cached, &cached_node_count) != AstCacheResultHit) {
+                unit_test_fail(test_case->case_name, "cache entry rejected");
+            }
+            ast_serialize(&data_again, 1, cached, cached_node_count);
+            ast_print_to_buf(import->root, &printed);
+            ast_print_to_buf(cached->root, &printed_again);
+            if (!buf_eql_buf(&data, &data_again) || !buf_eql_buf(&printed, &printed_again) ||
+                cached_node_count != node_count ||
+                cached->line_offsets->length != import->line_offsets->length)
+            {
+                unit_test_fail(test_case->case_name, "AST changed in the cache");
+            }
+
+            // a damaged entry, one from another compiler and one for other
+            // source are all rejected
+            buf_ptr(&data)[buf_len(&data) - 1] ^= 1;
+            if (ast_deserialize(&data, 1, cached, &cached_node_count) != AstCacheResultStale) {
+                unit_test_fail(test_case->case_name, "damaged cache entry accepted");
+            }
+            buf_ptr(&data)[buf_len(&data) - 1] ^= 1;
+            if (ast_deserialize(&data, 2, cached, &cached_node_count) != AstCacheResultStale) {
+                unit_test_fail(test_case->case_name, "cache entry from another compiler accepted");
+            }
+            cached->source_code = buf_sprintf("%s ", buf_ptr(source));
+            if (ast_deserialize(&data, 1, cached, &cached_node_count) != AstCacheResultStale) {
+                unit_test_fail(test_case->case_name, "cache entry for other source accepted");
+            }
+            file_count += 1;
+        }
+    }
+    if (file_count == 0) {
+        unit_test_fail("AST cache round trip", "no test sources parsed");
+    }
+    buf_deinit(&data);
+    buf_deinit(&data_again);
+    buf_deinit(&printed);
+    buf_deinit(&printed_again);
+    printf("OK (%d files)\n", file_count);
+}
+
 static void cleanup(void) {
     remove(tmp_source_path);
     remove(tmp_exe_path);
@@ -1898,8 +2224,11 @@ int main(int argc, char **argv) {
             return usage(argv[0]);
         }
     }
+    run_tokenizer_tests();
+    run_parser_tests();
     add_compiling_test_cases();
     add_compile_failure_test_cases();
+    run_ast_cache_tests();
     run_all_tests(reverse);
     cleanup();
 }